@@ -0,0 +1,53 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "proccli/snapshot_compact.h"
+
+namespace {
+
+proccli::DiagnosticsSnapshot syntheticSnapshot(int entries) {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 1;
+  proccli::PerfReport perf;
+  proccli::StraceReport strace;
+  for (int i = 0; i < entries; ++i) {
+    snapshot.processes.push_back({i + 1, 1, "/usr/bin/worker --shard " + std::to_string(i),
+                                  2048 + i % 512, 4096, (i % 100) / 10.0, 0.1, "00:01", 1});
+    snapshot.io.push_back({i + 1, i * 4096LL, i * 1024LL});
+    perf.hotspots.push_back({"ns::Class::method" + std::to_string(i) + "()", (i % 100) / 10.0});
+  }
+  for (int i = 0; i < 400; ++i) {
+    strace.top_syscalls.push_back({"syscall" + std::to_string(i), 100, 1.5, std::nullopt});
+  }
+  snapshot.perf = perf;
+  snapshot.strace = strace;
+  return snapshot;
+}
+
+void BM_CompactSnapshot(benchmark::State &state) {
+  auto entries = static_cast<int>(state.range(0));
+  auto snapshot = syntheticSnapshot(entries);
+  size_t tokens = 0;
+  for (auto _ : state) {
+    auto compact = proccli::compactSnapshot(snapshot);
+    tokens = compact.tokens;
+    benchmark::DoNotOptimize(compact);
+  }
+  state.counters["tokens"] = static_cast<double>(tokens);
+  state.SetItemsProcessed(state.iterations() * entries);
+}
+BENCHMARK(BM_CompactSnapshot)->Arg(1000)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+void BM_FullSnapshotDump(benchmark::State &state) {
+  auto snapshot = syntheticSnapshot(static_cast<int>(state.range(0)));
+  size_t tokens = 0;
+  for (auto _ : state) {
+    tokens = proccli::estimateTokens(nlohmann::json(snapshot).dump());
+    benchmark::DoNotOptimize(tokens);
+  }
+  state.counters["tokens"] = static_cast<double>(tokens);
+}
+BENCHMARK(BM_FullSnapshotDump)->Arg(1000)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+} // namespace
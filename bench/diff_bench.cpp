@@ -0,0 +1,42 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "proccli/snapshot_diff.h"
+
+namespace {
+
+proccli::DiagnosticsSnapshot syntheticSnapshot(int entries, int seed) {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 1;
+  proccli::PerfReport perf;
+  proccli::StraceReport strace;
+  for (int i = 0; i < entries; ++i) {
+    snapshot.processes.push_back({i + 1, 1, "/usr/bin/worker --shard " + std::to_string(i),
+                                  2048 + (i * seed) % 512, 4096, 0.5, 0.1, "00:01", 1});
+    snapshot.io.push_back({i + 1, i * 4096LL * seed, i * 1024LL});
+    perf.hotspots.push_back({"ns::Class::method" + std::to_string(i + seed) + "()",
+                             (i % 100) / 10.0});
+  }
+  for (int i = 0; i < 400; ++i) {
+    strace.top_syscalls.push_back({"syscall" + std::to_string(i), 100 * seed, 1.5 * seed,
+                                   std::nullopt});
+  }
+  snapshot.perf = perf;
+  snapshot.strace = strace;
+  return snapshot;
+}
+
+void BM_DiffSnapshots(benchmark::State &state) {
+  auto entries = static_cast<int>(state.range(0));
+  auto baseline = syntheticSnapshot(entries, 1);
+  auto current = syntheticSnapshot(entries, 2);
+  for (auto _ : state) {
+    auto diff = proccli::diffSnapshots(baseline, current);
+    benchmark::DoNotOptimize(diff);
+  }
+  state.SetItemsProcessed(state.iterations() * entries);
+}
+BENCHMARK(BM_DiffSnapshots)->Arg(50000)->Unit(benchmark::kMillisecond);
+
+} // namespace
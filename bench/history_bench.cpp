@@ -0,0 +1,59 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include "proccli/history.h"
+
+namespace {
+
+const std::string &historyRoot() {
+  static const std::string root = [] {
+    auto path = std::filesystem::temp_directory_path() /
+                ("proccli-history-bench-" + std::to_string(getpid()));
+    std::filesystem::remove_all(path);
+    std::string error;
+    for (int i = 0; i < 10000; ++i) {
+      char stamp[32];
+      std::snprintf(stamp, sizeof(stamp), "2026-%02d-%02dT%02d:%02d:00Z", 1 + i / 2000,
+                    1 + i / 80 % 25, i / 60 % 24, i % 60);
+      proccli::HistoryEntry entry;
+      entry.dir = (path / stamp).string();
+      entry.captured_at = stamp;
+      entry.pid = 1000 + i % 50;
+      entry.command = "./service-" + std::to_string(i % 50) + " --config /etc/service.yaml";
+      entry.cpu_percent = (i * 37) % 400 / 4.0;
+      entry.rss_kb = 100000 + i * 13;
+      entry.read_bytes = i * 4096LL;
+      entry.write_bytes = i * 1024LL;
+      entry.status = i % 10 == 0 ? "perf:partial" : "ok";
+      entry.top_hotspot = "ns::Handler::process(Request const&)";
+      entry.top_hotspot_percent = 42.0;
+      entry.top_syscall = "futex";
+      entry.top_syscall_ms = 12.5;
+      proccli::appendHistory(path.string(), entry, error);
+    }
+    return path.string();
+  }();
+  return root;
+}
+
+void BM_QueryHistory(benchmark::State &state) {
+  const std::string &root = historyRoot();
+  proccli::HistoryQuery query;
+  query.command = "service-7 ";
+  query.sort = "rss";
+  query.limit = 20;
+  for (auto _ : state) {
+    std::string error;
+    auto entries = proccli::queryHistory(proccli::readHistory(root, error), query);
+    benchmark::DoNotOptimize(entries);
+  }
+  state.SetItemsProcessed(state.iterations() * 10000);
+}
+BENCHMARK(BM_QueryHistory)->Unit(benchmark::kMillisecond);
+
+} // namespace
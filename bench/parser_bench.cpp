@@ -0,0 +1,164 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+
+#include "proccli/collectors.h"
+#include "proccli/massif.h"
+
+namespace {
+
+std::string syntheticSmaps(int mappings) {
+  std::string content;
+  for (int i = 0; i < mappings; ++i) {
+    content += i % 4 == 0 ? "7f0000000000-7f0000002000 r-xp 00002000 fe:00 12 /usr/lib/libx" +
+                                std::to_string(i % 64) + ".so\n"
+                          : std::string("7e0000000000-7e0000019000 rw-p 00000000 00:00 0 \n");
+    content +=
+        "Size:                100 kB\nKernelPageSize:        4 kB\nMMUPageSize:           4 kB\n"
+        "Rss:                  60 kB\nPss:                  60 kB\nPss_Dirty:            60 kB\n"
+        "Shared_Clean:          0 kB\nShared_Dirty:          0 kB\nPrivate_Clean:         0 kB\n"
+        "Private_Dirty:        60 kB\nReferenced:           60 kB\nAnonymous:            60 kB\n"
+        "KSM:                   0 kB\nLazyFree:              0 kB\nAnonHugePages:         0 kB\n"
+        "Swap:                  0 kB\nSwapPss:               0 kB\nLocked:                0 kB\n"
+        "THPeligible:           0\nVmFlags: rd wr mr mw me ac\n";
+  }
+  return content;
+}
+
+void BM_ParseSmaps(benchmark::State &state) {
+  std::string content = syntheticSmaps(static_cast<int>(state.range(0)));
+  for (auto _ : state) {
+    auto memory = proccli::ProcfsCollector::parseSmaps(1, content, true);
+    benchmark::DoNotOptimize(memory);
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<long long>(content.size()));
+}
+BENCHMARK(BM_ParseSmaps)->Arg(100000)->Unit(benchmark::kMillisecond);
+
+std::string repeat(const std::string &block, size_t bytes) {
+  std::string content;
+  content.reserve(bytes + block.size());
+  while (content.size() < bytes) {
+    content += block;
+  }
+  return content;
+}
+
+std::string syntheticValgrind(size_t bytes) {
+  return repeat("==48213== Invalid read of size 4\n"
+                "==48213==    at 0x109A2C: Session::flush() (session.cpp:88)\n"
+                "==48213==    by 0x10A113: Server::poll() (server.cpp:211)\n"
+                "==48213==  Address 0x4e2d0b0 is 0 bytes after a block of size 16 alloc'd\n"
+                "==48213==\n",
+                bytes) +
+         "==48213== LEAK SUMMARY:\n"
+         "==48213==    definitely lost: 40,960 bytes in 10 blocks\n"
+         "==48213==    indirectly lost: 1,048,576 bytes in 1 blocks\n"
+         "==48213==      possibly lost: 3,072 bytes in 3 blocks\n"
+         "==48213==    still reachable: 488,448 bytes in 197 blocks\n"
+         "==48213== ERROR SUMMARY: 3 errors from 3 contexts (suppressed: 0 from 0)\n";
+}
+
+std::string syntheticPerfReport(size_t bytes) {
+  return repeat("    38.12%  server   server               [.] Session::flush\n"
+                "    21.07%  server   libc.so.6            [.] __memmove_avx_unaligned_erms\n"
+                "     9.50%  server   [kernel.kallsyms]    [k] copy_user_enhanced_fast_string\n"
+                "#\n",
+                bytes);
+}
+
+std::string syntheticPs(size_t bytes) {
+  return repeat("   4411    4402 /usr/bin/python3 -m http.server 8000  19876 34560  1.5  0.1 "
+                "1-02:03:04\n"
+                "   9003       1 ./server --port 8080 --threads=4 1581056 2202876 97.3 9.8 00:42\n",
+                bytes);
+}
+
+std::string syntheticStrace(size_t bytes) {
+  return repeat("[pid 48213] 10:15:02.250200 read(7, \"GET / HTTP/1.1\\r\\n\", 4096) = 27 "
+                "<0.000011>\n"
+                "[pid 48214] 10:15:02.250310 <... futex resumed>) = 0 <0.250160>\n"
+                "48215 10:15:02.250500 openat(AT_FDCWD, \"/etc/hosts\", O_RDONLY) = 8 <0.000031>\n",
+                bytes);
+}
+
+std::string syntheticMemInfo(size_t bytes) {
+  return repeat("MemTotal:       32572968 kB\nMemFree:         9917344 kB\n"
+                "MemAvailable:   24330508 kB\nCached:         13068968 kB\n",
+                bytes);
+}
+
+std::string syntheticMassif(size_t bytes) {
+  std::string tree = "n40: 41943040 (heap allocation functions) malloc/new/new[], --alloc-fns, etc.\n";
+  for (int site = 0; site < 40; ++site) {
+    std::string index = std::to_string(site);
+    tree += " n2: 1048576 0x1092" + index + ": Cache::insert" + index + "(Key const&) (cache.cc:" +
+            index + ")\n"
+            "  n1: 786432 0x1093" + index + ": Loader::append(Record const&) (loader.cc:77)\n"
+            "   n0: 786432 0x1094" + index + ": main (main.cc:22)\n"
+            "  n0: 262144 0x1095" + index + ": main (main.cc:18)\n";
+  }
+  std::string content = "desc: (none)\ncmd: ./server\ntime_unit: i\n";
+  content.reserve(bytes + tree.size() * 2);
+  for (int snapshot = 0; content.size() < bytes; ++snapshot) {
+    content += "#-----------\nsnapshot=" + std::to_string(snapshot) +
+               "\n#-----------\ntime=" + std::to_string(snapshot * 1000) +
+               "\nmem_heap_B=" + std::to_string(41943040 + snapshot) +
+               "\nmem_heap_extra_B=65536\nmem_stacks_B=0\nheap_tree=detailed\n" + tree;
+  }
+  return content;
+}
+
+template <typename Parse>
+void runParser(benchmark::State &state, const std::string &content, Parse parse) {
+  for (auto _ : state) {
+    auto result = parse(content);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<long long>(content.size()));
+}
+
+void BM_ParseValgrind(benchmark::State &state) {
+  runParser(state, syntheticValgrind(static_cast<size_t>(state.range(0))),
+            proccli::ValgrindCollector::parse);
+}
+BENCHMARK(BM_ParseValgrind)->Arg(8 << 20)->Unit(benchmark::kMillisecond);
+
+void BM_ParsePerfReport(benchmark::State &state) {
+  auto threads = static_cast<size_t>(state.range(1));
+  runParser(state, syntheticPerfReport(static_cast<size_t>(state.range(0))),
+            [threads](const std::string &text) { return proccli::PerfCollector::parse(text, threads); });
+}
+BENCHMARK(BM_ParsePerfReport)
+    ->ArgsProduct({{8 << 20}, {1, 2, 4, 8, 16}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+void BM_ParsePs(benchmark::State &state) {
+  runParser(state, syntheticPs(static_cast<size_t>(state.range(0))), proccli::PsCollector::parse);
+}
+BENCHMARK(BM_ParsePs)->Arg(8 << 20)->Unit(benchmark::kMillisecond);
+
+void BM_ParseStrace(benchmark::State &state) {
+  auto threads = static_cast<size_t>(state.range(1));
+  runParser(state, syntheticStrace(static_cast<size_t>(state.range(0))),
+            [threads](const std::string &text) { return proccli::StraceCollector::parse(text, threads); });
+}
+BENCHMARK(BM_ParseStrace)
+    ->ArgsProduct({{64 << 20}, {1, 2, 4, 8, 16}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+void BM_ParseMemInfo(benchmark::State &state) {
+  runParser(state, syntheticMemInfo(static_cast<size_t>(state.range(0))),
+            proccli::ProcfsCollector::parseMemInfo);
+}
+BENCHMARK(BM_ParseMemInfo)->Arg(1 << 20)->Unit(benchmark::kMillisecond);
+
+void BM_ParseMassif(benchmark::State &state) {
+  runParser(state, syntheticMassif(static_cast<size_t>(state.range(0))),
+            [](const std::string &text) { return proccli::parseMassif(text); });
+}
+BENCHMARK(BM_ParseMassif)->Arg(32 << 20)->Unit(benchmark::kMillisecond);
+
+} // namespace
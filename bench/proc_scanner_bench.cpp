@@ -0,0 +1,79 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "proccli/collectors.h"
+#include "proccli/proc_scanner.h"
+
+namespace {
+
+std::filesystem::path syntheticProcRoot(int processes) {
+  auto root = std::filesystem::temp_directory_path() /
+              ("proccli_bench_proc_" + std::to_string(getpid()) + "_" + std::to_string(processes));
+  if (std::filesystem::exists(root / "uptime")) {
+    return root;
+  }
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "uptime") << "864000.00 100.00\n";
+  std::ofstream(root / "meminfo") << "MemTotal:       65536000 kB\n";
+  for (int pid = 1; pid <= processes; ++pid) {
+    auto dir = root / std::to_string(pid);
+    std::filesystem::create_directories(dir);
+    std::ofstream(dir / "stat") << pid << " (worker-" << pid << ") S " << (pid > 1 ? pid / 8 + 1 : 0)
+                                << " 1 1 0 -1 4194560 1200 0 3 0 " << pid * 7 << " " << pid * 3
+                                << " 0 0 20 0 4 0 " << pid * 11 << " 268435456 " << 1000 + pid
+                                << " 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 " << pid % 16
+                                << " 0 0 0 0 0\n";
+    std::ofstream(dir / "cmdline", std::ios::binary)
+        << "/usr/bin/worker" << '\0' << "--id" << '\0' << pid << '\0';
+  }
+  return root;
+}
+
+void BM_NativeScanSynthetic(benchmark::State &state) {
+  auto root = syntheticProcRoot(static_cast<int>(state.range(0)));
+  proccli::ProcScanner scanner(root.string());
+  for (auto _ : state) {
+    auto processes = scanner.scan();
+    benchmark::DoNotOptimize(processes);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_NativeScanSynthetic)->Arg(1000)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+void BM_PsParseSynthetic(benchmark::State &state) {
+  auto root = syntheticProcRoot(static_cast<int>(state.range(0)));
+  proccli::ProcScanner scanner(root.string());
+  std::string text = proccli::PsCollector::format(*scanner.scan());
+  for (auto _ : state) {
+    auto processes = proccli::PsCollector::parse(text);
+    benchmark::DoNotOptimize(processes);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PsParseSynthetic)->Arg(1000)->Arg(20000)->Unit(benchmark::kMillisecond);
+
+void BM_NativeScanLive(benchmark::State &state) {
+  proccli::ProcScanner scanner;
+  for (auto _ : state) {
+    auto processes = scanner.scan();
+    benchmark::DoNotOptimize(processes);
+  }
+}
+BENCHMARK(BM_NativeScanLive)->Unit(benchmark::kMillisecond);
+
+void BM_PsExecLive(benchmark::State &state) {
+  proccli::PsCollector collector;
+  for (auto _ : state) {
+    auto result = collector.collect();
+    auto processes = proccli::PsCollector::parse(result.output);
+    benchmark::DoNotOptimize(processes);
+  }
+}
+BENCHMARK(BM_PsExecLive)->Unit(benchmark::kMillisecond);
+
+} // namespace
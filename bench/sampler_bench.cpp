@@ -0,0 +1,59 @@
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+#include "proccli/collectors.h"
+#include "proccli/proc_scanner.h"
+#include "proccli/sampler.h"
+#include "proccli/utils.h"
+
+namespace {
+
+std::vector<int> livePids(size_t limit) {
+  proccli::ProcScanner scanner;
+  auto pids = scanner.listPids();
+  if (pids.size() > limit) {
+    pids.resize(limit);
+  }
+  return pids;
+}
+
+void BM_ReadFileSampling(benchmark::State &state) {
+  auto pids = livePids(static_cast<size_t>(state.range(0)));
+  proccli::ProcfsCollector collector;
+  for (auto _ : state) {
+    for (int pid : pids) {
+      proccli::ProcCounters counters;
+      auto stat = proccli::readFile("/proc/" + std::to_string(pid) + "/stat");
+      proccli::parseStatCounters(stat, counters);
+      if (auto status = collector.collectStatus(pid)) {
+        proccli::parseStatusCounters(status->output, counters);
+      }
+      if (auto io = collector.collectIo(pid)) {
+        proccli::parseIoCounters(io->output, counters);
+      }
+      benchmark::DoNotOptimize(counters);
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<long long>(pids.size()));
+}
+BENCHMARK(BM_ReadFileSampling)->Arg(1)->Arg(64)->Arg(1024);
+
+void BM_PreadSampling(benchmark::State &state) {
+  auto pids = livePids(static_cast<size_t>(state.range(0)));
+  proccli::ProcfsSampler sampler;
+  for (int pid : pids) {
+    sampler.add(pid);
+  }
+  std::vector<proccli::PidCounters> samples;
+  std::vector<int> exited;
+  for (auto _ : state) {
+    sampler.sample(samples, exited);
+    benchmark::DoNotOptimize(samples.data());
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<long long>(sampler.size()));
+}
+BENCHMARK(BM_PreadSampling)->Arg(1)->Arg(64)->Arg(1024);
+
+} // namespace
@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+
+#include <filesystem>
+#include <string>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/snapshot_binary.h"
+#include "proccli/utils.h"
+
+namespace {
+
+proccli::DiagnosticsSnapshot syntheticSnapshot(int processes) {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 1;
+  snapshot.target.command = "./server";
+  for (int i = 0; i < processes; ++i) {
+    snapshot.processes.push_back({i + 1, i / 8, "/usr/bin/worker --shard " + std::to_string(i % 512),
+                                  2048 + i, 4096 + i, 0.5, 0.1, "01:02:03", 1 + i % 16});
+    snapshot.threads.push_back({i + 1, "worker-" + std::to_string(i % 64), "S", 0.1, 1.5, 100.0 + i,
+                                i, i / 2, i % 8});
+  }
+  proccli::PerfReport perf;
+  perf.event = "cpu-clock";
+  perf.samples = processes;
+  for (int i = 0; i < processes / 4; ++i) {
+    perf.frames.push_back({"ns::Class::method" + std::to_string(i) + "(int, std::string const&)",
+                           1.0, 0.5});
+  }
+  snapshot.perf = perf;
+  proccli::StraceReport strace;
+  for (int i = 0; i < 300; ++i) {
+    proccli::LatencySummary latency;
+    latency.count = 1000;
+    for (int b = 0; b < 40; ++b) {
+      latency.buckets.push_back({1LL << (b % 30), 25});
+    }
+    strace.top_syscalls.push_back({"syscall" + std::to_string(i), 1000, 12.5, latency});
+  }
+  snapshot.strace = strace;
+  snapshot.quality.collectors = {{"ps", "ok", std::nullopt, 10.0},
+                                 {"perf", "partial", std::string("deadline exceeded"), 11000.0}};
+  return snapshot;
+}
+
+const std::filesystem::path &snapshotDir() {
+  static const std::filesystem::path dir = [] {
+    auto path = std::filesystem::temp_directory_path() /
+                ("proccli-snapshot-bench-" + std::to_string(getpid()));
+    auto snapshot = syntheticSnapshot(200000);
+    nlohmann::json json = snapshot;
+    proccli::writeFile((path / "normalized.json").string(), json.dump(2));
+    std::string error;
+    proccli::writeSnapshotBinary((path / "normalized.bin").string(), snapshot, error);
+    return path;
+  }();
+  return dir;
+}
+
+void BM_LoadSnapshotJson(benchmark::State &state) {
+  std::string path = (snapshotDir() / "normalized.json").string();
+  for (auto _ : state) {
+    auto json = nlohmann::json::parse(proccli::readFile(path));
+    auto snapshot = proccli::snapshotFromJson(json);
+    benchmark::DoNotOptimize(snapshot);
+  }
+  state.counters["file_mb"] = static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+}
+BENCHMARK(BM_LoadSnapshotJson)->Unit(benchmark::kMillisecond);
+
+void BM_LoadSnapshotBinary(benchmark::State &state) {
+  std::string path = (snapshotDir() / "normalized.bin").string();
+  for (auto _ : state) {
+    proccli::SnapshotReader reader;
+    proccli::DiagnosticsSnapshot snapshot;
+    std::string error;
+    bool ok = reader.open(path, error) && reader.readAll(snapshot, error);
+    benchmark::DoNotOptimize(ok);
+    benchmark::DoNotOptimize(snapshot);
+  }
+  state.counters["file_mb"] = static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+}
+BENCHMARK(BM_LoadSnapshotBinary)->Unit(benchmark::kMillisecond);
+
+void BM_LoadSnapshotBinaryReportSections(benchmark::State &state) {
+  std::string path = (snapshotDir() / "normalized.bin").string();
+  for (auto _ : state) {
+    proccli::SnapshotReader reader;
+    proccli::DiagnosticsSnapshot snapshot;
+    std::string error;
+    bool ok = reader.open(path, error) &&
+              reader.read(snapshot,
+                          {proccli::SnapshotSection::Meta, proccli::SnapshotSection::Target,
+                           proccli::SnapshotSection::Quality},
+                          error);
+    benchmark::DoNotOptimize(ok);
+    benchmark::DoNotOptimize(snapshot);
+  }
+}
+BENCHMARK(BM_LoadSnapshotBinaryReportSections)->Unit(benchmark::kMicrosecond);
+
+} // namespace
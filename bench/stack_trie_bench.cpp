@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <sstream>
+#include <string>
+
+#include "proccli/stack_trie.h"
+
+namespace {
+
+std::string syntheticPerfScript(size_t samples) {
+  std::mt19937 rng(7);
+  std::ostringstream out;
+  for (size_t i = 0; i < samples; ++i) {
+    out << "server 100/" << 100 + i % 8 << " [000] " << i << ".000001:     1000 cpu-clock:u:\n";
+    int depth = 4 + static_cast<int>(rng() % 12);
+    for (int d = depth; d > 0; --d) {
+      out << "\t    " << std::hex << 0x400000 + d * 0x40 << std::dec << " fn_" << d << "_"
+          << rng() % 4 << "+0x1a (/opt/server)\n";
+    }
+    out << "\n";
+  }
+  return out.str();
+}
+
+void BM_ParsePerfScript(benchmark::State &state) {
+  std::string text = syntheticPerfScript(static_cast<size_t>(state.range(0)));
+  for (auto _ : state) {
+    std::istringstream input(text);
+    proccli::StackTrie trie;
+    proccli::parsePerfScript(input, trie);
+    benchmark::DoNotOptimize(trie.totalWeight());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParsePerfScript)->Arg(10000);
+
+void BM_ParsePerfScriptChunked(benchmark::State &state) {
+  std::string text = syntheticPerfScript(static_cast<size_t>(state.range(0)));
+  auto threads = static_cast<size_t>(state.range(1));
+  for (auto _ : state) {
+    proccli::StackTrie trie;
+    proccli::parsePerfScript(std::string_view(text), trie, threads);
+    benchmark::DoNotOptimize(trie.totalWeight());
+  }
+  state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(text.size()));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_ParsePerfScriptChunked)
+    ->ArgsProduct({{200000}, {1, 2, 4, 8, 16}})
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond);
+
+void BM_TrieInsertRawStacks(benchmark::State &state) {
+  std::mt19937_64 rng(11);
+  std::vector<std::uint64_t> ips(1 << 12);
+  for (auto &ip : ips) {
+    ip = 0x400000 + rng() % 0x10000;
+  }
+  for (auto _ : state) {
+    proccli::StackTrie trie;
+    for (int sample = 0; sample < state.range(0); ++sample) {
+      std::uint32_t node = trie.child(proccli::StackTrie::kRoot, 0);
+      int depth = 8 + sample % 16;
+      for (int d = 0; d < depth; ++d) {
+        node = trie.child(node, ips[(sample * 7 + d * 131) % ips.size() % (64 * (d + 1))]);
+      }
+      trie.addSample(node, 1);
+    }
+    benchmark::DoNotOptimize(trie.nodes().size());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TrieInsertRawStacks)->Arg(1000000);
+
+} // namespace
@@ -0,0 +1,77 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "proccli/subprocess.h"
+
+namespace {
+
+std::string generator(long long bytes) {
+  return "yes 0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcde | head -c " +
+         std::to_string(bytes);
+}
+
+std::string popenFgets(const std::string &command) {
+  std::array<char, 256> buffer{};
+  std::string output;
+  FILE *pipe = popen(command.c_str(), "r");
+  if (!pipe) {
+    return output;
+  }
+  while (fgets(buffer.data(), static_cast<int>(buffer.size()), pipe) != nullptr) {
+    output += buffer.data();
+  }
+  pclose(pipe);
+  return output;
+}
+
+void BM_PopenFgetsCapture(benchmark::State &state) {
+  std::string command = generator(state.range(0));
+  for (auto _ : state) {
+    auto output = popenFgets(command);
+    benchmark::DoNotOptimize(output);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_PopenFgetsCapture)->Arg(256 << 20)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+void BM_SpawnCapture(benchmark::State &state) {
+  std::vector<std::string> argv = {"sh", "-c", generator(state.range(0))};
+  for (auto _ : state) {
+    auto result = proccli::runProcess(argv);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SpawnCapture)->Arg(256 << 20)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+void BM_SpawnToFile(benchmark::State &state) {
+  std::vector<std::string> argv = {"sh", "-c", generator(state.range(0))};
+  proccli::SubprocessOptions options;
+  options.stdout_path = "/dev/null";
+  for (auto _ : state) {
+    auto result = proccli::runProcess(argv, options);
+    benchmark::DoNotOptimize(result);
+  }
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SpawnToFile)->Arg(1 << 30)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+void BM_SpawnLineCallback(benchmark::State &state) {
+  std::vector<std::string> argv = {"sh", "-c", generator(state.range(0))};
+  size_t lines = 0;
+  proccli::SubprocessOptions options;
+  options.on_stdout_line = [&lines](std::string_view) { ++lines; };
+  for (auto _ : state) {
+    auto result = proccli::runProcess(argv, options);
+    benchmark::DoNotOptimize(result);
+  }
+  benchmark::DoNotOptimize(lines);
+  state.SetBytesProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SpawnLineCallback)->Arg(1 << 30)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+} // namespace
@@ -0,0 +1,52 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+#include <unistd.h>
+
+#include "proccli/symbolizer.h"
+
+namespace {
+
+std::vector<std::uint64_t> sampleAddresses(size_t count) {
+  std::mt19937_64 rng(42);
+  auto base = reinterpret_cast<std::uint64_t>(&sampleAddresses);
+  std::uniform_int_distribution<std::uint64_t> spread(0, 1 << 20);
+  std::vector<std::uint64_t> ips(count);
+  for (auto &ip : ips) {
+    ip = base - (1 << 19) + spread(rng);
+  }
+  return ips;
+}
+
+void BM_SymbolizerResolve(benchmark::State &state) {
+  proccli::Symbolizer symbolizer("");
+  symbolizer.loadProcess(getpid());
+  auto ips = sampleAddresses(4096);
+  for (auto _ : state) {
+    for (auto ip : ips) {
+      benchmark::DoNotOptimize(symbolizer.resolve(getpid(), ip));
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(ips.size()));
+}
+BENCHMARK(BM_SymbolizerResolve);
+
+void BM_SymbolTableLoad(benchmark::State &state) {
+  auto cache = std::filesystem::temp_directory_path() / "proccli-symbols-bench";
+  bool cached = state.range(0) != 0;
+  for (auto _ : state) {
+    if (!cached) {
+      std::filesystem::remove_all(cache);
+    }
+    benchmark::DoNotOptimize(
+        proccli::ElfSymbolTable::load("/proc/self/exe", cached ? cache.string() : ""));
+  }
+  std::filesystem::remove_all(cache);
+}
+BENCHMARK(BM_SymbolTableLoad)->Arg(0)->Arg(1);
+
+} // namespace
@@ -1,38 +1,69 @@
 #pragma once
 
+#include <atomic>
+#include <map>
 #include <optional>
+#include <queue>
 #include <string>
+#include <string_view>
+#include <thread>
 #include <vector>
 
 #include "proccli/diagnostics.h"
+#include "proccli/histogram.h"
+#include "proccli/valgrind_xml.h"
 
 namespace proccli {
 
+class CancelToken;
+
 struct CommandResult {
   int exit_code = 0;
   std::string output;
+  std::string error_output;
 };
 
 struct CollectorResult {
   std::string name;
   std::string status;
   std::optional<std::string> error;
+  double wall_ms = 0.0;
+};
+
+struct ThreadSample {
+  int tid = 0;
+  std::string name;
+  char state = '?';
+  unsigned long long cpu_ticks = 0;
+  long long voluntary_ctxt = 0;
+  long long nonvoluntary_ctxt = 0;
+  int processor = -1;
 };
 
 struct RawArtifacts {
   std::optional<std::string> ps_output;
+  std::optional<std::vector<ProcessInfo>> processes;
   std::optional<std::string> meminfo;
   std::optional<std::string> loadavg;
   std::vector<std::pair<int, std::string>> proc_status;
   std::vector<std::pair<int, std::string>> proc_io;
+  std::vector<ThreadInfo> threads;
+  std::optional<std::string> smaps_rollup;
+  std::optional<std::string> smaps;
   std::optional<std::string> valgrind_output;
+  std::optional<ValgrindReport> valgrind;
+  std::optional<HeapProfile> heap_profile;
   std::optional<std::string> perf_output;
+  std::optional<PerfReport> perf;
+  std::optional<CountersReport> counters;
   std::optional<std::string> strace_output;
+  std::optional<StraceReport> strace;
 };
 
 class PsCollector {
  public:
-  static std::vector<ProcessInfo> parse(const std::string &output);
+  static std::vector<ProcessInfo> parse(std::string_view output);
+  static std::string format(const std::vector<ProcessInfo> &processes);
   CommandResult collect();
 };
 
@@ -42,27 +73,112 @@ class ProcfsCollector {
   CommandResult collectLoadAvg();
   std::optional<CommandResult> collectStatus(int pid);
   std::optional<CommandResult> collectIo(int pid);
+  std::vector<ThreadSample> collectThreads(int pid, const std::string &root = "/proc");
+  std::optional<CommandResult> collectSmapsRollup(int pid);
+  std::optional<CommandResult> collectSmaps(int pid);
+
+  static std::vector<ThreadInfo> rankThreads(const std::vector<ThreadSample> &before,
+                                             const std::vector<ThreadSample> &after,
+                                             double seconds);
+
+  static std::optional<MemInfo> parseMemInfo(std::string_view content);
+  static std::optional<LoadAvg> parseLoadAvg(std::string_view content);
+  static std::optional<IoStats> parseIo(int pid, std::string_view content);
+  static std::optional<MemoryBreakdown> parseSmaps(int pid, std::string_view content,
+                                                   bool per_region);
+};
+
+struct ValgrindRunOptions {
+  std::string tool = "memcheck";
+  std::string xml_path;
+  std::string log_path;
+  std::string massif_path;
+};
 
-  static std::optional<MemInfo> parseMemInfo(const std::string &content);
-  static std::optional<LoadAvg> parseLoadAvg(const std::string &content);
-  static std::optional<IoStats> parseIo(int pid, const std::string &content);
+struct ValgrindRunResult {
+  bool ok = false;
+  std::string error;
+  ValgrindReport report;
+  std::optional<HeapProfile> heap_profile;
+  unsigned long long errors = 0;
+  int exit_code = 0;
 };
 
 class ValgrindCollector {
  public:
-  static std::optional<ValgrindReport> parse(const std::string &output);
+  ValgrindCollector() = default;
+  ~ValgrindCollector();
+  ValgrindCollector(const ValgrindCollector &) = delete;
+  ValgrindCollector &operator=(const ValgrindCollector &) = delete;
+
+  static std::optional<ValgrindReport> parse(std::string_view output);
+  static std::optional<ValgrindReport> parseXml(std::string_view xml);
+  static bool supportsXml(const std::string &tool);
+
+  int start(const std::string &command, const ValgrindRunOptions &options, std::string &error);
+  ValgrindRunResult finish(const CancelToken *cancel = nullptr);
+
+ private:
+  void readXml(int raw_fd);
+
+  int pid_ = -1;
+  int xml_fd_ = -1;
+  std::string massif_path_;
+  std::atomic<bool> exited_{false};
+  std::thread reader_;
+  ValgrindXmlParser parser_;
 };
 
 class PerfCollector {
  public:
-  static std::optional<PerfReport> parse(const std::string &output);
+  static std::optional<PerfReport> parse(std::string_view output, size_t threads = 0);
+  static std::string format(const PerfReport &report);
+};
+
+class StraceAggregator {
+ public:
+  explicit StraceAggregator(size_t slow_limit = 5);
+
+  void addLine(std::string_view line);
+  void merge(const StraceAggregator &other);
+  StraceReport report() const;
+  unsigned long long lines() const { return lines_; }
+
+ private:
+  struct Stats {
+    int count = 0;
+    std::uint64_t time_us = 0;
+    LatencyHistogram latency;
+  };
+  struct SlowerFirst {
+    bool operator()(const StraceSlowSyscall &a, const StraceSlowSyscall &b) const {
+      return a.duration_ms > b.duration_ms || (a.duration_ms == b.duration_ms && a.name < b.name);
+    }
+  };
+
+  void keepSlow(const std::string &name, double duration_ms);
+
+  size_t slow_limit_;
+  unsigned long long lines_ = 0;
+  std::map<std::string, Stats, std::less<>> stats_;
+  std::priority_queue<StraceSlowSyscall, std::vector<StraceSlowSyscall>, SlowerFirst> slow_;
+};
+
+struct StraceRunResult {
+  bool ok = false;
+  std::string error;
+  StraceReport report;
+  unsigned long long lines = 0;
 };
 
 class StraceCollector {
  public:
-  static std::optional<StraceReport> parse(const std::string &output);
+  static std::optional<StraceReport> parse(std::string_view output, size_t threads = 0);
+  static void aggregate(std::string_view output, StraceAggregator &aggregator, size_t threads = 0);
+  static StraceRunResult collect(int pid, int timeout_ms, const std::string &raw_path = "",
+                                 const CancelToken *cancel = nullptr);
 };
 
-CommandResult runCommand(const std::string &command);
+CommandResult runCommand(const std::vector<std::string> &argv, int timeout_ms = 0);
 
 } // namespace proccli
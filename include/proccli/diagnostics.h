@@ -30,15 +30,79 @@ struct SystemInfo {
   std::optional<MemInfo> meminfo;
 };
 
+struct MemoryRegion {
+  std::string name;
+  int mappings = 0;
+  long long size_kb = 0;
+  long long rss_kb = 0;
+  long long pss_kb = 0;
+  long long anonymous_kb = 0;
+  long long shared_kb = 0;
+  long long private_kb = 0;
+  long long swap_kb = 0;
+};
+
+struct MemoryBreakdown {
+  int pid = 0;
+  std::string source;
+  long long rss_kb = 0;
+  long long pss_kb = 0;
+  long long pss_anon_kb = 0;
+  long long pss_file_kb = 0;
+  long long pss_shmem_kb = 0;
+  long long anonymous_kb = 0;
+  long long shared_kb = 0;
+  long long private_kb = 0;
+  long long swap_kb = 0;
+  long long swap_pss_kb = 0;
+  std::vector<MemoryRegion> regions;
+};
+
 struct ProcessInfo {
   int pid = 0;
   int ppid = 0;
   std::string cmd;
-  int rss_kb = 0;
-  int vsz_kb = 0;
+  long long rss_kb = 0;
+  long long vsz_kb = 0;
   double cpu_percent = 0.0;
   double mem_percent = 0.0;
   std::string etime;
+  int num_threads = 0;
+};
+
+struct ProcessTreeNode {
+  int pid = 0;
+  int ppid = 0;
+  int depth = 0;
+  std::string cmd;
+  double cpu_percent = 0.0;
+  long long rss_kb = 0;
+  long long read_bytes = 0;
+  long long write_bytes = 0;
+  int num_threads = 0;
+  int subtree_processes = 0;
+  double subtree_cpu_percent = 0.0;
+  long long subtree_rss_kb = 0;
+  long long subtree_read_bytes = 0;
+  long long subtree_write_bytes = 0;
+  int subtree_threads = 0;
+};
+
+struct ProcessTree {
+  int root_pid = 0;
+  std::vector<ProcessTreeNode> nodes;
+};
+
+struct ThreadInfo {
+  int tid = 0;
+  std::string name;
+  std::string state;
+  double cpu_percent = 0.0;
+  double cpu_delta_ms = 0.0;
+  double cpu_total_ms = 0.0;
+  long long voluntary_ctxt_switches = 0;
+  long long nonvoluntary_ctxt_switches = 0;
+  int last_cpu = -1;
 };
 
 struct ValgrindError {
@@ -53,9 +117,44 @@ struct LeakSummary {
   int still_reachable_kb = 0;
 };
 
+struct ValgrindSite {
+  std::string kind;
+  std::string what;
+  std::vector<std::string> stack;
+  long long count = 0;
+  long long leaked_bytes = 0;
+  long long leaked_blocks = 0;
+};
+
 struct ValgrindReport {
   std::vector<ValgrindError> errors;
   std::optional<LeakSummary> leak_summary;
+  std::vector<ValgrindSite> sites;
+  long long unattributed_errors = 0;
+};
+
+struct HeapSnapshot {
+  int index = 0;
+  long long time = 0;
+  long long heap_bytes = 0;
+  long long extra_bytes = 0;
+  long long stack_bytes = 0;
+};
+
+struct HeapSite {
+  long long bytes = 0;
+  double percent = 0.0;
+  std::vector<std::string> stack;
+};
+
+struct HeapProfile {
+  std::string command;
+  std::string time_unit;
+  int peak_snapshot = -1;
+  long long peak_heap_bytes = 0;
+  long long peak_extra_bytes = 0;
+  std::vector<HeapSnapshot> timeline;
+  std::vector<HeapSite> peak_sites;
 };
 
 struct PerfHotspot {
@@ -63,14 +162,63 @@ struct PerfHotspot {
   double percent = 0.0;
 };
 
+struct PerfFrame {
+  std::string symbol;
+  double inclusive_percent = 0.0;
+  double exclusive_percent = 0.0;
+};
+
 struct PerfReport {
+  std::string event;
+  long long samples = 0;
+  long long lost = 0;
   std::vector<PerfHotspot> hotspots;
+  std::vector<PerfFrame> frames;
+};
+
+struct CounterValues {
+  int tid = 0;
+  std::optional<long long> cycles;
+  std::optional<long long> instructions;
+  std::optional<long long> cache_references;
+  std::optional<long long> cache_misses;
+  std::optional<long long> branch_misses;
+  long long page_faults = 0;
+  long long context_switches = 0;
+  long long cpu_migrations = 0;
+  std::optional<double> ipc;
+  std::optional<double> cache_miss_percent;
+  std::optional<double> branch_mpki;
+};
+
+struct CountersReport {
+  double duration_s = 0.0;
+  bool hardware = false;
+  bool multiplexed = false;
+  CounterValues process;
+  std::vector<CounterValues> threads;
+};
+
+struct LatencyBucket {
+  long long lowest_us = 0;
+  long long count = 0;
+};
+
+struct LatencySummary {
+  long long count = 0;
+  double p50_ms = 0.0;
+  double p90_ms = 0.0;
+  double p99_ms = 0.0;
+  double p999_ms = 0.0;
+  double max_ms = 0.0;
+  std::vector<LatencyBucket> buckets;
 };
 
 struct StraceSyscall {
   std::string name;
   int count = 0;
   double time_ms = 0.0;
+  std::optional<LatencySummary> latency;
 };
 
 struct StraceSlowSyscall {
@@ -89,6 +237,23 @@ struct IoStats {
   long long write_bytes = 0;
 };
 
+struct WatchSample {
+  double elapsed_ms = 0.0;
+  double cpu_percent = 0.0;
+  double read_bytes_per_sec = 0.0;
+  double write_bytes_per_sec = 0.0;
+  double voluntary_ctxt_per_sec = 0.0;
+  double nonvoluntary_ctxt_per_sec = 0.0;
+  long long rss_kb = 0;
+  long long rss_delta_kb = 0;
+};
+
+struct WatchSeries {
+  int pid = 0;
+  int interval_ms = 0;
+  std::vector<WatchSample> samples;
+};
+
 struct TimingInfo {
   std::string captured_at;
 };
@@ -97,6 +262,7 @@ struct CollectorStatus {
   std::string name;
   std::string status;
   std::optional<std::string> error;
+  std::optional<double> wall_ms;
 };
 
 struct QualityInfo {
@@ -108,10 +274,16 @@ struct DiagnosticsSnapshot {
   TargetInfo target;
   SystemInfo system;
   std::vector<ProcessInfo> processes;
+  std::optional<ProcessTree> process_tree;
+  std::vector<ThreadInfo> threads;
+  std::optional<MemoryBreakdown> memory;
   std::optional<ValgrindReport> valgrind;
+  std::optional<HeapProfile> heap_profile;
   std::optional<PerfReport> perf;
+  std::optional<CountersReport> counters;
   std::optional<StraceReport> strace;
   std::vector<IoStats> io;
+  std::optional<WatchSeries> watch;
   TimingInfo timing;
   QualityInfo quality;
 };
@@ -120,21 +292,37 @@ void to_json(nlohmann::json &j, const TargetInfo &info);
 void to_json(nlohmann::json &j, const LoadAvg &info);
 void to_json(nlohmann::json &j, const MemInfo &info);
 void to_json(nlohmann::json &j, const SystemInfo &info);
+void to_json(nlohmann::json &j, const MemoryRegion &info);
+void to_json(nlohmann::json &j, const MemoryBreakdown &info);
 void to_json(nlohmann::json &j, const ProcessInfo &info);
+void to_json(nlohmann::json &j, const ProcessTreeNode &info);
+void to_json(nlohmann::json &j, const ProcessTree &info);
+void to_json(nlohmann::json &j, const ThreadInfo &info);
 void to_json(nlohmann::json &j, const ValgrindError &info);
 void to_json(nlohmann::json &j, const LeakSummary &info);
+void to_json(nlohmann::json &j, const ValgrindSite &info);
 void to_json(nlohmann::json &j, const ValgrindReport &info);
+void to_json(nlohmann::json &j, const HeapSnapshot &info);
+void to_json(nlohmann::json &j, const HeapSite &info);
+void to_json(nlohmann::json &j, const HeapProfile &info);
 void to_json(nlohmann::json &j, const PerfHotspot &info);
+void to_json(nlohmann::json &j, const PerfFrame &info);
 void to_json(nlohmann::json &j, const PerfReport &info);
+void to_json(nlohmann::json &j, const CounterValues &info);
+void to_json(nlohmann::json &j, const CountersReport &info);
+void to_json(nlohmann::json &j, const LatencySummary &info);
 void to_json(nlohmann::json &j, const StraceSyscall &info);
 void to_json(nlohmann::json &j, const StraceSlowSyscall &info);
 void to_json(nlohmann::json &j, const StraceReport &info);
 void to_json(nlohmann::json &j, const IoStats &info);
+void to_json(nlohmann::json &j, const WatchSample &info);
+void to_json(nlohmann::json &j, const WatchSeries &info);
 void to_json(nlohmann::json &j, const TimingInfo &info);
 void to_json(nlohmann::json &j, const CollectorStatus &info);
 void to_json(nlohmann::json &j, const QualityInfo &info);
 void to_json(nlohmann::json &j, const DiagnosticsSnapshot &info);
 
+CountersReport countersFromJson(const nlohmann::json &j);
 DiagnosticsSnapshot snapshotFromJson(const nlohmann::json &j);
 
 } // namespace proccli
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBucketBits = 5;
+  static constexpr std::uint64_t kSubBuckets = 1ULL << kSubBucketBits;
+  static constexpr int kMaxMagnitude = 40;
+  static constexpr size_t kBucketCount = (kMaxMagnitude - kSubBucketBits + 2) * kSubBuckets;
+  static constexpr std::uint64_t kMaxValue = (1ULL << (kMaxMagnitude + 1)) - 1;
+
+  void record(std::uint64_t value_us, std::uint64_t count = 1);
+  void merge(const LatencyHistogram &other);
+
+  std::uint64_t count() const { return count_; }
+  std::uint64_t max() const { return max_; }
+  std::uint64_t valueAtPercentile(double percentile) const;
+  LatencySummary summary() const;
+  static LatencyHistogram fromSummary(const LatencySummary &summary);
+
+  static size_t bucketIndex(std::uint64_t value_us);
+  static std::uint64_t bucketLowest(size_t index);
+  static std::uint64_t bucketHighest(size_t index);
+
+ private:
+  std::array<std::uint64_t, kBucketCount> buckets_{};
+  std::uint64_t count_ = 0;
+  std::uint64_t max_ = 0;
+};
+
+} // namespace proccli
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+struct HistoryEntry {
+  std::string dir;
+  std::string captured_at;
+  std::optional<int> pid;
+  std::string command;
+  double cpu_percent = 0.0;
+  long long rss_kb = 0;
+  long long read_bytes = 0;
+  long long write_bytes = 0;
+  std::string status;
+  std::string top_hotspot;
+  double top_hotspot_percent = 0.0;
+  std::string top_syscall;
+  double top_syscall_ms = 0.0;
+};
+
+struct HistoryQuery {
+  std::optional<int> pid;
+  std::string command;
+  std::string since;
+  std::string until;
+  std::string status;
+  std::string sort = "time";
+  size_t limit = 0;
+};
+
+std::string historyIndexPath(const std::string &root);
+HistoryEntry summarizeRun(const std::string &dir, const DiagnosticsSnapshot &snapshot);
+std::string formatHistoryRow(const HistoryEntry &entry);
+std::optional<HistoryEntry> parseHistoryRow(std::string_view line);
+
+bool appendHistory(const std::string &root, const HistoryEntry &entry, std::string &error);
+std::vector<HistoryEntry> readHistory(const std::string &root, std::string &error);
+std::vector<HistoryEntry> queryHistory(std::vector<HistoryEntry> entries, const HistoryQuery &query);
+bool rebuildHistory(const std::string &root, size_t &runs, std::string &error);
+
+void to_json(nlohmann::json &j, const HistoryEntry &entry);
+
+} // namespace proccli
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace proccli {
+
+struct HttpOptions {
+  int connect_timeout_ms = 2000;
+  int read_timeout_ms = 60000;
+};
+
+struct HttpResponse {
+  int status = 0;
+  std::vector<std::pair<std::string, std::string>> headers;
+  std::string body;
+  std::string error;
+
+  std::string header(std::string_view name) const;
+};
+
+class HttpClient {
+ public:
+  using DataCallback = std::function<bool(std::string_view data)>;
+
+  HttpClient(std::string host, int port, HttpOptions options = {});
+  ~HttpClient();
+  HttpClient(const HttpClient &) = delete;
+  HttpClient &operator=(const HttpClient &) = delete;
+
+  HttpResponse get(const std::string &path, const DataCallback &on_data = {});
+  HttpResponse post(const std::string &path, const std::string &content_type,
+                    std::string_view body, const DataCallback &on_data = {});
+  bool connected() const { return fd_ >= 0; }
+
+ private:
+  HttpResponse request(const std::string &method, const std::string &path,
+                       const std::string &content_type, std::string_view body,
+                       const DataCallback &on_data);
+  bool exchange(const std::string &head, std::string_view body, const DataCallback &on_data,
+                HttpResponse &response, bool &received);
+  bool connect(std::string &error);
+  void disconnect();
+  bool sendAll(std::string_view data, std::string &error);
+  bool fill(std::string &error);
+  bool readLine(std::string &line, std::string &error);
+  bool readBody(size_t length, const DataCallback &on_data, HttpResponse &response);
+
+  std::string host_;
+  int port_ = 0;
+  HttpOptions options_;
+  int fd_ = -1;
+  std::string buffer_;
+  size_t pos_ = 0;
+  bool eof_ = false;
+};
+
+} // namespace proccli
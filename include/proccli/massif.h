@@ -0,0 +1,49 @@
+#pragma once
+
+#include <optional>
+#include <queue>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+class MassifParser {
+ public:
+  static constexpr size_t kStackDepth = 8;
+
+  explicit MassifParser(size_t top = 20);
+
+  void feed(std::string_view chunk);
+  void addLine(std::string_view line);
+  std::optional<HeapProfile> profile();
+
+ private:
+  struct SmallerFirst {
+    bool operator()(const HeapSite &a, const HeapSite &b) const { return a.bytes > b.bytes; }
+  };
+  using SiteHeap = std::priority_queue<HeapSite, std::vector<HeapSite>, SmallerFirst>;
+
+  void addTreeLine(std::string_view line);
+  void finishTree();
+
+  size_t top_;
+  std::string carry_;
+  HeapProfile profile_;
+  bool seen_header_ = false;
+  bool in_tree_ = false;
+  bool tree_is_peak_ = false;
+  bool skip_tree_ = false;
+  bool have_peak_ = false;
+  long long best_heap_bytes_ = -1;
+  std::vector<std::string> path_;
+  SiteHeap sites_;
+  std::vector<HeapSite> best_sites_;
+};
+
+std::optional<HeapProfile> parseMassif(std::string_view text);
+std::optional<HeapProfile> readMassifFile(const std::string &path, std::string &error);
+
+} // namespace proccli
@@ -10,5 +10,7 @@ namespace proccli {
 
 DiagnosticsSnapshot normalizeDiagnostics(const RawArtifacts &artifacts, const TargetInfo &target,
                                          const std::vector<CollectorResult> &collector_results);
+std::optional<DiagnosticsSnapshot> normalizeArtifactDir(const std::string &artifact_dir,
+                                                        std::string &error, size_t threads = 0);
 
 } // namespace proccli
@@ -1,20 +1,48 @@
 #pragma once
 
+#include <cstddef>
+#include <functional>
 #include <string>
+#include <string_view>
 
 #include "proccli/diagnostics.h"
+#include "proccli/http_client.h"
 
 namespace proccli {
 
+struct OllamaOptions {
+  std::string host = "localhost";
+  int port = 11434;
+  int connect_timeout_ms = 2000;
+  int read_timeout_ms = 300000;
+  size_t token_budget = 6144;
+  size_t response_tokens = 2048;
+};
+
 struct OllamaResult {
   bool ok = false;
   std::string response;
   std::string error;
+  double first_token_ms = 0.0;
+  double total_ms = 0.0;
+  size_t prompt_tokens = 0;
+  std::string compaction;
 };
 
+OllamaOptions ollamaOptionsFromEnv();
+
 class OllamaClient {
  public:
-  OllamaResult analyze(const DiagnosticsSnapshot &snapshot, const std::string &model) const;
+  using TokenCallback = std::function<void(std::string_view token)>;
+
+  explicit OllamaClient(OllamaOptions options = {});
+
+  OllamaResult analyze(const DiagnosticsSnapshot &snapshot, const std::string &model,
+                       const TokenCallback &on_token = {});
+
+ private:
+  OllamaOptions options_;
+  HttpClient http_;
 };
 
 } // namespace proccli
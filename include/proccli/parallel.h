@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <vector>
+
+namespace proccli {
+
+constexpr size_t kMinParseChunkBytes = 256 * 1024;
+
+size_t resolveThreads(size_t requested);
+size_t parseChunkCount(size_t bytes, size_t threads);
+std::vector<std::string_view> splitChunks(
+    std::string_view text, size_t count,
+    const std::function<bool(std::string_view line)> &starts_chunk = {});
+void parallelFor(size_t tasks, size_t threads, const std::function<void(size_t task)> &body);
+
+} // namespace proccli
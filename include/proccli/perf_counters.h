@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+class CancelToken;
+
+struct PerfCounterOptions {
+  int duration_ms = 1000;
+  bool per_thread = false;
+  bool hardware = true;
+};
+
+struct PerfCounterResult {
+  bool ok = false;
+  std::string error;
+  std::string warning;
+  CountersReport report;
+};
+
+class PerfCounterCollector {
+ public:
+  static constexpr size_t kEventCount = 8;
+  using Readings = std::array<std::optional<std::uint64_t>, kEventCount>;
+
+  explicit PerfCounterCollector(PerfCounterOptions options);
+  ~PerfCounterCollector();
+  PerfCounterCollector(const PerfCounterCollector &) = delete;
+  PerfCounterCollector &operator=(const PerfCounterCollector &) = delete;
+
+  PerfCounterResult collect(const std::vector<int> &pids, const CancelToken *cancel = nullptr);
+
+  static CounterValues toValues(int tid, const Readings &readings);
+
+ private:
+  struct Group {
+    int leader = -1;
+    std::vector<int> fds;
+    std::vector<size_t> events;
+  };
+  struct ThreadGroups {
+    int tid = 0;
+    Group hardware;
+    Group software;
+  };
+
+  bool openGroup(int tid, bool hardware, Group &group, std::string &error);
+  void attach(const std::vector<int> &tids);
+  bool readGroup(const Group &group, Readings &readings);
+  void closeAll();
+
+  PerfCounterOptions options_;
+  bool hardware_ = false;
+  bool exclude_kernel_ = false;
+  bool multiplexed_ = false;
+  std::array<bool, kEventCount> available_{};
+  std::vector<ThreadGroups> threads_;
+  std::unordered_set<int> attached_;
+};
+
+void deriveCounterRatios(CounterValues &values);
+
+} // namespace proccli
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+#include "proccli/stack_trie.h"
+#include "proccli/symbolizer.h"
+
+namespace proccli {
+
+struct PerfDataSample {
+  int pid = 0;
+  int tid = 0;
+  std::uint64_t ip = 0;
+  std::uint64_t period = 1;
+  bool kernel = false;
+  const std::uint64_t *callchain = nullptr;
+  size_t callchain_depth = 0;
+};
+
+struct PerfDataLocation {
+  int dso = -1;
+  std::uint64_t offset = 0;
+};
+
+class PerfDataReader {
+ public:
+  using SampleCallback = std::function<void(const PerfDataSample &)>;
+
+  PerfDataReader() = default;
+  ~PerfDataReader();
+  PerfDataReader(const PerfDataReader &) = delete;
+  PerfDataReader &operator=(const PerfDataReader &) = delete;
+
+  bool open(const std::string &path, std::string &error);
+  bool read(const SampleCallback &on_sample, std::string &error);
+
+  PerfDataLocation locate(int pid, std::uint64_t ip, bool kernel) const;
+  std::string describe(const PerfDataLocation &location);
+  std::string comm(int pid) const;
+
+  const std::string &event() const { return event_; }
+  std::uint64_t samples() const { return samples_; }
+  std::uint64_t lost() const { return lost_; }
+  const std::string &dsoPath(int dso) const { return dsos_[static_cast<size_t>(dso)].path; }
+
+ private:
+  struct Attr {
+    std::uint64_t sample_type = 0;
+    std::uint64_t read_format = 0;
+  };
+  struct Region {
+    std::uint64_t end = 0;
+    std::uint64_t pgoff = 0;
+    int dso = -1;
+  };
+  struct Dso {
+    std::string path;
+    std::string build_id;
+    bool loaded = false;
+    std::shared_ptr<ElfSymbolTable> table;
+  };
+  using AddressSpace = std::map<std::uint64_t, Region>;
+
+  bool parseSample(const unsigned char *body, const unsigned char *end, std::uint16_t misc,
+                   PerfDataSample &sample) const;
+  void addMapping(int pid, std::uint64_t start, std::uint64_t length, std::uint64_t pgoff,
+                  const std::string &path, const std::string &build_id);
+  int internDso(const std::string &path, const std::string &build_id);
+
+  const unsigned char *data_ = nullptr;
+  size_t size_ = 0;
+  std::uint64_t data_offset_ = 0;
+  std::uint64_t data_size_ = 0;
+  std::vector<Attr> attrs_;
+  std::unordered_map<std::uint64_t, size_t> attr_by_id_;
+  bool has_identifier_ = false;
+  std::string event_;
+  std::uint64_t samples_ = 0;
+  std::uint64_t lost_ = 0;
+  std::unordered_map<int, AddressSpace> spaces_;
+  std::unordered_map<int, std::string> comms_;
+  std::vector<Dso> dsos_;
+  std::unordered_map<std::string, int> dso_by_path_;
+};
+
+std::optional<PerfReport> readPerfData(const std::string &path, std::string &error,
+                                       size_t limit = 20, StackTrie *stacks = nullptr);
+
+} // namespace proccli
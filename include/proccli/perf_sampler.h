@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+#include "proccli/stack_trie.h"
+
+namespace proccli {
+
+class CancelToken;
+
+struct PerfSamplerOptions {
+  int duration_ms = 10000;
+  int frequency_hz = 999;
+  std::string event = "cpu-clock";
+  int ring_pages = 16;
+  bool callchain = true;
+};
+
+struct PerfSampleSet {
+  std::string event;
+  std::uint64_t samples = 0;
+  std::uint64_t lost = 0;
+  int attached_threads = 0;
+  std::unordered_map<int, std::unordered_map<std::uint64_t, std::uint64_t>> ip_counts;
+  StackTrie stacks;
+  std::vector<std::pair<int, std::uint64_t>> stack_frames;
+  std::unordered_map<int, std::unordered_map<std::uint64_t, std::uint64_t>> stack_frame_ids;
+  // /proc/<pid>/maps captured while sampling, so processes that exit before symbolization still
+  // resolve.
+  std::unordered_map<int, std::string> maps;
+};
+
+struct PerfSamplingResult {
+  bool ok = false;
+  std::string error;
+  PerfSampleSet sample_set;
+};
+
+class PerfSampler {
+ public:
+  explicit PerfSampler(PerfSamplerOptions options);
+  ~PerfSampler();
+  PerfSampler(const PerfSampler &) = delete;
+  PerfSampler &operator=(const PerfSampler &) = delete;
+
+  PerfSamplingResult sample(const std::vector<int> &pids, const CancelToken *cancel = nullptr);
+
+ private:
+  struct Stream {
+    int tid = 0;
+    int fd = -1;
+    void *ring = nullptr;
+    size_t ring_size = 0;
+  };
+
+  static std::vector<int> listThreads(const std::vector<int> &pids);
+  static void snapshotMaps(const std::vector<int> &pids, PerfSampleSet &set);
+  bool openStreams(const std::vector<int> &tids, bool hardware, std::string &error);
+  void closeStreams();
+  void drain(Stream &stream, PerfSampleSet &set);
+
+  PerfSamplerOptions options_;
+  std::vector<Stream> streams_;
+  std::unordered_set<int> attached_;
+  std::vector<char> record_buffer_;
+};
+
+class Symbolizer;
+
+std::vector<PerfHotspot> rankHotspots(const std::map<std::string, std::uint64_t> &weights,
+                                      std::uint64_t total, size_t limit);
+StackTrie symbolizeStacks(const PerfSampleSet &set, Symbolizer &symbolizer);
+PerfReport buildPerfReport(const PerfSampleSet &set, Symbolizer &symbolizer, size_t limit = 20,
+                           StackTrie *stacks = nullptr);
+PerfReport buildPerfReport(const PerfSampleSet &set, size_t limit = 20);
+PerfReport buildStackReport(const StackTrie &stacks, size_t limit = 20);
+
+} // namespace proccli
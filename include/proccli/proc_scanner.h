@@ -0,0 +1,55 @@
+#pragma once
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+struct ProcStat {
+  int pid = 0;
+  std::string comm;
+  char state = '?';
+  int ppid = 0;
+  unsigned long long utime = 0;
+  unsigned long long stime = 0;
+  long num_threads = 0;
+  unsigned long long starttime = 0;
+  unsigned long long vsize = 0;
+  long long rss_pages = 0;
+  int processor = -1;
+};
+
+bool parseProcStat(std::string_view content, ProcStat &stat);
+std::string formatElapsed(long long seconds);
+
+class ProcScanner {
+ public:
+  explicit ProcScanner(std::string root = "/proc");
+  ~ProcScanner();
+  ProcScanner(const ProcScanner &) = delete;
+  ProcScanner &operator=(const ProcScanner &) = delete;
+
+  std::optional<std::vector<ProcessInfo>> scan();
+  std::vector<int> listPids();
+
+ private:
+  bool openRoot();
+  void loadSystemInfo();
+
+  std::string root_;
+  int root_fd_ = -1;
+  std::vector<char> dirents_;
+  std::string stat_buffer_;
+  std::string cmdline_buffer_;
+  std::string path_buffer_;
+  double uptime_seconds_ = 0.0;
+  long long mem_total_kb_ = 0;
+  long clock_ticks_ = 100;
+  long page_size_kb_ = 4;
+};
+
+} // namespace proccli
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+std::vector<int> descendantPids(const std::vector<ProcessInfo> &processes, int root_pid);
+std::optional<ProcessTree> buildProcessTree(const std::vector<ProcessInfo> &processes,
+                                            int root_pid, const std::vector<IoStats> &io);
+
+} // namespace proccli
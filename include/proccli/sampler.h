@@ -0,0 +1,69 @@
+#pragma once
+
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+struct ProcCounters {
+  double timestamp_s = 0.0;
+  unsigned long long cpu_ticks = 0;
+  long long read_bytes = 0;
+  long long write_bytes = 0;
+  long long voluntary_ctxt = 0;
+  long long nonvoluntary_ctxt = 0;
+  long long rss_kb = 0;
+};
+
+bool parseStatCounters(std::string_view content, ProcCounters &counters);
+bool parseStatusCounters(std::string_view content, ProcCounters &counters);
+bool parseIoCounters(std::string_view content, ProcCounters &counters);
+WatchSample computeRates(const ProcCounters &previous, const ProcCounters &current,
+                         long clock_ticks);
+double monotonicSeconds();
+
+struct PidCounters {
+  int pid = 0;
+  ProcCounters counters;
+};
+
+class ProcfsSampler {
+ public:
+  explicit ProcfsSampler(std::string root = "/proc");
+  ~ProcfsSampler();
+  ProcfsSampler(const ProcfsSampler &) = delete;
+  ProcfsSampler &operator=(const ProcfsSampler &) = delete;
+
+  bool add(int pid);
+  void remove(int pid);
+  size_t size() const { return entries_.size(); }
+  void sample(std::vector<PidCounters> &samples, std::vector<int> &exited);
+
+ private:
+  struct Entry {
+    int pid = 0;
+    int stat_fd = -1;
+    int status_fd = -1;
+    int io_fd = -1;
+    std::string stat_buffer;
+    std::string status_buffer;
+    std::string io_buffer;
+  };
+
+  static void closeEntry(Entry &entry);
+  static bool sampleEntry(Entry &entry, double timestamp, ProcCounters &counters);
+
+  std::string root_;
+  std::vector<Entry> entries_;
+};
+
+using WatchCallback = std::function<bool(const WatchSample &)>;
+
+WatchSeries watchProcess(int pid, int interval_ms, int duration_ms, const WatchCallback &on_sample);
+
+} // namespace proccli
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "proccli/collectors.h"
+
+namespace proccli {
+
+class CancelToken {
+ public:
+  explicit CancelToken(int deadline_ms = 0);
+
+  void cancel() { cancelled_ = true; }
+  bool cancelled() const { return cancelled_ || expired(); }
+  bool interrupted() const { return cancelled_; }
+  bool expired() const;
+
+ private:
+  std::atomic<bool> cancelled_{false};
+  double deadline_ = 0.0;
+};
+
+struct CollectorTask {
+  std::string name;
+  int deadline_ms = 0;
+  std::vector<std::string> after;
+  std::string exclusive;
+  std::function<CollectorResult(const CancelToken &cancel)> run;
+};
+
+class CollectorScheduler {
+ public:
+  explicit CollectorScheduler(size_t max_parallel = 0);
+
+  void add(CollectorTask task);
+  std::vector<CollectorResult> run(const std::function<bool()> &interrupted = {});
+
+ private:
+  size_t max_parallel_;
+  std::vector<CollectorTask> tasks_;
+};
+
+} // namespace proccli
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+#include "proccli/utils.h"
+
+namespace proccli {
+
+enum class SnapshotSection : uint32_t {
+  Meta = 1,
+  Target,
+  System,
+  Processes,
+  ProcessTree,
+  Threads,
+  Memory,
+  Valgrind,
+  HeapProfile,
+  Perf,
+  Counters,
+  Strace,
+  Io,
+  Watch,
+  Quality,
+};
+
+constexpr uint32_t kSnapshotBinaryVersion = 2;
+
+bool isSnapshotBinary(std::string_view data);
+std::string encodeSnapshotBinary(const DiagnosticsSnapshot &snapshot);
+bool writeSnapshotBinary(const std::string &path, const DiagnosticsSnapshot &snapshot,
+                         std::string &error);
+
+class SnapshotReader {
+ public:
+  SnapshotReader() = default;
+  SnapshotReader(const SnapshotReader &) = delete;
+  SnapshotReader &operator=(const SnapshotReader &) = delete;
+
+  bool open(const std::string &path, std::string &error);
+  bool attach(std::string_view data, std::string &error);
+
+  bool has(SnapshotSection section) const;
+  size_t records(SnapshotSection section) const;
+  bool read(DiagnosticsSnapshot &snapshot, std::initializer_list<SnapshotSection> sections,
+            std::string &error) const;
+  bool readAll(DiagnosticsSnapshot &snapshot, std::string &error) const;
+
+ private:
+  struct Section {
+    uint32_t id = 0;
+    uint32_t records = 0;
+    std::string_view body;
+  };
+
+  const Section *find(SnapshotSection section) const;
+  bool readSection(const Section &section, DiagnosticsSnapshot &snapshot, std::string &error) const;
+
+  MappedFile file_;
+  std::string_view data_;
+  std::vector<Section> sections_;
+  std::string_view string_entries_;
+  std::string_view string_blob_;
+  uint64_t string_count_ = 0;
+};
+
+std::optional<DiagnosticsSnapshot> loadSnapshot(const std::string &dir,
+                                                std::initializer_list<SnapshotSection> sections);
+
+} // namespace proccli
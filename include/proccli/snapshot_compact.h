@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+struct CompactOptions {
+  size_t token_budget = 8192;
+  size_t max_stack_frames = 8;
+  size_t max_command_chars = 160;
+  size_t max_series_points = 32;
+};
+
+struct CompactSection {
+  std::string name;
+  size_t tokens = 0;
+  size_t kept = 0;
+  size_t omitted = 0;
+  bool dropped = false;
+};
+
+struct CompactSnapshot {
+  nlohmann::json payload;
+  size_t tokens = 0;
+  std::vector<CompactSection> sections;
+};
+
+size_t estimateTokens(std::string_view text);
+CompactSnapshot compactSnapshot(const DiagnosticsSnapshot &snapshot,
+                                const CompactOptions &options = {});
+std::string formatCompactSummary(const CompactSnapshot &compact);
+
+} // namespace proccli
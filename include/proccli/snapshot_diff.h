@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+struct DiffThresholds {
+  double relative_percent = 10.0;
+  double cpu_percent = 5.0;
+  double rss_kb = 10240.0;
+  double io_bytes = 1048576.0;
+  double syscall_count = 100.0;
+  double syscall_ms = 10.0;
+  double hotspot_percent = 2.0;
+};
+
+struct MetricDelta {
+  std::string kind;
+  std::string key;
+  std::string metric;
+  double baseline = 0.0;
+  double current = 0.0;
+  double delta = 0.0;
+  std::optional<double> relative_percent;
+  bool regression = false;
+};
+
+struct SnapshotDiff {
+  std::vector<MetricDelta> deltas;
+  size_t regressions = 0;
+};
+
+bool setDiffThreshold(DiffThresholds &thresholds, std::string_view spec, std::string &error);
+SnapshotDiff diffSnapshots(const DiagnosticsSnapshot &baseline, const DiagnosticsSnapshot &current,
+                           const DiffThresholds &thresholds = {});
+std::string formatDiff(const SnapshotDiff &diff, size_t max_changes = 20);
+
+void to_json(nlohmann::json &j, const MetricDelta &delta);
+void to_json(nlohmann::json &j, const SnapshotDiff &diff);
+
+} // namespace proccli
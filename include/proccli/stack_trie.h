@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+class StackTrie {
+ public:
+  static constexpr std::uint32_t kRoot = 0;
+
+  struct Node {
+    std::uint64_t frame = 0;
+    std::uint32_t parent = 0;
+    std::uint32_t first_child = 0;
+    std::uint32_t next_sibling = 0;
+    std::uint64_t self = 0;
+    std::uint64_t total = 0;
+  };
+
+  StackTrie();
+
+  std::uint32_t child(std::uint32_t node, std::uint64_t frame);
+  void addSample(std::uint32_t leaf, std::uint64_t weight);
+  std::uint64_t internFrame(std::string_view name);
+  const std::string &frameName(std::uint64_t frame) const { return names_[frame]; }
+
+  const std::vector<Node> &nodes() const { return nodes_; }
+  std::uint64_t totalWeight() const { return nodes_[kRoot].total; }
+  bool empty() const { return nodes_[kRoot].total == 0; }
+
+  void merge(const StackTrie &other);
+  StackTrie relabel(const std::function<std::string(std::uint64_t frame)> &name) const;
+  void writeFolded(std::ostream &out) const;
+  std::vector<PerfFrame> topFrames(size_t limit, bool include_roots = false) const;
+
+ private:
+  struct Edge {
+    std::uint32_t node = 0;
+    std::uint64_t frame = 0;
+    bool operator==(const Edge &other) const {
+      return node == other.node && frame == other.frame;
+    }
+  };
+  struct EdgeHash {
+    size_t operator()(const Edge &edge) const {
+      return std::hash<std::uint64_t>()(edge.frame * 0x9e3779b97f4a7c15ULL ^ edge.node);
+    }
+  };
+
+  std::vector<Node> nodes_;
+  std::unordered_map<Edge, std::uint32_t, EdgeHash> edges_;
+  std::vector<std::string> names_;
+  std::unordered_map<std::string, std::uint64_t> name_ids_;
+};
+
+bool parsePerfScript(std::istream &input, StackTrie &trie);
+bool parsePerfScript(std::string_view text, StackTrie &trie, size_t threads = 0);
+bool parseFolded(std::string_view text, StackTrie &trie);
+std::string renderFlameGraph(const StackTrie &trie, const std::string &title);
+
+} // namespace proccli
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace proccli {
+
+struct SubprocessOptions {
+  int timeout_ms = 0;
+  int kill_grace_ms = 2000;
+  std::string input;
+  std::string stdout_path;
+  std::function<void(std::string_view line)> on_stdout_line;
+  std::function<bool()> stop_requested;
+  bool capture_stderr = true;
+  bool merge_stderr = false;
+};
+
+struct SubprocessResult {
+  bool started = false;
+  int spawn_errno = 0;
+  int exit_code = -1;
+  int term_signal = 0;
+  bool timed_out = false;
+  bool stopped = false;
+  unsigned long long stdout_bytes = 0;
+  std::string out;
+  std::string err;
+  std::string error;
+};
+
+SubprocessResult runProcess(const std::vector<std::string> &argv,
+                            const SubprocessOptions &options = {});
+
+} // namespace proccli
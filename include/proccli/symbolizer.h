@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace proccli {
+
+class ElfSymbolTable {
+ public:
+  static std::shared_ptr<ElfSymbolTable> load(const std::string &path,
+                                              const std::string &cache_dir);
+
+  const std::string &buildId() const { return build_id_; }
+  size_t size() const { return symbols_.size(); }
+  bool loadedFromCache() const { return from_cache_; }
+  bool fileOffsetToVaddr(std::uint64_t offset, std::uint64_t &vaddr) const;
+  std::string_view lookup(std::uint64_t vaddr) const;
+
+ private:
+  struct Symbol {
+    std::uint64_t start = 0;
+    std::uint32_t size = 0;
+    std::uint32_t name = 0;
+  };
+  struct Segment {
+    std::uint64_t offset = 0;
+    std::uint64_t vaddr = 0;
+    std::uint64_t filesz = 0;
+  };
+
+  bool parse(const unsigned char *data, size_t size, const std::string &cache_dir);
+  bool readCache(const std::string &path);
+  void writeCache(const std::string &path) const;
+
+  std::vector<Symbol> symbols_;
+  std::vector<Segment> segments_;
+  std::string names_;
+  std::string build_id_;
+  bool from_cache_ = false;
+};
+
+struct ResolvedFrame {
+  std::string_view module;
+  std::string_view symbol;
+  std::uint64_t offset = 0;
+};
+
+std::string defaultSymbolCacheDir();
+std::string demangle(std::string_view symbol);
+
+class Symbolizer {
+ public:
+  explicit Symbolizer(std::string cache_dir = defaultSymbolCacheDir());
+
+  bool loadProcess(int pid);
+  bool loadMaps(int pid, std::string_view maps);
+  ResolvedFrame resolve(int pid, std::uint64_t ip);
+  std::string describe(int pid, std::uint64_t ip);
+
+ private:
+  struct Mapping {
+    std::uint64_t start = 0;
+    std::uint64_t end = 0;
+    std::uint64_t offset = 0;
+    std::string path;
+    std::string module;
+    std::shared_ptr<ElfSymbolTable> table;
+  };
+
+  std::shared_ptr<ElfSymbolTable> table(int pid, const std::string &path);
+
+  std::string cache_dir_;
+  std::unordered_map<int, std::vector<Mapping>> processes_;
+  std::unordered_map<std::string, std::shared_ptr<ElfSymbolTable>> tables_;
+};
+
+} // namespace proccli
@@ -1,12 +1,31 @@
 #pragma once
 
+#include <cstddef>
 #include <string>
+#include <string_view>
 
 namespace proccli {
 
+class MappedFile {
+ public:
+  MappedFile() = default;
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool open(const std::string &path, std::string &error);
+  std::string_view view() const { return {data_, size_}; }
+  void release(std::string_view consumed) const;
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
+
 std::string readFile(const std::string &path);
+bool readFileAt(int dir_fd, const char *path, std::string &buffer);
 void writeFile(const std::string &path, const std::string &content);
 std::string isoTimestamp();
-std::string makeArtifactsDir(const std::string &base);
+std::string makeArtifactsDir(const std::string &base, const std::string &root = "artifacts");
 
 } // namespace proccli
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "proccli/diagnostics.h"
+
+namespace proccli {
+
+class ValgrindXmlParser {
+ public:
+  static constexpr size_t kStackDepth = 8;
+
+  explicit ValgrindXmlParser(size_t max_sites = 4096);
+
+  void feed(std::string_view chunk);
+  ValgrindReport report(size_t top = 20) const;
+  unsigned long long errors() const { return errors_; }
+
+ private:
+  enum class Element {
+    Other,
+    Root,
+    Error,
+    Unique,
+    Kind,
+    What,
+    Xwhat,
+    Text,
+    LeakedBytes,
+    LeakedBlocks,
+    Stack,
+    Frame,
+    Ip,
+    Obj,
+    Fn,
+    File,
+    Line,
+    ErrorCounts,
+    Pair,
+    Count,
+  };
+  struct FrameText {
+    std::string ip;
+    std::string obj;
+    std::string fn;
+    std::string file;
+    std::string line;
+  };
+  struct PendingError {
+    std::string unique;
+    std::string kind;
+    std::string what;
+    std::vector<std::string> stack;
+    long long leaked_bytes = 0;
+    long long leaked_blocks = 0;
+    int stacks = 0;
+  };
+  struct KindTotals {
+    long long count = 0;
+    long long leaked_bytes = 0;
+  };
+  struct SiteRef {
+    size_t site = 0;
+    std::string kind;
+    long long counted = 0;
+  };
+
+  void handleTag(std::string_view tag);
+  void openElement(std::string_view name);
+  void closeElement();
+  void finishText(Element element);
+  void commitError();
+  void applyErrorCount();
+  Element parent(size_t level = 1) const;
+
+  size_t max_sites_;
+  unsigned long long errors_ = 0;
+  bool in_tag_ = false;
+  bool capturing_ = false;
+  std::string tag_;
+  std::string text_;
+  std::vector<Element> elements_;
+  PendingError error_;
+  FrameText frame_;
+  std::string pair_unique_;
+  long long pair_count_ = 0;
+  std::vector<ValgrindSite> sites_;
+  size_t leak_sites_ = 0;
+  std::unordered_map<std::string, size_t> site_index_;
+  std::unordered_map<std::string, SiteRef> uniques_;
+  std::map<std::string, KindTotals> kinds_;
+  long long unattributed_ = 0;
+};
+
+} // namespace proccli
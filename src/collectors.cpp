@@ -1,89 +1,340 @@
 #include "proccli/collectors.h"
+#include "proccli/massif.h"
+#include "proccli/parallel.h"
+#include "proccli/proc_scanner.h"
+#include "proccli/scheduler.h"
+#include "proccli/subprocess.h"
+#include "proccli/sampler.h"
 #include "proccli/utils.h"
 
 #include <algorithm>
 #include <array>
+#include <charconv>
+#include <cmath>
 #include <cstdio>
+#include <cstdlib>
 #include <map>
-#include <regex>
 #include <sstream>
+#include <unordered_map>
+
+#include <cctype>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 #include <spdlog/spdlog.h>
 
 namespace proccli {
 
-CommandResult runCommand(const std::string &command) {
-  CommandResult result;
-  std::array<char, 256> buffer{};
-  std::string output;
-  FILE *pipe = popen(command.c_str(), "r");
-  if (!pipe) {
-    result.exit_code = 1;
-    return result;
+namespace {
+
+constexpr int kPsTimeoutMs = 10000;
+constexpr int kValgrindKillGraceMs = 2000;
+
+struct SmapsTotals {
+  long long size_kb = 0;
+  long long rss_kb = 0;
+  long long pss_kb = 0;
+  long long pss_anon_kb = 0;
+  long long pss_file_kb = 0;
+  long long pss_shmem_kb = 0;
+  long long anonymous_kb = 0;
+  long long shared_kb = 0;
+  long long private_kb = 0;
+  long long swap_kb = 0;
+  long long swap_pss_kb = 0;
+  bool has_pss_split = false;
+};
+
+bool isSmapsHeader(std::string_view line) {
+  if (line.empty()) {
+    return false;
+  }
+  char c = line.front();
+  return ((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')) &&
+         line.find('-') < line.find(' ');
+}
+
+std::string_view smapsMappingName(std::string_view line) {
+  for (int field = 0; field < 5; ++field) {
+    auto space = line.find(' ');
+    if (space == std::string_view::npos) {
+      return {};
+    }
+    line.remove_prefix(space);
+    while (!line.empty() && line.front() == ' ') {
+      line.remove_prefix(1);
+    }
+  }
+  return line;
+}
+
+void applySmapsField(std::string_view key, long long value, SmapsTotals &totals) {
+  if (key == "Size") {
+    totals.size_kb += value;
+  } else if (key == "Rss") {
+    totals.rss_kb += value;
+  } else if (key == "Pss") {
+    totals.pss_kb += value;
+  } else if (key == "Pss_Anon") {
+    totals.pss_anon_kb += value;
+    totals.has_pss_split = true;
+  } else if (key == "Pss_File") {
+    totals.pss_file_kb += value;
+    totals.has_pss_split = true;
+  } else if (key == "Pss_Shmem") {
+    totals.pss_shmem_kb += value;
+    totals.has_pss_split = true;
+  } else if (key == "Shared_Clean" || key == "Shared_Dirty") {
+    totals.shared_kb += value;
+  } else if (key == "Private_Clean" || key == "Private_Dirty") {
+    totals.private_kb += value;
+  } else if (key == "Anonymous") {
+    totals.anonymous_kb += value;
+  } else if (key == "Swap") {
+    totals.swap_kb += value;
+  } else if (key == "SwapPss") {
+    totals.swap_pss_kb += value;
+  }
+}
+
+void addRegion(MemoryRegion &region, const SmapsTotals &mapping) {
+  region.mappings += 1;
+  region.size_kb += mapping.size_kb;
+  region.rss_kb += mapping.rss_kb;
+  region.pss_kb += mapping.pss_kb;
+  region.anonymous_kb += mapping.anonymous_kb;
+  region.shared_kb += mapping.shared_kb;
+  region.private_kb += mapping.private_kb;
+  region.swap_kb += mapping.swap_kb;
+}
+
+bool isBlank(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\v' || c == '\f' || c == '\r';
+}
+
+bool isDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+std::string_view nextLine(std::string_view &text) {
+  size_t end = text.find('\n');
+  std::string_view line = text.substr(0, end);
+  text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+  return line;
+}
+
+std::string_view nextToken(std::string_view &text) {
+  size_t start = 0;
+  while (start < text.size() && isBlank(text[start])) {
+    ++start;
+  }
+  size_t end = start;
+  while (end < text.size() && !isBlank(text[end])) {
+    ++end;
+  }
+  std::string_view token = text.substr(start, end - start);
+  text.remove_prefix(end);
+  return token;
+}
+
+std::string_view splitKey(std::string_view &line) {
+  size_t colon = line.find(':');
+  if (colon == std::string_view::npos) {
+    return {};
+  }
+  std::string_view key = line.substr(0, colon);
+  line.remove_prefix(colon + 1);
+  return key;
+}
+
+template <typename T>
+bool parseNumber(std::string_view token, T &value) {
+  T parsed{};
+  auto [ptr, ec] = std::from_chars(token.data(), token.data() + token.size(), parsed);
+  if (token.empty() || ec != std::errc() || ptr != token.data() + token.size()) {
+    return false;
   }
-  while (fgets(buffer.data(), static_cast<int>(buffer.size()), pipe) != nullptr) {
-    output += buffer.data();
+  value = parsed;
+  return true;
+}
+
+void parsePerfReportHeader(std::string_view line, PerfReport &report) {
+  constexpr std::string_view kEvent = "# Event: ";
+  constexpr std::string_view kSamples = "# Samples: ";
+  if (line.compare(0, kEvent.size(), kEvent) == 0) {
+    report.event = line.substr(kEvent.size());
+  } else if (line.compare(0, kSamples.size(), kSamples) == 0) {
+    line.remove_prefix(kSamples.size());
+    long long samples = 0;
+    long long lost = 0;
+    if (parseNumber(nextToken(line), samples) && nextToken(line) == "(lost") {
+      std::string_view count = nextToken(line);
+      if (!count.empty() && count.back() == ')' &&
+          parseNumber(count.substr(0, count.size() - 1), lost)) {
+        report.samples = samples;
+        report.lost = lost;
+      }
+    }
+  }
+}
+
+void parsePerfReportLine(std::string_view line, PerfReport &report) {
+  if (line.empty() || isBlank(line.back())) {
+    return;
+  }
+  if (line.front() == '#') {
+    parsePerfReportHeader(line, report);
+    return;
+  }
+  size_t start = 0;
+  while (start < line.size() && isBlank(line[start])) {
+    ++start;
+  }
+  size_t index = start;
+  auto skipDigits = [&line, &index]() {
+    size_t first = index;
+    while (index < line.size() && isDigit(line[index])) {
+      ++index;
+    }
+    return index > first;
+  };
+  if (!skipDigits() || index == line.size() || line[index] != '.') {
+    return;
   }
-  int code = pclose(pipe);
-  result.exit_code = code;
-  result.output = output;
+  ++index;
+  if (!skipDigits() || index == line.size() || line[index] != '%') {
+    return;
+  }
+  size_t percent_end = index;
+  if (percent_end + 2 >= line.size() || !isBlank(line[percent_end + 1])) {
+    return;
+  }
+  // Demangled symbols contain spaces, so everything after the "[.] " / "[k] " marker is the
+  // symbol; only lines without a marker fall back to the last token.
+  size_t symbol = std::string_view::npos;
+  for (size_t open = line.find('[', percent_end); open != std::string_view::npos;
+       open = line.find('[', open + 1)) {
+    if (open + 3 < line.size() && line[open + 2] == ']' && line[open + 3] == ' ' &&
+        isBlank(line[open - 1])) {
+      symbol = open + 4;
+      break;
+    }
+  }
+  if (symbol == std::string_view::npos) {
+    symbol = line.size();
+    while (symbol > 0 && !isBlank(line[symbol - 1])) {
+      --symbol;
+    }
+    if (symbol < percent_end + 3) {
+      return;
+    }
+  }
+  if (symbol >= line.size()) {
+    return;
+  }
+  PerfHotspot hotspot;
+  hotspot.symbol = line.substr(symbol);
+  parseNumber(line.substr(start, percent_end - start), hotspot.percent);
+  report.hotspots.push_back(std::move(hotspot));
+}
+
+bool findInPath(const std::string &name) {
+  const char *path = std::getenv("PATH");
+  std::string_view rest(path != nullptr ? path : "");
+  while (!rest.empty()) {
+    size_t end = rest.find(':');
+    std::string dir(rest.substr(0, end));
+    rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+    std::string candidate = (dir.empty() ? "." : dir) + "/" + name;
+    if (access(candidate.c_str(), X_OK) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+} // namespace
+
+CommandResult runCommand(const std::vector<std::string> &argv, int timeout_ms) {
+  SubprocessOptions options;
+  options.timeout_ms = timeout_ms;
+  auto process = runProcess(argv, options);
+  CommandResult result;
+  result.exit_code = process.started ? process.exit_code : 127;
+  result.output = std::move(process.out);
+  result.error_output = process.error.empty() ? std::move(process.err) : process.error;
   return result;
 }
 
 CommandResult PsCollector::collect() {
-  return runCommand("ps -eo pid,ppid,cmd,rss,vsz,pcpu,pmem,etime --no-headers");
+  return runCommand({"ps", "-eo", "pid,ppid,cmd,rss,vsz,pcpu,pmem,etime,nlwp", "--no-headers"},
+                    kPsTimeoutMs);
 }
 
-std::vector<ProcessInfo> PsCollector::parse(const std::string &output) {
+std::vector<ProcessInfo> PsCollector::parse(std::string_view output) {
   std::vector<ProcessInfo> processes;
-  std::istringstream stream(output);
-  std::string line;
-  while (std::getline(stream, line)) {
-    if (line.empty()) {
-      continue;
+  std::vector<std::string_view> tokens;
+  std::string_view rest(output);
+  while (!rest.empty()) {
+    std::string_view line = nextLine(rest);
+    tokens.clear();
+    for (auto token = nextToken(line); !token.empty(); token = nextToken(line)) {
+      tokens.push_back(token);
     }
-    std::istringstream line_stream(line);
-    ProcessInfo info;
-    if (!(line_stream >> info.pid >> info.ppid)) {
+    if (tokens.size() < 7) {
       continue;
     }
-    std::string cmd_part;
-    std::vector<std::string> cmd_tokens;
-    while (line_stream >> cmd_part) {
-      cmd_tokens.push_back(cmd_part);
+    size_t last = tokens.size() - 1;
+    ProcessInfo info;
+    // An optional thread count follows etime; etime always contains a ':' and the count never
+    // does, which keeps ps.txt files written before the column existed readable.
+    if (tokens.size() >= 8 && tokens[last].find(':') == std::string_view::npos &&
+        tokens[last - 1].find(':') != std::string_view::npos &&
+        parseNumber(tokens[last], info.num_threads)) {
+      --last;
     }
-    if (cmd_tokens.size() < 5) {
+    if (!parseNumber(tokens[0], info.pid) || !parseNumber(tokens[1], info.ppid) ||
+        !parseNumber(tokens[last - 4], info.rss_kb) || !parseNumber(tokens[last - 3], info.vsz_kb) ||
+        !parseNumber(tokens[last - 2], info.cpu_percent) ||
+        !parseNumber(tokens[last - 1], info.mem_percent)) {
       continue;
     }
-    info.etime = cmd_tokens.back();
-    cmd_tokens.pop_back();
-    info.mem_percent = std::stod(cmd_tokens.back());
-    cmd_tokens.pop_back();
-    info.cpu_percent = std::stod(cmd_tokens.back());
-    cmd_tokens.pop_back();
-    info.vsz_kb = std::stoi(cmd_tokens.back());
-    cmd_tokens.pop_back();
-    info.rss_kb = std::stoi(cmd_tokens.back());
-    cmd_tokens.pop_back();
-    std::ostringstream cmd_stream;
-    for (size_t i = 0; i < cmd_tokens.size(); ++i) {
-      if (i > 0) {
-        cmd_stream << ' ';
+    info.etime = tokens[last];
+    for (size_t i = 2; i + 4 < last; ++i) {
+      if (i > 2) {
+        info.cmd += ' ';
       }
-      cmd_stream << cmd_tokens[i];
+      info.cmd += tokens[i];
     }
-    info.cmd = cmd_stream.str();
-    processes.push_back(info);
+    processes.push_back(std::move(info));
   }
   return processes;
 }
 
+std::string PsCollector::format(const std::vector<ProcessInfo> &processes) {
+  std::ostringstream output;
+  for (const auto &info : processes) {
+    output << info.pid << ' ' << info.ppid << ' ' << info.cmd << ' ' << info.rss_kb << ' '
+           << info.vsz_kb << ' ' << info.cpu_percent << ' ' << info.mem_percent << ' ' << info.etime
+           << ' ' << info.num_threads << '\n';
+  }
+  return output.str();
+}
+
 CommandResult ProcfsCollector::collectMemInfo() {
-  return runCommand("cat /proc/meminfo");
+  std::string content = readFile("/proc/meminfo");
+  return CommandResult{content.empty() ? 1 : 0, content, {}};
 }
 
 CommandResult ProcfsCollector::collectLoadAvg() {
-  return runCommand("cat /proc/loadavg");
+  std::string content = readFile("/proc/loadavg");
+  return CommandResult{content.empty() ? 1 : 0, content, {}};
 }
 
 std::optional<CommandResult> ProcfsCollector::collectStatus(int pid) {
@@ -92,7 +343,7 @@ std::optional<CommandResult> ProcfsCollector::collectStatus(int pid) {
   if (content.empty()) {
     return std::nullopt;
   }
-  return CommandResult{0, content};
+  return CommandResult{0, content, {}};
 }
 
 std::optional<CommandResult> ProcfsCollector::collectIo(int pid) {
@@ -101,91 +352,321 @@ std::optional<CommandResult> ProcfsCollector::collectIo(int pid) {
   if (content.empty()) {
     return std::nullopt;
   }
-  return CommandResult{0, content};
+  return CommandResult{0, content, {}};
+}
+
+std::vector<ThreadSample> ProcfsCollector::collectThreads(int pid, const std::string &root) {
+  std::vector<ThreadSample> threads;
+  std::string task_root = root + "/" + std::to_string(pid) + "/task";
+  ProcScanner tasks(task_root);
+  std::vector<int> tids = tasks.listPids();
+  int dir_fd = open(task_root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (dir_fd < 0) {
+    return threads;
+  }
+  threads.reserve(tids.size());
+  std::string buffer;
+  std::string path;
+  ProcStat stat;
+  for (int tid : tids) {
+    path = std::to_string(tid);
+    size_t base = path.size();
+    path += "/stat";
+    if (!readFileAt(dir_fd, path.c_str(), buffer) || !parseProcStat(buffer, stat)) {
+      continue;
+    }
+    ThreadSample sample;
+    sample.tid = tid;
+    sample.name = stat.comm;
+    sample.state = stat.state;
+    sample.cpu_ticks = stat.utime + stat.stime;
+    sample.processor = stat.processor;
+    path.resize(base);
+    path += "/status";
+    if (readFileAt(dir_fd, path.c_str(), buffer)) {
+      ProcCounters counters;
+      parseStatusCounters(buffer, counters);
+      sample.voluntary_ctxt = counters.voluntary_ctxt;
+      sample.nonvoluntary_ctxt = counters.nonvoluntary_ctxt;
+    }
+    threads.push_back(std::move(sample));
+  }
+  close(dir_fd);
+  return threads;
+}
+
+std::vector<ThreadInfo> ProcfsCollector::rankThreads(const std::vector<ThreadSample> &before,
+                                                     const std::vector<ThreadSample> &after,
+                                                     double seconds) {
+  long clock_ticks = sysconf(_SC_CLK_TCK);
+  if (clock_ticks <= 0) {
+    clock_ticks = 100;
+  }
+  double ms_per_tick = 1000.0 / static_cast<double>(clock_ticks);
+  std::unordered_map<int, const ThreadSample *> previous;
+  previous.reserve(before.size());
+  for (const auto &sample : before) {
+    previous.emplace(sample.tid, &sample);
+  }
+  std::vector<ThreadInfo> threads;
+  threads.reserve(after.size());
+  for (const auto &sample : after) {
+    ThreadInfo info;
+    info.tid = sample.tid;
+    info.name = sample.name;
+    info.state = std::string(1, sample.state);
+    info.cpu_total_ms = static_cast<double>(sample.cpu_ticks) * ms_per_tick;
+    unsigned long long delta = sample.cpu_ticks;
+    auto it = previous.find(sample.tid);
+    if (it != previous.end() && it->second->cpu_ticks <= sample.cpu_ticks) {
+      delta = sample.cpu_ticks - it->second->cpu_ticks;
+    }
+    info.cpu_delta_ms = static_cast<double>(delta) * ms_per_tick;
+    if (seconds > 0.0) {
+      info.cpu_percent = info.cpu_delta_ms / (seconds * 10.0);
+    }
+    info.voluntary_ctxt_switches = sample.voluntary_ctxt;
+    info.nonvoluntary_ctxt_switches = sample.nonvoluntary_ctxt;
+    info.last_cpu = sample.processor;
+    threads.push_back(std::move(info));
+  }
+  std::sort(threads.begin(), threads.end(), [](const ThreadInfo &a, const ThreadInfo &b) {
+    if (a.cpu_delta_ms != b.cpu_delta_ms) {
+      return a.cpu_delta_ms > b.cpu_delta_ms;
+    }
+    if (a.cpu_total_ms != b.cpu_total_ms) {
+      return a.cpu_total_ms > b.cpu_total_ms;
+    }
+    return a.tid < b.tid;
+  });
+  return threads;
+}
+
+std::optional<CommandResult> ProcfsCollector::collectSmapsRollup(int pid) {
+  std::string content = readFile("/proc/" + std::to_string(pid) + "/smaps_rollup");
+  if (content.empty()) {
+    return std::nullopt;
+  }
+  return CommandResult{0, content, {}};
+}
+
+std::optional<CommandResult> ProcfsCollector::collectSmaps(int pid) {
+  std::string content = readFile("/proc/" + std::to_string(pid) + "/smaps");
+  if (content.empty()) {
+    return std::nullopt;
+  }
+  return CommandResult{0, content, {}};
+}
+
+std::optional<MemoryBreakdown> ProcfsCollector::parseSmaps(int pid, std::string_view content,
+                                                           bool per_region) {
+  if (content.empty()) {
+    return std::nullopt;
+  }
+  SmapsTotals totals;
+  SmapsTotals mapping;
+  std::string_view name;
+  bool in_mapping = false;
+  std::unordered_map<std::string_view, size_t> region_index;
+  std::vector<MemoryRegion> regions;
+
+  auto finishMapping = [&]() {
+    if (!in_mapping || !per_region) {
+      return;
+    }
+    std::string_view key = name;
+    if (key.empty()) {
+      key = "[anon]";
+    } else if (key.size() > 10 && key.substr(key.size() - 10) == " (deleted)") {
+      key.remove_suffix(10);
+    }
+    auto [it, inserted] = region_index.emplace(key, regions.size());
+    if (inserted) {
+      regions.push_back(MemoryRegion{std::string(key)});
+    }
+    addRegion(regions[it->second], mapping);
+    if (!mapping.has_pss_split) {
+      if (name.empty() || name.front() == '[') {
+        totals.pss_anon_kb += mapping.pss_kb;
+      } else if (name.compare(0, 9, "/dev/shm/") == 0 || name.compare(0, 6, "/SYSV0") == 0 ||
+                 name.compare(0, 7, "/memfd:") == 0) {
+        totals.pss_shmem_kb += mapping.pss_kb;
+      } else {
+        totals.pss_file_kb += mapping.pss_kb;
+      }
+    }
+  };
+
+  size_t pos = 0;
+  bool found = false;
+  while (pos < content.size()) {
+    size_t end = content.find('\n', pos);
+    if (end == std::string_view::npos) {
+      end = content.size();
+    }
+    std::string_view line = content.substr(pos, end - pos);
+    pos = end + 1;
+    if (isSmapsHeader(line)) {
+      finishMapping();
+      mapping = SmapsTotals{};
+      name = smapsMappingName(line);
+      in_mapping = true;
+      continue;
+    }
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos) {
+      continue;
+    }
+    std::string_view key = line.substr(0, colon);
+    std::string_view rest = line.substr(colon + 1);
+    while (!rest.empty() && rest.front() == ' ') {
+      rest.remove_prefix(1);
+    }
+    long long value = 0;
+    if (std::from_chars(rest.data(), rest.data() + rest.size(), value).ec != std::errc()) {
+      continue;
+    }
+    applySmapsField(key, value, totals);
+    if (per_region) {
+      applySmapsField(key, value, mapping);
+    }
+    found = true;
+  }
+  finishMapping();
+  if (!found) {
+    return std::nullopt;
+  }
+
+  MemoryBreakdown breakdown;
+  breakdown.pid = pid;
+  breakdown.source = per_region ? "smaps" : "smaps_rollup";
+  breakdown.rss_kb = totals.rss_kb;
+  breakdown.pss_kb = totals.pss_kb;
+  breakdown.pss_anon_kb = totals.pss_anon_kb;
+  breakdown.pss_file_kb = totals.pss_file_kb;
+  breakdown.pss_shmem_kb = totals.pss_shmem_kb;
+  breakdown.anonymous_kb = totals.anonymous_kb;
+  breakdown.shared_kb = totals.shared_kb;
+  breakdown.private_kb = totals.private_kb;
+  breakdown.swap_kb = totals.swap_kb;
+  breakdown.swap_pss_kb = totals.swap_pss_kb;
+  std::sort(regions.begin(), regions.end(), [](const MemoryRegion &a, const MemoryRegion &b) {
+    if (a.pss_kb != b.pss_kb) {
+      return a.pss_kb > b.pss_kb;
+    }
+    return a.name < b.name;
+  });
+  breakdown.regions = std::move(regions);
+  return breakdown;
 }
 
-std::optional<MemInfo> ProcfsCollector::parseMemInfo(const std::string &content) {
+std::optional<MemInfo> ProcfsCollector::parseMemInfo(std::string_view content) {
   if (content.empty()) {
     return std::nullopt;
   }
   MemInfo info;
-  std::istringstream stream(content);
-  std::string key;
-  long value = 0;
-  std::string unit;
-  while (stream >> key >> value >> unit) {
-    if (key == "MemTotal:") {
-      info.mem_total_kb = static_cast<int>(value);
-    } else if (key == "MemFree:") {
-      info.mem_free_kb = static_cast<int>(value);
-    } else if (key == "MemAvailable:") {
-      info.mem_available_kb = static_cast<int>(value);
+  std::string_view rest(content);
+  while (!rest.empty()) {
+    std::string_view value = nextLine(rest);
+    std::string_view key = splitKey(value);
+    int *field = key == "MemTotal"       ? &info.mem_total_kb
+                 : key == "MemFree"      ? &info.mem_free_kb
+                 : key == "MemAvailable" ? &info.mem_available_kb
+                                         : nullptr;
+    if (field != nullptr) {
+      parseNumber(nextToken(value), *field);
     }
   }
   return info;
 }
 
-std::optional<LoadAvg> ProcfsCollector::parseLoadAvg(const std::string &content) {
+std::optional<LoadAvg> ProcfsCollector::parseLoadAvg(std::string_view content) {
   if (content.empty()) {
     return std::nullopt;
   }
-  std::istringstream stream(content);
+  std::string_view rest(content);
   LoadAvg info;
-  if (!(stream >> info.one >> info.five >> info.fifteen)) {
+  if (!parseNumber(nextToken(rest), info.one) || !parseNumber(nextToken(rest), info.five) ||
+      !parseNumber(nextToken(rest), info.fifteen)) {
     return std::nullopt;
   }
   return info;
 }
 
-std::optional<IoStats> ProcfsCollector::parseIo(int pid, const std::string &content) {
+std::optional<IoStats> ProcfsCollector::parseIo(int pid, std::string_view content) {
   if (content.empty()) {
     return std::nullopt;
   }
   IoStats stats;
   stats.pid = pid;
-  std::istringstream stream(content);
-  std::string key;
-  long long value = 0;
-  while (stream >> key >> value) {
-    if (key == "read_bytes:") {
-      stats.read_bytes = value;
-    } else if (key == "write_bytes:") {
-      stats.write_bytes = value;
+  std::string_view rest(content);
+  while (!rest.empty()) {
+    std::string_view value = nextLine(rest);
+    std::string_view key = splitKey(value);
+    if (key == "read_bytes") {
+      parseNumber(nextToken(value), stats.read_bytes);
+    } else if (key == "write_bytes") {
+      parseNumber(nextToken(value), stats.write_bytes);
     }
   }
   return stats;
 }
 
-std::optional<ValgrindReport> ValgrindCollector::parse(const std::string &output) {
+std::optional<ValgrindReport> ValgrindCollector::parse(std::string_view output) {
   if (output.empty()) {
     return std::nullopt;
   }
   ValgrindReport report;
-  std::regex error_summary(R"(ERROR SUMMARY: (\d+) errors)" );
-  std::smatch match;
-  if (std::regex_search(output, match, error_summary)) {
-    report.errors.push_back({"summary", std::stoi(match[1])});
-  }
-  std::regex leak_line(R"((definitely lost|indirectly lost|possibly lost|still reachable):\s+([0-9,]+) bytes)" );
-  auto begin = std::sregex_iterator(output.begin(), output.end(), leak_line);
-  auto end = std::sregex_iterator();
+  std::string_view text(output);
+  constexpr std::string_view kErrorSummary = "ERROR SUMMARY: ";
+  for (size_t pos = text.find(kErrorSummary); pos != std::string_view::npos;
+       pos = text.find(kErrorSummary, pos + 1)) {
+    std::string_view rest = text.substr(pos + kErrorSummary.size());
+    int count = 0;
+    if (rest.empty() || !isDigit(rest.front())) {
+      continue;
+    }
+    auto [ptr, ec] = std::from_chars(rest.data(), rest.data() + rest.size(), count);
+    rest.remove_prefix(static_cast<size_t>(ptr - rest.data()));
+    if (ec == std::errc() && rest.compare(0, 7, " errors") == 0) {
+      report.errors.push_back({"summary", count});
+      break;
+    }
+  }
+  constexpr std::array<std::pair<std::string_view, int LeakSummary::*>, 4> kLeakKinds = {{
+      {"definitely lost:", &LeakSummary::definitely_lost_kb},
+      {"indirectly lost:", &LeakSummary::indirectly_lost_kb},
+      {"possibly lost:", &LeakSummary::possibly_lost_kb},
+      {"still reachable:", &LeakSummary::still_reachable_kb},
+  }};
   LeakSummary summary;
   bool found = false;
-  for (auto it = begin; it != end; ++it) {
-    std::string kind = (*it)[1];
-    std::string bytes_str = (*it)[2];
-    bytes_str.erase(std::remove(bytes_str.begin(), bytes_str.end(), ','), bytes_str.end());
-    int kb = static_cast<int>(std::stoll(bytes_str) / 1024);
-    if (kind == "definitely lost") {
-      summary.definitely_lost_kb = kb;
-    } else if (kind == "indirectly lost") {
-      summary.indirectly_lost_kb = kb;
-    } else if (kind == "possibly lost") {
-      summary.possibly_lost_kb = kb;
-    } else if (kind == "still reachable") {
-      summary.still_reachable_kb = kb;
+  for (const auto &[kind, field] : kLeakKinds) {
+    for (size_t pos = text.find(kind); pos != std::string_view::npos;
+         pos = text.find(kind, pos + kind.size())) {
+      std::string_view rest = text.substr(pos + kind.size());
+      size_t index = 0;
+      while (index < rest.size() && isBlank(rest[index])) {
+        ++index;
+      }
+      if (index == 0) {
+        continue;
+      }
+      long long bytes = 0;
+      bool digits = false;
+      while (index < rest.size() && (isDigit(rest[index]) || rest[index] == ',')) {
+        if (rest[index] != ',') {
+          bytes = bytes * 10 + (rest[index] - '0');
+          digits = true;
+        }
+        ++index;
+      }
+      if (!digits || rest.compare(index, 6, " bytes") != 0) {
+        continue;
+      }
+      summary.*field = static_cast<int>(bytes / 1024);
+      found = true;
     }
-    found = true;
   }
   if (found) {
     report.leak_summary = summary;
@@ -193,64 +674,393 @@ std::optional<ValgrindReport> ValgrindCollector::parse(const std::string &output
   return report;
 }
 
-std::optional<PerfReport> PerfCollector::parse(const std::string &output) {
+std::optional<ValgrindReport> ValgrindCollector::parseXml(std::string_view xml) {
+  if (xml.empty()) {
+    return std::nullopt;
+  }
+  ValgrindXmlParser parser;
+  parser.feed(xml);
+  return parser.report();
+}
+
+bool ValgrindCollector::supportsXml(const std::string &tool) {
+  return tool == "memcheck" || tool == "helgrind" || tool == "drd";
+}
+
+ValgrindCollector::~ValgrindCollector() {
+  if (pid_ > 0) {
+    finish();
+  }
+}
+
+int ValgrindCollector::start(const std::string &command, const ValgrindRunOptions &options,
+                             std::string &error) {
+  bool massif = options.tool == "massif";
+  if (!supportsXml(options.tool) && !massif) {
+    error = "valgrind tool " + options.tool +
+            " is not supported (use memcheck, helgrind, drd or massif)";
+    return -1;
+  }
+  if (massif && options.massif_path.empty()) {
+    error = "massif needs an output path";
+    return -1;
+  }
+  if (!findInPath("valgrind")) {
+    error = "valgrind not found in PATH";
+    return -1;
+  }
+  int pipe_fds[2] = {-1, -1};
+  if (!massif && pipe(pipe_fds) != 0) {
+    error = std::string("pipe failed: ") + std::strerror(errno);
+    return -1;
+  }
+  std::vector<std::string> args = {"sh", "-c", "exec valgrind \"$@\" " + command, "sh",
+                                   "--tool=" + options.tool};
+  if (massif) {
+    args.push_back("--massif-out-file=" + options.massif_path);
+  } else {
+    fcntl(pipe_fds[0], F_SETFD, FD_CLOEXEC);
+    args.push_back("--xml=yes");
+    args.push_back("--xml-fd=" + std::to_string(pipe_fds[1]));
+  }
+  if (options.tool == "memcheck") {
+    args.push_back("--leak-check=full");
+    args.push_back("--show-leak-kinds=definite,indirect,possible");
+  }
+  if (!options.log_path.empty()) {
+    args.push_back("--log-file=" + options.log_path);
+  }
+  std::vector<char *> argv;
+  for (auto &arg : args) {
+    argv.push_back(arg.data());
+  }
+  argv.push_back(nullptr);
+  pid_t child = fork();
+  if (child < 0) {
+    error = std::string("fork failed: ") + std::strerror(errno);
+    if (!massif) {
+      close(pipe_fds[0]);
+      close(pipe_fds[1]);
+    }
+    return -1;
+  }
+  if (child == 0) {
+    execv("/bin/sh", argv.data());
+    _exit(127);
+  }
+  pid_ = static_cast<int>(child);
+  exited_ = false;
+  if (massif) {
+    massif_path_ = options.massif_path;
+    return pid_;
+  }
+  close(pipe_fds[1]);
+  xml_fd_ = pipe_fds[0];
+  int raw_fd = -1;
+  if (!options.xml_path.empty()) {
+    raw_fd = open(options.xml_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  }
+  reader_ = std::thread(&ValgrindCollector::readXml, this, raw_fd);
+  return pid_;
+}
+
+void ValgrindCollector::readXml(int raw_fd) {
+  std::vector<char> buffer(1 << 16);
+  while (true) {
+    pollfd poll_fd{xml_fd_, POLLIN, 0};
+    int ready = poll(&poll_fd, 1, 100);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready == 0) {
+      if (exited_) {
+        break;
+      }
+      continue;
+    }
+    ssize_t bytes = read(xml_fd_, buffer.data(), buffer.size());
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      break;
+    }
+    if (raw_fd >= 0 && write(raw_fd, buffer.data(), static_cast<size_t>(bytes)) < 0) {
+      close(raw_fd);
+      raw_fd = -1;
+    }
+    parser_.feed(std::string_view(buffer.data(), static_cast<size_t>(bytes)));
+  }
+  if (raw_fd >= 0) {
+    close(raw_fd);
+  }
+}
+
+ValgrindRunResult ValgrindCollector::finish(const CancelToken *cancel) {
+  ValgrindRunResult result;
+  if (pid_ <= 0) {
+    result.error = "valgrind was not started";
+    return result;
+  }
+  int status = 0;
+  double kill_at = 0.0;
+  bool terminated = false;
+  while (true) {
+    pid_t waited = waitpid(static_cast<pid_t>(pid_), &status, cancel != nullptr ? WNOHANG : 0);
+    if (waited == pid_ || (waited < 0 && errno != EINTR)) {
+      break;
+    }
+    if (waited <= 0 && cancel == nullptr) {
+      continue;
+    }
+    if (!terminated && cancel->cancelled()) {
+      kill(static_cast<pid_t>(pid_), SIGTERM);
+      kill_at = monotonicSeconds() + kValgrindKillGraceMs / 1000.0;
+      terminated = true;
+    } else if (kill_at > 0.0 && monotonicSeconds() >= kill_at) {
+      kill(static_cast<pid_t>(pid_), SIGKILL);
+      kill_at = 0.0;
+    }
+    usleep(20 * 1000);
+  }
+  exited_ = true;
+  pid_ = -1;
+  result.exit_code = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+  if (!massif_path_.empty()) {
+    std::string path = std::move(massif_path_);
+    massif_path_.clear();
+    result.heap_profile = readMassifFile(path, result.error);
+    result.ok = result.heap_profile.has_value();
+    return result;
+  }
+  reader_.join();
+  close(xml_fd_);
+  xml_fd_ = -1;
+  result.errors = parser_.errors();
+  result.report = parser_.report();
+  if (result.errors == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 127) {
+    result.error = "valgrind could not start the command";
+    return result;
+  }
+  result.ok = true;
+  return result;
+}
+
+std::optional<PerfReport> PerfCollector::parse(std::string_view output, size_t threads) {
   if (output.empty()) {
     return std::nullopt;
   }
+  auto chunks = splitChunks(output, parseChunkCount(output.size(), threads));
+  std::vector<PerfReport> partial(chunks.size());
+  parallelFor(chunks.size(), threads, [&](size_t index) {
+    std::string_view rest = chunks[index];
+    while (!rest.empty()) {
+      parsePerfReportLine(nextLine(rest), partial[index]);
+    }
+  });
   PerfReport report;
-  std::regex line_regex(R"(^\s*([0-9]+\.[0-9]+)%\s+.*\s+(\S+)$)" );
-  std::istringstream stream(output);
-  std::string line;
-  while (std::getline(stream, line)) {
-    std::smatch match;
-    if (std::regex_search(line, match, line_regex)) {
-      report.hotspots.push_back({match[2], std::stod(match[1])});
+  for (auto &part : partial) {
+    if (report.event.empty()) {
+      report.event = std::move(part.event);
     }
+    report.samples += part.samples;
+    report.lost += part.lost;
+    report.hotspots.insert(report.hotspots.end(), std::make_move_iterator(part.hotspots.begin()),
+                           std::make_move_iterator(part.hotspots.end()));
   }
   return report;
 }
 
-std::optional<StraceReport> StraceCollector::parse(const std::string &output) {
-  if (output.empty()) {
-    return std::nullopt;
+std::string PerfCollector::format(const PerfReport &report) {
+  std::ostringstream output;
+  output << "# Event: " << report.event << "\n";
+  output << "# Samples: " << report.samples << " (lost " << report.lost << ")\n";
+  char percent[64];
+  for (const auto &hotspot : report.hotspots) {
+    // Shortest fixed notation that parses back to the same double, so normalize is lossless.
+    auto [end, ec] = std::to_chars(percent, percent + sizeof(percent), hotspot.percent,
+                                   std::chars_format::fixed);
+    std::string_view digits(percent, ec == std::errc() ? static_cast<size_t>(end - percent) : 0);
+    if (digits.find('.') == std::string_view::npos) {
+      output << std::string(digits.size() < 3 ? 3 - digits.size() : 0, ' ') << digits << ".0";
+    } else {
+      output << std::string(digits.size() < 6 ? 6 - digits.size() : 0, ' ') << digits;
+    }
+    output << "%  [.] " << hotspot.symbol << "\n";
   }
+  return output.str();
+}
+
+StraceAggregator::StraceAggregator(size_t slow_limit) : slow_limit_(slow_limit) {}
+
+void StraceAggregator::addLine(std::string_view line) {
+  lines_ += 1;
+  auto skipSpaces = [&line]() {
+    while (!line.empty() && line.front() == ' ') {
+      line.remove_prefix(1);
+    }
+  };
+  if (line.compare(0, 4, "[pid") == 0) {
+    auto close = line.find(']');
+    if (close == std::string_view::npos) {
+      return;
+    }
+    line.remove_prefix(close + 1);
+  } else {
+    size_t digits = 0;
+    while (digits < line.size() && std::isdigit(static_cast<unsigned char>(line[digits]))) {
+      ++digits;
+    }
+    if (digits > 0 && digits < line.size() && line[digits] == ' ') {
+      line.remove_prefix(digits);
+    }
+  }
+  skipSpaces();
+  if (line.size() > 2 && std::isdigit(static_cast<unsigned char>(line[0])) &&
+      line.find(':') < line.find(' ')) {
+    line.remove_prefix(std::min(line.find(' '), line.size()));
+    skipSpaces();
+  }
+  if (line.empty() || line.back() != '>') {
+    return;
+  }
+  std::string_view name;
+  if (line.compare(0, 5, "<... ") == 0) {
+    auto end = line.find(' ', 5);
+    if (end == std::string_view::npos) {
+      return;
+    }
+    name = line.substr(5, end - 5);
+  } else {
+    size_t end = 0;
+    while (end < line.size() &&
+           (std::isalnum(static_cast<unsigned char>(line[end])) || line[end] == '_')) {
+      ++end;
+    }
+    if (end == 0 || end >= line.size() || line[end] != '(') {
+      return;
+    }
+    name = line.substr(0, end);
+  }
+  auto open = line.rfind('<');
+  if (open == std::string_view::npos || open == 0) {
+    return;
+  }
+  std::string_view number = line.substr(open + 1, line.size() - open - 2);
+  double seconds = 0.0;
+  auto [ptr, ec] = std::from_chars(number.data(), number.data() + number.size(), seconds);
+  if (ec != std::errc() || ptr != number.data() + number.size()) {
+    return;
+  }
+  auto duration_us = static_cast<std::uint64_t>(std::llround(std::max(seconds, 0.0) * 1e6));
+  auto it = stats_.find(name);
+  if (it == stats_.end()) {
+    it = stats_.emplace(std::string(name), Stats{}).first;
+  }
+  it->second.count += 1;
+  it->second.time_us += duration_us;
+  it->second.latency.record(duration_us);
+  keepSlow(it->first, static_cast<double>(duration_us) / 1000.0);
+}
+
+void StraceAggregator::keepSlow(const std::string &name, double duration_ms) {
+  if (slow_limit_ == 0) {
+    return;
+  }
+  StraceSlowSyscall call{name, duration_ms};
+  if (slow_.size() < slow_limit_) {
+    slow_.push(std::move(call));
+  } else if (SlowerFirst()(call, slow_.top())) {
+    slow_.pop();
+    slow_.push(std::move(call));
+  }
+}
+
+void StraceAggregator::merge(const StraceAggregator &other) {
+  lines_ += other.lines_;
+  for (const auto &item : other.stats_) {
+    auto &stats = stats_[item.first];
+    stats.count += item.second.count;
+    stats.time_us += item.second.time_us;
+    stats.latency.merge(item.second.latency);
+  }
+  auto slow = other.slow_;
+  while (!slow.empty()) {
+    keepSlow(slow.top().name, slow.top().duration_ms);
+    slow.pop();
+  }
+}
+
+// Every syscall keeps its stats so diff and history can rank by any field; consumers that render
+// the list (the compact snapshot) apply their own top-K.
+StraceReport StraceAggregator::report() const {
   StraceReport report;
-  std::regex syscall_regex(R"((\w+)\(.*\)\s+=\s+.*<([0-9.]+)>)" );
-  std::istringstream stream(output);
-  std::string line;
-  std::map<std::string, std::pair<int, double>> stats;
-  std::vector<StraceSlowSyscall> slow;
-  while (std::getline(stream, line)) {
-    std::smatch match;
-    if (std::regex_search(line, match, syscall_regex)) {
-      std::string name = match[1];
-      double duration = std::stod(match[2]) * 1000.0;
-      auto &entry = stats[name];
-      entry.first += 1;
-      entry.second += duration;
-      slow.push_back({name, duration});
-    }
-  }
-  std::vector<StraceSyscall> syscalls;
-  syscalls.reserve(stats.size());
-  for (const auto &item : stats) {
-    syscalls.push_back({item.first, item.second.first, item.second.second});
-  }
-  std::sort(syscalls.begin(), syscalls.end(),
-            [](const StraceSyscall &a, const StraceSyscall &b) { return a.count > b.count; });
-  if (syscalls.size() > 5) {
-    syscalls.resize(5);
-  }
-  std::sort(slow.begin(), slow.end(),
-            [](const StraceSlowSyscall &a, const StraceSlowSyscall &b) {
-              return a.duration_ms > b.duration_ms;
-            });
-  if (slow.size() > 5) {
-    slow.resize(5);
-  }
-  report.top_syscalls = syscalls;
-  report.slow_syscalls = slow;
+  for (const auto &item : stats_) {
+    report.top_syscalls.push_back({item.first, item.second.count,
+                                   static_cast<double>(item.second.time_us) / 1000.0,
+                                   item.second.latency.summary()});
+  }
+  std::stable_sort(report.top_syscalls.begin(), report.top_syscalls.end(),
+                   [](const StraceSyscall &a, const StraceSyscall &b) { return a.count > b.count; });
+  auto slow = slow_;
+  while (!slow.empty()) {
+    report.slow_syscalls.push_back(slow.top());
+    slow.pop();
+  }
+  std::reverse(report.slow_syscalls.begin(), report.slow_syscalls.end());
   return report;
 }
 
+std::optional<StraceReport> StraceCollector::parse(std::string_view output, size_t threads) {
+  if (output.empty()) {
+    return std::nullopt;
+  }
+  StraceAggregator aggregator;
+  aggregate(output, aggregator, threads);
+  return aggregator.report();
+}
+
+void StraceCollector::aggregate(std::string_view output, StraceAggregator &aggregator,
+                                size_t threads) {
+  auto chunks = splitChunks(output, parseChunkCount(output.size(), threads));
+  std::vector<StraceAggregator> partial(chunks.size());
+  parallelFor(chunks.size(), threads, [&](size_t index) {
+    std::string_view rest = chunks[index];
+    while (!rest.empty()) {
+      partial[index].addLine(nextLine(rest));
+    }
+  });
+  for (const auto &part : partial) {
+    aggregator.merge(part);
+  }
+}
+
+StraceRunResult StraceCollector::collect(int pid, int timeout_ms, const std::string &raw_path,
+                                         const CancelToken *cancel) {
+  StraceRunResult result;
+  StraceAggregator aggregator;
+  SubprocessOptions options;
+  options.timeout_ms = timeout_ms;
+  options.stdout_path = raw_path;
+  options.merge_stderr = true;
+  options.on_stdout_line = [&aggregator](std::string_view line) { aggregator.addLine(line); };
+  if (cancel != nullptr) {
+    options.stop_requested = [cancel] { return cancel->cancelled(); };
+  }
+  auto run =
+      runProcess({"strace", "-f", "-T", "-tt", "-qq", "-p", std::to_string(pid)}, options);
+  result.lines = aggregator.lines();
+  if (!run.started) {
+    result.error = run.spawn_errno == ENOENT ? "strace not found in PATH" : run.error;
+    return result;
+  }
+  if (result.lines == 0 && !run.timed_out && !run.stopped && run.exit_code != 0) {
+    result.error = "strace exited with status " + std::to_string(run.exit_code);
+    return result;
+  }
+  result.report = aggregator.report();
+  result.ok = true;
+  return result;
+}
+
 } // namespace proccli
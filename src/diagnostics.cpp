@@ -32,6 +32,34 @@ void to_json(nlohmann::json &j, const SystemInfo &info) {
   }
 }
 
+void to_json(nlohmann::json &j, const MemoryRegion &info) {
+  j = nlohmann::json{{"name", info.name},
+                     {"mappings", info.mappings},
+                     {"size_kb", info.size_kb},
+                     {"rss_kb", info.rss_kb},
+                     {"pss_kb", info.pss_kb},
+                     {"anonymous_kb", info.anonymous_kb},
+                     {"shared_kb", info.shared_kb},
+                     {"private_kb", info.private_kb},
+                     {"swap_kb", info.swap_kb}};
+}
+
+void to_json(nlohmann::json &j, const MemoryBreakdown &info) {
+  j = nlohmann::json{{"pid", info.pid},
+                     {"source", info.source},
+                     {"rss_kb", info.rss_kb},
+                     {"pss_kb", info.pss_kb},
+                     {"pss_anon_kb", info.pss_anon_kb},
+                     {"pss_file_kb", info.pss_file_kb},
+                     {"pss_shmem_kb", info.pss_shmem_kb},
+                     {"anonymous_kb", info.anonymous_kb},
+                     {"shared_kb", info.shared_kb},
+                     {"private_kb", info.private_kb},
+                     {"swap_kb", info.swap_kb},
+                     {"swap_pss_kb", info.swap_pss_kb},
+                     {"regions", info.regions}};
+}
+
 void to_json(nlohmann::json &j, const ProcessInfo &info) {
   j = nlohmann::json{{"pid", info.pid},
                      {"ppid", info.ppid},
@@ -40,7 +68,42 @@ void to_json(nlohmann::json &j, const ProcessInfo &info) {
                      {"vsz_kb", info.vsz_kb},
                      {"cpu_percent", info.cpu_percent},
                      {"mem_percent", info.mem_percent},
-                     {"etime", info.etime}};
+                     {"etime", info.etime},
+                     {"num_threads", info.num_threads}};
+}
+
+void to_json(nlohmann::json &j, const ProcessTreeNode &info) {
+  j = nlohmann::json{{"pid", info.pid},
+                     {"ppid", info.ppid},
+                     {"depth", info.depth},
+                     {"cmd", info.cmd},
+                     {"cpu_percent", info.cpu_percent},
+                     {"rss_kb", info.rss_kb},
+                     {"read_bytes", info.read_bytes},
+                     {"write_bytes", info.write_bytes},
+                     {"num_threads", info.num_threads},
+                     {"subtree_processes", info.subtree_processes},
+                     {"subtree_cpu_percent", info.subtree_cpu_percent},
+                     {"subtree_rss_kb", info.subtree_rss_kb},
+                     {"subtree_read_bytes", info.subtree_read_bytes},
+                     {"subtree_write_bytes", info.subtree_write_bytes},
+                     {"subtree_threads", info.subtree_threads}};
+}
+
+void to_json(nlohmann::json &j, const ProcessTree &info) {
+  j = nlohmann::json{{"root_pid", info.root_pid}, {"nodes", info.nodes}};
+}
+
+void to_json(nlohmann::json &j, const ThreadInfo &info) {
+  j = nlohmann::json{{"tid", info.tid},
+                     {"name", info.name},
+                     {"state", info.state},
+                     {"cpu_percent", info.cpu_percent},
+                     {"cpu_delta_ms", info.cpu_delta_ms},
+                     {"cpu_total_ms", info.cpu_total_ms},
+                     {"voluntary_ctxt_switches", info.voluntary_ctxt_switches},
+                     {"nonvoluntary_ctxt_switches", info.nonvoluntary_ctxt_switches},
+                     {"last_cpu", info.last_cpu}};
 }
 
 void to_json(nlohmann::json &j, const ValgrindError &info) {
@@ -54,23 +117,116 @@ void to_json(nlohmann::json &j, const LeakSummary &info) {
                      {"still_reachable_kb", info.still_reachable_kb}};
 }
 
+void to_json(nlohmann::json &j, const ValgrindSite &info) {
+  j = nlohmann::json{{"kind", info.kind},
+                     {"what", info.what},
+                     {"stack", info.stack},
+                     {"count", info.count},
+                     {"leaked_bytes", info.leaked_bytes},
+                     {"leaked_blocks", info.leaked_blocks}};
+}
+
 void to_json(nlohmann::json &j, const ValgrindReport &info) {
   j = nlohmann::json{{"errors", info.errors}};
   if (info.leak_summary) {
     j["leak_summary"] = *info.leak_summary;
   }
+  if (!info.sites.empty()) {
+    j["sites"] = info.sites;
+  }
+  if (info.unattributed_errors > 0) {
+    j["unattributed_errors"] = info.unattributed_errors;
+  }
+}
+
+void to_json(nlohmann::json &j, const HeapSnapshot &info) {
+  j = nlohmann::json{{"index", info.index},
+                     {"time", info.time},
+                     {"heap_bytes", info.heap_bytes},
+                     {"extra_bytes", info.extra_bytes},
+                     {"stack_bytes", info.stack_bytes}};
+}
+
+void to_json(nlohmann::json &j, const HeapSite &info) {
+  j = nlohmann::json{{"bytes", info.bytes}, {"percent", info.percent}, {"stack", info.stack}};
+}
+
+void to_json(nlohmann::json &j, const HeapProfile &info) {
+  j = nlohmann::json{{"command", info.command},
+                     {"time_unit", info.time_unit},
+                     {"peak_snapshot", info.peak_snapshot},
+                     {"peak_heap_bytes", info.peak_heap_bytes},
+                     {"peak_extra_bytes", info.peak_extra_bytes},
+                     {"timeline", info.timeline},
+                     {"peak_sites", info.peak_sites}};
 }
 
 void to_json(nlohmann::json &j, const PerfHotspot &info) {
   j = nlohmann::json{{"symbol", info.symbol}, {"percent", info.percent}};
 }
 
+void to_json(nlohmann::json &j, const PerfFrame &info) {
+  j = nlohmann::json{{"symbol", info.symbol},
+                     {"inclusive_percent", info.inclusive_percent},
+                     {"exclusive_percent", info.exclusive_percent}};
+}
+
 void to_json(nlohmann::json &j, const PerfReport &info) {
-  j = nlohmann::json{{"hotspots", info.hotspots}};
+  j = nlohmann::json{{"event", info.event},
+                     {"samples", info.samples},
+                     {"lost", info.lost},
+                     {"hotspots", info.hotspots}};
+  if (!info.frames.empty()) {
+    j["frames"] = info.frames;
+  }
+}
+
+void to_json(nlohmann::json &j, const CounterValues &info) {
+  j = nlohmann::json{{"tid", info.tid},
+                     {"page_faults", info.page_faults},
+                     {"context_switches", info.context_switches},
+                     {"cpu_migrations", info.cpu_migrations}};
+  auto put = [&j](const char *key, const auto &value) {
+    if (value) {
+      j[key] = *value;
+    }
+  };
+  put("cycles", info.cycles);
+  put("instructions", info.instructions);
+  put("cache_references", info.cache_references);
+  put("cache_misses", info.cache_misses);
+  put("branch_misses", info.branch_misses);
+  put("ipc", info.ipc);
+  put("cache_miss_percent", info.cache_miss_percent);
+  put("branch_mpki", info.branch_mpki);
+}
+
+void to_json(nlohmann::json &j, const CountersReport &info) {
+  j = nlohmann::json{{"duration_s", info.duration_s},
+                     {"hardware", info.hardware},
+                     {"multiplexed", info.multiplexed},
+                     {"process", info.process}};
+  if (!info.threads.empty()) {
+    j["threads"] = info.threads;
+  }
+}
+
+void to_json(nlohmann::json &j, const LatencySummary &info) {
+  nlohmann::json buckets = nlohmann::json::array();
+  for (const auto &bucket : info.buckets) {
+    buckets.push_back({bucket.lowest_us, bucket.count});
+  }
+  j = nlohmann::json{{"count", info.count},     {"p50_ms", info.p50_ms},
+                     {"p90_ms", info.p90_ms},   {"p99_ms", info.p99_ms},
+                     {"p999_ms", info.p999_ms}, {"max_ms", info.max_ms},
+                     {"buckets", buckets}};
 }
 
 void to_json(nlohmann::json &j, const StraceSyscall &info) {
   j = nlohmann::json{{"name", info.name}, {"count", info.count}, {"time_ms", info.time_ms}};
+  if (info.latency) {
+    j["latency"] = *info.latency;
+  }
 }
 
 void to_json(nlohmann::json &j, const StraceSlowSyscall &info) {
@@ -87,6 +243,22 @@ void to_json(nlohmann::json &j, const IoStats &info) {
                      {"write_bytes", info.write_bytes}};
 }
 
+void to_json(nlohmann::json &j, const WatchSample &info) {
+  j = nlohmann::json{{"elapsed_ms", info.elapsed_ms},
+                     {"cpu_percent", info.cpu_percent},
+                     {"read_bytes_per_sec", info.read_bytes_per_sec},
+                     {"write_bytes_per_sec", info.write_bytes_per_sec},
+                     {"voluntary_ctxt_per_sec", info.voluntary_ctxt_per_sec},
+                     {"nonvoluntary_ctxt_per_sec", info.nonvoluntary_ctxt_per_sec},
+                     {"rss_kb", info.rss_kb},
+                     {"rss_delta_kb", info.rss_delta_kb}};
+}
+
+void to_json(nlohmann::json &j, const WatchSeries &info) {
+  j = nlohmann::json{
+      {"pid", info.pid}, {"interval_ms", info.interval_ms}, {"samples", info.samples}};
+}
+
 void to_json(nlohmann::json &j, const TimingInfo &info) {
   j = nlohmann::json{{"captured_at", info.captured_at}};
 }
@@ -96,6 +268,9 @@ void to_json(nlohmann::json &j, const CollectorStatus &info) {
   if (info.error) {
     j["error"] = *info.error;
   }
+  if (info.wall_ms) {
+    j["wall_ms"] = *info.wall_ms;
+  }
 }
 
 void to_json(nlohmann::json &j, const QualityInfo &info) {
@@ -107,18 +282,97 @@ void to_json(nlohmann::json &j, const DiagnosticsSnapshot &info) {
                      {"target", info.target},
                      {"system", info.system},
                      {"processes", info.processes},
+                     {"threads", info.threads},
                      {"io", info.io},
                      {"timing", info.timing},
                      {"quality", info.quality}};
+  if (info.process_tree) {
+    j["process_tree"] = *info.process_tree;
+  }
+  if (info.memory) {
+    j["memory"] = *info.memory;
+  }
   if (info.valgrind) {
     j["valgrind"] = *info.valgrind;
   }
+  if (info.heap_profile) {
+    j["heap_profile"] = *info.heap_profile;
+  }
   if (info.perf) {
     j["perf"] = *info.perf;
   }
+  if (info.counters) {
+    j["counters"] = *info.counters;
+  }
   if (info.strace) {
     j["strace"] = *info.strace;
   }
+  if (info.watch) {
+    j["watch"] = *info.watch;
+  }
+}
+
+namespace {
+
+CounterValues counterValuesFromJson(const nlohmann::json &j) {
+  CounterValues values;
+  values.tid = j.value("tid", 0);
+  values.page_faults = j.value("page_faults", 0LL);
+  values.context_switches = j.value("context_switches", 0LL);
+  values.cpu_migrations = j.value("cpu_migrations", 0LL);
+  auto count = [&j](const char *key, std::optional<long long> &value) {
+    if (j.contains(key)) {
+      value = j.at(key).get<long long>();
+    }
+  };
+  auto ratio = [&j](const char *key, std::optional<double> &value) {
+    if (j.contains(key)) {
+      value = j.at(key).get<double>();
+    }
+  };
+  count("cycles", values.cycles);
+  count("instructions", values.instructions);
+  count("cache_references", values.cache_references);
+  count("cache_misses", values.cache_misses);
+  count("branch_misses", values.branch_misses);
+  ratio("ipc", values.ipc);
+  ratio("cache_miss_percent", values.cache_miss_percent);
+  ratio("branch_mpki", values.branch_mpki);
+  return values;
+}
+
+LatencySummary latencySummaryFromJson(const nlohmann::json &j) {
+  LatencySummary summary;
+  summary.count = j.value("count", 0LL);
+  summary.p50_ms = j.value("p50_ms", 0.0);
+  summary.p90_ms = j.value("p90_ms", 0.0);
+  summary.p99_ms = j.value("p99_ms", 0.0);
+  summary.p999_ms = j.value("p999_ms", 0.0);
+  summary.max_ms = j.value("max_ms", 0.0);
+  if (j.contains("buckets")) {
+    for (const auto &bucket : j.at("buckets")) {
+      summary.buckets.push_back({bucket.at(0).get<long long>(), bucket.at(1).get<long long>()});
+    }
+  }
+  return summary;
+}
+
+} // namespace
+
+CountersReport countersFromJson(const nlohmann::json &j) {
+  CountersReport report;
+  report.duration_s = j.value("duration_s", 0.0);
+  report.hardware = j.value("hardware", false);
+  report.multiplexed = j.value("multiplexed", false);
+  if (j.contains("process")) {
+    report.process = counterValuesFromJson(j.at("process"));
+  }
+  if (j.contains("threads")) {
+    for (const auto &thread : j.at("threads")) {
+      report.threads.push_back(counterValuesFromJson(thread));
+    }
+  }
+  return report;
 }
 
 DiagnosticsSnapshot snapshotFromJson(const nlohmann::json &j) {
@@ -151,14 +405,89 @@ DiagnosticsSnapshot snapshotFromJson(const nlohmann::json &j) {
       info.pid = proc.value("pid", 0);
       info.ppid = proc.value("ppid", 0);
       info.cmd = proc.value("cmd", "");
-      info.rss_kb = proc.value("rss_kb", 0);
-      info.vsz_kb = proc.value("vsz_kb", 0);
+      info.rss_kb = proc.value("rss_kb", 0LL);
+      info.vsz_kb = proc.value("vsz_kb", 0LL);
       info.cpu_percent = proc.value("cpu_percent", 0.0);
       info.mem_percent = proc.value("mem_percent", 0.0);
       info.etime = proc.value("etime", "");
+      info.num_threads = proc.value("num_threads", 0);
       snapshot.processes.push_back(info);
     }
   }
+  if (j.contains("process_tree")) {
+    const auto &tree = j.at("process_tree");
+    ProcessTree pt;
+    pt.root_pid = tree.value("root_pid", 0);
+    if (tree.contains("nodes")) {
+      for (const auto &node : tree.at("nodes")) {
+        ProcessTreeNode info;
+        info.pid = node.value("pid", 0);
+        info.ppid = node.value("ppid", 0);
+        info.depth = node.value("depth", 0);
+        info.cmd = node.value("cmd", "");
+        info.cpu_percent = node.value("cpu_percent", 0.0);
+        info.rss_kb = node.value("rss_kb", 0LL);
+        info.read_bytes = node.value("read_bytes", 0LL);
+        info.write_bytes = node.value("write_bytes", 0LL);
+        info.num_threads = node.value("num_threads", 0);
+        info.subtree_processes = node.value("subtree_processes", 0);
+        info.subtree_cpu_percent = node.value("subtree_cpu_percent", 0.0);
+        info.subtree_rss_kb = node.value("subtree_rss_kb", 0LL);
+        info.subtree_read_bytes = node.value("subtree_read_bytes", 0LL);
+        info.subtree_write_bytes = node.value("subtree_write_bytes", 0LL);
+        info.subtree_threads = node.value("subtree_threads", 0);
+        pt.nodes.push_back(info);
+      }
+    }
+    snapshot.process_tree = pt;
+  }
+  if (j.contains("threads")) {
+    for (const auto &thread : j.at("threads")) {
+      ThreadInfo info;
+      info.tid = thread.value("tid", 0);
+      info.name = thread.value("name", "");
+      info.state = thread.value("state", "");
+      info.cpu_percent = thread.value("cpu_percent", 0.0);
+      info.cpu_delta_ms = thread.value("cpu_delta_ms", 0.0);
+      info.cpu_total_ms = thread.value("cpu_total_ms", 0.0);
+      info.voluntary_ctxt_switches = thread.value("voluntary_ctxt_switches", 0LL);
+      info.nonvoluntary_ctxt_switches = thread.value("nonvoluntary_ctxt_switches", 0LL);
+      info.last_cpu = thread.value("last_cpu", -1);
+      snapshot.threads.push_back(info);
+    }
+  }
+  if (j.contains("memory")) {
+    const auto &mem = j.at("memory");
+    MemoryBreakdown breakdown;
+    breakdown.pid = mem.value("pid", 0);
+    breakdown.source = mem.value("source", "");
+    breakdown.rss_kb = mem.value("rss_kb", 0LL);
+    breakdown.pss_kb = mem.value("pss_kb", 0LL);
+    breakdown.pss_anon_kb = mem.value("pss_anon_kb", 0LL);
+    breakdown.pss_file_kb = mem.value("pss_file_kb", 0LL);
+    breakdown.pss_shmem_kb = mem.value("pss_shmem_kb", 0LL);
+    breakdown.anonymous_kb = mem.value("anonymous_kb", 0LL);
+    breakdown.shared_kb = mem.value("shared_kb", 0LL);
+    breakdown.private_kb = mem.value("private_kb", 0LL);
+    breakdown.swap_kb = mem.value("swap_kb", 0LL);
+    breakdown.swap_pss_kb = mem.value("swap_pss_kb", 0LL);
+    if (mem.contains("regions")) {
+      for (const auto &region : mem.at("regions")) {
+        MemoryRegion info;
+        info.name = region.value("name", "");
+        info.mappings = region.value("mappings", 0);
+        info.size_kb = region.value("size_kb", 0LL);
+        info.rss_kb = region.value("rss_kb", 0LL);
+        info.pss_kb = region.value("pss_kb", 0LL);
+        info.anonymous_kb = region.value("anonymous_kb", 0LL);
+        info.shared_kb = region.value("shared_kb", 0LL);
+        info.private_kb = region.value("private_kb", 0LL);
+        info.swap_kb = region.value("swap_kb", 0LL);
+        breakdown.regions.push_back(info);
+      }
+    }
+    snapshot.memory = breakdown;
+  }
   if (j.contains("valgrind")) {
     ValgrindReport vg;
     if (j.at("valgrind").contains("errors")) {
@@ -173,20 +502,72 @@ DiagnosticsSnapshot snapshotFromJson(const nlohmann::json &j) {
                                     ls.value("possibly_lost_kb", 0),
                                     ls.value("still_reachable_kb", 0)};
     }
+    if (j.at("valgrind").contains("sites")) {
+      for (const auto &site : j.at("valgrind").at("sites")) {
+        ValgrindSite info;
+        info.kind = site.value("kind", "");
+        info.what = site.value("what", "");
+        info.stack = site.value("stack", std::vector<std::string>{});
+        info.count = site.value("count", 0LL);
+        info.leaked_bytes = site.value("leaked_bytes", 0LL);
+        info.leaked_blocks = site.value("leaked_blocks", 0LL);
+        vg.sites.push_back(std::move(info));
+      }
+    }
+    vg.unattributed_errors = j.at("valgrind").value("unattributed_errors", 0LL);
     snapshot.valgrind = vg;
   }
+  if (j.contains("heap_profile")) {
+    const auto &hp = j.at("heap_profile");
+    HeapProfile profile;
+    profile.command = hp.value("command", "");
+    profile.time_unit = hp.value("time_unit", "");
+    profile.peak_snapshot = hp.value("peak_snapshot", -1);
+    profile.peak_heap_bytes = hp.value("peak_heap_bytes", 0LL);
+    profile.peak_extra_bytes = hp.value("peak_extra_bytes", 0LL);
+    if (hp.contains("timeline")) {
+      for (const auto &entry : hp.at("timeline")) {
+        profile.timeline.push_back({entry.value("index", 0), entry.value("time", 0LL),
+                                    entry.value("heap_bytes", 0LL), entry.value("extra_bytes", 0LL),
+                                    entry.value("stack_bytes", 0LL)});
+      }
+    }
+    if (hp.contains("peak_sites")) {
+      for (const auto &site : hp.at("peak_sites")) {
+        profile.peak_sites.push_back({site.value("bytes", 0LL), site.value("percent", 0.0),
+                                      site.value("stack", std::vector<std::string>{})});
+      }
+    }
+    snapshot.heap_profile = profile;
+  }
   if (j.contains("perf")) {
     PerfReport pr;
+    pr.event = j.at("perf").value("event", "");
+    pr.samples = j.at("perf").value("samples", 0LL);
+    pr.lost = j.at("perf").value("lost", 0LL);
     for (const auto &hotspot : j.at("perf").at("hotspots")) {
       pr.hotspots.push_back({hotspot.value("symbol", ""), hotspot.value("percent", 0.0)});
     }
+    if (j.at("perf").contains("frames")) {
+      for (const auto &frame : j.at("perf").at("frames")) {
+        pr.frames.push_back({frame.value("symbol", ""), frame.value("inclusive_percent", 0.0),
+                             frame.value("exclusive_percent", 0.0)});
+      }
+    }
     snapshot.perf = pr;
   }
+  if (j.contains("counters")) {
+    snapshot.counters = countersFromJson(j.at("counters"));
+  }
   if (j.contains("strace")) {
     StraceReport sr;
     for (const auto &syscall : j.at("strace").at("top_syscalls")) {
-      sr.top_syscalls.push_back(
-          {syscall.value("name", ""), syscall.value("count", 0), syscall.value("time_ms", 0.0)});
+      StraceSyscall entry{syscall.value("name", ""), syscall.value("count", 0),
+                          syscall.value("time_ms", 0.0), {}};
+      if (syscall.contains("latency")) {
+        entry.latency = latencySummaryFromJson(syscall.at("latency"));
+      }
+      sr.top_syscalls.push_back(std::move(entry));
     }
     for (const auto &slow : j.at("strace").at("slow_syscalls")) {
       sr.slow_syscalls.push_back({slow.value("name", ""), slow.value("duration_ms", 0.0)});
@@ -199,6 +580,27 @@ DiagnosticsSnapshot snapshotFromJson(const nlohmann::json &j) {
                              io.value("write_bytes", 0LL)});
     }
   }
+  if (j.contains("watch")) {
+    const auto &watch = j.at("watch");
+    WatchSeries series;
+    series.pid = watch.value("pid", 0);
+    series.interval_ms = watch.value("interval_ms", 0);
+    if (watch.contains("samples")) {
+      for (const auto &sample : watch.at("samples")) {
+        WatchSample ws;
+        ws.elapsed_ms = sample.value("elapsed_ms", 0.0);
+        ws.cpu_percent = sample.value("cpu_percent", 0.0);
+        ws.read_bytes_per_sec = sample.value("read_bytes_per_sec", 0.0);
+        ws.write_bytes_per_sec = sample.value("write_bytes_per_sec", 0.0);
+        ws.voluntary_ctxt_per_sec = sample.value("voluntary_ctxt_per_sec", 0.0);
+        ws.nonvoluntary_ctxt_per_sec = sample.value("nonvoluntary_ctxt_per_sec", 0.0);
+        ws.rss_kb = sample.value("rss_kb", 0LL);
+        ws.rss_delta_kb = sample.value("rss_delta_kb", 0LL);
+        series.samples.push_back(ws);
+      }
+    }
+    snapshot.watch = series;
+  }
   if (j.contains("timing")) {
     snapshot.timing.captured_at = j.at("timing").value("captured_at", "");
   }
@@ -210,6 +612,9 @@ DiagnosticsSnapshot snapshotFromJson(const nlohmann::json &j) {
       if (collector.contains("error")) {
         status.error = collector.at("error").get<std::string>();
       }
+      if (collector.contains("wall_ms")) {
+        status.wall_ms = collector.at("wall_ms").get<double>();
+      }
       snapshot.quality.collectors.push_back(status);
     }
   }
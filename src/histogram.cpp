@@ -0,0 +1,98 @@
+#include "proccli/histogram.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace proccli {
+
+size_t LatencyHistogram::bucketIndex(std::uint64_t value_us) {
+  value_us = std::min(value_us, kMaxValue);
+  if (value_us < kSubBuckets) {
+    return static_cast<size_t>(value_us);
+  }
+  int magnitude = 63 - __builtin_clzll(value_us);
+  int shift = magnitude - kSubBucketBits;
+  return static_cast<size_t>(shift + 1) * kSubBuckets + (value_us >> shift) - kSubBuckets;
+}
+
+std::uint64_t LatencyHistogram::bucketLowest(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  size_t shift = index / kSubBuckets - 1;
+  return (index % kSubBuckets + kSubBuckets) << shift;
+}
+
+std::uint64_t LatencyHistogram::bucketHighest(size_t index) {
+  if (index < kSubBuckets) {
+    return index;
+  }
+  size_t shift = index / kSubBuckets - 1;
+  return bucketLowest(index) + (1ULL << shift) - 1;
+}
+
+void LatencyHistogram::record(std::uint64_t value_us, std::uint64_t count) {
+  if (count == 0) {
+    return;
+  }
+  buckets_[bucketIndex(value_us)] += count;
+  count_ += count;
+  max_ = std::max(max_, std::min(value_us, kMaxValue));
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other) {
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    buckets_[i] += other.buckets_[i];
+  }
+  count_ += other.count_;
+  max_ = std::max(max_, other.max_);
+}
+
+std::uint64_t LatencyHistogram::valueAtPercentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  percentile = std::clamp(percentile, 0.0, 100.0);
+  auto rank = static_cast<std::uint64_t>(std::ceil(percentile / 100.0 * count_));
+  rank = std::max<std::uint64_t>(rank, 1);
+  std::uint64_t seen = 0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    seen += buckets_[i];
+    if (seen >= rank) {
+      return std::min(bucketHighest(i), max_);
+    }
+  }
+  return max_;
+}
+
+LatencySummary LatencyHistogram::summary() const {
+  LatencySummary summary;
+  summary.count = static_cast<long long>(count_);
+  summary.p50_ms = valueAtPercentile(50.0) / 1000.0;
+  summary.p90_ms = valueAtPercentile(90.0) / 1000.0;
+  summary.p99_ms = valueAtPercentile(99.0) / 1000.0;
+  summary.p999_ms = valueAtPercentile(99.9) / 1000.0;
+  summary.max_ms = max_ / 1000.0;
+  for (size_t i = 0; i < kBucketCount; ++i) {
+    if (buckets_[i] != 0) {
+      summary.buckets.push_back(
+          {static_cast<long long>(bucketLowest(i)), static_cast<long long>(buckets_[i])});
+    }
+  }
+  return summary;
+}
+
+LatencyHistogram LatencyHistogram::fromSummary(const LatencySummary &summary) {
+  LatencyHistogram histogram;
+  for (const auto &bucket : summary.buckets) {
+    if (bucket.lowest_us >= 0 && bucket.count > 0) {
+      histogram.record(static_cast<std::uint64_t>(bucket.lowest_us),
+                       static_cast<std::uint64_t>(bucket.count));
+    }
+  }
+  histogram.max_ = std::max(histogram.max_, static_cast<std::uint64_t>(
+                                                std::llround(std::max(summary.max_ms, 0.0) * 1000.0)));
+  return histogram;
+}
+
+} // namespace proccli
@@ -0,0 +1,380 @@
+#include "proccli/history.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "proccli/snapshot_binary.h"
+#include "proccli/utils.h"
+
+namespace proccli {
+
+namespace {
+
+constexpr std::string_view kIndexHeader =
+    "# proccli history v1: dir captured_at pid command cpu_percent rss_kb read_bytes write_bytes "
+    "status top_hotspot top_hotspot_percent top_syscall top_syscall_ms\n";
+constexpr size_t kColumns = 13;
+
+std::string clean(const std::string &value) {
+  std::string out = value;
+  std::replace_if(out.begin(), out.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; },
+                  ' ');
+  return out;
+}
+
+std::string fixed(double value, int precision) {
+  char buffer[64];
+  std::snprintf(buffer, sizeof(buffer), "%.*f", precision, value);
+  return buffer;
+}
+
+template <typename T>
+bool parseField(std::string_view field, T &value) {
+  if (field.empty()) {
+    value = T{};
+    return true;
+  }
+  auto [ptr, ec] = std::from_chars(field.data(), field.data() + field.size(), value);
+  return ec == std::errc() && ptr == field.data() + field.size();
+}
+
+long long totalIo(const HistoryEntry &entry) {
+  return entry.read_bytes + entry.write_bytes;
+}
+
+} // namespace
+
+std::string historyIndexPath(const std::string &root) {
+  return (std::filesystem::path(root) / "index.tsv").string();
+}
+
+HistoryEntry summarizeRun(const std::string &dir, const DiagnosticsSnapshot &snapshot) {
+  HistoryEntry entry;
+  entry.dir = dir;
+  entry.captured_at = snapshot.timing.captured_at;
+  entry.pid = snapshot.target.pid;
+  entry.command = snapshot.target.command.value_or("");
+
+  const ProcessTreeNode *root = nullptr;
+  if (snapshot.process_tree) {
+    for (const auto &node : snapshot.process_tree->nodes) {
+      if (node.pid == snapshot.process_tree->root_pid) {
+        root = &node;
+        break;
+      }
+    }
+  }
+  if (root != nullptr) {
+    entry.cpu_percent = root->subtree_cpu_percent;
+    entry.rss_kb = root->subtree_rss_kb;
+    entry.read_bytes = root->subtree_read_bytes;
+    entry.write_bytes = root->subtree_write_bytes;
+    if (entry.command.empty()) {
+      entry.command = root->cmd;
+    }
+  } else if (entry.pid) {
+    for (const auto &process : snapshot.processes) {
+      if (process.pid == *entry.pid) {
+        entry.cpu_percent = process.cpu_percent;
+        entry.rss_kb = process.rss_kb;
+        if (entry.command.empty()) {
+          entry.command = process.cmd;
+        }
+        break;
+      }
+    }
+    for (const auto &io : snapshot.io) {
+      if (io.pid == *entry.pid) {
+        entry.read_bytes = io.read_bytes;
+        entry.write_bytes = io.write_bytes;
+        break;
+      }
+    }
+  }
+  if (entry.rss_kb == 0 && snapshot.memory) {
+    entry.rss_kb = snapshot.memory->rss_kb;
+  }
+
+  for (const auto &collector : snapshot.quality.collectors) {
+    if (collector.status == "ok" || collector.status == "disabled") {
+      continue;
+    }
+    if (!entry.status.empty()) {
+      entry.status += ',';
+    }
+    entry.status += collector.name + ":" + collector.status;
+  }
+  if (entry.status.empty()) {
+    entry.status = "ok";
+  }
+
+  if (snapshot.perf) {
+    for (const auto &hotspot : snapshot.perf->hotspots) {
+      if (entry.top_hotspot.empty() || hotspot.percent > entry.top_hotspot_percent) {
+        entry.top_hotspot = hotspot.symbol;
+        entry.top_hotspot_percent = hotspot.percent;
+      }
+    }
+    if (entry.top_hotspot.empty()) {
+      for (const auto &frame : snapshot.perf->frames) {
+        if (entry.top_hotspot.empty() || frame.exclusive_percent > entry.top_hotspot_percent) {
+          entry.top_hotspot = frame.symbol;
+          entry.top_hotspot_percent = frame.exclusive_percent;
+        }
+      }
+    }
+  }
+  if (snapshot.strace) {
+    for (const auto &syscall : snapshot.strace->top_syscalls) {
+      if (entry.top_syscall.empty() || syscall.time_ms > entry.top_syscall_ms) {
+        entry.top_syscall = syscall.name;
+        entry.top_syscall_ms = syscall.time_ms;
+      }
+    }
+  }
+  return entry;
+}
+
+std::string formatHistoryRow(const HistoryEntry &entry) {
+  std::string row;
+  row += clean(entry.dir) + '\t';
+  row += clean(entry.captured_at) + '\t';
+  row += (entry.pid ? std::to_string(*entry.pid) : std::string()) + '\t';
+  row += clean(entry.command) + '\t';
+  row += fixed(entry.cpu_percent, 2) + '\t';
+  row += std::to_string(entry.rss_kb) + '\t';
+  row += std::to_string(entry.read_bytes) + '\t';
+  row += std::to_string(entry.write_bytes) + '\t';
+  row += clean(entry.status) + '\t';
+  row += clean(entry.top_hotspot) + '\t';
+  row += fixed(entry.top_hotspot_percent, 2) + '\t';
+  row += clean(entry.top_syscall) + '\t';
+  row += fixed(entry.top_syscall_ms, 3) + '\n';
+  return row;
+}
+
+std::optional<HistoryEntry> parseHistoryRow(std::string_view line) {
+  if (!line.empty() && line.back() == '\n') {
+    line.remove_suffix(1);
+  }
+  std::string_view fields[kColumns];
+  size_t count = 0;
+  while (count < kColumns) {
+    auto tab = line.find('\t');
+    fields[count++] = line.substr(0, tab);
+    if (tab == std::string_view::npos) {
+      line = {};
+      break;
+    }
+    line.remove_prefix(tab + 1);
+  }
+  if (count != kColumns || !line.empty() || fields[0].empty()) {
+    return std::nullopt;
+  }
+  HistoryEntry entry;
+  entry.dir = fields[0];
+  entry.captured_at = fields[1];
+  if (!fields[2].empty()) {
+    int pid = 0;
+    if (!parseField(fields[2], pid)) {
+      return std::nullopt;
+    }
+    entry.pid = pid;
+  }
+  entry.command = fields[3];
+  entry.status = fields[8];
+  entry.top_hotspot = fields[9];
+  entry.top_syscall = fields[11];
+  if (!parseField(fields[4], entry.cpu_percent) || !parseField(fields[5], entry.rss_kb) ||
+      !parseField(fields[6], entry.read_bytes) || !parseField(fields[7], entry.write_bytes) ||
+      !parseField(fields[10], entry.top_hotspot_percent) ||
+      !parseField(fields[12], entry.top_syscall_ms)) {
+    return std::nullopt;
+  }
+  return entry;
+}
+
+bool appendHistory(const std::string &root, const HistoryEntry &entry, std::string &error) {
+  std::error_code ec;
+  std::filesystem::create_directories(root, ec);
+  std::string path = historyIndexPath(root);
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  std::string data = formatHistoryRow(entry);
+  struct stat info {};
+  if (fstat(fd, &info) == 0 && info.st_size == 0) {
+    data.insert(0, kIndexHeader);
+  }
+  ssize_t written = ::write(fd, data.data(), data.size());
+  close(fd);
+  if (written != static_cast<ssize_t>(data.size())) {
+    error = "cannot append to " + path;
+    return false;
+  }
+  return true;
+}
+
+std::vector<HistoryEntry> readHistory(const std::string &root, std::string &error) {
+  std::vector<HistoryEntry> entries;
+  std::string path = historyIndexPath(root);
+  std::error_code ec;
+  if (!std::filesystem::is_regular_file(path, ec)) {
+    error = "no history index at " + path + " (run `proccli reindex`)";
+    return entries;
+  }
+  MappedFile file;
+  if (!file.open(path, error)) {
+    return entries;
+  }
+  std::unordered_map<std::string, size_t> latest;
+  std::string_view content = file.view();
+  while (!content.empty()) {
+    auto end = content.find('\n');
+    std::string_view line = content.substr(0, end);
+    content.remove_prefix(end == std::string_view::npos ? content.size() : end + 1);
+    if (line.empty() || line.front() == '#') {
+      continue;
+    }
+    auto entry = parseHistoryRow(line);
+    if (!entry) {
+      continue;
+    }
+    auto [it, inserted] = latest.emplace(entry->dir, entries.size());
+    if (inserted) {
+      entries.push_back(std::move(*entry));
+    } else {
+      entries[it->second] = std::move(*entry);
+    }
+  }
+  return entries;
+}
+
+std::vector<HistoryEntry> queryHistory(std::vector<HistoryEntry> entries, const HistoryQuery &query) {
+  auto rejected = [&query](const HistoryEntry &entry) {
+    if (query.pid && entry.pid != query.pid) {
+      return true;
+    }
+    if (!query.command.empty() && entry.command.find(query.command) == std::string::npos) {
+      return true;
+    }
+    if (!query.since.empty() && entry.captured_at < query.since) {
+      return true;
+    }
+    if (!query.until.empty() && entry.captured_at.compare(0, query.until.size(), query.until) > 0) {
+      return true;
+    }
+    if (query.status == "ok") {
+      return entry.status != "ok";
+    }
+    return !query.status.empty() && entry.status.find(":" + query.status) == std::string::npos;
+  };
+  entries.erase(std::remove_if(entries.begin(), entries.end(), rejected), entries.end());
+
+  if (query.sort == "cpu") {
+    std::stable_sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+      return a.cpu_percent > b.cpu_percent;
+    });
+  } else if (query.sort == "rss") {
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto &a, const auto &b) { return a.rss_kb > b.rss_kb; });
+  } else if (query.sort == "io") {
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const auto &a, const auto &b) { return totalIo(a) > totalIo(b); });
+  } else {
+    std::stable_sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+      return a.captured_at != b.captured_at ? a.captured_at < b.captured_at : a.dir < b.dir;
+    });
+    if (query.limit > 0 && entries.size() > query.limit) {
+      entries.erase(entries.begin(), entries.end() - static_cast<long>(query.limit));
+    }
+  }
+  if (query.limit > 0 && entries.size() > query.limit) {
+    entries.resize(query.limit);
+  }
+  return entries;
+}
+
+bool rebuildHistory(const std::string &root, size_t &runs, std::string &error) {
+  namespace fs = std::filesystem;
+  std::error_code list_ec;
+  std::error_code ec;
+  std::vector<HistoryEntry> entries;
+  for (const auto &item : fs::directory_iterator(root, list_ec)) {
+    if (!item.is_directory(ec)) {
+      continue;
+    }
+    std::string dir = item.path().string();
+    if (!fs::exists(item.path() / "normalized.bin", ec) &&
+        !fs::exists(item.path() / "normalized.json", ec)) {
+      continue;
+    }
+    auto snapshot = loadSnapshot(
+        dir, {SnapshotSection::Meta, SnapshotSection::Target, SnapshotSection::Processes,
+              SnapshotSection::ProcessTree, SnapshotSection::Memory, SnapshotSection::Perf,
+              SnapshotSection::Strace, SnapshotSection::Io, SnapshotSection::Quality});
+    if (snapshot) {
+      entries.push_back(summarizeRun(dir, *snapshot));
+    }
+  }
+  if (list_ec) {
+    error = "cannot list " + root + ": " + list_ec.message();
+    return false;
+  }
+  std::sort(entries.begin(), entries.end(), [](const auto &a, const auto &b) {
+    return a.captured_at != b.captured_at ? a.captured_at < b.captured_at : a.dir < b.dir;
+  });
+
+  std::string path = historyIndexPath(root);
+  std::string temp = path + ".tmp";
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file << kIndexHeader;
+    for (const auto &entry : entries) {
+      file << formatHistoryRow(entry);
+    }
+    if (!file) {
+      error = "cannot write " + temp;
+      return false;
+    }
+  }
+  if (std::rename(temp.c_str(), path.c_str()) != 0) {
+    error = "cannot rename " + temp + ": " + std::strerror(errno);
+    std::remove(temp.c_str());
+    return false;
+  }
+  runs = entries.size();
+  return true;
+}
+
+void to_json(nlohmann::json &j, const HistoryEntry &entry) {
+  j = nlohmann::json{{"dir", entry.dir},
+                     {"captured_at", entry.captured_at},
+                     {"command", entry.command},
+                     {"cpu_percent", entry.cpu_percent},
+                     {"rss_kb", entry.rss_kb},
+                     {"read_bytes", entry.read_bytes},
+                     {"write_bytes", entry.write_bytes},
+                     {"status", entry.status},
+                     {"top_hotspot", entry.top_hotspot},
+                     {"top_hotspot_percent", entry.top_hotspot_percent},
+                     {"top_syscall", entry.top_syscall},
+                     {"top_syscall_ms", entry.top_syscall_ms}};
+  if (entry.pid) {
+    j["pid"] = *entry.pid;
+  }
+}
+
+} // namespace proccli
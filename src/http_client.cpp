@@ -0,0 +1,389 @@
+#include "proccli/http_client.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <limits>
+
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace proccli {
+
+namespace {
+
+constexpr size_t kReadChunkBytes = 64 * 1024;
+constexpr size_t kMaxHeaderLineBytes = 64 * 1024;
+constexpr size_t kMaxHeaders = 128;
+constexpr size_t kUntilClose = std::numeric_limits<size_t>::max();
+
+bool equalsIgnoreCase(std::string_view a, std::string_view b) {
+  return a.size() == b.size() && std::equal(a.begin(), a.end(), b.begin(), [](char x, char y) {
+           return std::tolower(static_cast<unsigned char>(x)) ==
+                  std::tolower(static_cast<unsigned char>(y));
+         });
+}
+
+std::string_view trim(std::string_view text) {
+  while (!text.empty() && (text.front() == ' ' || text.front() == '\t')) {
+    text.remove_prefix(1);
+  }
+  while (!text.empty() && (text.back() == ' ' || text.back() == '\t')) {
+    text.remove_suffix(1);
+  }
+  return text;
+}
+
+} // namespace
+
+std::string HttpResponse::header(std::string_view name) const {
+  for (const auto &[key, value] : headers) {
+    if (equalsIgnoreCase(key, name)) {
+      return value;
+    }
+  }
+  return {};
+}
+
+HttpClient::HttpClient(std::string host, int port, HttpOptions options)
+    : host_(std::move(host)), port_(port), options_(options) {}
+
+HttpClient::~HttpClient() {
+  disconnect();
+}
+
+HttpResponse HttpClient::get(const std::string &path, const DataCallback &on_data) {
+  return request("GET", path, "", {}, on_data);
+}
+
+HttpResponse HttpClient::post(const std::string &path, const std::string &content_type,
+                              std::string_view body, const DataCallback &on_data) {
+  return request("POST", path, content_type, body, on_data);
+}
+
+HttpResponse HttpClient::request(const std::string &method, const std::string &path,
+                                 const std::string &content_type, std::string_view body,
+                                 const DataCallback &on_data) {
+  std::string head = method + " " + path + " HTTP/1.1\r\nHost: " + host_ + ":" +
+                     std::to_string(port_) + "\r\nUser-Agent: proccli\r\nAccept: */*\r\n";
+  if (!content_type.empty()) {
+    head += "Content-Type: " + content_type + "\r\n";
+  }
+  if (method != "GET" || !body.empty()) {
+    head += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+  }
+  head += "\r\n";
+
+  bool reused = fd_ >= 0;
+  while (true) {
+    HttpResponse response;
+    if (fd_ < 0 && !connect(response.error)) {
+      return response;
+    }
+    bool received = false;
+    if (exchange(head, body, on_data, response, received)) {
+      return response;
+    }
+    disconnect();
+    if (!reused || received) {
+      return response;
+    }
+    reused = false;
+  }
+}
+
+bool HttpClient::exchange(const std::string &head, std::string_view body,
+                          const DataCallback &on_data, HttpResponse &response, bool &received) {
+  std::string &error = response.error;
+  if (!sendAll(head, error) || !sendAll(body, error)) {
+    return false;
+  }
+  std::string line;
+  if (!readLine(line, error)) {
+    return false;
+  }
+  received = true;
+  std::string_view status_line = line;
+  if (status_line.size() < 12 || status_line.compare(0, 7, "HTTP/1.") != 0 ||
+      std::from_chars(status_line.data() + 9, status_line.data() + 12, response.status).ec !=
+          std::errc()) {
+    error = "malformed HTTP status line from " + host_ + ": " + line.substr(0, 80);
+    return false;
+  }
+  bool keep_alive = status_line[7] == '1';
+  bool chunked = false;
+  bool has_length = false;
+  size_t length = 0;
+  while (true) {
+    if (!readLine(line, error)) {
+      return false;
+    }
+    if (line.empty()) {
+      break;
+    }
+    if (response.headers.size() >= kMaxHeaders) {
+      error = "too many HTTP headers from " + host_;
+      return false;
+    }
+    auto colon = line.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+    std::string_view name = trim(std::string_view(line).substr(0, colon));
+    std::string_view value = trim(std::string_view(line).substr(colon + 1));
+    if (equalsIgnoreCase(name, "content-length")) {
+      auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), length);
+      if (ec != std::errc() || ptr != value.data() + value.size()) {
+        error = "invalid Content-Length from " + host_;
+        return false;
+      }
+      has_length = true;
+    } else if (equalsIgnoreCase(name, "transfer-encoding")) {
+      chunked = value.size() >= 7 && equalsIgnoreCase(value.substr(value.size() - 7), "chunked");
+    } else if (equalsIgnoreCase(name, "connection")) {
+      if (equalsIgnoreCase(value, "close")) {
+        keep_alive = false;
+      } else if (equalsIgnoreCase(value, "keep-alive")) {
+        keep_alive = true;
+      }
+    }
+    response.headers.emplace_back(std::string(name), std::string(value));
+  }
+
+  if (response.status == 204 || response.status == 304 || response.status / 100 == 1) {
+    return true;
+  }
+  if (chunked) {
+    while (true) {
+      if (!readLine(line, error)) {
+        return false;
+      }
+      std::string_view size_text = trim(std::string_view(line).substr(0, line.find(';')));
+      size_t size = 0;
+      auto [ptr, ec] =
+          std::from_chars(size_text.data(), size_text.data() + size_text.size(), size, 16);
+      if (size_text.empty() || ec != std::errc() || ptr != size_text.data() + size_text.size()) {
+        error = "invalid chunk size from " + host_;
+        return false;
+      }
+      if (size == 0) {
+        break;
+      }
+      if (!readBody(size, on_data, response) || !readLine(line, error)) {
+        return false;
+      }
+    }
+    do {
+      if (!readLine(line, error)) {
+        return false;
+      }
+    } while (!line.empty());
+  } else if (has_length) {
+    if (!readBody(length, on_data, response)) {
+      return false;
+    }
+  } else {
+    if (!readBody(kUntilClose, on_data, response)) {
+      return false;
+    }
+    keep_alive = false;
+  }
+  if (!keep_alive) {
+    disconnect();
+  }
+  return true;
+}
+
+bool HttpClient::connect(std::string &error) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo *addresses = nullptr;
+  std::string endpoint = host_ + ":" + std::to_string(port_);
+  int rc = getaddrinfo(host_.c_str(), std::to_string(port_).c_str(), &hints, &addresses);
+  if (rc != 0) {
+    error = "cannot resolve " + host_ + ": " + gai_strerror(rc);
+    return false;
+  }
+  error = "cannot connect to " + endpoint;
+  for (addrinfo *address = addresses; address != nullptr; address = address->ai_next) {
+    int fd = socket(address->ai_family, address->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    address->ai_protocol);
+    if (fd < 0) {
+      error = "cannot create socket: " + std::string(std::strerror(errno));
+      continue;
+    }
+    int result = ::connect(fd, address->ai_addr, address->ai_addrlen);
+    if (result != 0 && errno == EINPROGRESS) {
+      pollfd entry{fd, POLLOUT, 0};
+      int ready = poll(&entry, 1, options_.connect_timeout_ms);
+      int socket_error = 0;
+      socklen_t size = sizeof(socket_error);
+      if (ready == 0) {
+        socket_error = ETIMEDOUT;
+      } else if (ready < 0 || getsockopt(fd, SOL_SOCKET, SO_ERROR, &socket_error, &size) != 0) {
+        socket_error = errno;
+      }
+      if (socket_error == 0) {
+        result = 0;
+      } else {
+        errno = socket_error;
+      }
+    }
+    if (result != 0) {
+      error = errno == ETIMEDOUT ? "connecting to " + endpoint + " timed out after " +
+                                       std::to_string(options_.connect_timeout_ms) + " ms"
+                                 : "cannot connect to " + endpoint + ": " + std::strerror(errno);
+      close(fd);
+      continue;
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    fd_ = fd;
+    break;
+  }
+  freeaddrinfo(addresses);
+  if (fd_ < 0) {
+    return false;
+  }
+  error.clear();
+  buffer_.clear();
+  pos_ = 0;
+  eof_ = false;
+  return true;
+}
+
+void HttpClient::disconnect() {
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  buffer_.clear();
+  pos_ = 0;
+  eof_ = false;
+}
+
+bool HttpClient::sendAll(std::string_view data, std::string &error) {
+  while (!data.empty()) {
+    ssize_t sent = send(fd_, data.data(), data.size(), MSG_NOSIGNAL);
+    if (sent > 0) {
+      data.remove_prefix(static_cast<size_t>(sent));
+      continue;
+    }
+    if (sent < 0 && errno == EINTR) {
+      continue;
+    }
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      pollfd entry{fd_, POLLOUT, 0};
+      int ready = poll(&entry, 1, options_.read_timeout_ms);
+      if (ready == 0) {
+        error = "sending to " + host_ + " timed out after " +
+                std::to_string(options_.read_timeout_ms) + " ms";
+        return false;
+      }
+      continue;
+    }
+    error = "cannot send to " + host_ + ": " + std::strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool HttpClient::fill(std::string &error) {
+  if (eof_) {
+    error = "connection closed by " + host_;
+    return false;
+  }
+  if (pos_ > 0 && pos_ * 2 >= buffer_.size()) {
+    buffer_.erase(0, pos_);
+    pos_ = 0;
+  }
+  while (true) {
+    pollfd entry{fd_, POLLIN, 0};
+    int ready = poll(&entry, 1, options_.read_timeout_ms);
+    if (ready < 0 && errno == EINTR) {
+      continue;
+    }
+    if (ready == 0) {
+      error = "reading from " + host_ + " timed out after " +
+              std::to_string(options_.read_timeout_ms) + " ms";
+      return false;
+    }
+    size_t used = buffer_.size();
+    buffer_.resize(used + kReadChunkBytes);
+    ssize_t count = recv(fd_, buffer_.data() + used, kReadChunkBytes, 0);
+    buffer_.resize(used + static_cast<size_t>(std::max<ssize_t>(count, 0)));
+    if (count > 0) {
+      return true;
+    }
+    if (count == 0) {
+      eof_ = true;
+      error = "connection closed by " + host_;
+      return false;
+    }
+    if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK) {
+      error = "cannot read from " + host_ + ": " + std::strerror(errno);
+      return false;
+    }
+  }
+}
+
+bool HttpClient::readLine(std::string &line, std::string &error) {
+  while (true) {
+    auto end = buffer_.find('\n', pos_);
+    if (end != std::string::npos) {
+      line.assign(buffer_, pos_, end - pos_);
+      if (!line.empty() && line.back() == '\r') {
+        line.pop_back();
+      }
+      pos_ = end + 1;
+      return true;
+    }
+    if (buffer_.size() - pos_ > kMaxHeaderLineBytes) {
+      error = "HTTP header line from " + host_ + " is too long";
+      return false;
+    }
+    if (!fill(error)) {
+      return false;
+    }
+  }
+}
+
+bool HttpClient::readBody(size_t length, const DataCallback &on_data, HttpResponse &response) {
+  while (length > 0) {
+    if (pos_ == buffer_.size()) {
+      buffer_.clear();
+      pos_ = 0;
+      if (!fill(response.error)) {
+        if (length == kUntilClose && eof_) {
+          response.error.clear();
+          return true;
+        }
+        return false;
+      }
+    }
+    size_t count = std::min(length, buffer_.size() - pos_);
+    std::string_view data(buffer_.data() + pos_, count);
+    pos_ += count;
+    if (length != kUntilClose) {
+      length -= count;
+    }
+    if (on_data) {
+      if (!on_data(data)) {
+        response.error = "request to " + host_ + " aborted";
+        return false;
+      }
+    } else {
+      response.body.append(data);
+    }
+  }
+  return true;
+}
+
+} // namespace proccli
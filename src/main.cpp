@@ -1,4 +1,8 @@
+#include <cerrno>
+#include <csignal>
 #include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
 #include <optional>
 #include <string>
@@ -12,14 +16,26 @@
 
 #include "proccli/collectors.h"
 #include "proccli/diagnostics.h"
+#include "proccli/history.h"
 #include "proccli/normalizer.h"
 #include "proccli/ollama_client.h"
+#include "proccli/perf_counters.h"
+#include "proccli/perf_data.h"
+#include "proccli/perf_sampler.h"
+#include "proccli/proc_scanner.h"
+#include "proccli/process_tree.h"
 #include "proccli/report.h"
+#include "proccli/sampler.h"
+#include "proccli/snapshot_binary.h"
+#include "proccli/snapshot_diff.h"
+#include "proccli/scheduler.h"
+#include "proccli/stack_trie.h"
+#include "proccli/symbolizer.h"
 #include "proccli/utils.h"
 
 namespace proccli {
 
-enum class CommandType { Run, Collect, Analyze, Report };
+enum class CommandType { Run, Collect, Analyze, Report, Watch, Normalize, Convert, History, Reindex, Diff };
 
 struct Options {
   CommandType command = CommandType::Run;
@@ -27,22 +43,45 @@ struct Options {
   std::optional<std::string> command_str;
   std::string output;
   std::string input;
+  std::string history_root = "artifacts";
   std::string format = "text";
   bool valgrind = true;
   bool ps = true;
+  bool ps_exec = false;
   bool procfs = true;
+  bool smaps_deep = false;
   bool perf = true;
+  bool counters = true;
+  bool counters_per_thread = false;
+  int counters_duration = 1;
   bool strace = true;
   int strace_timeout = 10;
+  bool strace_raw = false;
   int perf_duration = 10;
+  std::string perf_event = "cpu-clock";
+  std::string perf_data;
+  std::string perf_script;
+  int interval_ms = 1000;
+  int thread_interval_ms = 250;
+  int duration = 0;
   std::string valgrind_tool = "memcheck";
+  int valgrind_timeout = 600;
   std::string model = "llama3";
+  size_t token_budget = 6144;
+  std::string since;
+  std::string until;
+  std::string status;
+  std::string sort = "time";
+  int limit = 0;
+  std::string baseline;
+  DiffThresholds thresholds;
 };
 
 void printUsage() {
   std::cout << "proccli [command] [options]\n\n"
-            << "Commands: run, collect, analyze, report\n"
-            << "Options: --pid <pid>, --command <cmd>, --output <path>, --input <path>, --format text|json\n";
+            << "Commands: run, collect, analyze, report, watch, normalize, convert, history, reindex, diff\n"
+            << "Options: --pid <pid>, --command <cmd>, --output <path>, --input <path>, --format text|json\n"
+            << "         --history-root <dir>\n";
 }
 
 std::optional<Options> parseArgs(int argc, char **argv, std::string &error) {
@@ -50,13 +89,27 @@ std::optional<Options> parseArgs(int argc, char **argv, std::string &error) {
   int index = 1;
   if (index < argc) {
     std::string first = argv[index];
-    if (first == "run" || first == "collect" || first == "analyze" || first == "report") {
+    if (first == "run" || first == "collect" || first == "analyze" || first == "report" ||
+        first == "watch" || first == "normalize" || first == "convert" ||
+        first == "history" || first == "reindex" || first == "diff") {
       if (first == "collect") {
         options.command = CommandType::Collect;
       } else if (first == "analyze") {
         options.command = CommandType::Analyze;
       } else if (first == "report") {
         options.command = CommandType::Report;
+      } else if (first == "watch") {
+        options.command = CommandType::Watch;
+      } else if (first == "normalize") {
+        options.command = CommandType::Normalize;
+      } else if (first == "convert") {
+        options.command = CommandType::Convert;
+      } else if (first == "history") {
+        options.command = CommandType::History;
+      } else if (first == "reindex") {
+        options.command = CommandType::Reindex;
+      } else if (first == "diff") {
+        options.command = CommandType::Diff;
       } else {
         options.command = CommandType::Run;
       }
@@ -73,26 +126,72 @@ std::optional<Options> parseArgs(int argc, char **argv, std::string &error) {
       options.output = argv[++index];
     } else if (arg == "--input" && index + 1 < argc) {
       options.input = argv[++index];
+    } else if (arg == "--history-root" && index + 1 < argc) {
+      options.history_root = argv[++index];
     } else if (arg == "--format" && index + 1 < argc) {
       options.format = argv[++index];
     } else if (arg == "--no-valgrind") {
       options.valgrind = false;
     } else if (arg == "--no-ps") {
       options.ps = false;
+    } else if (arg == "--ps-exec") {
+      options.ps_exec = true;
     } else if (arg == "--no-proc") {
       options.procfs = false;
+    } else if (arg == "--smaps-deep") {
+      options.smaps_deep = true;
     } else if (arg == "--no-perf") {
       options.perf = false;
+    } else if (arg == "--no-counters") {
+      options.counters = false;
+    } else if (arg == "--counters-per-thread") {
+      options.counters_per_thread = true;
+    } else if (arg == "--counters-duration" && index + 1 < argc) {
+      options.counters_duration = std::stoi(argv[++index]);
     } else if (arg == "--no-strace") {
       options.strace = false;
     } else if (arg == "--strace-timeout" && index + 1 < argc) {
       options.strace_timeout = std::stoi(argv[++index]);
+    } else if (arg == "--strace-raw") {
+      options.strace_raw = true;
     } else if (arg == "--perf-duration" && index + 1 < argc) {
       options.perf_duration = std::stoi(argv[++index]);
+    } else if (arg == "--interval-ms" && index + 1 < argc) {
+      options.interval_ms = std::stoi(argv[++index]);
+    } else if (arg == "--thread-interval-ms" && index + 1 < argc) {
+      options.thread_interval_ms = std::stoi(argv[++index]);
+    } else if (arg == "--duration" && index + 1 < argc) {
+      options.duration = std::stoi(argv[++index]);
+    } else if (arg == "--perf-event" && index + 1 < argc) {
+      options.perf_event = argv[++index];
+    } else if (arg == "--perf-data" && index + 1 < argc) {
+      options.perf_data = argv[++index];
+    } else if (arg == "--perf-script" && index + 1 < argc) {
+      options.perf_script = argv[++index];
     } else if (arg == "--valgrind-tool" && index + 1 < argc) {
       options.valgrind_tool = argv[++index];
+    } else if (arg == "--valgrind-timeout" && index + 1 < argc) {
+      options.valgrind_timeout = std::stoi(argv[++index]);
     } else if (arg == "--model" && index + 1 < argc) {
       options.model = argv[++index];
+    } else if (arg == "--token-budget" && index + 1 < argc) {
+      options.token_budget = std::stoul(argv[++index]);
+    } else if (arg == "--since" && index + 1 < argc) {
+      options.since = argv[++index];
+    } else if (arg == "--until" && index + 1 < argc) {
+      options.until = argv[++index];
+    } else if (arg == "--status" && index + 1 < argc) {
+      options.status = argv[++index];
+    } else if (arg == "--sort" && index + 1 < argc) {
+      options.sort = argv[++index];
+    } else if (arg == "--limit" && index + 1 < argc) {
+      options.limit = std::stoi(argv[++index]);
+    } else if (arg == "--baseline" && index + 1 < argc) {
+      options.baseline = argv[++index];
+    } else if (arg == "--threshold" && index + 1 < argc) {
+      if (!setDiffThreshold(options.thresholds, argv[++index], error)) {
+        return std::nullopt;
+      }
     } else if (arg == "--help") {
       printUsage();
       return std::nullopt;
@@ -107,28 +206,122 @@ std::optional<Options> parseArgs(int argc, char **argv, std::string &error) {
     error = "--pid and --command are mutually exclusive";
     return std::nullopt;
   }
-  if ((options.command == CommandType::Analyze || options.command == CommandType::Report) &&
+  if ((options.command == CommandType::Analyze || options.command == CommandType::Report ||
+       options.command == CommandType::Normalize) &&
       options.input.empty()) {
-    error = "--input is required for analyze/report";
+    error = "--input is required for analyze/report/normalize";
+    return std::nullopt;
+  }
+  if (options.command == CommandType::Diff && (options.baseline.empty() || options.input.empty())) {
+    error = "diff requires --baseline and --input";
+    return std::nullopt;
+  }
+  if (options.command == CommandType::Convert && (options.input.empty() || options.output.empty())) {
+    error = "convert requires --input and --output";
     return std::nullopt;
   }
-  if ((options.command == CommandType::Run || options.command == CommandType::Collect) &&
+  if ((options.command == CommandType::Run || options.command == CommandType::Collect ||
+       options.command == CommandType::Watch) &&
       !options.pid && !options.command_str) {
     error = "--pid or --command is required";
     return std::nullopt;
   }
+  if (options.perf_event != "cpu-clock" && options.perf_event != "cycles") {
+    error = "--perf-event must be cpu-clock or cycles";
+    return std::nullopt;
+  }
+  if (options.sort != "time" && options.sort != "cpu" && options.sort != "rss" &&
+      options.sort != "io") {
+    error = "--sort must be time, cpu, rss or io";
+    return std::nullopt;
+  }
+  if (options.limit < 0) {
+    error = "--limit must not be negative";
+    return std::nullopt;
+  }
+  if (options.token_budget < 512) {
+    error = "--token-budget must be at least 512";
+    return std::nullopt;
+  }
+  if (options.interval_ms < 10) {
+    error = "--interval-ms must be at least 10";
+    return std::nullopt;
+  }
   return options;
 }
 
-int runCommandTarget(const std::string &command) {
+// With own_group the target leads a new process group, so stopCommandTarget also reaches the
+// commands the shell starts.
+int runCommandTarget(const std::string &command, bool own_group = false) {
   pid_t pid = fork();
   if (pid == 0) {
+    if (own_group) {
+      setpgid(0, 0);
+    }
     execl("/bin/sh", "sh", "-c", command.c_str(), static_cast<char *>(nullptr));
     _exit(127);
   }
+  if (own_group && pid > 0) {
+    setpgid(pid, pid);
+  }
   return static_cast<int>(pid);
 }
 
+constexpr int kTargetKillGraceMs = 2000;
+
+// Stops a target started by runCommandTarget(command, true) that outlived the watch: SIGTERM to its
+// process group, then SIGKILL once the grace period has passed, and reaps it either way.
+void stopCommandTarget(pid_t pid) {
+  int status = 0;
+  if (waitpid(pid, &status, WNOHANG) != 0) {
+    return;
+  }
+  kill(-pid, SIGTERM);
+  double kill_at = monotonicSeconds() + kTargetKillGraceMs / 1000.0;
+  pid_t reaped = 0;
+  while ((reaped = waitpid(pid, &status, WNOHANG)) == 0 || (reaped < 0 && errno == EINTR)) {
+    if (monotonicSeconds() >= kill_at) {
+      kill(-pid, SIGKILL);
+      while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+      }
+      return;
+    }
+    usleep(10000);
+  }
+}
+
+void writeSnapshot(const std::string &dir, const DiagnosticsSnapshot &snapshot) {
+  nlohmann::json snapshot_json = snapshot;
+  writeFile(dir + "/normalized.json", snapshot_json.dump(2));
+  std::string error;
+  if (!writeSnapshotBinary(dir + "/normalized.bin", snapshot, error)) {
+    spdlog::warn("binary snapshot not written: {}", error);
+  }
+}
+
+// Only runs stored directly under the history root are indexed, so that reindex (which scans the
+// root's subdirectories) and history agree on the rows.
+void indexRun(const std::string &dir, const std::string &root, const DiagnosticsSnapshot &snapshot) {
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::path run = fs::weakly_canonical(fs::absolute(dir, ec), ec);
+  if (!run.has_filename()) {
+    run = run.parent_path();
+  }
+  fs::path base = fs::weakly_canonical(fs::absolute(root, ec), ec);
+  if (!base.has_filename()) {
+    base = base.parent_path();
+  }
+  if (ec || run.parent_path() != base) {
+    spdlog::info("run {} is outside history root {}, not indexed", dir, root);
+    return;
+  }
+  std::string error;
+  if (!appendHistory(root, summarizeRun(dir, snapshot), error)) {
+    spdlog::warn("history index not updated: {}", error);
+  }
+}
+
 struct CollectedData {
   std::string artifact_dir;
   DiagnosticsSnapshot snapshot;
@@ -151,110 +344,435 @@ CollectorResult recordCollector(const std::string &name, bool enabled, const std
   return result;
 }
 
+void writeStackArtifacts(const std::string &artifact_dir, const StackTrie &stacks,
+                         const std::string &title) {
+  if (stacks.empty()) {
+    return;
+  }
+  std::ofstream folded(artifact_dir + "/raw/perf.folded");
+  stacks.writeFolded(folded);
+  writeFile(artifact_dir + "/flamegraph.svg", renderFlameGraph(stacks, title));
+}
+
+constexpr int kCollectorDeadlineMs = 10000;
+
+volatile std::sig_atomic_t collect_stop_requested = 0;
+
+void requestCollectStop(int) {
+  collect_stop_requested = 1;
+}
+
+std::vector<int> targetPids(const RawArtifacts &artifacts, int target_pid) {
+  if (artifacts.processes) {
+    return descendantPids(*artifacts.processes, target_pid);
+  }
+  if (artifacts.ps_output) {
+    return descendantPids(PsCollector::parse(*artifacts.ps_output), target_pid);
+  }
+  return {target_pid};
+}
+
+CollectorResult collectPerf(const Options &options, CollectedData &data, int target_pid,
+                            const CancelToken &cancel) {
+  if (!options.perf) {
+    return recordCollector("perf", false, "");
+  }
+  if (!options.perf_script.empty()) {
+    StackTrie stacks;
+    bool parsed = false;
+    if (std::filesystem::is_regular_file(options.perf_script)) {
+      MappedFile script;
+      std::string error;
+      if (!script.open(options.perf_script, error)) {
+        return recordCollector("perf", true, "", error);
+      }
+      parsed = parsePerfScript(script.view(), stacks);
+    } else {
+      std::ifstream script(options.perf_script);
+      parsed = script && parsePerfScript(script, stacks);
+    }
+    if (!parsed) {
+      return recordCollector("perf", true, "", "no samples in " + options.perf_script);
+    }
+    auto report = buildStackReport(stacks);
+    writeFile(data.artifact_dir + "/raw/perf.txt", PerfCollector::format(report));
+    writeStackArtifacts(data.artifact_dir, stacks, "perf script: " + options.perf_script);
+    data.artifacts.perf = std::move(report);
+    return recordCollector("perf", true, "");
+  }
+  if (!options.perf_data.empty()) {
+    std::string error;
+    StackTrie stacks;
+    auto report = readPerfData(options.perf_data, error, 20, &stacks);
+    if (!report) {
+      return recordCollector("perf", true, "", error);
+    }
+    writeFile(data.artifact_dir + "/raw/perf.txt", PerfCollector::format(*report));
+    writeStackArtifacts(data.artifact_dir, stacks, "perf.data: " + options.perf_data);
+    data.artifacts.perf = std::move(*report);
+    return recordCollector("perf", true, "");
+  }
+  if (target_pid <= 0) {
+    return recordCollector("perf", true, "", "no target pid");
+  }
+  PerfSamplerOptions perf_options;
+  perf_options.duration_ms = options.perf_duration * 1000;
+  perf_options.event = options.perf_event;
+  PerfSampler sampler(perf_options);
+  auto result = sampler.sample(targetPids(data.artifacts, target_pid), &cancel);
+  if (!result.ok) {
+    return recordCollector("perf", true, "", result.error);
+  }
+  Symbolizer symbolizer;
+  StackTrie stacks;
+  auto report = buildPerfReport(result.sample_set, symbolizer, 20, &stacks);
+  writeFile(data.artifact_dir + "/raw/perf.txt", PerfCollector::format(report));
+  writeStackArtifacts(data.artifact_dir, stacks,
+                      "proccli " + report.event + " profile of pid " + std::to_string(target_pid));
+  data.artifacts.perf = std::move(report);
+  return recordCollector("perf", true, "");
+}
+
 CollectedData collect(const Options &options) {
   CollectedData data;
-  data.artifact_dir = makeArtifactsDir(options.output);
+  data.artifact_dir = makeArtifactsDir(options.output, options.history_root);
 
   TargetInfo target;
   int target_pid = 0;
+  ValgrindCollector valgrind;
+  bool under_valgrind = false;
+  std::string valgrind_error;
   if (options.pid) {
     target.pid = options.pid;
     target_pid = *options.pid;
+    valgrind_error = "valgrind requires --command";
   } else if (options.command_str) {
     target.command = options.command_str;
-    target_pid = runCommandTarget(*options.command_str);
+    if (options.valgrind) {
+      ValgrindRunOptions valgrind_options;
+      valgrind_options.tool = options.valgrind_tool;
+      valgrind_options.xml_path = data.artifact_dir + "/raw/valgrind.xml";
+      valgrind_options.log_path = data.artifact_dir + "/raw/valgrind.txt";
+      valgrind_options.massif_path = data.artifact_dir + "/raw/massif.out";
+      target_pid = valgrind.start(*options.command_str, valgrind_options, valgrind_error);
+      under_valgrind = target_pid > 0;
+      if (!under_valgrind) {
+        spdlog::warn("Running without valgrind: {}", valgrind_error);
+      }
+    }
+    if (!under_valgrind) {
+      target_pid = runCommandTarget(*options.command_str);
+    }
     target.pid = target_pid;
   }
 
-  if (options.ps) {
-    PsCollector collector;
-    auto result = collector.collect();
-    if (result.exit_code == 0) {
-      data.artifacts.ps_output = result.output;
-      writeFile(data.artifact_dir + "/raw/ps.txt", result.output);
-      data.collector_results.push_back(recordCollector("ps", true, result.output));
-    } else {
-      data.collector_results.push_back(recordCollector("ps", true, "", "ps failed"));
-    }
-  } else {
-    data.collector_results.push_back(recordCollector("ps", false, ""));
-  }
+  std::signal(SIGINT, requestCollectStop);
+  CollectorScheduler scheduler;
+  scheduler.add({"ps", kCollectorDeadlineMs, {}, "", [&](const CancelToken &cancel) {
+                   if (!options.ps) {
+                     return recordCollector("ps", false, "");
+                   }
+                   std::optional<std::vector<ProcessInfo>> scanned;
+                   if (!options.ps_exec) {
+                     ProcScanner scanner;
+                     scanned = scanner.scan();
+                     if (!scanned) {
+                       spdlog::warn("Native /proc scan failed, falling back to ps");
+                     }
+                   }
+                   PsCollector collector;
+                   if (scanned) {
+                     writeFile(data.artifact_dir + "/raw/ps.txt", PsCollector::format(*scanned));
+                     data.artifacts.processes = std::move(scanned);
+                     return recordCollector("ps", true, "");
+                   }
+                   if (cancel.cancelled()) {
+                     return CollectorResult{"ps", "partial", std::string("cancelled before ps ran")};
+                   }
+                   auto result = collector.collect();
+                   if (result.exit_code != 0) {
+                     return recordCollector("ps", true, "", "ps failed");
+                   }
+                   data.artifacts.ps_output = result.output;
+                   writeFile(data.artifact_dir + "/raw/ps.txt", result.output);
+                   return recordCollector("ps", true, result.output);
+                 }});
 
-  if (options.procfs) {
-    ProcfsCollector proc;
-    auto meminfo = proc.collectMemInfo();
-    if (meminfo.exit_code == 0) {
-      data.artifacts.meminfo = meminfo.output;
-      writeFile(data.artifact_dir + "/raw/meminfo.txt", meminfo.output);
-    }
-    auto loadavg = proc.collectLoadAvg();
-    if (loadavg.exit_code == 0) {
-      data.artifacts.loadavg = loadavg.output;
-      writeFile(data.artifact_dir + "/raw/loadavg.txt", loadavg.output);
-    }
-    if (target_pid > 0) {
-      if (auto status = proc.collectStatus(target_pid)) {
-        data.artifacts.proc_status.push_back({target_pid, status->output});
-        writeFile(data.artifact_dir + "/raw/status.txt", status->output);
-      }
-      if (auto io = proc.collectIo(target_pid)) {
-        data.artifacts.proc_io.push_back({target_pid, io->output});
-        writeFile(data.artifact_dir + "/raw/io.txt", io->output);
-      }
-    }
-    data.collector_results.push_back(recordCollector("proc", true, ""));
-  } else {
-    data.collector_results.push_back(recordCollector("proc", false, ""));
-  }
+  scheduler.add(
+      {"proc", options.thread_interval_ms + kCollectorDeadlineMs, {"ps"}, "",
+       [&](const CancelToken &cancel) {
+         if (!options.procfs) {
+           return recordCollector("proc", false, "");
+         }
+         ProcfsCollector proc;
+         auto meminfo = proc.collectMemInfo();
+         if (meminfo.exit_code == 0) {
+           data.artifacts.meminfo = meminfo.output;
+           writeFile(data.artifact_dir + "/raw/meminfo.txt", meminfo.output);
+         }
+         auto loadavg = proc.collectLoadAvg();
+         if (loadavg.exit_code == 0) {
+           data.artifacts.loadavg = loadavg.output;
+           writeFile(data.artifact_dir + "/raw/loadavg.txt", loadavg.output);
+         }
+         if (target_pid > 0) {
+           if (auto status = proc.collectStatus(target_pid)) {
+             data.artifacts.proc_status.push_back({target_pid, status->output});
+             writeFile(data.artifact_dir + "/raw/status.txt", status->output);
+           }
+           if (auto io = proc.collectIo(target_pid)) {
+             data.artifacts.proc_io.push_back({target_pid, io->output});
+             writeFile(data.artifact_dir + "/raw/io.txt", io->output);
+           }
+           if (auto rollup = proc.collectSmapsRollup(target_pid)) {
+             data.artifacts.smaps_rollup = rollup->output;
+             writeFile(data.artifact_dir + "/raw/smaps_rollup.txt", rollup->output);
+           }
+           if (options.smaps_deep || !data.artifacts.smaps_rollup) {
+             if (auto smaps = proc.collectSmaps(target_pid)) {
+               data.artifacts.smaps = smaps->output;
+               writeFile(data.artifact_dir + "/raw/smaps.txt", smaps->output);
+             }
+           }
+           for (int pid : targetPids(data.artifacts, target_pid)) {
+             if (cancel.cancelled()) {
+               return CollectorResult{"proc", "partial", std::string("cancelled")};
+             }
+             if (pid == target_pid) {
+               continue;
+             }
+             if (auto io = proc.collectIo(pid)) {
+               data.artifacts.proc_io.push_back({pid, io->output});
+               writeFile(data.artifact_dir + "/raw/io-" + std::to_string(pid) + ".txt",
+                         io->output);
+             }
+           }
+           auto before = proc.collectThreads(target_pid);
+           double started = monotonicSeconds();
+           double until = started + options.thread_interval_ms / 1000.0;
+           while (!cancel.cancelled() && monotonicSeconds() < until) {
+             usleep(10 * 1000);
+           }
+           auto after = proc.collectThreads(target_pid);
+           data.artifacts.threads =
+               ProcfsCollector::rankThreads(before, after, monotonicSeconds() - started);
+         }
+         return recordCollector("proc", true, "");
+       }});
 
-  if (options.valgrind) {
-    data.collector_results.push_back(
-        recordCollector("valgrind", true, "", "valgrind execution not implemented"));
-  } else {
-    data.collector_results.push_back(recordCollector("valgrind", false, ""));
-  }
+  scheduler.add({"perf", options.perf_duration * 1000 + kCollectorDeadlineMs, {"ps"}, "",
+                 [&](const CancelToken &cancel) {
+                   return collectPerf(options, data, target_pid, cancel);
+                 }});
 
-  if (options.perf) {
-    data.collector_results.push_back(
-        recordCollector("perf", true, "", "perf execution not implemented"));
-  } else {
-    data.collector_results.push_back(recordCollector("perf", false, ""));
+  scheduler.add(
+      {"counters", options.counters_duration * 1000 + kCollectorDeadlineMs, {"ps"}, "",
+       [&](const CancelToken &cancel) {
+         if (!options.counters) {
+           return recordCollector("counters", false, "");
+         }
+         if (target_pid <= 0) {
+           return recordCollector("counters", true, "", "no target pid");
+         }
+         PerfCounterOptions counter_options;
+         counter_options.duration_ms = options.counters_duration * 1000;
+         counter_options.per_thread = options.counters_per_thread;
+         PerfCounterCollector counters(counter_options);
+         auto result = counters.collect(targetPids(data.artifacts, target_pid), &cancel);
+         if (!result.ok) {
+           return recordCollector("counters", true, "", result.error);
+         }
+         writeFile(data.artifact_dir + "/raw/counters.json",
+                   nlohmann::json(result.report).dump(2));
+         data.artifacts.counters = std::move(result.report);
+         if (!result.warning.empty()) {
+           return CollectorResult{"counters", "partial", result.warning};
+         }
+         return recordCollector("counters", true, "");
+       }});
+
+  scheduler.add(
+      {"strace", options.strace_timeout * 1000 + kCollectorDeadlineMs, {}, "ptrace",
+       [&](const CancelToken &cancel) {
+         if (!options.strace) {
+           return recordCollector("strace", false, "");
+         }
+         if (target_pid <= 0) {
+           return recordCollector("strace", true, "", "no target pid");
+         }
+         std::string raw_path = options.strace_raw ? data.artifact_dir + "/raw/strace.txt" : "";
+         auto result =
+             StraceCollector::collect(target_pid, options.strace_timeout * 1000, raw_path, &cancel);
+         if (!result.ok) {
+           return recordCollector("strace", true, "", result.error);
+         }
+         spdlog::info("strace: {} lines aggregated", result.lines);
+         data.artifacts.strace = std::move(result.report);
+         return recordCollector("strace", true, "");
+       }});
+
+  scheduler.add({"valgrind", options.valgrind_timeout * 1000, {}, "ptrace",
+                 [&](const CancelToken &cancel) {
+                   if (!options.valgrind) {
+                     return recordCollector("valgrind", false, "");
+                   }
+                   if (!under_valgrind) {
+                     return recordCollector("valgrind", true, "", valgrind_error);
+                   }
+                   auto result = valgrind.finish(&cancel);
+                   if (!result.ok) {
+                     if (cancel.cancelled()) {
+                       return CollectorResult{"valgrind", "partial", result.error};
+                     }
+                     return recordCollector("valgrind", true, "", result.error);
+                   }
+                   if (result.heap_profile) {
+                     spdlog::info("massif: {} snapshots", result.heap_profile->timeline.size());
+                     data.artifacts.heap_profile = std::move(result.heap_profile);
+                   } else {
+                     spdlog::info("valgrind: {} errors aggregated", result.errors);
+                     data.artifacts.valgrind = std::move(result.report);
+                   }
+                   return recordCollector("valgrind", true, "");
+                 }});
+
+  double started = monotonicSeconds();
+  data.collector_results = scheduler.run([] { return collect_stop_requested != 0; });
+  std::signal(SIGINT, SIG_DFL);
+  spdlog::info("collectors finished in {:.0f} ms", (monotonicSeconds() - started) * 1000.0);
+
+  if (options.command_str && !under_valgrind) {
+    int status = 0;
+    waitpid(static_cast<pid_t>(target_pid), &status, 0);
   }
 
-  if (options.strace) {
-    data.collector_results.push_back(
-        recordCollector("strace", true, "", "strace execution not implemented"));
-  } else {
-    data.collector_results.push_back(recordCollector("strace", false, ""));
+  data.snapshot = normalizeDiagnostics(data.artifacts, target, data.collector_results);
+  writeSnapshot(data.artifact_dir, data.snapshot);
+  indexRun(data.artifact_dir, options.history_root, data.snapshot);
+  return data;
+}
+
+volatile std::sig_atomic_t watch_stop_requested = 0;
+
+void requestWatchStop(int) {
+  watch_stop_requested = 1;
+}
+
+CollectedData watch(const Options &options) {
+  CollectedData data;
+  data.artifact_dir = makeArtifactsDir(options.output, options.history_root);
+
+  TargetInfo target;
+  int target_pid = 0;
+  if (options.pid) {
+    target.pid = options.pid;
+    target_pid = *options.pid;
+  } else if (options.command_str) {
+    target.command = options.command_str;
+    target_pid = runCommandTarget(*options.command_str, true);
+    target.pid = target_pid;
   }
 
+  std::signal(SIGINT, requestWatchStop);
+  std::signal(SIGTERM, requestWatchStop);
+  std::cout << std::setw(10) << "elapsed_ms" << std::setw(9) << "cpu%" << std::setw(14) << "read_B/s"
+            << std::setw(14) << "write_B/s" << std::setw(10) << "vcsw/s" << std::setw(10) << "ivcsw/s"
+            << std::setw(12) << "rss_kb" << std::setw(10) << "drss_kb" << "\n";
+  auto series = watchProcess(target_pid, options.interval_ms, options.duration * 1000,
+                             [](const WatchSample &sample) {
+                               std::cout << std::fixed << std::setprecision(0) << std::setw(10)
+                                         << sample.elapsed_ms << std::setprecision(1)
+                                         << std::setw(9) << sample.cpu_percent
+                                         << std::setprecision(0) << std::setw(14)
+                                         << sample.read_bytes_per_sec << std::setw(14)
+                                         << sample.write_bytes_per_sec << std::setw(10)
+                                         << sample.voluntary_ctxt_per_sec << std::setw(10)
+                                         << sample.nonvoluntary_ctxt_per_sec << std::setw(12)
+                                         << sample.rss_kb << std::setw(10) << sample.rss_delta_kb
+                                         << "\n";
+                               return watch_stop_requested == 0;
+                             });
+  std::signal(SIGINT, SIG_DFL);
+  std::signal(SIGTERM, SIG_DFL);
+
   if (options.command_str) {
-    int status = 0;
-    waitpid(static_cast<pid_t>(target_pid), &status, 0);
+    stopCommandTarget(static_cast<pid_t>(target_pid));
   }
 
+  if (series.samples.empty()) {
+    data.collector_results.push_back(
+        recordCollector("watch", true, "", "target exited before a full interval was sampled"));
+  } else {
+    data.collector_results.push_back(recordCollector("watch", true, ""));
+  }
   data.snapshot = normalizeDiagnostics(data.artifacts, target, data.collector_results);
-  nlohmann::json snapshot_json = data.snapshot;
-  writeFile(data.artifact_dir + "/normalized.json", snapshot_json.dump(2));
+  data.snapshot.watch = std::move(series);
+  writeSnapshot(data.artifact_dir, data.snapshot);
+  indexRun(data.artifact_dir, options.history_root, data.snapshot);
   return data;
 }
 
-std::optional<DiagnosticsSnapshot> loadSnapshot(const std::string &input) {
-  auto content = readFile(input + "/normalized.json");
-  if (content.empty()) {
-    return std::nullopt;
+bool convertSnapshot(const std::string &input, const std::string &output, std::string &error) {
+  MappedFile file;
+  if (!file.open(input, error)) {
+    return false;
   }
-  auto json = nlohmann::json::parse(content, nullptr, false);
+  if (isSnapshotBinary(file.view())) {
+    SnapshotReader reader;
+    DiagnosticsSnapshot snapshot;
+    if (!reader.attach(file.view(), error) || !reader.readAll(snapshot, error)) {
+      return false;
+    }
+    nlohmann::json snapshot_json = snapshot;
+    writeFile(output, snapshot_json.dump(2));
+    return true;
+  }
+  auto json = nlohmann::json::parse(file.view().begin(), file.view().end(), nullptr, false);
   if (json.is_discarded()) {
-    return std::nullopt;
+    error = input + " is neither JSON nor a binary snapshot";
+    return false;
   }
-  return snapshotFromJson(json);
+  return writeSnapshotBinary(output, snapshotFromJson(json), error);
 }
 
-std::string analyze(const std::string &output_dir, const std::string &model,
-                    DiagnosticsSnapshot &snapshot) {
-  OllamaClient client;
-  auto result = client.analyze(snapshot, model);
+void printHistory(const std::vector<HistoryEntry> &entries) {
+  std::cout << std::left << std::setw(22) << "captured_at" << std::right << std::setw(8) << "pid"
+            << std::setw(8) << "cpu%" << std::setw(12) << "rss_kb" << std::setw(14) << "read_B"
+            << std::setw(14) << "write_B" << "  " << std::left << std::setw(24) << "status"
+            << std::setw(28) << "top_hotspot" << std::setw(16) << "top_syscall" << "dir\n";
+  for (const auto &entry : entries) {
+    std::cout << std::left << std::setw(22) << entry.captured_at << std::right << std::setw(8)
+              << (entry.pid ? std::to_string(*entry.pid) : "-") << std::fixed
+              << std::setprecision(1) << std::setw(8) << entry.cpu_percent << std::setw(12)
+              << entry.rss_kb << std::setw(14) << entry.read_bytes << std::setw(14)
+              << entry.write_bytes << "  " << std::left << std::setw(24) << entry.status
+              << std::setw(28) << (entry.top_hotspot.empty() ? "-" : entry.top_hotspot)
+              << std::setw(16) << (entry.top_syscall.empty() ? "-" : entry.top_syscall)
+              << entry.dir << "\n";
+  }
+}
+
+std::string analyze(const std::string &output_dir, const std::string &model, size_t token_budget,
+                    DiagnosticsSnapshot &snapshot, std::ostream &tokens) {
+  auto ollama_options = ollamaOptionsFromEnv();
+  ollama_options.token_budget = token_budget;
+  OllamaClient client(ollama_options);
+  bool streamed = false;
+  auto result = client.analyze(snapshot, model, [&](std::string_view token) {
+    tokens << token << std::flush;
+    streamed = true;
+  });
+  if (streamed) {
+    tokens << "\n";
+  }
+  spdlog::info("ollama: prompt ~{} of {} tokens; kept {}", result.prompt_tokens, token_budget,
+               result.compaction);
+  if (result.ok) {
+    spdlog::info("ollama: first token after {:.0f} ms, complete after {:.0f} ms",
+                 result.first_token_ms, result.total_ms);
+  } else {
+    spdlog::warn("ollama: {}", result.error);
+  }
   std::string response = result.response;
   if (!output_dir.empty()) {
     writeFile(output_dir + "/analysis.txt", response);
@@ -284,20 +802,119 @@ int main(int argc, char **argv) {
       return 0;
     }
 
+    if (options.command == proccli::CommandType::Watch) {
+      auto data = proccli::watch(options);
+      std::cout << "Artifacts stored at: " << data.artifact_dir << "\n";
+      return 0;
+    }
+
+    if (options.command == proccli::CommandType::Normalize) {
+      std::string normalize_error;
+      auto snapshot = proccli::normalizeArtifactDir(options.input, normalize_error);
+      if (!snapshot) {
+        std::cerr << "Unable to normalize artifacts: " << normalize_error << "\n";
+        return 1;
+      }
+      proccli::writeSnapshot(options.input, *snapshot);
+      std::cout << "Normalized snapshot written to: " << options.input << "/normalized.json\n";
+      return 0;
+    }
+
+    if (options.command == proccli::CommandType::Convert) {
+      std::string convert_error;
+      if (!proccli::convertSnapshot(options.input, options.output, convert_error)) {
+        std::cerr << "Unable to convert snapshot: " << convert_error << "\n";
+        return 1;
+      }
+      std::cout << "Snapshot written to: " << options.output << "\n";
+      return 0;
+    }
+
+    if (options.command == proccli::CommandType::Reindex) {
+      std::string root = options.input.empty() ? options.history_root : options.input;
+      std::string reindex_error;
+      size_t runs = 0;
+      if (!proccli::rebuildHistory(root, runs, reindex_error)) {
+        std::cerr << "Unable to rebuild history index: " << reindex_error << "\n";
+        return 1;
+      }
+      std::cout << "Indexed " << runs << " runs in " << proccli::historyIndexPath(root) << "\n";
+      return 0;
+    }
+
+    if (options.command == proccli::CommandType::History) {
+      std::string root = options.input.empty() ? options.history_root : options.input;
+      std::string history_error;
+      auto entries = proccli::readHistory(root, history_error);
+      if (!history_error.empty()) {
+        std::cerr << "Unable to read history: " << history_error << "\n";
+        return 1;
+      }
+      proccli::HistoryQuery query;
+      query.pid = options.pid;
+      query.command = options.command_str.value_or("");
+      query.since = options.since;
+      query.until = options.until;
+      query.status = options.status;
+      query.sort = options.sort;
+      query.limit = static_cast<size_t>(options.limit);
+      entries = proccli::queryHistory(std::move(entries), query);
+      if (options.format == "json") {
+        std::cout << nlohmann::json(entries).dump(2) << "\n";
+        return 0;
+      }
+      proccli::printHistory(entries);
+      return 0;
+    }
+
+    if (options.command == proccli::CommandType::Diff) {
+      using proccli::SnapshotSection;
+      auto load = [](const std::string &dir) {
+        return proccli::loadSnapshot(
+            dir, {SnapshotSection::Meta, SnapshotSection::Target, SnapshotSection::Processes,
+                  SnapshotSection::ProcessTree, SnapshotSection::Memory, SnapshotSection::Perf,
+                  SnapshotSection::Strace, SnapshotSection::Io});
+      };
+      auto baseline = load(options.baseline);
+      auto current = load(options.input);
+      if (!baseline || !current) {
+        std::cerr << "Unable to load normalized snapshot from "
+                  << (baseline ? options.input : options.baseline) << "\n";
+        return 1;
+      }
+      auto diff = proccli::diffSnapshots(*baseline, *current, options.thresholds);
+      std::string rendered =
+          options.format == "json"
+              ? nlohmann::json(diff).dump(2)
+              : proccli::formatDiff(diff, options.limit > 0 ? static_cast<size_t>(options.limit) : 20);
+      if (!options.output.empty()) {
+        proccli::writeFile(options.output, rendered);
+      }
+      std::cout << rendered << "\n";
+      return diff.regressions > 0 ? 2 : 0;
+    }
+
     if (options.command == proccli::CommandType::Analyze) {
-      auto snapshot_opt = proccli::loadSnapshot(options.input);
+      auto snapshot_opt = proccli::loadSnapshot(options.input, {});
       if (!snapshot_opt) {
         std::cerr << "Unable to load normalized snapshot." << "\n";
         return 1;
       }
       auto snapshot = *snapshot_opt;
-      proccli::analyze(options.input, options.model, snapshot);
+      proccli::analyze(options.input, options.model, options.token_budget, snapshot,
+                       std::cout);
       std::cout << "Analysis complete." << "\n";
       return 0;
     }
 
     if (options.command == proccli::CommandType::Report) {
-      auto snapshot_opt = proccli::loadSnapshot(options.input);
+      using proccli::SnapshotSection;
+      auto snapshot_opt =
+          options.format == "json"
+              ? proccli::loadSnapshot(options.input, {})
+              : proccli::loadSnapshot(options.input, {SnapshotSection::Meta,
+                                                      SnapshotSection::Target,
+                                                      SnapshotSection::Quality});
       if (!snapshot_opt) {
         std::cerr << "Unable to load normalized snapshot." << "\n";
         return 1;
@@ -316,7 +933,8 @@ int main(int argc, char **argv) {
     }
 
     auto data = proccli::collect(options);
-    auto analysis = proccli::analyze(data.artifact_dir, options.model, data.snapshot);
+    auto analysis = proccli::analyze(data.artifact_dir, options.model, options.token_budget,
+                                     data.snapshot, std::cerr);
     auto report = proccli::renderReport(analysis, data.snapshot);
     proccli::writeFile(data.artifact_dir + "/report.txt", report);
     if (!options.output.empty()) {
@@ -0,0 +1,231 @@
+#include "proccli/massif.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace proccli {
+
+namespace {
+
+template <typename T>
+bool parseValue(std::string_view text, T &value) {
+  auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+bool splitField(std::string_view line, std::string_view key, std::string_view &value) {
+  if (line.size() <= key.size() || line.compare(0, key.size(), key) != 0) {
+    return false;
+  }
+  value = line.substr(key.size());
+  return true;
+}
+
+std::string_view frameLabel(std::string_view label) {
+  if (label.compare(0, 2, "0x") == 0) {
+    size_t colon = label.find(": ");
+    if (colon != std::string_view::npos) {
+      return label.substr(colon + 2);
+    }
+  }
+  return label;
+}
+
+} // namespace
+
+MassifParser::MassifParser(size_t top) : top_(top) {}
+
+void MassifParser::feed(std::string_view chunk) {
+  while (!chunk.empty()) {
+    size_t end = chunk.find('\n');
+    if (end == std::string_view::npos) {
+      carry_.append(chunk);
+      return;
+    }
+    if (carry_.empty()) {
+      addLine(chunk.substr(0, end));
+    } else {
+      carry_.append(chunk.substr(0, end));
+      addLine(carry_);
+      carry_.clear();
+    }
+    chunk.remove_prefix(end + 1);
+  }
+}
+
+void MassifParser::addLine(std::string_view line) {
+  if (!line.empty() && line.back() == '\r') {
+    line.remove_suffix(1);
+  }
+  if (line.empty()) {
+    return;
+  }
+  if (in_tree_ && (line.front() == 'n' || line.front() == ' ')) {
+    if (!skip_tree_) {
+      addTreeLine(line);
+    }
+    return;
+  }
+  if (in_tree_) {
+    finishTree();
+  }
+  std::string_view value;
+  if (splitField(line, "snapshot=", value)) {
+    HeapSnapshot snapshot;
+    parseValue(value, snapshot.index);
+    profile_.timeline.push_back(snapshot);
+    seen_header_ = true;
+  } else if (profile_.timeline.empty()) {
+    if (splitField(line, "cmd: ", value)) {
+      profile_.command = std::string(value);
+    } else if (splitField(line, "time_unit: ", value)) {
+      profile_.time_unit = std::string(value);
+    }
+  } else if (splitField(line, "time=", value)) {
+    parseValue(value, profile_.timeline.back().time);
+  } else if (splitField(line, "mem_heap_B=", value)) {
+    parseValue(value, profile_.timeline.back().heap_bytes);
+  } else if (splitField(line, "mem_heap_extra_B=", value)) {
+    parseValue(value, profile_.timeline.back().extra_bytes);
+  } else if (splitField(line, "mem_stacks_B=", value)) {
+    parseValue(value, profile_.timeline.back().stack_bytes);
+  } else if (splitField(line, "heap_tree=", value) && value != "empty") {
+    in_tree_ = true;
+    tree_is_peak_ = value == "peak";
+    skip_tree_ = !tree_is_peak_ &&
+                 (have_peak_ || profile_.timeline.back().heap_bytes <= best_heap_bytes_);
+  }
+}
+
+void MassifParser::addTreeLine(std::string_view line) {
+  size_t depth = 0;
+  while (depth < line.size() && line[depth] == ' ') {
+    ++depth;
+  }
+  line.remove_prefix(depth);
+  size_t colon = line.find(": ");
+  if (line.size() < 2 || line.front() != 'n' || colon == std::string_view::npos) {
+    return;
+  }
+  int children = 0;
+  parseValue(line.substr(1, colon - 1), children);
+  line.remove_prefix(colon + 2);
+  size_t space = line.find(' ');
+  long long bytes = 0;
+  if (space == std::string_view::npos || !parseValue(line.substr(0, space), bytes)) {
+    return;
+  }
+  std::string_view label = line.substr(space + 1);
+  if (depth == 0) {
+    path_.clear();
+    return;
+  }
+  path_.resize(depth - 1);
+  path_.emplace_back(frameLabel(label));
+  if (children != 0 || label.compare(0, 3, "in ") == 0) {
+    return;
+  }
+  if (sites_.size() >= top_ && bytes <= sites_.top().bytes) {
+    return;
+  }
+  HeapSite site;
+  site.bytes = bytes;
+  size_t frames = std::min(path_.size(), kStackDepth);
+  site.stack.assign(path_.begin(), path_.begin() + static_cast<std::ptrdiff_t>(frames));
+  sites_.push(std::move(site));
+  if (sites_.size() > top_) {
+    sites_.pop();
+  }
+}
+
+void MassifParser::finishTree() {
+  in_tree_ = false;
+  path_.clear();
+  if (skip_tree_) {
+    return;
+  }
+  const auto &snapshot = profile_.timeline.back();
+  best_heap_bytes_ = snapshot.heap_bytes;
+  have_peak_ = have_peak_ || tree_is_peak_;
+  profile_.peak_snapshot = snapshot.index;
+  profile_.peak_heap_bytes = snapshot.heap_bytes;
+  profile_.peak_extra_bytes = snapshot.extra_bytes;
+  best_sites_.clear();
+  while (!sites_.empty()) {
+    best_sites_.push_back(sites_.top());
+    sites_.pop();
+  }
+  std::reverse(best_sites_.begin(), best_sites_.end());
+}
+
+std::optional<HeapProfile> MassifParser::profile() {
+  if (!carry_.empty()) {
+    addLine(carry_);
+    carry_.clear();
+  }
+  if (in_tree_) {
+    finishTree();
+  }
+  if (!seen_header_) {
+    return std::nullopt;
+  }
+  HeapProfile profile = profile_;
+  if (profile.peak_snapshot < 0) {
+    auto peak = std::max_element(profile.timeline.begin(), profile.timeline.end(),
+                                 [](const HeapSnapshot &a, const HeapSnapshot &b) {
+                                   return a.heap_bytes < b.heap_bytes;
+                                 });
+    profile.peak_snapshot = peak->index;
+    profile.peak_heap_bytes = peak->heap_bytes;
+    profile.peak_extra_bytes = peak->extra_bytes;
+  }
+  profile.peak_sites = best_sites_;
+  for (auto &site : profile.peak_sites) {
+    if (profile.peak_heap_bytes > 0) {
+      site.percent = static_cast<double>(site.bytes) * 100.0 /
+                     static_cast<double>(profile.peak_heap_bytes);
+    }
+  }
+  return profile;
+}
+
+std::optional<HeapProfile> parseMassif(std::string_view text) {
+  MassifParser parser;
+  parser.feed(text);
+  return parser.profile();
+}
+
+std::optional<HeapProfile> readMassifFile(const std::string &path, std::string &error) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return std::nullopt;
+  }
+  posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  MassifParser parser;
+  std::vector<char> buffer(1 << 16);
+  while (true) {
+    ssize_t bytes = read(fd, buffer.data(), buffer.size());
+    if (bytes < 0 && errno == EINTR) {
+      continue;
+    }
+    if (bytes <= 0) {
+      break;
+    }
+    parser.feed(std::string_view(buffer.data(), static_cast<size_t>(bytes)));
+  }
+  close(fd);
+  auto profile = parser.profile();
+  if (!profile) {
+    error = "no massif snapshots in " + path;
+  }
+  return profile;
+}
+
+} // namespace proccli
@@ -1,45 +1,262 @@
 #include "proccli/normalizer.h"
 
+#include <algorithm>
+#include <charconv>
+#include <deque>
+#include <filesystem>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/massif.h"
+#include "proccli/parallel.h"
+#include "proccli/perf_sampler.h"
+#include "proccli/process_tree.h"
+#include "proccli/stack_trie.h"
 #include "proccli/utils.h"
 
 namespace proccli {
 
-DiagnosticsSnapshot normalizeDiagnostics(const RawArtifacts &artifacts, const TargetInfo &target,
-                                         const std::vector<CollectorResult> &collector_results) {
-  DiagnosticsSnapshot snapshot;
-  snapshot.target = target;
-  if (artifacts.ps_output) {
-    snapshot.processes = PsCollector::parse(*artifacts.ps_output);
+namespace {
+
+constexpr size_t kNormalizeWindowBytes = 64 << 20;
+
+struct RawTexts {
+  std::optional<std::string_view> ps_output;
+  std::optional<std::string_view> meminfo;
+  std::optional<std::string_view> loadavg;
+  std::vector<std::pair<int, std::string_view>> proc_io;
+  std::optional<std::string_view> smaps_rollup;
+  std::optional<std::string_view> smaps;
+  std::optional<std::string_view> valgrind_output;
+  std::optional<std::string_view> perf_output;
+  std::optional<std::string_view> strace_output;
+};
+
+std::optional<std::string_view> view(const std::optional<std::string> &text) {
+  if (!text) {
+    return std::nullopt;
   }
-  if (artifacts.meminfo) {
-    snapshot.system.meminfo = ProcfsCollector::parseMemInfo(*artifacts.meminfo);
+  return std::string_view(*text);
+}
+
+void applyRawTexts(const RawTexts &texts, DiagnosticsSnapshot &snapshot) {
+  if (texts.ps_output) {
+    snapshot.processes = PsCollector::parse(*texts.ps_output);
   }
-  if (artifacts.loadavg) {
-    snapshot.system.loadavg = ProcfsCollector::parseLoadAvg(*artifacts.loadavg);
+  if (texts.meminfo) {
+    snapshot.system.meminfo = ProcfsCollector::parseMemInfo(*texts.meminfo);
   }
-  for (const auto &entry : artifacts.proc_io) {
+  if (texts.loadavg) {
+    snapshot.system.loadavg = ProcfsCollector::parseLoadAvg(*texts.loadavg);
+  }
+  if (!texts.proc_io.empty()) {
+    snapshot.io.clear();
+  }
+  for (const auto &entry : texts.proc_io) {
     auto io = ProcfsCollector::parseIo(entry.first, entry.second);
     if (io) {
       snapshot.io.push_back(*io);
     }
   }
-  if (artifacts.valgrind_output) {
-    snapshot.valgrind = ValgrindCollector::parse(*artifacts.valgrind_output);
+  const auto &pid = snapshot.target.pid;
+  if (pid && (texts.smaps || texts.smaps_rollup)) {
+    std::optional<MemoryBreakdown> rollup;
+    if (texts.smaps_rollup) {
+      rollup = ProcfsCollector::parseSmaps(*pid, *texts.smaps_rollup, false);
+    }
+    snapshot.memory.reset();
+    if (texts.smaps) {
+      snapshot.memory = ProcfsCollector::parseSmaps(*pid, *texts.smaps, true);
+    }
+    if (snapshot.memory && rollup) {
+      rollup->source = "smaps_rollup+smaps";
+      rollup->regions = std::move(snapshot.memory->regions);
+      snapshot.memory = std::move(rollup);
+    } else if (!snapshot.memory) {
+      snapshot.memory = std::move(rollup);
+    }
+  }
+  if (pid && !snapshot.processes.empty()) {
+    snapshot.process_tree = buildProcessTree(snapshot.processes, *pid, snapshot.io);
+  }
+  if (texts.valgrind_output) {
+    snapshot.valgrind = ValgrindCollector::parse(*texts.valgrind_output);
+  }
+  if (texts.perf_output) {
+    snapshot.perf = PerfCollector::parse(*texts.perf_output);
+  }
+  if (texts.strace_output) {
+    snapshot.strace = StraceCollector::parse(*texts.strace_output);
+  }
+}
+
+} // namespace
+
+DiagnosticsSnapshot normalizeDiagnostics(const RawArtifacts &artifacts, const TargetInfo &target,
+                                         const std::vector<CollectorResult> &collector_results) {
+  DiagnosticsSnapshot snapshot;
+  snapshot.target = target;
+  RawTexts texts;
+  if (artifacts.processes) {
+    snapshot.processes = *artifacts.processes;
+  } else {
+    texts.ps_output = view(artifacts.ps_output);
+  }
+  snapshot.threads = artifacts.threads;
+  texts.meminfo = view(artifacts.meminfo);
+  texts.loadavg = view(artifacts.loadavg);
+  for (const auto &entry : artifacts.proc_io) {
+    texts.proc_io.emplace_back(entry.first, entry.second);
+  }
+  texts.smaps_rollup = view(artifacts.smaps_rollup);
+  texts.smaps = view(artifacts.smaps);
+  snapshot.heap_profile = artifacts.heap_profile;
+  if (artifacts.valgrind) {
+    snapshot.valgrind = artifacts.valgrind;
+  } else {
+    texts.valgrind_output = view(artifacts.valgrind_output);
   }
-  if (artifacts.perf_output) {
-    snapshot.perf = PerfCollector::parse(*artifacts.perf_output);
+  if (artifacts.perf) {
+    snapshot.perf = artifacts.perf;
+  } else {
+    texts.perf_output = view(artifacts.perf_output);
   }
-  if (artifacts.strace_output) {
-    snapshot.strace = StraceCollector::parse(*artifacts.strace_output);
+  snapshot.counters = artifacts.counters;
+  if (artifacts.strace) {
+    snapshot.strace = artifacts.strace;
+  } else {
+    texts.strace_output = view(artifacts.strace_output);
   }
+  applyRawTexts(texts, snapshot);
   snapshot.timing.captured_at = isoTimestamp();
 
   for (const auto &collector : collector_results) {
-    CollectorStatus status{collector.name, collector.status, collector.error};
+    CollectorStatus status{collector.name, collector.status, collector.error, std::nullopt};
+    if (collector.status != "disabled") {
+      status.wall_ms = collector.wall_ms;
+    }
     snapshot.quality.collectors.push_back(status);
   }
 
   return snapshot;
 }
 
+std::optional<DiagnosticsSnapshot> normalizeArtifactDir(const std::string &artifact_dir,
+                                                        std::string &error, size_t threads) {
+  namespace fs = std::filesystem;
+  fs::path raw = fs::path(artifact_dir) / "raw";
+  std::error_code ec;
+  if (!fs::is_directory(raw, ec)) {
+    error = raw.string() + " is not a directory";
+    return std::nullopt;
+  }
+  DiagnosticsSnapshot snapshot;
+  std::string previous = readFile((fs::path(artifact_dir) / "normalized.json").string());
+  if (!previous.empty()) {
+    auto json = nlohmann::json::parse(previous, nullptr, false);
+    if (!json.is_discarded()) {
+      snapshot = snapshotFromJson(json);
+    }
+  }
+
+  std::deque<MappedFile> files;
+  auto map = [&](const std::string &name) -> MappedFile * {
+    fs::path path = raw / name;
+    if (!fs::is_regular_file(path, ec)) {
+      return nullptr;
+    }
+    auto &file = files.emplace_back();
+    if (!file.open(path.string(), error)) {
+      files.pop_back();
+      return nullptr;
+    }
+    return &file;
+  };
+  auto text = [&](const std::string &name) -> std::optional<std::string_view> {
+    MappedFile *file = map(name);
+    if (file == nullptr) {
+      return std::nullopt;
+    }
+    return file->view();
+  };
+
+  RawTexts texts;
+  texts.ps_output = text("ps.txt");
+  texts.meminfo = text("meminfo.txt");
+  texts.loadavg = text("loadavg.txt");
+  if (auto io = text("io.txt"); io && snapshot.target.pid) {
+    texts.proc_io.emplace_back(*snapshot.target.pid, *io);
+  }
+  std::vector<int> io_pids;
+  for (const auto &entry : fs::directory_iterator(raw, ec)) {
+    std::string name = entry.path().filename().string();
+    int pid = 0;
+    if (name.size() > 7 && name.compare(0, 3, "io-") == 0 &&
+        name.compare(name.size() - 4, 4, ".txt") == 0 &&
+        std::from_chars(name.data() + 3, name.data() + name.size() - 4, pid).ptr ==
+            name.data() + name.size() - 4) {
+      io_pids.push_back(pid);
+    }
+  }
+  std::sort(io_pids.begin(), io_pids.end());
+  for (int pid : io_pids) {
+    if (auto io = text("io-" + std::to_string(pid) + ".txt")) {
+      texts.proc_io.emplace_back(pid, *io);
+    }
+  }
+  texts.smaps_rollup = text("smaps_rollup.txt");
+  texts.smaps = text("smaps.txt");
+  texts.valgrind_output = text("valgrind.txt");
+  texts.perf_output = text("perf.txt");
+  if (!error.empty()) {
+    return std::nullopt;
+  }
+  applyRawTexts(texts, snapshot);
+
+  if (auto folded = text("perf.folded")) {
+    StackTrie stacks;
+    if (parseFolded(*folded, stacks)) {
+      auto report = buildStackReport(stacks);
+      if (snapshot.perf && texts.perf_output) {
+        snapshot.perf->frames = std::move(report.frames);
+      } else {
+        snapshot.perf = std::move(report);
+      }
+    }
+  }
+  if (auto xml = text("valgrind.xml")) {
+    if (auto report = ValgrindCollector::parseXml(*xml)) {
+      snapshot.valgrind = std::move(report);
+    }
+  }
+  if (fs::is_regular_file(raw / "massif.out", ec)) {
+    std::string massif_error;
+    if (auto profile = readMassifFile((raw / "massif.out").string(), massif_error)) {
+      snapshot.heap_profile = std::move(profile);
+    }
+  }
+  if (auto counters = text("counters.json")) {
+    auto json = nlohmann::json::parse(counters->begin(), counters->end(), nullptr, false);
+    if (!json.is_discarded()) {
+      snapshot.counters = countersFromJson(json);
+    }
+  }
+  if (MappedFile *strace = map("strace.txt"); strace != nullptr && !strace->view().empty()) {
+    StraceAggregator aggregator;
+    std::string_view content = strace->view();
+    for (auto window : splitChunks(content, content.size() / kNormalizeWindowBytes + 1)) {
+      StraceCollector::aggregate(window, aggregator, threads);
+      strace->release(window);
+    }
+    snapshot.strace = aggregator.report();
+  }
+  if (!error.empty()) {
+    return std::nullopt;
+  }
+  if (snapshot.timing.captured_at.empty()) {
+    snapshot.timing.captured_at = isoTimestamp();
+  }
+  return snapshot;
+}
+
 } // namespace proccli
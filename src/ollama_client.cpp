@@ -1,69 +1,153 @@
 #include "proccli/ollama_client.h"
 
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+
 #include <nlohmann/json.hpp>
 
-#include "proccli/collectors.h"
+#include "proccli/snapshot_compact.h"
 
 namespace proccli {
 
 namespace {
-std::string extractResponse(const std::string &payload) {
-  auto pos = payload.find("\"response\"");
-  if (pos == std::string::npos) {
-    return payload;
+
+constexpr const char *kInstruction =
+    "Analyze the following diagnostics JSON and provide findings and recommended actions.\n\n";
+
+constexpr const char *kUnavailableResponse =
+    "Unable to reach local Ollama server. Provide guidance based on available diagnostics.";
+
+double millisecondsSince(std::chrono::steady_clock::time_point start) {
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  return std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+} // namespace
+
+OllamaOptions ollamaOptionsFromEnv() {
+  OllamaOptions options;
+  const char *env = std::getenv("OLLAMA_HOST");
+  if (env == nullptr || *env == '\0') {
+    return options;
   }
-  auto start = payload.find('"', pos + 10);
-  if (start == std::string::npos) {
-    return payload;
+  std::string_view value = env;
+  if (value.compare(0, 7, "http://") == 0) {
+    value.remove_prefix(7);
   }
-  start = payload.find('"', start + 1);
-  if (start == std::string::npos) {
-    return payload;
+  value = value.substr(0, value.find('/'));
+  auto colon = value.rfind(':');
+  if (colon != std::string_view::npos && value.find(']', colon) == std::string_view::npos) {
+    int port = 0;
+    std::string_view digits = value.substr(colon + 1);
+    auto [ptr, ec] = std::from_chars(digits.data(), digits.data() + digits.size(), port);
+    if (ec == std::errc() && ptr == digits.data() + digits.size() && port > 0) {
+      options.port = port;
+      value = value.substr(0, colon);
+    }
   }
-  auto end = payload.find('"', start + 1);
-  if (end == std::string::npos) {
-    return payload;
+  if (value.size() > 2 && value.front() == '[' && value.back() == ']') {
+    value = value.substr(1, value.size() - 2);
   }
-  return payload.substr(start + 1, end - start - 1);
-}
-
-std::string escapeForShell(const std::string &value) {
-  std::string escaped;
-  escaped.reserve(value.size());
-  for (char c : value) {
-    if (c == '"') {
-      escaped += "\\\"";
-    } else if (c == '\\') {
-      escaped += "\\\\";
-    } else if (c == '\n') {
-      escaped += "\\n";
-    } else {
-      escaped += c;
-    }
+  if (!value.empty()) {
+    options.host = std::string(value);
   }
-  return escaped;
+  return options;
 }
-} // namespace
 
-OllamaResult OllamaClient::analyze(const DiagnosticsSnapshot &snapshot, const std::string &model) const {
+OllamaClient::OllamaClient(OllamaOptions options)
+    : options_(std::move(options)),
+      http_(options_.host, options_.port,
+            HttpOptions{options_.connect_timeout_ms, options_.read_timeout_ms}) {}
+
+OllamaResult OllamaClient::analyze(const DiagnosticsSnapshot &snapshot, const std::string &model,
+                                   const TokenCallback &on_token) {
   nlohmann::json payload;
   payload["model"] = model;
-  payload["prompt"] =
-      "Analyze the following diagnostics JSON and provide findings and recommended actions.";
-  payload["stream"] = false;
+  payload["stream"] = true;
   payload["context"] = nlohmann::json::array();
-  payload["input"] = snapshot;
-
-  std::string payload_str = payload.dump();
-  std::string command = "curl -s http://localhost:11434/api/generate -d \"" +
-                        escapeForShell(payload_str) + "\"";
-  auto result = runCommand(command);
-  if (result.exit_code != 0 || result.output.empty()) {
-    return {false,
-            "Unable to reach local Ollama server. Provide guidance based on available diagnostics.",
-            "Ollama server unavailable"};
+  payload["options"] = {{"num_ctx", options_.token_budget + options_.response_tokens}};
+
+  OllamaResult result;
+  size_t envelope_tokens = estimateTokens(kInstruction);
+  CompactOptions compact_options;
+  compact_options.token_budget =
+      options_.token_budget > envelope_tokens ? options_.token_budget - envelope_tokens : 0;
+  auto compact = compactSnapshot(snapshot, compact_options);
+  result.compaction = formatCompactSummary(compact);
+  std::string prompt = kInstruction;
+  prompt += compact.payload.dump();
+  result.prompt_tokens = estimateTokens(prompt);
+  payload["prompt"] = std::move(prompt);
+
+  std::string stream_error;
+  bool done = false;
+  auto started = std::chrono::steady_clock::now();
+  auto handleLine = [&](std::string_view line) {
+    if (line.find_first_not_of(" \t\r") == std::string_view::npos) {
+      return true;
+    }
+    auto message = nlohmann::json::parse(line, nullptr, false);
+    if (message.is_discarded() || !message.is_object()) {
+      stream_error = "malformed response line from Ollama";
+      return false;
+    }
+    if (auto error = message.find("error"); error != message.end()) {
+      stream_error = error->is_string() ? error->get<std::string>() : error->dump();
+      return false;
+    }
+    if (auto token = message.find("response"); token != message.end() && token->is_string()) {
+      const auto &text = token->get_ref<const std::string &>();
+      if (!text.empty()) {
+        if (result.response.empty()) {
+          result.first_token_ms = millisecondsSince(started);
+        }
+        result.response += text;
+        if (on_token) {
+          on_token(text);
+        }
+      }
+    }
+    if (message.value("done", false)) {
+      done = true;
+    }
+    return true;
+  };
+
+  std::string pending;
+  auto onData = [&](std::string_view data) {
+    pending.append(data);
+    size_t start = 0;
+    size_t end = 0;
+    while ((end = pending.find('\n', start)) != std::string::npos) {
+      if (!handleLine(std::string_view(pending).substr(start, end - start))) {
+        return false;
+      }
+      start = end + 1;
+    }
+    pending.erase(0, start);
+    return true;
+  };
+  auto response = http_.post("/api/generate", "application/json", payload.dump(), onData);
+  if (stream_error.empty() && response.error.empty() && !pending.empty()) {
+    handleLine(pending);
+  }
+  result.total_ms = millisecondsSince(started);
+
+  if (!stream_error.empty()) {
+    result.error = "Ollama error: " + stream_error;
+  } else if (!response.error.empty()) {
+    result.error = response.error;
+  } else if (response.status != 200) {
+    result.error = "Ollama returned HTTP " + std::to_string(response.status);
+  } else if (!done) {
+    result.error = "Ollama stream ended before the response was complete";
+  }
+  result.ok = result.error.empty();
+  if (result.response.empty() && !result.ok) {
+    result.response = kUnavailableResponse;
   }
-  return {true, extractResponse(result.output), ""};
+  return result;
 }
 
 } // namespace proccli
@@ -0,0 +1,96 @@
+#include "proccli/parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+namespace proccli {
+
+size_t resolveThreads(size_t requested) {
+  if (requested > 0) {
+    return requested;
+  }
+  return std::max<size_t>(std::thread::hardware_concurrency(), 1);
+}
+
+size_t parseChunkCount(size_t bytes, size_t threads) {
+  threads = resolveThreads(threads);
+  if (threads == 1) {
+    return 1;
+  }
+  return std::clamp<size_t>(bytes / kMinParseChunkBytes, 1, threads * 4);
+}
+
+std::vector<std::string_view> splitChunks(
+    std::string_view text, size_t count,
+    const std::function<bool(std::string_view line)> &starts_chunk) {
+  std::vector<std::string_view> chunks;
+  count = std::max<size_t>(count, 1);
+  size_t begin = 0;
+  for (size_t i = 1; i < count && begin < text.size(); ++i) {
+    size_t cut = std::max(begin, text.size() / count * i);
+    while (cut < text.size()) {
+      size_t newline = text.find('\n', cut);
+      if (newline == std::string_view::npos) {
+        cut = text.size();
+        break;
+      }
+      cut = newline + 1;
+      if (!starts_chunk || starts_chunk(text.substr(cut, text.find('\n', cut) - cut))) {
+        break;
+      }
+    }
+    if (cut >= text.size()) {
+      break;
+    }
+    if (cut > begin) {
+      chunks.push_back(text.substr(begin, cut - begin));
+      begin = cut;
+    }
+  }
+  if (begin < text.size() || chunks.empty()) {
+    chunks.push_back(text.substr(begin));
+  }
+  return chunks;
+}
+
+void parallelFor(size_t tasks, size_t threads, const std::function<void(size_t task)> &body) {
+  threads = std::min(resolveThreads(threads), tasks);
+  if (threads <= 1) {
+    for (size_t task = 0; task < tasks; ++task) {
+      body(task);
+    }
+    return;
+  }
+  std::atomic<size_t> next{0};
+  std::exception_ptr failure;
+  std::mutex failure_mutex;
+  auto worker = [&]() {
+    for (size_t task = next++; task < tasks; task = next++) {
+      try {
+        body(task);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(failure_mutex);
+        if (!failure) {
+          failure = std::current_exception();
+        }
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  for (size_t i = 1; i < threads; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : workers) {
+    thread.join();
+  }
+  if (failure) {
+    std::rethrow_exception(failure);
+  }
+}
+
+} // namespace proccli
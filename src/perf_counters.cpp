@@ -0,0 +1,274 @@
+#include "proccli/perf_counters.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "proccli/proc_scanner.h"
+#include "proccli/sampler.h"
+#include "proccli/scheduler.h"
+
+namespace proccli {
+
+namespace {
+
+struct EventSpec {
+  std::uint32_t type;
+  std::uint64_t config;
+  bool hardware;
+};
+
+constexpr std::array<EventSpec, PerfCounterCollector::kEventCount> kEvents = {{
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, true},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, true},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, true},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, true},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, true},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS, false},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, false},
+    {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS, false},
+}};
+
+int perfEventOpen(perf_event_attr *attr, int tid, int group_fd) {
+  return static_cast<int>(
+      syscall(SYS_perf_event_open, attr, tid, -1, group_fd, PERF_FLAG_FD_CLOEXEC));
+}
+
+std::vector<int> listThreads(const std::vector<int> &pids) {
+  std::vector<int> tids;
+  for (int pid : pids) {
+    ProcScanner tasks("/proc/" + std::to_string(pid) + "/task");
+    auto found = tasks.listPids();
+    tids.insert(tids.end(), found.begin(), found.end());
+  }
+  return tids;
+}
+
+std::optional<long long> count(const std::optional<std::uint64_t> &reading) {
+  if (!reading) {
+    return std::nullopt;
+  }
+  return static_cast<long long>(*reading);
+}
+
+} // namespace
+
+void deriveCounterRatios(CounterValues &values) {
+  if (values.cycles && values.instructions && *values.cycles > 0) {
+    values.ipc = static_cast<double>(*values.instructions) / static_cast<double>(*values.cycles);
+  }
+  if (values.cache_references && values.cache_misses && *values.cache_references > 0) {
+    values.cache_miss_percent = static_cast<double>(*values.cache_misses) * 100.0 /
+                                static_cast<double>(*values.cache_references);
+  }
+  if (values.branch_misses && values.instructions && *values.instructions > 0) {
+    values.branch_mpki = static_cast<double>(*values.branch_misses) * 1000.0 /
+                         static_cast<double>(*values.instructions);
+  }
+}
+
+PerfCounterCollector::PerfCounterCollector(PerfCounterOptions options)
+    : options_(std::move(options)) {
+  for (size_t i = 0; i < kEventCount; ++i) {
+    available_[i] = !kEvents[i].hardware || options_.hardware;
+  }
+}
+
+PerfCounterCollector::~PerfCounterCollector() {
+  closeAll();
+}
+
+void PerfCounterCollector::closeAll() {
+  for (auto &thread : threads_) {
+    for (Group *group : {&thread.hardware, &thread.software}) {
+      for (int fd : group->fds) {
+        close(fd);
+      }
+      group->fds.clear();
+    }
+  }
+  threads_.clear();
+  attached_.clear();
+}
+
+bool PerfCounterCollector::openGroup(int tid, bool hardware, Group &group, std::string &error) {
+  bool probing = threads_.empty();
+  for (size_t index = 0; index < kEventCount; ++index) {
+    if (kEvents[index].hardware != hardware || !available_[index]) {
+      continue;
+    }
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = kEvents[index].type;
+    attr.config = kEvents[index].config;
+    attr.disabled = group.leader < 0 ? 1 : 0;
+    attr.read_format =
+        PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.exclude_kernel = exclude_kernel_ ? 1 : 0;
+    attr.exclude_hv = 1;
+    int fd = perfEventOpen(&attr, tid, group.leader);
+    if (fd < 0 && (errno == EACCES || errno == EPERM) && !exclude_kernel_) {
+      exclude_kernel_ = true;
+      attr.exclude_kernel = 1;
+      fd = perfEventOpen(&attr, tid, group.leader);
+    }
+    if (fd < 0) {
+      if (errno == ESRCH) {
+        break;
+      }
+      if (group.leader < 0) {
+        error = std::strerror(errno);
+        if (probing) {
+          for (size_t i = 0; i < kEventCount; ++i) {
+            available_[i] = available_[i] && kEvents[i].hardware != hardware;
+          }
+        }
+        break;
+      }
+      if (probing) {
+        available_[index] = false;
+      }
+      continue;
+    }
+    if (group.leader < 0) {
+      group.leader = fd;
+    }
+    group.fds.push_back(fd);
+    group.events.push_back(index);
+  }
+  return group.leader >= 0;
+}
+
+void PerfCounterCollector::attach(const std::vector<int> &tids) {
+  for (int tid : tids) {
+    if (attached_.count(tid) != 0) {
+      continue;
+    }
+    ThreadGroups thread;
+    thread.tid = tid;
+    std::string error;
+    if (hardware_) {
+      openGroup(tid, true, thread.hardware, error);
+    }
+    openGroup(tid, false, thread.software, error);
+    if (thread.hardware.leader < 0 && thread.software.leader < 0) {
+      continue;
+    }
+    for (const Group *group : {&thread.hardware, &thread.software}) {
+      if (group->leader >= 0) {
+        ioctl(group->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+      }
+    }
+    attached_.insert(tid);
+    threads_.push_back(std::move(thread));
+  }
+}
+
+bool PerfCounterCollector::readGroup(const Group &group, Readings &readings) {
+  if (group.leader < 0) {
+    return false;
+  }
+  std::vector<std::uint64_t> buffer(3 + group.fds.size());
+  ssize_t bytes = read(group.leader, buffer.data(), buffer.size() * sizeof(std::uint64_t));
+  if (bytes < static_cast<ssize_t>(3 * sizeof(std::uint64_t))) {
+    return false;
+  }
+  std::uint64_t nr = std::min<std::uint64_t>(buffer[0], group.events.size());
+  std::uint64_t enabled = buffer[1];
+  std::uint64_t running = buffer[2];
+  if (running == 0) {
+    return false;
+  }
+  for (std::uint64_t i = 0; i < nr; ++i) {
+    std::uint64_t value = buffer[3 + i];
+    if (running < enabled) {
+      value = static_cast<std::uint64_t>(static_cast<long double>(value) * enabled / running);
+      multiplexed_ = true;
+    }
+    readings[group.events[i]] = readings[group.events[i]].value_or(0) + value;
+  }
+  return true;
+}
+
+CounterValues PerfCounterCollector::toValues(int tid, const Readings &readings) {
+  CounterValues values;
+  values.tid = tid;
+  values.cycles = count(readings[0]);
+  values.instructions = count(readings[1]);
+  values.cache_references = count(readings[2]);
+  values.cache_misses = count(readings[3]);
+  values.branch_misses = count(readings[4]);
+  values.page_faults = count(readings[5]).value_or(0);
+  values.context_switches = count(readings[6]).value_or(0);
+  values.cpu_migrations = count(readings[7]).value_or(0);
+  deriveCounterRatios(values);
+  return values;
+}
+
+PerfCounterResult PerfCounterCollector::collect(const std::vector<int> &pids,
+                                                const CancelToken *cancel) {
+  PerfCounterResult result;
+  std::vector<int> tids = listThreads(pids);
+  if (tids.empty()) {
+    result.error = "no target threads to attach to";
+    return result;
+  }
+  if (options_.hardware) {
+    Group probe;
+    std::string error;
+    hardware_ = openGroup(tids.front(), true, probe, error);
+    for (int fd : probe.fds) {
+      close(fd);
+    }
+    if (!hardware_) {
+      result.warning = "hardware counters unavailable (" + error + "), software events only";
+    }
+  }
+  double started = monotonicSeconds();
+  attach(tids);
+  if (threads_.empty()) {
+    result.error = std::string("perf_event_open failed: ") + std::strerror(errno);
+    return result;
+  }
+  double deadline = started + options_.duration_ms / 1000.0;
+  while (true) {
+    double remaining = deadline - monotonicSeconds();
+    if (remaining <= 0.0 || (cancel != nullptr && cancel->cancelled())) {
+      break;
+    }
+    usleep(static_cast<useconds_t>(std::min(remaining, 0.1) * 1e6));
+    attach(listThreads(pids));
+  }
+  Readings total;
+  for (const auto &thread : threads_) {
+    Readings readings;
+    for (const Group *group : {&thread.hardware, &thread.software}) {
+      if (group->leader >= 0) {
+        ioctl(group->leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      }
+      readGroup(*group, readings);
+    }
+    for (size_t i = 0; i < kEventCount; ++i) {
+      if (readings[i]) {
+        total[i] = total[i].value_or(0) + *readings[i];
+      }
+    }
+    if (options_.per_thread) {
+      result.report.threads.push_back(toValues(thread.tid, readings));
+    }
+  }
+  result.report.duration_s = monotonicSeconds() - started;
+  result.report.hardware = hardware_;
+  result.report.multiplexed = multiplexed_;
+  result.report.process = toValues(pids.front(), total);
+  closeAll();
+  result.ok = true;
+  return result;
+}
+
+} // namespace proccli
@@ -0,0 +1,469 @@
+#include "proccli/perf_data.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/perf_event.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "proccli/perf_sampler.h"
+
+namespace proccli {
+
+namespace {
+
+constexpr std::uint64_t kPerfMagic = 0x32454c4946524550ULL;
+constexpr std::uint64_t kPerfMagicSwapped = 0x50455246494c4532ULL;
+constexpr size_t kHeaderSize = 104;
+constexpr size_t kReleaseChunk = 256u << 20;
+constexpr int kProcessFrame = -2;
+
+template <typename T>
+T load(const unsigned char *data) {
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+std::string hexBytes(const unsigned char *data, size_t size) {
+  static const char digits[] = "0123456789abcdef";
+  std::string out;
+  for (size_t i = 0; i < size; ++i) {
+    out += digits[data[i] >> 4];
+    out += digits[data[i] & 0xf];
+  }
+  return out;
+}
+
+std::string eventName(std::uint32_t type, std::uint64_t config) {
+  if (type == PERF_TYPE_HARDWARE) {
+    switch (config) {
+    case PERF_COUNT_HW_CPU_CYCLES:
+      return "cycles";
+    case PERF_COUNT_HW_INSTRUCTIONS:
+      return "instructions";
+    case PERF_COUNT_HW_CACHE_MISSES:
+      return "cache-misses";
+    case PERF_COUNT_HW_BRANCH_MISSES:
+      return "branch-misses";
+    default:
+      break;
+    }
+  } else if (type == PERF_TYPE_SOFTWARE) {
+    if (config == PERF_COUNT_SW_CPU_CLOCK) {
+      return "cpu-clock";
+    }
+    if (config == PERF_COUNT_SW_TASK_CLOCK) {
+      return "task-clock";
+    }
+  }
+  return "type" + std::to_string(type) + ":" + std::to_string(config);
+}
+
+std::string cString(const unsigned char *begin, const unsigned char *end) {
+  size_t length = strnlen(reinterpret_cast<const char *>(begin), static_cast<size_t>(end - begin));
+  return std::string(reinterpret_cast<const char *>(begin), length);
+}
+
+} // namespace
+
+PerfDataReader::~PerfDataReader() {
+  if (data_) {
+    munmap(const_cast<unsigned char *>(data_), size_);
+  }
+}
+
+bool PerfDataReader::open(const std::string &path, std::string &error) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(kHeaderSize)) {
+    close(fd);
+    error = path + " is too small to be a perf.data file";
+    return false;
+  }
+  size_ = static_cast<size_t>(info.st_size);
+  void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    error = "cannot map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  data_ = static_cast<const unsigned char *>(mapped);
+  madvise(mapped, size_, MADV_SEQUENTIAL);
+
+  std::uint64_t magic = load<std::uint64_t>(data_);
+  if (magic == kPerfMagicSwapped) {
+    error = "big-endian perf.data is not supported";
+    return false;
+  }
+  if (magic != kPerfMagic) {
+    error = path + " is not a perf.data file (pipe-mode captures are not supported)";
+    return false;
+  }
+  std::uint64_t attr_size = load<std::uint64_t>(data_ + 16);
+  std::uint64_t attrs_offset = load<std::uint64_t>(data_ + 24);
+  std::uint64_t attrs_size = load<std::uint64_t>(data_ + 32);
+  data_offset_ = load<std::uint64_t>(data_ + 40);
+  data_size_ = load<std::uint64_t>(data_ + 48);
+  if (attr_size < 16 + 40 || attrs_offset > size_ || attrs_size > size_ - attrs_offset ||
+      data_offset_ > size_) {
+    error = "corrupt perf.data header";
+    return false;
+  }
+  if (data_size_ == 0 || data_size_ > size_ - data_offset_) {
+    data_size_ = size_ - data_offset_;
+  }
+  for (std::uint64_t pos = attrs_offset; pos + attr_size <= attrs_offset + attrs_size;
+       pos += attr_size) {
+    const unsigned char *attr = data_ + pos;
+    Attr entry;
+    entry.sample_type = load<std::uint64_t>(attr + 24);
+    entry.read_format = load<std::uint64_t>(attr + 32);
+    if (attrs_.empty()) {
+      event_ = eventName(load<std::uint32_t>(attr), load<std::uint64_t>(attr + 8));
+      has_identifier_ = (entry.sample_type & PERF_SAMPLE_IDENTIFIER) != 0;
+    }
+    std::uint64_t ids_offset = load<std::uint64_t>(attr + attr_size - 16);
+    std::uint64_t ids_size = load<std::uint64_t>(attr + attr_size - 8);
+    if (ids_offset <= size_ && ids_size <= size_ - ids_offset) {
+      for (std::uint64_t id = 0; id + 8 <= ids_size; id += 8) {
+        attr_by_id_[load<std::uint64_t>(data_ + ids_offset + id)] = attrs_.size();
+      }
+    }
+    attrs_.push_back(entry);
+  }
+  if (attrs_.empty()) {
+    error = "perf.data has no event attributes";
+    return false;
+  }
+  return true;
+}
+
+bool PerfDataReader::parseSample(const unsigned char *body, const unsigned char *end,
+                                 std::uint16_t misc, PerfDataSample &sample) const {
+  const unsigned char *cursor = body;
+  auto take = [&](std::uint64_t &value) {
+    if (end - cursor < 8) {
+      return false;
+    }
+    value = load<std::uint64_t>(cursor);
+    cursor += 8;
+    return true;
+  };
+  std::uint64_t value = 0;
+  const Attr *attr = &attrs_.front();
+  if (has_identifier_) {
+    if (!take(value)) {
+      return false;
+    }
+    auto it = attr_by_id_.find(value);
+    if (it != attr_by_id_.end()) {
+      attr = &attrs_[it->second];
+    }
+  }
+  std::uint64_t type = attr->sample_type;
+  sample = PerfDataSample{};
+  sample.kernel = (misc & PERF_RECORD_MISC_CPUMODE_MASK) == PERF_RECORD_MISC_KERNEL;
+  if ((type & PERF_SAMPLE_IP) && !take(sample.ip)) {
+    return false;
+  }
+  if (type & PERF_SAMPLE_TID) {
+    if (!take(value)) {
+      return false;
+    }
+    sample.pid = static_cast<int>(static_cast<std::uint32_t>(value));
+    sample.tid = static_cast<int>(static_cast<std::uint32_t>(value >> 32));
+  }
+  for (std::uint64_t skipped : {static_cast<std::uint64_t>(PERF_SAMPLE_TIME),
+                                static_cast<std::uint64_t>(PERF_SAMPLE_ADDR),
+                                static_cast<std::uint64_t>(PERF_SAMPLE_ID),
+                                static_cast<std::uint64_t>(PERF_SAMPLE_STREAM_ID),
+                                static_cast<std::uint64_t>(PERF_SAMPLE_CPU)}) {
+    if ((type & skipped) && !take(value)) {
+      return false;
+    }
+  }
+  if ((type & PERF_SAMPLE_PERIOD) && !take(sample.period)) {
+    return false;
+  }
+  if (type & PERF_SAMPLE_READ) {
+    std::uint64_t format = attr->read_format;
+    std::uint64_t per_value = 1 + ((format & PERF_FORMAT_ID) ? 1 : 0) +
+                              ((format & PERF_FORMAT_LOST) ? 1 : 0);
+    std::uint64_t words = ((format & PERF_FORMAT_TOTAL_TIME_ENABLED) ? 1 : 0) +
+                          ((format & PERF_FORMAT_TOTAL_TIME_RUNNING) ? 1 : 0);
+    if (format & PERF_FORMAT_GROUP) {
+      if (!take(value) || value > static_cast<std::uint64_t>(end - cursor) / 8) {
+        return false;
+      }
+      words += value * per_value;
+    } else {
+      words += per_value;
+    }
+    if (static_cast<std::uint64_t>(end - cursor) / 8 < words) {
+      return false;
+    }
+    cursor += words * 8;
+  }
+  if (type & PERF_SAMPLE_CALLCHAIN) {
+    if (!take(value) || static_cast<std::uint64_t>(end - cursor) / 8 < value) {
+      return false;
+    }
+    sample.callchain = reinterpret_cast<const std::uint64_t *>(cursor);
+    sample.callchain_depth = static_cast<size_t>(value);
+  }
+  return true;
+}
+
+int PerfDataReader::internDso(const std::string &path, const std::string &build_id) {
+  auto it = dso_by_path_.find(path);
+  if (it != dso_by_path_.end()) {
+    if (!build_id.empty()) {
+      dsos_[static_cast<size_t>(it->second)].build_id = build_id;
+    }
+    return it->second;
+  }
+  int index = static_cast<int>(dsos_.size());
+  dsos_.push_back({path, build_id, false, nullptr});
+  dso_by_path_.emplace(path, index);
+  return index;
+}
+
+void PerfDataReader::addMapping(int pid, std::uint64_t start, std::uint64_t length,
+                                std::uint64_t pgoff, const std::string &path,
+                                const std::string &build_id) {
+  if (length == 0) {
+    return;
+  }
+  AddressSpace &space = spaces_[pid];
+  std::uint64_t end = start + length;
+  auto it = space.lower_bound(start);
+  if (it != space.begin() && std::prev(it)->second.end > start) {
+    --it;
+  }
+  while (it != space.end() && it->first < end) {
+    it = space.erase(it);
+  }
+  space.emplace(start, Region{end, pgoff, internDso(path, build_id)});
+}
+
+bool PerfDataReader::read(const SampleCallback &on_sample, std::string &error) {
+  const unsigned char *cursor = data_ + data_offset_;
+  const unsigned char *end = cursor + data_size_;
+  const unsigned char *released = data_;
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  PerfDataSample sample;
+  while (end - cursor >= static_cast<std::ptrdiff_t>(sizeof(perf_event_header))) {
+    auto header = load<perf_event_header>(cursor);
+    if (header.size < sizeof(perf_event_header) || static_cast<std::ptrdiff_t>(header.size) > end - cursor) {
+      error = "truncated perf.data record at offset " + std::to_string(cursor - data_);
+      return false;
+    }
+    const unsigned char *body = cursor + sizeof(perf_event_header);
+    const unsigned char *record_end = cursor + header.size;
+    switch (header.type) {
+    case PERF_RECORD_SAMPLE:
+      if (parseSample(body, record_end, header.misc, sample)) {
+        samples_ += 1;
+        on_sample(sample);
+      }
+      break;
+    case PERF_RECORD_MMAP:
+      if (record_end - body > 32) {
+        addMapping(static_cast<int>(load<std::uint32_t>(body)), load<std::uint64_t>(body + 8),
+                   load<std::uint64_t>(body + 16), load<std::uint64_t>(body + 24),
+                   cString(body + 32, record_end), "");
+      }
+      break;
+    case PERF_RECORD_MMAP2:
+      if (record_end - body > 64) {
+        std::string build_id;
+        if (header.misc & PERF_RECORD_MISC_MMAP_BUILD_ID) {
+          build_id = hexBytes(body + 36, std::min<size_t>(body[32], 20));
+        }
+        addMapping(static_cast<int>(load<std::uint32_t>(body)), load<std::uint64_t>(body + 8),
+                   load<std::uint64_t>(body + 16), load<std::uint64_t>(body + 24),
+                   cString(body + 64, record_end), build_id);
+      }
+      break;
+    case PERF_RECORD_COMM:
+      if (record_end - body > 8 && load<std::uint32_t>(body) == load<std::uint32_t>(body + 4)) {
+        int pid = static_cast<int>(load<std::uint32_t>(body));
+        if (header.misc & PERF_RECORD_MISC_COMM_EXEC) {
+          spaces_.erase(pid);
+        }
+        comms_[pid] = cString(body + 8, record_end);
+      }
+      break;
+    case PERF_RECORD_FORK:
+      if (record_end - body >= 8) {
+        int pid = static_cast<int>(load<std::uint32_t>(body));
+        int ppid = static_cast<int>(load<std::uint32_t>(body + 4));
+        auto parent = spaces_.find(ppid);
+        if (pid != ppid && parent != spaces_.end() && spaces_.count(pid) == 0) {
+          AddressSpace copy = parent->second;
+          spaces_.emplace(pid, std::move(copy));
+        }
+      }
+      break;
+    case PERF_RECORD_LOST:
+      if (record_end - body >= 16) {
+        lost_ += load<std::uint64_t>(body + 8);
+      }
+      break;
+    case PERF_RECORD_LOST_SAMPLES:
+      if (record_end - body >= 8) {
+        lost_ += load<std::uint64_t>(body);
+      }
+      break;
+    default:
+      break;
+    }
+    cursor = record_end;
+    if (static_cast<size_t>(cursor - released) >= kReleaseChunk) {
+      const unsigned char *until = data_ + ((cursor - data_) / page) * page;
+      madvise(const_cast<unsigned char *>(released), static_cast<size_t>(until - released),
+              MADV_DONTNEED);
+      released = until;
+    }
+  }
+  return true;
+}
+
+PerfDataLocation PerfDataReader::locate(int pid, std::uint64_t ip, bool kernel) const {
+  for (int space_pid : {kernel ? -1 : pid, -1}) {
+    auto space = spaces_.find(space_pid);
+    if (space == spaces_.end()) {
+      continue;
+    }
+    auto it = space->second.upper_bound(ip);
+    if (it == space->second.begin()) {
+      continue;
+    }
+    --it;
+    if (ip < it->second.end) {
+      return {it->second.dso, ip - it->first + it->second.pgoff};
+    }
+  }
+  return {-1, ip};
+}
+
+std::string PerfDataReader::describe(const PerfDataLocation &location) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "+0x%llx",
+                static_cast<unsigned long long>(location.offset));
+  if (location.dso < 0) {
+    return std::string("[unknown]") + buffer;
+  }
+  Dso &dso = dsos_[static_cast<size_t>(location.dso)];
+  if (!dso.loaded) {
+    dso.loaded = true;
+    if (!dso.path.empty() && dso.path.front() == '/') {
+      dso.table = ElfSymbolTable::load(dso.path, defaultSymbolCacheDir());
+      if (dso.table && !dso.build_id.empty() && !dso.table->buildId().empty() &&
+          dso.table->buildId().compare(0, dso.build_id.size(), dso.build_id) != 0) {
+        dso.table.reset();
+      }
+    }
+  }
+  std::uint64_t vaddr = 0;
+  if (dso.table && dso.table->fileOffsetToVaddr(location.offset, vaddr)) {
+    auto symbol = dso.table->lookup(vaddr);
+    if (!symbol.empty()) {
+      return demangle(symbol);
+    }
+  }
+  auto slash = dso.path.rfind('/');
+  return (slash == std::string::npos ? dso.path : dso.path.substr(slash + 1)) + buffer;
+}
+
+std::string PerfDataReader::comm(int pid) const {
+  auto it = comms_.find(pid);
+  return it == comms_.end() ? "pid " + std::to_string(pid) : it->second;
+}
+
+std::optional<PerfReport> readPerfData(const std::string &path, std::string &error, size_t limit,
+                                       StackTrie *stacks) {
+  PerfDataReader reader;
+  if (!reader.open(path, error)) {
+    return std::nullopt;
+  }
+  std::unordered_map<int, std::unordered_map<std::uint64_t, std::uint64_t>> weights;
+  std::uint64_t total = 0;
+  StackTrie raw;
+  std::vector<PerfDataLocation> frames;
+  std::unordered_map<int, std::unordered_map<std::uint64_t, std::uint64_t>> frame_ids;
+  std::vector<std::uint64_t> chain;
+  auto intern = [&](PerfDataLocation location) {
+    auto [it, inserted] = frame_ids[location.dso].try_emplace(location.offset, frames.size());
+    if (inserted) {
+      frames.push_back(location);
+    }
+    return it->second;
+  };
+  bool ok = reader.read(
+      [&](const PerfDataSample &sample) {
+        PerfDataLocation location = reader.locate(sample.pid, sample.ip, sample.kernel);
+        weights[location.dso][location.offset] += sample.period;
+        total += sample.period;
+        if (!stacks) {
+          return;
+        }
+        chain.clear();
+        bool kernel = sample.kernel;
+        for (size_t i = 0; i < sample.callchain_depth; ++i) {
+          std::uint64_t ip = sample.callchain[i];
+          if (ip >= static_cast<std::uint64_t>(PERF_CONTEXT_MAX)) {
+            kernel = ip == static_cast<std::uint64_t>(PERF_CONTEXT_KERNEL);
+            continue;
+          }
+          chain.push_back(intern(reader.locate(sample.pid, ip, kernel)));
+        }
+        if (chain.empty()) {
+          chain.push_back(intern(location));
+        }
+        std::uint64_t process = intern({kProcessFrame, static_cast<std::uint64_t>(sample.pid)});
+        std::uint32_t node = raw.child(StackTrie::kRoot, process);
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+          node = raw.child(node, *it);
+        }
+        raw.addSample(node, sample.period);
+      },
+      error);
+  if (!ok) {
+    return std::nullopt;
+  }
+  std::map<std::string, std::uint64_t> by_label;
+  for (const auto &[dso, offsets] : weights) {
+    for (const auto &[offset, weight] : offsets) {
+      by_label[reader.describe({dso, offset})] += weight;
+    }
+  }
+  PerfReport report;
+  report.event = reader.event();
+  report.samples = static_cast<long long>(reader.samples());
+  report.lost = static_cast<long long>(reader.lost());
+  report.hotspots = rankHotspots(by_label, total, limit);
+  if (stacks && !raw.empty()) {
+    *stacks = raw.relabel([&](std::uint64_t frame) {
+      const PerfDataLocation &location = frames[frame];
+      if (location.dso == kProcessFrame) {
+        return reader.comm(static_cast<int>(location.offset));
+      }
+      return reader.describe(location);
+    });
+    report.frames = stacks->topFrames(limit);
+  }
+  return report;
+}
+
+} // namespace proccli
@@ -0,0 +1,349 @@
+#include "proccli/perf_sampler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <map>
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <spdlog/spdlog.h>
+
+#include "proccli/proc_scanner.h"
+#include "proccli/sampler.h"
+#include "proccli/scheduler.h"
+#include "proccli/symbolizer.h"
+#include "proccli/utils.h"
+
+namespace proccli {
+
+namespace {
+
+int perfEventOpen(perf_event_attr *attr, int tid) {
+  return static_cast<int>(syscall(SYS_perf_event_open, attr, tid, -1, -1, PERF_FLAG_FD_CLOEXEC));
+}
+
+std::uint64_t stackFrame(PerfSampleSet &set, int pid, std::uint64_t ip) {
+  auto [it, inserted] = set.stack_frame_ids[pid].try_emplace(ip, set.stack_frames.size());
+  if (inserted) {
+    set.stack_frames.emplace_back(pid, ip);
+  }
+  return it->second;
+}
+
+std::string processLabel(int pid) {
+  std::string comm = readFile("/proc/" + std::to_string(pid) + "/comm");
+  while (!comm.empty() && (comm.back() == '\n' || comm.back() == ' ')) {
+    comm.pop_back();
+  }
+  return comm.empty() ? "pid " + std::to_string(pid) : comm;
+}
+
+} // namespace
+
+PerfSampler::PerfSampler(PerfSamplerOptions options) : options_(std::move(options)) {}
+
+PerfSampler::~PerfSampler() {
+  closeStreams();
+}
+
+void PerfSampler::closeStreams() {
+  for (auto &stream : streams_) {
+    if (stream.ring) {
+      munmap(stream.ring, stream.ring_size);
+    }
+    if (stream.fd >= 0) {
+      close(stream.fd);
+    }
+  }
+  streams_.clear();
+  attached_.clear();
+}
+
+bool PerfSampler::openStreams(const std::vector<int> &tids, bool hardware, std::string &error) {
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t ring_size = page * (1 + static_cast<size_t>(options_.ring_pages));
+  for (int tid : tids) {
+    if (attached_.count(tid) != 0) {
+      continue;
+    }
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = hardware ? PERF_TYPE_HARDWARE : PERF_TYPE_SOFTWARE;
+    attr.config = hardware ? static_cast<std::uint64_t>(PERF_COUNT_HW_CPU_CYCLES)
+                           : static_cast<std::uint64_t>(PERF_COUNT_SW_CPU_CLOCK);
+    attr.freq = 1;
+    attr.sample_freq = static_cast<std::uint64_t>(options_.frequency_hz);
+    attr.sample_type = PERF_SAMPLE_IP | PERF_SAMPLE_TID;
+    if (options_.callchain) {
+      attr.sample_type |= PERF_SAMPLE_CALLCHAIN;
+      attr.exclude_callchain_kernel = 1;
+    }
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = perfEventOpen(&attr, tid);
+    if (fd < 0) {
+      if (errno == ESRCH) {
+        continue;
+      }
+      error = std::string("perf_event_open failed: ") + std::strerror(errno);
+      if (streams_.empty()) {
+        return false;
+      }
+      continue;
+    }
+    void *ring = mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring == MAP_FAILED) {
+      error = std::string("perf ring buffer mmap failed: ") + std::strerror(errno);
+      close(fd);
+      if (streams_.empty()) {
+        return false;
+      }
+      continue;
+    }
+    streams_.push_back({tid, fd, ring, ring_size});
+    attached_.insert(tid);
+  }
+  if (streams_.empty()) {
+    error = "no target threads to attach to";
+    return false;
+  }
+  return true;
+}
+
+void PerfSampler::drain(Stream &stream, PerfSampleSet &set) {
+  auto *meta = static_cast<perf_event_mmap_page *>(stream.ring);
+  size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  char *data = static_cast<char *>(stream.ring) + page;
+  std::uint64_t data_size = stream.ring_size - page;
+  std::uint64_t head = meta->data_head;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  std::uint64_t tail = meta->data_tail;
+  while (tail < head) {
+    perf_event_header header{};
+    std::uint64_t offset = tail % data_size;
+    if (offset + sizeof(header) <= data_size) {
+      std::memcpy(&header, data + offset, sizeof(header));
+    } else {
+      size_t first = static_cast<size_t>(data_size - offset);
+      std::memcpy(&header, data + offset, first);
+      std::memcpy(reinterpret_cast<char *>(&header) + first, data, sizeof(header) - first);
+    }
+    if (header.size == 0) {
+      break;
+    }
+    if (record_buffer_.size() < header.size) {
+      record_buffer_.resize(header.size);
+    }
+    if (offset + header.size <= data_size) {
+      std::memcpy(record_buffer_.data(), data + offset, header.size);
+    } else {
+      size_t first = static_cast<size_t>(data_size - offset);
+      std::memcpy(record_buffer_.data(), data + offset, first);
+      std::memcpy(record_buffer_.data() + first, data, header.size - first);
+    }
+    const char *body = record_buffer_.data() + sizeof(header);
+    if (header.type == PERF_RECORD_SAMPLE) {
+      std::uint64_t ip = 0;
+      std::uint32_t pid = 0;
+      std::memcpy(&ip, body, sizeof(ip));
+      std::memcpy(&pid, body + sizeof(ip), sizeof(pid));
+      set.ip_counts[static_cast<int>(pid)][ip] += 1;
+      set.samples += 1;
+      std::uint32_t node = set.stacks.child(StackTrie::kRoot, stackFrame(set, static_cast<int>(pid), 0));
+      std::uint64_t depth = 0;
+      const char *chain = body + sizeof(ip) + 2 * sizeof(pid);
+      if (options_.callchain && chain + sizeof(depth) <= record_buffer_.data() + header.size) {
+        std::memcpy(&depth, chain, sizeof(depth));
+        chain += sizeof(depth);
+        depth = std::min<std::uint64_t>(
+            depth, static_cast<std::uint64_t>(record_buffer_.data() + header.size - chain) / 8);
+      }
+      if (depth == 0) {
+        node = set.stacks.child(node, stackFrame(set, static_cast<int>(pid), ip));
+      }
+      for (std::uint64_t i = depth; i > 0; --i) {
+        std::uint64_t frame = 0;
+        std::memcpy(&frame, chain + (i - 1) * sizeof(frame), sizeof(frame));
+        if (frame >= static_cast<std::uint64_t>(PERF_CONTEXT_MAX)) {
+          continue;
+        }
+        node = set.stacks.child(node, stackFrame(set, static_cast<int>(pid), frame));
+      }
+      set.stacks.addSample(node, 1);
+    } else if (header.type == PERF_RECORD_LOST) {
+      std::uint64_t lost = 0;
+      std::memcpy(&lost, body + sizeof(std::uint64_t), sizeof(lost));
+      set.lost += lost;
+    }
+    tail += header.size;
+  }
+  std::atomic_thread_fence(std::memory_order_release);
+  meta->data_tail = tail;
+}
+
+std::vector<int> PerfSampler::listThreads(const std::vector<int> &pids) {
+  std::vector<int> tids;
+  for (int pid : pids) {
+    ProcScanner tasks("/proc/" + std::to_string(pid) + "/task");
+    auto found = tasks.listPids();
+    tids.insert(tids.end(), found.begin(), found.end());
+  }
+  return tids;
+}
+
+void PerfSampler::snapshotMaps(const std::vector<int> &pids, PerfSampleSet &set) {
+  for (int pid : pids) {
+    std::string maps = readFile("/proc/" + std::to_string(pid) + "/maps");
+    if (!maps.empty()) {
+      set.maps[pid] = std::move(maps);
+    }
+  }
+}
+
+PerfSamplingResult PerfSampler::sample(const std::vector<int> &pids, const CancelToken *cancel) {
+  PerfSamplingResult result;
+  std::vector<int> tids = listThreads(pids);
+  bool hardware = options_.event == "cycles";
+  std::string error;
+  if (!openStreams(tids, hardware, error)) {
+    if (!hardware) {
+      result.error = error;
+      return result;
+    }
+    spdlog::warn("Hardware cycles unavailable ({}), falling back to cpu-clock", error);
+    hardware = false;
+    if (!openStreams(tids, hardware, error)) {
+      result.error = error;
+      return result;
+    }
+  }
+  result.sample_set.event = hardware ? "cycles" : "cpu-clock";
+  result.sample_set.attached_threads = static_cast<int>(streams_.size());
+  snapshotMaps(pids, result.sample_set);
+
+  for (auto &stream : streams_) {
+    ioctl(stream.fd, PERF_EVENT_IOC_ENABLE, 0);
+  }
+  double deadline = monotonicSeconds() + options_.duration_ms / 1000.0;
+  int ticks = 0;
+  while (true) {
+    double remaining = deadline - monotonicSeconds();
+    if (remaining <= 0.0 || (cancel != nullptr && cancel->cancelled())) {
+      break;
+    }
+    usleep(static_cast<useconds_t>(std::min(remaining, 0.05) * 1e6));
+    for (auto &stream : streams_) {
+      drain(stream, result.sample_set);
+    }
+    if (++ticks % 5 == 0) {
+      size_t attached = streams_.size();
+      if (openStreams(listThreads(pids), hardware, error)) {
+        for (size_t i = attached; i < streams_.size(); ++i) {
+          ioctl(streams_[i].fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+      }
+      snapshotMaps(pids, result.sample_set);
+    }
+  }
+  result.sample_set.attached_threads = static_cast<int>(streams_.size());
+  for (auto &stream : streams_) {
+    ioctl(stream.fd, PERF_EVENT_IOC_DISABLE, 0);
+    drain(stream, result.sample_set);
+  }
+  closeStreams();
+  result.ok = true;
+  return result;
+}
+
+std::vector<PerfHotspot> rankHotspots(const std::map<std::string, std::uint64_t> &weights,
+                                      std::uint64_t total, size_t limit) {
+  std::vector<PerfHotspot> hotspots;
+  if (total == 0) {
+    return hotspots;
+  }
+  std::vector<std::pair<std::string, std::uint64_t>> ranked(weights.begin(), weights.end());
+  std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b) {
+    if (a.second != b.second) {
+      return a.second > b.second;
+    }
+    return a.first < b.first;
+  });
+  if (ranked.size() > limit) {
+    ranked.resize(limit);
+  }
+  for (const auto &[label, weight] : ranked) {
+    hotspots.push_back(
+        {label, static_cast<double>(weight) * 100.0 / static_cast<double>(total)});
+  }
+  return hotspots;
+}
+
+StackTrie symbolizeStacks(const PerfSampleSet &set, Symbolizer &symbolizer) {
+  for (const auto &[pid, maps] : set.maps) {
+    symbolizer.loadMaps(pid, maps);
+  }
+  return set.stacks.relabel([&](std::uint64_t frame) {
+    auto [pid, ip] = set.stack_frames[frame];
+    if (ip == 0) {
+      return processLabel(pid);
+    }
+    return symbolizer.describe(pid, ip);
+  });
+}
+
+PerfReport buildPerfReport(const PerfSampleSet &set, Symbolizer &symbolizer, size_t limit,
+                           StackTrie *stacks) {
+  PerfReport report;
+  report.event = set.event;
+  report.samples = static_cast<long long>(set.samples);
+  report.lost = static_cast<long long>(set.lost);
+  if (set.samples == 0) {
+    return report;
+  }
+  std::map<std::string, std::uint64_t> by_label;
+  for (const auto &[pid, counts] : set.ip_counts) {
+    auto maps = set.maps.find(pid);
+    if (maps == set.maps.end() || !symbolizer.loadMaps(pid, maps->second)) {
+      symbolizer.loadProcess(pid);
+    }
+    for (const auto &[ip, count] : counts) {
+      by_label[symbolizer.describe(pid, ip)] += count;
+    }
+  }
+  report.hotspots = rankHotspots(by_label, set.samples, limit);
+  if (!set.stacks.empty()) {
+    StackTrie named = symbolizeStacks(set, symbolizer);
+    report.frames = named.topFrames(limit);
+    if (stacks) {
+      *stacks = std::move(named);
+    }
+  }
+  return report;
+}
+
+PerfReport buildPerfReport(const PerfSampleSet &set, size_t limit) {
+  Symbolizer symbolizer;
+  return buildPerfReport(set, symbolizer, limit);
+}
+
+PerfReport buildStackReport(const StackTrie &stacks, size_t limit) {
+  PerfReport report;
+  std::map<std::string, std::uint64_t> by_label;
+  for (const auto &node : stacks.nodes()) {
+    if (node.self > 0 && node.parent != StackTrie::kRoot) {
+      by_label[stacks.frameName(node.frame)] += node.self;
+    }
+  }
+  report.hotspots = rankHotspots(by_label, stacks.totalWeight(), limit);
+  report.frames = stacks.topFrames(limit);
+  return report;
+}
+
+} // namespace proccli
@@ -0,0 +1,250 @@
+#include "proccli/proc_scanner.h"
+
+#include <charconv>
+#include <cstdio>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "proccli/utils.h"
+
+namespace proccli {
+
+namespace {
+
+struct LinuxDirent64 {
+  unsigned long long d_ino;
+  long long d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+
+bool parsePid(const char *name, int &pid) {
+  if (*name < '0' || *name > '9') {
+    return false;
+  }
+  const char *end = name;
+  while (*end != '\0') {
+    ++end;
+  }
+  auto result = std::from_chars(name, end, pid);
+  return result.ec == std::errc() && result.ptr == end;
+}
+
+template <typename T>
+bool nextNumber(std::string_view &rest, T &value) {
+  while (!rest.empty() && rest.front() == ' ') {
+    rest.remove_prefix(1);
+  }
+  auto result = std::from_chars(rest.data(), rest.data() + rest.size(), value);
+  if (result.ec != std::errc()) {
+    return false;
+  }
+  rest.remove_prefix(static_cast<size_t>(result.ptr - rest.data()));
+  return true;
+}
+
+void skipFields(std::string_view &rest, int count) {
+  for (int i = 0; i < count; ++i) {
+    while (!rest.empty() && rest.front() == ' ') {
+      rest.remove_prefix(1);
+    }
+    while (!rest.empty() && rest.front() != ' ') {
+      rest.remove_prefix(1);
+    }
+  }
+}
+
+} // namespace
+
+bool parseProcStat(std::string_view content, ProcStat &stat) {
+  auto open = content.find('(');
+  auto close = content.rfind(')');
+  if (open == std::string_view::npos || close == std::string_view::npos || close < open) {
+    return false;
+  }
+  std::string_view head = content.substr(0, open);
+  while (!head.empty() && head.back() == ' ') {
+    head.remove_suffix(1);
+  }
+  if (std::from_chars(head.data(), head.data() + head.size(), stat.pid).ec != std::errc()) {
+    return false;
+  }
+  stat.comm.assign(content.substr(open + 1, close - open - 1));
+  std::string_view rest = content.substr(close + 1);
+  while (!rest.empty() && rest.front() == ' ') {
+    rest.remove_prefix(1);
+  }
+  if (rest.empty()) {
+    return false;
+  }
+  stat.state = rest.front();
+  rest.remove_prefix(1);
+  if (!nextNumber(rest, stat.ppid)) {
+    return false;
+  }
+  skipFields(rest, 9);
+  if (!nextNumber(rest, stat.utime) || !nextNumber(rest, stat.stime)) {
+    return false;
+  }
+  skipFields(rest, 4);
+  if (!nextNumber(rest, stat.num_threads)) {
+    return false;
+  }
+  skipFields(rest, 1);
+  if (!nextNumber(rest, stat.starttime) || !nextNumber(rest, stat.vsize) ||
+      !nextNumber(rest, stat.rss_pages)) {
+    return false;
+  }
+  skipFields(rest, 14);
+  if (!nextNumber(rest, stat.processor)) {
+    stat.processor = -1;
+  }
+  return true;
+}
+
+std::string formatElapsed(long long seconds) {
+  if (seconds < 0) {
+    seconds = 0;
+  }
+  long long days = seconds / 86400;
+  long long hours = (seconds / 3600) % 24;
+  long long minutes = (seconds / 60) % 60;
+  long long secs = seconds % 60;
+  char buffer[48];
+  if (days > 0) {
+    std::snprintf(buffer, sizeof(buffer), "%lld-%02lld:%02lld:%02lld", days, hours, minutes, secs);
+  } else if (hours > 0) {
+    std::snprintf(buffer, sizeof(buffer), "%02lld:%02lld:%02lld", hours, minutes, secs);
+  } else {
+    std::snprintf(buffer, sizeof(buffer), "%02lld:%02lld", minutes, secs);
+  }
+  return buffer;
+}
+
+ProcScanner::ProcScanner(std::string root) : root_(std::move(root)), dirents_(64 * 1024) {
+  clock_ticks_ = sysconf(_SC_CLK_TCK);
+  if (clock_ticks_ <= 0) {
+    clock_ticks_ = 100;
+  }
+  page_size_kb_ = sysconf(_SC_PAGESIZE) / 1024;
+  if (page_size_kb_ <= 0) {
+    page_size_kb_ = 4;
+  }
+}
+
+ProcScanner::~ProcScanner() {
+  if (root_fd_ >= 0) {
+    close(root_fd_);
+  }
+}
+
+bool ProcScanner::openRoot() {
+  if (root_fd_ >= 0) {
+    return true;
+  }
+  root_fd_ = open(root_.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  return root_fd_ >= 0;
+}
+
+void ProcScanner::loadSystemInfo() {
+  if (readFileAt(root_fd_, "uptime", stat_buffer_)) {
+    std::string_view rest(stat_buffer_);
+    nextNumber(rest, uptime_seconds_);
+  }
+  if (readFileAt(root_fd_, "meminfo", stat_buffer_)) {
+    std::string_view content(stat_buffer_);
+    auto pos = content.find("MemTotal:");
+    if (pos != std::string_view::npos) {
+      std::string_view rest = content.substr(pos + 9);
+      nextNumber(rest, mem_total_kb_);
+    }
+  }
+}
+
+std::vector<int> ProcScanner::listPids() {
+  std::vector<int> pids;
+  if (!openRoot()) {
+    return pids;
+  }
+  lseek(root_fd_, 0, SEEK_SET);
+  while (true) {
+    long count = syscall(SYS_getdents64, root_fd_, dirents_.data(), dirents_.size());
+    if (count <= 0) {
+      break;
+    }
+    long offset = 0;
+    while (offset < count) {
+      auto *entry = reinterpret_cast<LinuxDirent64 *>(dirents_.data() + offset);
+      offset += entry->d_reclen;
+      if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) {
+        continue;
+      }
+      int pid = 0;
+      if (parsePid(entry->d_name, pid)) {
+        pids.push_back(pid);
+      }
+    }
+  }
+  return pids;
+}
+
+std::optional<std::vector<ProcessInfo>> ProcScanner::scan() {
+  if (!openRoot()) {
+    return std::nullopt;
+  }
+  loadSystemInfo();
+  std::vector<int> pids = listPids();
+  std::vector<ProcessInfo> processes;
+  processes.reserve(pids.size());
+  ProcStat stat;
+  for (int pid : pids) {
+    path_buffer_ = std::to_string(pid);
+    size_t base = path_buffer_.size();
+    path_buffer_ += "/stat";
+    if (!readFileAt(root_fd_, path_buffer_.c_str(), stat_buffer_) ||
+        !parseProcStat(stat_buffer_, stat)) {
+      continue;
+    }
+    path_buffer_.resize(base);
+    path_buffer_ += "/cmdline";
+    readFileAt(root_fd_, path_buffer_.c_str(), cmdline_buffer_);
+    while (!cmdline_buffer_.empty() && cmdline_buffer_.back() == '\0') {
+      cmdline_buffer_.pop_back();
+    }
+
+    ProcessInfo info;
+    info.pid = stat.pid;
+    info.ppid = stat.ppid;
+    if (cmdline_buffer_.empty()) {
+      info.cmd = "[" + stat.comm + "]";
+    } else {
+      info.cmd = cmdline_buffer_;
+      for (char &c : info.cmd) {
+        if (c == '\0' || c == '\n' || c == '\t' || c == '\r') {
+          c = ' ';
+        }
+      }
+    }
+    info.rss_kb = stat.rss_pages * page_size_kb_;
+    info.vsz_kb = static_cast<long long>(stat.vsize / 1024);
+    double start_seconds = static_cast<double>(stat.starttime) / clock_ticks_;
+    double elapsed = uptime_seconds_ - start_seconds;
+    if (elapsed > 0.0) {
+      double cpu_seconds = static_cast<double>(stat.utime + stat.stime) / clock_ticks_;
+      info.cpu_percent = static_cast<int>(cpu_seconds * 1000.0 / elapsed) / 10.0;
+    }
+    if (mem_total_kb_ > 0) {
+      info.mem_percent = static_cast<int>(info.rss_kb * 1000.0 / mem_total_kb_) / 10.0;
+    }
+    info.etime = formatElapsed(static_cast<long long>(elapsed));
+    info.num_threads = static_cast<int>(stat.num_threads);
+    processes.push_back(std::move(info));
+  }
+  return processes;
+}
+
+} // namespace proccli
@@ -0,0 +1,133 @@
+#include "proccli/process_tree.h"
+
+#include <unordered_map>
+
+namespace proccli {
+
+namespace {
+
+struct ChildIndex {
+  std::unordered_map<int, size_t> by_pid;
+  std::vector<size_t> offsets;
+  std::vector<size_t> children;
+};
+
+ChildIndex buildChildIndex(const std::vector<ProcessInfo> &processes) {
+  ChildIndex index;
+  index.by_pid.reserve(processes.size());
+  for (size_t i = 0; i < processes.size(); ++i) {
+    index.by_pid.emplace(processes[i].pid, i);
+  }
+  std::vector<size_t> parent(processes.size(), processes.size());
+  index.offsets.assign(processes.size() + 1, 0);
+  for (size_t i = 0; i < processes.size(); ++i) {
+    auto it = index.by_pid.find(processes[i].ppid);
+    if (it != index.by_pid.end() && it->second != i) {
+      parent[i] = it->second;
+      index.offsets[it->second + 1]++;
+    }
+  }
+  for (size_t i = 0; i < processes.size(); ++i) {
+    index.offsets[i + 1] += index.offsets[i];
+  }
+  index.children.resize(index.offsets.back());
+  std::vector<size_t> cursor(index.offsets.begin(), index.offsets.end() - 1);
+  for (size_t i = 0; i < processes.size(); ++i) {
+    if (parent[i] != processes.size()) {
+      index.children[cursor[parent[i]]++] = i;
+    }
+  }
+  return index;
+}
+
+std::vector<std::pair<size_t, int>> preorder(const ChildIndex &index, size_t root, size_t count) {
+  std::vector<std::pair<size_t, int>> order;
+  std::vector<bool> visited(count, false);
+  std::vector<std::pair<size_t, int>> stack = {{root, 0}};
+  while (!stack.empty()) {
+    auto [node, depth] = stack.back();
+    stack.pop_back();
+    if (visited[node]) {
+      continue;
+    }
+    visited[node] = true;
+    order.emplace_back(node, depth);
+    for (size_t c = index.offsets[node + 1]; c > index.offsets[node]; --c) {
+      stack.emplace_back(index.children[c - 1], depth + 1);
+    }
+  }
+  return order;
+}
+
+} // namespace
+
+std::vector<int> descendantPids(const std::vector<ProcessInfo> &processes, int root_pid) {
+  std::vector<int> pids;
+  ChildIndex index = buildChildIndex(processes);
+  auto root = index.by_pid.find(root_pid);
+  if (root == index.by_pid.end()) {
+    return pids;
+  }
+  for (const auto &entry : preorder(index, root->second, processes.size())) {
+    pids.push_back(processes[entry.first].pid);
+  }
+  return pids;
+}
+
+std::optional<ProcessTree> buildProcessTree(const std::vector<ProcessInfo> &processes,
+                                            int root_pid, const std::vector<IoStats> &io) {
+  ChildIndex index = buildChildIndex(processes);
+  auto root = index.by_pid.find(root_pid);
+  if (root == index.by_pid.end()) {
+    return std::nullopt;
+  }
+  std::unordered_map<int, const IoStats *> io_by_pid;
+  io_by_pid.reserve(io.size());
+  for (const auto &stats : io) {
+    io_by_pid.emplace(stats.pid, &stats);
+  }
+
+  auto order = preorder(index, root->second, processes.size());
+  ProcessTree tree;
+  tree.root_pid = root_pid;
+  tree.nodes.reserve(order.size());
+  std::unordered_map<int, size_t> node_by_pid;
+  node_by_pid.reserve(order.size());
+  for (const auto &[position, depth] : order) {
+    const ProcessInfo &info = processes[position];
+    ProcessTreeNode node;
+    node.pid = info.pid;
+    node.ppid = info.ppid;
+    node.depth = depth;
+    node.cmd = info.cmd;
+    node.cpu_percent = info.cpu_percent;
+    node.rss_kb = info.rss_kb;
+    node.num_threads = info.num_threads;
+    auto stats = io_by_pid.find(info.pid);
+    if (stats != io_by_pid.end()) {
+      node.read_bytes = stats->second->read_bytes;
+      node.write_bytes = stats->second->write_bytes;
+    }
+    node.subtree_processes = 1;
+    node.subtree_cpu_percent = node.cpu_percent;
+    node.subtree_rss_kb = node.rss_kb;
+    node.subtree_read_bytes = node.read_bytes;
+    node.subtree_write_bytes = node.write_bytes;
+    node.subtree_threads = node.num_threads;
+    node_by_pid.emplace(node.pid, tree.nodes.size());
+    tree.nodes.push_back(std::move(node));
+  }
+  for (size_t i = tree.nodes.size(); i > 1; --i) {
+    const ProcessTreeNode &child = tree.nodes[i - 1];
+    ProcessTreeNode &parent = tree.nodes[node_by_pid.at(child.ppid)];
+    parent.subtree_processes += child.subtree_processes;
+    parent.subtree_cpu_percent += child.subtree_cpu_percent;
+    parent.subtree_rss_kb += child.subtree_rss_kb;
+    parent.subtree_read_bytes += child.subtree_read_bytes;
+    parent.subtree_write_bytes += child.subtree_write_bytes;
+    parent.subtree_threads += child.subtree_threads;
+  }
+  return tree;
+}
+
+} // namespace proccli
@@ -0,0 +1,249 @@
+#include "proccli/sampler.h"
+
+#include <cerrno>
+#include <charconv>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "proccli/proc_scanner.h"
+
+namespace proccli {
+
+namespace {
+
+bool fieldValue(std::string_view content, std::string_view key, long long &value) {
+  size_t pos = 0;
+  while (pos < content.size()) {
+    size_t end = content.find('\n', pos);
+    if (end == std::string_view::npos) {
+      end = content.size();
+    }
+    std::string_view line = content.substr(pos, end - pos);
+    pos = end + 1;
+    if (line.size() <= key.size() || line.compare(0, key.size(), key) != 0 ||
+        line[key.size()] != ':') {
+      continue;
+    }
+    line.remove_prefix(key.size() + 1);
+    while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) {
+      line.remove_prefix(1);
+    }
+    return std::from_chars(line.data(), line.data() + line.size(), value).ec == std::errc();
+  }
+  return false;
+}
+
+bool preadAll(int fd, std::string &buffer, std::string_view &content) {
+  while (true) {
+    ssize_t count = pread(fd, buffer.data(), buffer.size(), 0);
+    if (count <= 0) {
+      return false;
+    }
+    if (static_cast<size_t>(count) < buffer.size()) {
+      content = std::string_view(buffer.data(), static_cast<size_t>(count));
+      return true;
+    }
+    buffer.resize(buffer.size() * 2);
+  }
+}
+
+} // namespace
+
+bool parseStatCounters(std::string_view content, ProcCounters &counters) {
+  thread_local ProcStat stat;
+  if (!parseProcStat(content, stat) || stat.state == 'Z' || stat.state == 'X') {
+    return false;
+  }
+  counters.cpu_ticks = stat.utime + stat.stime;
+  return true;
+}
+
+bool parseStatusCounters(std::string_view content, ProcCounters &counters) {
+  bool found = fieldValue(content, "VmRSS", counters.rss_kb);
+  found |= fieldValue(content, "voluntary_ctxt_switches", counters.voluntary_ctxt);
+  found |= fieldValue(content, "nonvoluntary_ctxt_switches", counters.nonvoluntary_ctxt);
+  return found;
+}
+
+bool parseIoCounters(std::string_view content, ProcCounters &counters) {
+  bool found = fieldValue(content, "read_bytes", counters.read_bytes);
+  found |= fieldValue(content, "write_bytes", counters.write_bytes);
+  return found;
+}
+
+WatchSample computeRates(const ProcCounters &previous, const ProcCounters &current,
+                         long clock_ticks) {
+  WatchSample sample;
+  sample.rss_kb = current.rss_kb;
+  sample.rss_delta_kb = current.rss_kb - previous.rss_kb;
+  double seconds = current.timestamp_s - previous.timestamp_s;
+  if (seconds <= 0.0) {
+    return sample;
+  }
+  double ticks = static_cast<double>(current.cpu_ticks - previous.cpu_ticks);
+  sample.cpu_percent = ticks / static_cast<double>(clock_ticks) / seconds * 100.0;
+  sample.read_bytes_per_sec = (current.read_bytes - previous.read_bytes) / seconds;
+  sample.write_bytes_per_sec = (current.write_bytes - previous.write_bytes) / seconds;
+  sample.voluntary_ctxt_per_sec = (current.voluntary_ctxt - previous.voluntary_ctxt) / seconds;
+  sample.nonvoluntary_ctxt_per_sec =
+      (current.nonvoluntary_ctxt - previous.nonvoluntary_ctxt) / seconds;
+  return sample;
+}
+
+double monotonicSeconds() {
+  timespec ts{};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return static_cast<double>(ts.tv_sec) + static_cast<double>(ts.tv_nsec) / 1e9;
+}
+
+ProcfsSampler::ProcfsSampler(std::string root) : root_(std::move(root)) {}
+
+ProcfsSampler::~ProcfsSampler() {
+  for (auto &entry : entries_) {
+    closeEntry(entry);
+  }
+}
+
+void ProcfsSampler::closeEntry(Entry &entry) {
+  for (int *fd : {&entry.stat_fd, &entry.status_fd, &entry.io_fd}) {
+    if (*fd >= 0) {
+      close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+bool ProcfsSampler::add(int pid) {
+  for (const auto &entry : entries_) {
+    if (entry.pid == pid) {
+      return true;
+    }
+  }
+  std::string base = root_ + "/" + std::to_string(pid);
+  Entry entry;
+  entry.pid = pid;
+  entry.stat_fd = open((base + "/stat").c_str(), O_RDONLY | O_CLOEXEC);
+  if (entry.stat_fd < 0) {
+    return false;
+  }
+  entry.status_fd = open((base + "/status").c_str(), O_RDONLY | O_CLOEXEC);
+  entry.io_fd = open((base + "/io").c_str(), O_RDONLY | O_CLOEXEC);
+  entry.stat_buffer.resize(1024);
+  entry.status_buffer.resize(4096);
+  entry.io_buffer.resize(512);
+  entries_.push_back(std::move(entry));
+  return true;
+}
+
+void ProcfsSampler::remove(int pid) {
+  for (size_t i = 0; i < entries_.size(); ++i) {
+    if (entries_[i].pid == pid) {
+      closeEntry(entries_[i]);
+      if (i + 1 != entries_.size()) {
+        entries_[i] = std::move(entries_.back());
+      }
+      entries_.pop_back();
+      return;
+    }
+  }
+}
+
+bool ProcfsSampler::sampleEntry(Entry &entry, double timestamp, ProcCounters &counters) {
+  counters = ProcCounters{};
+  counters.timestamp_s = timestamp;
+  std::string_view stat;
+  if (!preadAll(entry.stat_fd, entry.stat_buffer, stat) || !parseStatCounters(stat, counters)) {
+    return false;
+  }
+  std::string_view content;
+  if (entry.status_fd >= 0 && preadAll(entry.status_fd, entry.status_buffer, content)) {
+    parseStatusCounters(content, counters);
+  }
+  if (entry.io_fd >= 0 && preadAll(entry.io_fd, entry.io_buffer, content)) {
+    parseIoCounters(content, counters);
+  }
+  return true;
+}
+
+void ProcfsSampler::sample(std::vector<PidCounters> &samples, std::vector<int> &exited) {
+  samples.clear();
+  exited.clear();
+  double timestamp = monotonicSeconds();
+  size_t i = 0;
+  while (i < entries_.size()) {
+    PidCounters item;
+    item.pid = entries_[i].pid;
+    if (sampleEntry(entries_[i], timestamp, item.counters)) {
+      samples.push_back(item);
+      ++i;
+      continue;
+    }
+    exited.push_back(entries_[i].pid);
+    closeEntry(entries_[i]);
+    if (i + 1 != entries_.size()) {
+      entries_[i] = std::move(entries_.back());
+    }
+    entries_.pop_back();
+  }
+}
+
+WatchSeries watchProcess(int pid, int interval_ms, int duration_ms, const WatchCallback &on_sample) {
+  WatchSeries series;
+  series.pid = pid;
+  series.interval_ms = interval_ms;
+  long clock_ticks = sysconf(_SC_CLK_TCK);
+  if (clock_ticks <= 0) {
+    clock_ticks = 100;
+  }
+
+  ProcfsSampler sampler;
+  std::vector<PidCounters> samples;
+  std::vector<int> exited;
+  if (!sampler.add(pid)) {
+    return series;
+  }
+  sampler.sample(samples, exited);
+  if (samples.empty()) {
+    return series;
+  }
+  ProcCounters previous = samples.front().counters;
+  double start = previous.timestamp_s;
+  long long interval_ns = static_cast<long long>(interval_ms) * 1000000LL;
+  timespec deadline{};
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  while (true) {
+    long long next_ns = deadline.tv_nsec + interval_ns;
+    deadline.tv_sec += static_cast<time_t>(next_ns / 1000000000LL);
+    deadline.tv_nsec = static_cast<long>(next_ns % 1000000000LL);
+    timespec now{};
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (now.tv_sec > deadline.tv_sec ||
+        (now.tv_sec == deadline.tv_sec && now.tv_nsec > deadline.tv_nsec)) {
+      deadline = now;
+    } else {
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, nullptr) == EINTR) {
+      }
+    }
+
+    sampler.sample(samples, exited);
+    if (samples.empty()) {
+      break;
+    }
+    const ProcCounters &current = samples.front().counters;
+    WatchSample sample = computeRates(previous, current, clock_ticks);
+    sample.elapsed_ms = (current.timestamp_s - start) * 1000.0;
+    series.samples.push_back(sample);
+    previous = current;
+    if (on_sample && !on_sample(sample)) {
+      break;
+    }
+    if (duration_ms > 0 && sample.elapsed_ms >= duration_ms) {
+      break;
+    }
+  }
+  return series;
+}
+
+} // namespace proccli
@@ -0,0 +1,146 @@
+#include "proccli/scheduler.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+
+#include "proccli/sampler.h"
+
+namespace proccli {
+
+namespace {
+
+enum class TaskState { Pending, Running, Done };
+
+} // namespace
+
+CancelToken::CancelToken(int deadline_ms) {
+  if (deadline_ms > 0) {
+    deadline_ = monotonicSeconds() + deadline_ms / 1000.0;
+  }
+}
+
+bool CancelToken::expired() const {
+  return deadline_ > 0.0 && monotonicSeconds() >= deadline_;
+}
+
+CollectorScheduler::CollectorScheduler(size_t max_parallel) : max_parallel_(max_parallel) {}
+
+void CollectorScheduler::add(CollectorTask task) {
+  tasks_.push_back(std::move(task));
+}
+
+std::vector<CollectorResult> CollectorScheduler::run(const std::function<bool()> &interrupted) {
+  size_t limit = max_parallel_ == 0 ? tasks_.size() : max_parallel_;
+  std::vector<CollectorResult> results(tasks_.size());
+  std::vector<TaskState> states(tasks_.size(), TaskState::Pending);
+  std::vector<std::unique_ptr<CancelToken>> tokens(tasks_.size());
+  std::vector<std::thread> threads;
+  std::mutex mutex;
+  std::condition_variable done;
+  size_t running = 0;
+  size_t finished = 0;
+  bool cancelled = false;
+
+  auto ready = [&](size_t index) {
+    for (const auto &name : tasks_[index].after) {
+      for (size_t other = 0; other < tasks_.size(); ++other) {
+        if (tasks_[other].name == name && states[other] != TaskState::Done) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+  auto execute = [&](size_t index) {
+    const auto &task = tasks_[index];
+    const CancelToken &token = *tokens[index];
+    double started = monotonicSeconds();
+    CollectorResult result;
+    try {
+      result = task.run(token);
+    } catch (const std::exception &error) {
+      result = {task.name, "failed", std::string(error.what())};
+    }
+    result.name = task.name;
+    result.wall_ms = (monotonicSeconds() - started) * 1000.0;
+    if (result.status != "failed" && result.status != "disabled" && token.cancelled()) {
+      result.status = "partial";
+      result.error = token.interrupted()
+                         ? std::string("cancelled")
+                         : "deadline of " + std::to_string(task.deadline_ms) + " ms exceeded";
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    results[index] = std::move(result);
+    states[index] = TaskState::Done;
+    --running;
+    ++finished;
+    done.notify_all();
+  };
+
+  std::unique_lock<std::mutex> lock(mutex);
+  while (finished < tasks_.size()) {
+    std::set<std::string> claimed;
+    for (size_t index = 0; index < tasks_.size(); ++index) {
+      const auto &task = tasks_[index];
+      if (states[index] == TaskState::Running && !task.exclusive.empty()) {
+        claimed.insert(task.exclusive);
+      }
+    }
+    for (size_t index = 0; index < tasks_.size() && running < limit; ++index) {
+      const auto &task = tasks_[index];
+      if (states[index] != TaskState::Pending) {
+        continue;
+      }
+      if (cancelled) {
+        results[index] = {task.name, "failed", std::string("cancelled before start")};
+        states[index] = TaskState::Done;
+        ++finished;
+        continue;
+      }
+      if (!ready(index) || (!task.exclusive.empty() && claimed.count(task.exclusive) > 0)) {
+        continue;
+      }
+      if (!task.exclusive.empty()) {
+        claimed.insert(task.exclusive);
+      }
+      states[index] = TaskState::Running;
+      tokens[index] = std::make_unique<CancelToken>(task.deadline_ms);
+      ++running;
+      threads.emplace_back(execute, index);
+    }
+    if (finished == tasks_.size()) {
+      break;
+    }
+    if (running == 0) {
+      for (size_t index = 0; index < tasks_.size(); ++index) {
+        if (states[index] == TaskState::Pending) {
+          results[index] = {tasks_[index].name, "failed", std::string("unresolved dependency")};
+          states[index] = TaskState::Done;
+          ++finished;
+        }
+      }
+      break;
+    }
+    done.wait_for(lock, std::chrono::milliseconds(100));
+    if (!cancelled && interrupted && interrupted()) {
+      cancelled = true;
+      for (size_t index = 0; index < tasks_.size(); ++index) {
+        if (states[index] == TaskState::Running) {
+          tokens[index]->cancel();
+        }
+      }
+    }
+  }
+  lock.unlock();
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  return results;
+}
+
+} // namespace proccli
@@ -0,0 +1,661 @@
+#include "proccli/snapshot_binary.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+
+#include <spdlog/spdlog.h>
+
+namespace proccli {
+
+namespace {
+
+constexpr char kMagic[8] = {'P', 'C', 'S', 'N', 'A', 'P', '\r', '\n'};
+
+struct FileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t section_count;
+  uint64_t strings_offset;
+  uint64_t string_count;
+};
+
+struct SectionEntry {
+  uint32_t id;
+  uint32_t records; // element count of the section's main list, informational only
+  uint64_t offset;
+  uint64_t size;
+};
+
+struct StringEntry {
+  uint32_t offset;
+  uint32_t length;
+};
+
+static_assert(sizeof(FileHeader) == 32, "unexpected header layout");
+static_assert(sizeof(SectionEntry) == 24, "unexpected section entry layout");
+static_assert(sizeof(StringEntry) == 8, "unexpected string entry layout");
+
+template <class T>
+struct IsOptional : std::false_type {};
+template <class T>
+struct IsOptional<std::optional<T>> : std::true_type {};
+template <class T>
+struct IsVector : std::false_type {};
+template <class T>
+struct IsVector<std::vector<T>> : std::true_type {};
+
+template <class A>
+void fields(A &ar, TargetInfo &v) {
+  ar(v.pid, v.command);
+}
+
+template <class A>
+void fields(A &ar, LoadAvg &v) {
+  ar(v.one, v.five, v.fifteen);
+}
+
+template <class A>
+void fields(A &ar, MemInfo &v) {
+  ar(v.mem_total_kb, v.mem_free_kb, v.mem_available_kb);
+}
+
+template <class A>
+void fields(A &ar, SystemInfo &v) {
+  ar(v.loadavg, v.meminfo);
+}
+
+template <class A>
+void fields(A &ar, MemoryRegion &v) {
+  ar(v.name, v.mappings, v.size_kb, v.rss_kb, v.pss_kb, v.anonymous_kb, v.shared_kb, v.private_kb,
+     v.swap_kb);
+}
+
+template <class A>
+void fields(A &ar, MemoryBreakdown &v) {
+  ar(v.pid, v.source, v.rss_kb, v.pss_kb, v.pss_anon_kb, v.pss_file_kb, v.pss_shmem_kb,
+     v.anonymous_kb, v.shared_kb, v.private_kb, v.swap_kb, v.swap_pss_kb, v.regions);
+}
+
+template <class A>
+void fields(A &ar, ProcessInfo &v) {
+  ar(v.pid, v.ppid, v.cmd, v.rss_kb, v.vsz_kb, v.cpu_percent, v.mem_percent, v.etime,
+     v.num_threads);
+}
+
+template <class A>
+void fields(A &ar, ProcessTreeNode &v) {
+  ar(v.pid, v.ppid, v.depth, v.cmd, v.cpu_percent, v.rss_kb, v.read_bytes, v.write_bytes,
+     v.num_threads, v.subtree_processes, v.subtree_cpu_percent, v.subtree_rss_kb,
+     v.subtree_read_bytes, v.subtree_write_bytes, v.subtree_threads);
+}
+
+template <class A>
+void fields(A &ar, ProcessTree &v) {
+  ar(v.root_pid, v.nodes);
+}
+
+template <class A>
+void fields(A &ar, ThreadInfo &v) {
+  ar(v.tid, v.name, v.state, v.cpu_percent, v.cpu_delta_ms, v.cpu_total_ms,
+     v.voluntary_ctxt_switches, v.nonvoluntary_ctxt_switches, v.last_cpu);
+}
+
+template <class A>
+void fields(A &ar, ValgrindError &v) {
+  ar(v.kind, v.count);
+}
+
+template <class A>
+void fields(A &ar, LeakSummary &v) {
+  ar(v.definitely_lost_kb, v.indirectly_lost_kb, v.possibly_lost_kb, v.still_reachable_kb);
+}
+
+template <class A>
+void fields(A &ar, ValgrindSite &v) {
+  ar(v.kind, v.what, v.stack, v.count, v.leaked_bytes, v.leaked_blocks);
+}
+
+template <class A>
+void fields(A &ar, ValgrindReport &v) {
+  ar(v.errors, v.leak_summary, v.sites, v.unattributed_errors);
+}
+
+template <class A>
+void fields(A &ar, HeapSnapshot &v) {
+  ar(v.index, v.time, v.heap_bytes, v.extra_bytes, v.stack_bytes);
+}
+
+template <class A>
+void fields(A &ar, HeapSite &v) {
+  ar(v.bytes, v.percent, v.stack);
+}
+
+template <class A>
+void fields(A &ar, HeapProfile &v) {
+  ar(v.command, v.time_unit, v.peak_snapshot, v.peak_heap_bytes, v.peak_extra_bytes, v.timeline,
+     v.peak_sites);
+}
+
+template <class A>
+void fields(A &ar, PerfHotspot &v) {
+  ar(v.symbol, v.percent);
+}
+
+template <class A>
+void fields(A &ar, PerfFrame &v) {
+  ar(v.symbol, v.inclusive_percent, v.exclusive_percent);
+}
+
+template <class A>
+void fields(A &ar, PerfReport &v) {
+  ar(v.event, v.samples, v.lost, v.hotspots, v.frames);
+}
+
+template <class A>
+void fields(A &ar, CounterValues &v) {
+  ar(v.tid, v.cycles, v.instructions, v.cache_references, v.cache_misses, v.branch_misses,
+     v.page_faults, v.context_switches, v.cpu_migrations, v.ipc, v.cache_miss_percent,
+     v.branch_mpki);
+}
+
+template <class A>
+void fields(A &ar, CountersReport &v) {
+  ar(v.duration_s, v.hardware, v.multiplexed, v.process, v.threads);
+}
+
+template <class A>
+void fields(A &ar, LatencyBucket &v) {
+  ar(v.lowest_us, v.count);
+}
+
+template <class A>
+void fields(A &ar, LatencySummary &v) {
+  ar(v.count, v.p50_ms, v.p90_ms, v.p99_ms, v.p999_ms, v.max_ms, v.buckets);
+}
+
+template <class A>
+void fields(A &ar, StraceSyscall &v) {
+  ar(v.name, v.count, v.time_ms, v.latency);
+}
+
+template <class A>
+void fields(A &ar, StraceSlowSyscall &v) {
+  ar(v.name, v.duration_ms);
+}
+
+template <class A>
+void fields(A &ar, StraceReport &v) {
+  ar(v.top_syscalls, v.slow_syscalls);
+}
+
+template <class A>
+void fields(A &ar, IoStats &v) {
+  ar(v.pid, v.read_bytes, v.write_bytes);
+}
+
+template <class A>
+void fields(A &ar, WatchSample &v) {
+  ar(v.elapsed_ms, v.cpu_percent, v.read_bytes_per_sec, v.write_bytes_per_sec,
+     v.voluntary_ctxt_per_sec, v.nonvoluntary_ctxt_per_sec, v.rss_kb, v.rss_delta_kb);
+}
+
+template <class A>
+void fields(A &ar, WatchSeries &v) {
+  ar(v.pid, v.interval_ms, v.samples);
+}
+
+template <class A>
+void fields(A &ar, CollectorStatus &v) {
+  ar(v.name, v.status, v.error, v.wall_ms);
+}
+
+template <class A>
+void fields(A &ar, QualityInfo &v) {
+  ar(v.collectors);
+}
+
+class StringTable {
+ public:
+  uint32_t intern(const std::string &value) {
+    auto [it, inserted] = index_.emplace(value, static_cast<uint32_t>(order_.size()));
+    if (inserted) {
+      order_.push_back(&it->first);
+    }
+    return it->second;
+  }
+
+  size_t size() const { return order_.size(); }
+
+  void append(std::string &out) const {
+    uint32_t offset = 0;
+    for (const auto *value : order_) {
+      StringEntry entry{offset, static_cast<uint32_t>(value->size())};
+      out.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+      offset += entry.length;
+    }
+    for (const auto *value : order_) {
+      out += *value;
+    }
+  }
+
+ private:
+  std::unordered_map<std::string, uint32_t> index_;
+  std::vector<const std::string *> order_;
+};
+
+// Section bodies are variable-length: vectors and optionals are written inline behind a count or
+// presence byte, so a section is decoded front to back and only whole sections load lazily.
+class Encoder {
+ public:
+  explicit Encoder(StringTable &strings) : strings_(strings) {}
+
+  template <class... Ts>
+  void operator()(const Ts &...values) {
+    (put(values), ...);
+  }
+
+  std::string take() { return std::move(out_); }
+
+ private:
+  template <class R>
+  void raw(R value) {
+    out_.append(reinterpret_cast<const char *>(&value), sizeof(value));
+  }
+
+  template <class T>
+  void put(const T &value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      raw<uint8_t>(value ? 1 : 0);
+    } else if constexpr (std::is_same_v<T, int>) {
+      raw<int32_t>(value);
+    } else if constexpr (std::is_same_v<T, long long>) {
+      raw<int64_t>(value);
+    } else if constexpr (std::is_same_v<T, double>) {
+      raw<double>(value);
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      raw<uint32_t>(strings_.intern(value));
+    } else if constexpr (IsOptional<T>::value) {
+      raw<uint8_t>(value ? 1 : 0);
+      if (value) {
+        put(*value);
+      }
+    } else if constexpr (IsVector<T>::value) {
+      raw<uint32_t>(static_cast<uint32_t>(value.size()));
+      for (const auto &item : value) {
+        put(item);
+      }
+    } else {
+      fields(*this, const_cast<T &>(value));
+    }
+  }
+
+  StringTable &strings_;
+  std::string out_;
+};
+
+class Decoder {
+ public:
+  Decoder(std::string_view body, std::string_view entries, std::string_view blob, uint64_t count)
+      : body_(body), entries_(entries), blob_(blob), count_(count) {}
+
+  template <class... Ts>
+  void operator()(Ts &...values) {
+    (get(values), ...);
+  }
+
+  bool ok() const { return ok_ && pos_ == body_.size(); }
+
+ private:
+  template <class R>
+  R raw() {
+    R value{};
+    if (!ok_ || body_.size() - pos_ < sizeof(R)) {
+      ok_ = false;
+      return value;
+    }
+    std::memcpy(&value, body_.data() + pos_, sizeof(R));
+    pos_ += sizeof(R);
+    return value;
+  }
+
+  std::string string(uint32_t index) {
+    if (index >= count_) {
+      ok_ = false;
+      return {};
+    }
+    StringEntry entry{};
+    std::memcpy(&entry, entries_.data() + static_cast<size_t>(index) * sizeof(entry), sizeof(entry));
+    if (entry.offset > blob_.size() || blob_.size() - entry.offset < entry.length) {
+      ok_ = false;
+      return {};
+    }
+    return std::string(blob_.substr(entry.offset, entry.length));
+  }
+
+  template <class T>
+  void get(T &value) {
+    if constexpr (std::is_same_v<T, bool>) {
+      value = raw<uint8_t>() != 0;
+    } else if constexpr (std::is_same_v<T, int>) {
+      value = raw<int32_t>();
+    } else if constexpr (std::is_same_v<T, long long>) {
+      value = raw<int64_t>();
+    } else if constexpr (std::is_same_v<T, double>) {
+      value = raw<double>();
+    } else if constexpr (std::is_same_v<T, std::string>) {
+      value = string(raw<uint32_t>());
+    } else if constexpr (IsOptional<T>::value) {
+      value.reset();
+      if (raw<uint8_t>() != 0) {
+        get(value.emplace());
+      }
+    } else if constexpr (IsVector<T>::value) {
+      auto count = raw<uint32_t>();
+      value.clear();
+      if (count > body_.size() - pos_) {
+        ok_ = false;
+        return;
+      }
+      value.reserve(count);
+      for (uint32_t i = 0; i < count && ok_; ++i) {
+        get(value.emplace_back());
+      }
+    } else {
+      fields(*this, value);
+    }
+  }
+
+  std::string_view body_;
+  std::string_view entries_;
+  std::string_view blob_;
+  uint64_t count_ = 0;
+  size_t pos_ = 0;
+  bool ok_ = true;
+};
+
+uint32_t recordCount(size_t count) {
+  return static_cast<uint32_t>(count);
+}
+
+} // namespace
+
+bool isSnapshotBinary(std::string_view data) {
+  return data.size() >= sizeof(kMagic) && std::memcmp(data.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+std::string encodeSnapshotBinary(const DiagnosticsSnapshot &snapshot) {
+  StringTable strings;
+  std::vector<std::pair<SectionEntry, std::string>> sections;
+  auto add = [&](SnapshotSection id, uint32_t records, const auto &...values) {
+    Encoder encoder(strings);
+    encoder(values...);
+    sections.push_back({SectionEntry{static_cast<uint32_t>(id), records, 0, 0}, encoder.take()});
+  };
+  add(SnapshotSection::Meta, 1, snapshot.version, snapshot.timing.captured_at);
+  add(SnapshotSection::Target, 1, snapshot.target);
+  add(SnapshotSection::System, 1, snapshot.system);
+  add(SnapshotSection::Processes, recordCount(snapshot.processes.size()), snapshot.processes);
+  if (snapshot.process_tree) {
+    add(SnapshotSection::ProcessTree, recordCount(snapshot.process_tree->nodes.size()),
+        *snapshot.process_tree);
+  }
+  add(SnapshotSection::Threads, recordCount(snapshot.threads.size()), snapshot.threads);
+  if (snapshot.memory) {
+    add(SnapshotSection::Memory, recordCount(snapshot.memory->regions.size()), *snapshot.memory);
+  }
+  if (snapshot.valgrind) {
+    add(SnapshotSection::Valgrind, recordCount(snapshot.valgrind->sites.size()),
+        *snapshot.valgrind);
+  }
+  if (snapshot.heap_profile) {
+    add(SnapshotSection::HeapProfile, recordCount(snapshot.heap_profile->timeline.size()),
+        *snapshot.heap_profile);
+  }
+  if (snapshot.perf) {
+    add(SnapshotSection::Perf, recordCount(snapshot.perf->frames.size()), *snapshot.perf);
+  }
+  if (snapshot.counters) {
+    add(SnapshotSection::Counters, recordCount(snapshot.counters->threads.size()),
+        *snapshot.counters);
+  }
+  if (snapshot.strace) {
+    add(SnapshotSection::Strace, recordCount(snapshot.strace->top_syscalls.size()),
+        *snapshot.strace);
+  }
+  add(SnapshotSection::Io, recordCount(snapshot.io.size()), snapshot.io);
+  if (snapshot.watch) {
+    add(SnapshotSection::Watch, recordCount(snapshot.watch->samples.size()), *snapshot.watch);
+  }
+  add(SnapshotSection::Quality, recordCount(snapshot.quality.collectors.size()),
+      snapshot.quality);
+
+  uint64_t offset = sizeof(FileHeader) + sections.size() * sizeof(SectionEntry);
+  for (auto &section : sections) {
+    offset = (offset + 7) & ~uint64_t{7};
+    section.first.offset = offset;
+    section.first.size = section.second.size();
+    offset += section.second.size();
+  }
+  offset = (offset + 7) & ~uint64_t{7};
+
+  FileHeader header{};
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kSnapshotBinaryVersion;
+  header.section_count = static_cast<uint32_t>(sections.size());
+  header.strings_offset = offset;
+  header.string_count = strings.size();
+
+  std::string out;
+  out.reserve(offset + strings.size() * sizeof(StringEntry));
+  out.append(reinterpret_cast<const char *>(&header), sizeof(header));
+  for (const auto &section : sections) {
+    out.append(reinterpret_cast<const char *>(&section.first), sizeof(section.first));
+  }
+  for (const auto &section : sections) {
+    out.resize(section.first.offset, '\0');
+    out += section.second;
+  }
+  out.resize(offset, '\0');
+  strings.append(out);
+  return out;
+}
+
+bool writeSnapshotBinary(const std::string &path, const DiagnosticsSnapshot &snapshot,
+                         std::string &error) {
+  std::string data = encodeSnapshotBinary(snapshot);
+  std::string temp = path + ".tmp";
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    file.write(data.data(), static_cast<std::streamsize>(data.size()));
+    if (!file) {
+      error = "cannot write " + temp;
+      return false;
+    }
+  }
+  if (std::rename(temp.c_str(), path.c_str()) != 0) {
+    error = "cannot rename " + temp + ": " + std::strerror(errno);
+    std::remove(temp.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool SnapshotReader::open(const std::string &path, std::string &error) {
+  if (!file_.open(path, error)) {
+    return false;
+  }
+  return attach(file_.view(), error);
+}
+
+bool SnapshotReader::attach(std::string_view data, std::string &error) {
+  sections_.clear();
+  data_ = data;
+  if (!isSnapshotBinary(data) || data.size() < sizeof(FileHeader)) {
+    error = "not a binary snapshot";
+    return false;
+  }
+  FileHeader header{};
+  std::memcpy(&header, data.data(), sizeof(header));
+  if (header.version != kSnapshotBinaryVersion) {
+    error = "unsupported binary snapshot version " + std::to_string(header.version);
+    return false;
+  }
+  if ((data.size() - sizeof(header)) / sizeof(SectionEntry) < header.section_count) {
+    error = "truncated section table";
+    return false;
+  }
+  for (uint32_t i = 0; i < header.section_count; ++i) {
+    SectionEntry entry{};
+    std::memcpy(&entry, data.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+    if (entry.offset > data.size() || data.size() - entry.offset < entry.size) {
+      error = "section " + std::to_string(entry.id) + " is out of bounds";
+      return false;
+    }
+    sections_.push_back({entry.id, entry.records, data.substr(entry.offset, entry.size)});
+  }
+  if (header.strings_offset > data.size() ||
+      (data.size() - header.strings_offset) / sizeof(StringEntry) < header.string_count) {
+    error = "string table is out of bounds";
+    return false;
+  }
+  string_count_ = header.string_count;
+  string_entries_ = data.substr(header.strings_offset, header.string_count * sizeof(StringEntry));
+  string_blob_ = data.substr(header.strings_offset + string_entries_.size());
+  return true;
+}
+
+const SnapshotReader::Section *SnapshotReader::find(SnapshotSection section) const {
+  for (const auto &entry : sections_) {
+    if (entry.id == static_cast<uint32_t>(section)) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+bool SnapshotReader::has(SnapshotSection section) const {
+  return find(section) != nullptr;
+}
+
+size_t SnapshotReader::records(SnapshotSection section) const {
+  const Section *entry = find(section);
+  return entry == nullptr ? 0 : entry->records;
+}
+
+bool SnapshotReader::readSection(const Section &section, DiagnosticsSnapshot &snapshot,
+                                 std::string &error) const {
+  Decoder decoder(section.body, string_entries_, string_blob_, string_count_);
+  switch (static_cast<SnapshotSection>(section.id)) {
+    case SnapshotSection::Meta:
+      decoder(snapshot.version, snapshot.timing.captured_at);
+      break;
+    case SnapshotSection::Target:
+      decoder(snapshot.target);
+      break;
+    case SnapshotSection::System:
+      decoder(snapshot.system);
+      break;
+    case SnapshotSection::Processes:
+      decoder(snapshot.processes);
+      break;
+    case SnapshotSection::ProcessTree:
+      decoder(snapshot.process_tree.emplace());
+      break;
+    case SnapshotSection::Threads:
+      decoder(snapshot.threads);
+      break;
+    case SnapshotSection::Memory:
+      decoder(snapshot.memory.emplace());
+      break;
+    case SnapshotSection::Valgrind:
+      decoder(snapshot.valgrind.emplace());
+      break;
+    case SnapshotSection::HeapProfile:
+      decoder(snapshot.heap_profile.emplace());
+      break;
+    case SnapshotSection::Perf:
+      decoder(snapshot.perf.emplace());
+      break;
+    case SnapshotSection::Counters:
+      decoder(snapshot.counters.emplace());
+      break;
+    case SnapshotSection::Strace:
+      decoder(snapshot.strace.emplace());
+      break;
+    case SnapshotSection::Io:
+      decoder(snapshot.io);
+      break;
+    case SnapshotSection::Watch:
+      decoder(snapshot.watch.emplace());
+      break;
+    case SnapshotSection::Quality:
+      decoder(snapshot.quality);
+      break;
+    default:
+      return true;
+  }
+  if (!decoder.ok()) {
+    error = "section " + std::to_string(section.id) + " is corrupt";
+    return false;
+  }
+  return true;
+}
+
+bool SnapshotReader::read(DiagnosticsSnapshot &snapshot,
+                          std::initializer_list<SnapshotSection> sections,
+                          std::string &error) const {
+  for (auto id : sections) {
+    const Section *section = find(id);
+    if (section != nullptr && !readSection(*section, snapshot, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool SnapshotReader::readAll(DiagnosticsSnapshot &snapshot, std::string &error) const {
+  for (const auto &section : sections_) {
+    if (!readSection(section, snapshot, error)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::optional<DiagnosticsSnapshot> loadSnapshot(const std::string &dir,
+                                                std::initializer_list<SnapshotSection> sections) {
+  namespace fs = std::filesystem;
+  std::error_code bin_ec;
+  std::error_code json_ec;
+  auto bin_time = fs::last_write_time(dir + "/normalized.bin", bin_ec);
+  auto json_time = fs::last_write_time(dir + "/normalized.json", json_ec);
+  if (!bin_ec && (json_ec || bin_time >= json_time)) {
+    SnapshotReader reader;
+    DiagnosticsSnapshot snapshot;
+    std::string error;
+    bool loaded = reader.open(dir + "/normalized.bin", error) &&
+                  (sections.size() == 0 ? reader.readAll(snapshot, error)
+                                        : reader.read(snapshot, sections, error));
+    if (loaded) {
+      return snapshot;
+    }
+    spdlog::warn("ignoring normalized.bin: {}", error);
+  }
+  auto content = readFile(dir + "/normalized.json");
+  if (content.empty()) {
+    return std::nullopt;
+  }
+  auto json = nlohmann::json::parse(content, nullptr, false);
+  if (json.is_discarded()) {
+    return std::nullopt;
+  }
+  return snapshotFromJson(json);
+}
+
+} // namespace proccli
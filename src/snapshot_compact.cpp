@@ -0,0 +1,573 @@
+#include "proccli/snapshot_compact.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <type_traits>
+
+namespace proccli {
+
+namespace {
+
+constexpr size_t kBytesPerToken = 3;
+constexpr size_t kItemSeparatorTokens = 1;
+constexpr size_t kSectionOverheadTokens = 2;
+constexpr size_t kOmittedSlackTokens = 4;
+
+struct Slice {
+  std::string key;
+  double weight = 0.0;
+  size_t total = 0;
+  std::vector<nlohmann::json> items;
+  std::vector<size_t> costs;
+  std::function<nlohmann::json(size_t kept)> omitted;
+  size_t reserve = 0;
+  size_t demand = 0;
+  size_t granted = 0;
+  size_t kept = 0;
+};
+
+struct Section {
+  std::string name;
+  bool required = false;
+  nlohmann::json base;
+  std::vector<Slice> slices;
+  size_t cost = 0;
+  bool dropped = false;
+};
+
+size_t jsonTokens(const nlohmann::json &value) {
+  return estimateTokens(value.dump());
+}
+
+double rounded(double value) {
+  return std::round(value * 100.0) / 100.0;
+}
+
+std::string clipped(const std::string &text, size_t limit) {
+  if (text.size() <= limit) {
+    return text;
+  }
+  while (limit > 0 && (static_cast<unsigned char>(text[limit]) & 0xC0) == 0x80) {
+    --limit;
+  }
+  return text.substr(0, limit) + "...";
+}
+
+template <typename T, typename Better>
+std::vector<const T *> rankBy(const std::vector<T> &values, Better better) {
+  std::vector<const T *> order;
+  order.reserve(values.size());
+  for (const auto &value : values) {
+    order.push_back(&value);
+  }
+  std::stable_sort(order.begin(), order.end(),
+                   [&](const T *a, const T *b) { return better(*a, *b); });
+  return order;
+}
+
+template <typename Iterator, typename T, typename Value>
+auto sumOf(Iterator first, Iterator last, Value T::*field) {
+  std::conditional_t<std::is_integral_v<Value>, long long, Value> total{};
+  for (; first != last; ++first) {
+    total += (*first)->*field;
+  }
+  return total;
+}
+
+template <typename T>
+std::vector<T> downsample(const std::vector<T> &values, size_t limit) {
+  if (values.size() <= limit) {
+    return values;
+  }
+  if (limit < 2) {
+    return limit == 0 ? std::vector<T>{} : std::vector<T>{values.back()};
+  }
+  std::vector<T> result;
+  result.reserve(limit);
+  for (size_t index = 0; index < limit; ++index) {
+    result.push_back(values[index * (values.size() - 1) / (limit - 1)]);
+  }
+  return result;
+}
+
+template <typename T, typename ToItem, typename Summarize>
+Slice makeSlice(std::string key, double weight, std::vector<const T *> order, size_t cap,
+                ToItem to_item, Summarize summarize) {
+  Slice slice;
+  slice.key = std::move(key);
+  slice.weight = weight;
+  slice.total = order.size();
+  for (const T *value : order) {
+    if (slice.demand > cap) {
+      break;
+    }
+    nlohmann::json item = to_item(*value);
+    size_t cost = jsonTokens(item) + kItemSeparatorTokens;
+    slice.demand += cost;
+    slice.costs.push_back(cost);
+    slice.items.push_back(std::move(item));
+  }
+  slice.omitted = [order = std::move(order), summarize](size_t kept) {
+    nlohmann::json rest = summarize(order.cbegin() + static_cast<std::ptrdiff_t>(kept),
+                                    order.cend());
+    rest["count"] = order.size() - kept;
+    return rest;
+  };
+  slice.reserve = jsonTokens(slice.omitted(0)) + estimateTokens(slice.key) + kOmittedSlackTokens;
+  return slice;
+}
+
+template <typename T>
+nlohmann::json withTruncatedStack(T value, size_t max_frames) {
+  size_t frames = value.stack.size();
+  if (frames > max_frames) {
+    value.stack.resize(max_frames);
+  }
+  nlohmann::json item = value;
+  if (frames > max_frames) {
+    item["stack_frames_omitted"] = frames - max_frames;
+  }
+  return item;
+}
+
+std::vector<const ProcessInfo *> processOrder(const std::vector<ProcessInfo> &processes,
+                                              std::optional<int> target_pid) {
+  auto by_cpu = rankBy(processes, [](const ProcessInfo &a, const ProcessInfo &b) {
+    return a.cpu_percent > b.cpu_percent;
+  });
+  auto by_rss = rankBy(processes, [](const ProcessInfo &a, const ProcessInfo &b) {
+    return a.rss_kb > b.rss_kb;
+  });
+  std::vector<const ProcessInfo *> order;
+  order.reserve(processes.size());
+  std::vector<bool> taken(processes.size(), false);
+  auto take = [&](const ProcessInfo *process) {
+    size_t index = static_cast<size_t>(process - processes.data());
+    if (!taken[index]) {
+      taken[index] = true;
+      order.push_back(process);
+    }
+  };
+  if (target_pid) {
+    for (const auto &process : processes) {
+      if (process.pid == *target_pid) {
+        take(&process);
+      }
+    }
+  }
+  for (size_t index = 0; index < processes.size(); ++index) {
+    take(by_cpu[index]);
+    take(by_rss[index]);
+  }
+  return order;
+}
+
+std::vector<Section> buildSections(const DiagnosticsSnapshot &snapshot,
+                                   const CompactOptions &options) {
+  size_t cap = options.token_budget;
+  size_t max_frames = options.max_stack_frames;
+  std::vector<Section> sections;
+  sections.reserve(16);
+  auto add = [&](std::string name, nlohmann::json base, bool required = false) -> Section & {
+    sections.push_back({std::move(name), required, std::move(base), {}, 0, false});
+    return sections.back();
+  };
+
+  add("target", snapshot.target, true);
+  nlohmann::json issues = nlohmann::json::array();
+  nlohmann::json ok = nlohmann::json::array();
+  for (const auto &collector : snapshot.quality.collectors) {
+    if (collector.status == "ok") {
+      ok.push_back(collector.name);
+    } else {
+      issues.push_back(collector);
+    }
+  }
+  add("quality", {{"issues", issues}, {"ok", ok}}, true);
+  add("system", snapshot.system, true);
+  add("timing", snapshot.timing, true);
+
+  if (snapshot.process_tree) {
+    const auto &tree = *snapshot.process_tree;
+    auto &section = add("process_tree", {{"root_pid", tree.root_pid}});
+    auto order = rankBy(tree.nodes, [](const ProcessTreeNode &a, const ProcessTreeNode &b) {
+      if ((a.depth == 0) != (b.depth == 0)) {
+        return a.depth == 0;
+      }
+      if (a.subtree_cpu_percent != b.subtree_cpu_percent) {
+        return a.subtree_cpu_percent > b.subtree_cpu_percent;
+      }
+      return a.subtree_rss_kb > b.subtree_rss_kb;
+    });
+    section.slices.push_back(makeSlice(
+        "nodes", 6.0, std::move(order), cap,
+        [&options](ProcessTreeNode node) {
+          node.cmd = clipped(node.cmd, options.max_command_chars);
+          return nlohmann::json(node);
+        },
+        [](auto first, auto last) {
+          return nlohmann::json{
+              {"cpu_percent", rounded(sumOf(first, last, &ProcessTreeNode::cpu_percent))},
+              {"rss_kb", sumOf(first, last, &ProcessTreeNode::rss_kb)}};
+        }));
+  }
+
+  if (snapshot.perf) {
+    const auto &perf = *snapshot.perf;
+    auto &section =
+        add("perf", {{"event", perf.event}, {"samples", perf.samples}, {"lost", perf.lost}});
+    section.slices.push_back(makeSlice(
+        "hotspots", 6.0,
+        rankBy(perf.hotspots,
+               [](const PerfHotspot &a, const PerfHotspot &b) { return a.percent > b.percent; }),
+        cap, [](const PerfHotspot &hotspot) { return nlohmann::json(hotspot); },
+        [](auto first, auto last) {
+          return nlohmann::json{{"percent", rounded(sumOf(first, last, &PerfHotspot::percent))}};
+        }));
+    if (!perf.frames.empty()) {
+      section.slices.push_back(makeSlice(
+          "frames", 2.0,
+          rankBy(perf.frames,
+                 [](const PerfFrame &a, const PerfFrame &b) {
+                   return a.inclusive_percent > b.inclusive_percent;
+                 }),
+          cap, [](const PerfFrame &frame) { return nlohmann::json(frame); },
+          [](auto, auto) { return nlohmann::json::object(); }));
+    }
+  }
+
+  if (snapshot.strace) {
+    const auto &strace = *snapshot.strace;
+    auto &section = add("strace", nlohmann::json::object());
+    section.slices.push_back(makeSlice(
+        "top_syscalls", 5.0,
+        rankBy(strace.top_syscalls,
+               [](const StraceSyscall &a, const StraceSyscall &b) {
+                 if (a.time_ms != b.time_ms) {
+                   return a.time_ms > b.time_ms;
+                 }
+                 return a.count > b.count;
+               }),
+        cap,
+        [](const StraceSyscall &syscall) {
+          nlohmann::json item = syscall;
+          if (auto latency = item.find("latency"); latency != item.end()) {
+            latency->erase("buckets");
+          }
+          return item;
+        },
+        [](auto first, auto last) {
+          return nlohmann::json{{"calls", sumOf(first, last, &StraceSyscall::count)},
+                                {"time_ms", rounded(sumOf(first, last, &StraceSyscall::time_ms))}};
+        }));
+    section.slices.push_back(makeSlice(
+        "slow_syscalls", 2.0,
+        rankBy(strace.slow_syscalls,
+               [](const StraceSlowSyscall &a, const StraceSlowSyscall &b) {
+                 return a.duration_ms > b.duration_ms;
+               }),
+        cap, [](const StraceSlowSyscall &syscall) { return nlohmann::json(syscall); },
+        [](auto first, auto last) {
+          return nlohmann::json{
+              {"duration_ms", rounded(sumOf(first, last, &StraceSlowSyscall::duration_ms))}};
+        }));
+  }
+
+  if (!snapshot.processes.empty()) {
+    double cpu = 0.0;
+    long long rss_kb = 0;
+    for (const auto &process : snapshot.processes) {
+      cpu += process.cpu_percent;
+      rss_kb += process.rss_kb;
+    }
+    auto &section = add("processes", {{"count", snapshot.processes.size()},
+                                      {"cpu_percent", rounded(cpu)},
+                                      {"rss_kb", rss_kb}});
+    section.slices.push_back(makeSlice(
+        "entries", 4.0, processOrder(snapshot.processes, snapshot.target.pid), cap,
+        [&options](ProcessInfo process) {
+          process.cmd = clipped(process.cmd, options.max_command_chars);
+          return nlohmann::json(process);
+        },
+        [](auto first, auto last) {
+          return nlohmann::json{
+              {"cpu_percent", rounded(sumOf(first, last, &ProcessInfo::cpu_percent))},
+              {"rss_kb", sumOf(first, last, &ProcessInfo::rss_kb)}};
+        }));
+  }
+
+  if (snapshot.valgrind) {
+    nlohmann::json base = *snapshot.valgrind;
+    base.erase("sites");
+    auto &section = add("valgrind", std::move(base));
+    section.slices.push_back(makeSlice(
+        "sites", 3.0,
+        rankBy(snapshot.valgrind->sites,
+               [](const ValgrindSite &a, const ValgrindSite &b) {
+                 if (a.leaked_bytes != b.leaked_bytes) {
+                   return a.leaked_bytes > b.leaked_bytes;
+                 }
+                 return a.count > b.count;
+               }),
+        cap,
+        [max_frames](const ValgrindSite &site) { return withTruncatedStack(site, max_frames); },
+        [](auto first, auto last) {
+          return nlohmann::json{{"occurrences", sumOf(first, last, &ValgrindSite::count)},
+                                {"leaked_bytes", sumOf(first, last, &ValgrindSite::leaked_bytes)}};
+        }));
+  }
+
+  if (snapshot.memory) {
+    nlohmann::json base = *snapshot.memory;
+    base.erase("regions");
+    auto &section = add("memory", std::move(base));
+    section.slices.push_back(makeSlice(
+        "regions", 2.0,
+        rankBy(snapshot.memory->regions,
+               [](const MemoryRegion &a, const MemoryRegion &b) { return a.rss_kb > b.rss_kb; }),
+        cap, [](const MemoryRegion &region) { return nlohmann::json(region); },
+        [](auto first, auto last) {
+          return nlohmann::json{{"rss_kb", sumOf(first, last, &MemoryRegion::rss_kb)},
+                                {"pss_kb", sumOf(first, last, &MemoryRegion::pss_kb)}};
+        }));
+  }
+
+  if (snapshot.heap_profile) {
+    const auto &heap = *snapshot.heap_profile;
+    nlohmann::json base = heap;
+    base.erase("peak_sites");
+    base["timeline"] = downsample(heap.timeline, options.max_series_points);
+    auto &section = add("heap_profile", std::move(base));
+    section.slices.push_back(makeSlice(
+        "peak_sites", 2.0,
+        rankBy(heap.peak_sites,
+               [](const HeapSite &a, const HeapSite &b) { return a.bytes > b.bytes; }),
+        cap, [max_frames](const HeapSite &site) { return withTruncatedStack(site, max_frames); },
+        [](auto first, auto last) {
+          return nlohmann::json{{"bytes", sumOf(first, last, &HeapSite::bytes)},
+                                {"percent", rounded(sumOf(first, last, &HeapSite::percent))}};
+        }));
+  }
+
+  if (!snapshot.threads.empty()) {
+    double cpu = 0.0;
+    for (const auto &thread : snapshot.threads) {
+      cpu += thread.cpu_percent;
+    }
+    auto &section =
+        add("threads", {{"count", snapshot.threads.size()}, {"cpu_percent", rounded(cpu)}});
+    section.slices.push_back(makeSlice(
+        "entries", 2.0,
+        rankBy(snapshot.threads,
+               [](const ThreadInfo &a, const ThreadInfo &b) {
+                 if (a.cpu_percent != b.cpu_percent) {
+                   return a.cpu_percent > b.cpu_percent;
+                 }
+                 return a.nonvoluntary_ctxt_switches > b.nonvoluntary_ctxt_switches;
+               }),
+        cap, [](const ThreadInfo &thread) { return nlohmann::json(thread); },
+        [](auto first, auto last) {
+          return nlohmann::json{
+              {"cpu_percent", rounded(sumOf(first, last, &ThreadInfo::cpu_percent))}};
+        }));
+  }
+
+  if (snapshot.counters) {
+    nlohmann::json base = *snapshot.counters;
+    base.erase("threads");
+    auto &section = add("counters", std::move(base));
+    if (!snapshot.counters->threads.empty()) {
+      section.slices.push_back(makeSlice(
+          "threads", 1.0,
+          rankBy(snapshot.counters->threads,
+                 [](const CounterValues &a, const CounterValues &b) {
+                   if (a.cycles.value_or(0) != b.cycles.value_or(0)) {
+                     return a.cycles.value_or(0) > b.cycles.value_or(0);
+                   }
+                   return a.context_switches > b.context_switches;
+                 }),
+          cap, [](const CounterValues &values) { return nlohmann::json(values); },
+          [](auto first, auto last) {
+            return nlohmann::json{
+                {"context_switches", sumOf(first, last, &CounterValues::context_switches)}};
+          }));
+    }
+  }
+
+  if (!snapshot.io.empty()) {
+    long long read_bytes = 0;
+    long long write_bytes = 0;
+    for (const auto &io : snapshot.io) {
+      read_bytes += io.read_bytes;
+      write_bytes += io.write_bytes;
+    }
+    auto &section = add("io", {{"count", snapshot.io.size()},
+                               {"read_bytes", read_bytes},
+                               {"write_bytes", write_bytes}});
+    section.slices.push_back(makeSlice(
+        "entries", 2.0,
+        rankBy(snapshot.io,
+               [](const IoStats &a, const IoStats &b) {
+                 return a.read_bytes + a.write_bytes > b.read_bytes + b.write_bytes;
+               }),
+        cap, [](const IoStats &io) { return nlohmann::json(io); },
+        [](auto first, auto last) {
+          return nlohmann::json{{"read_bytes", sumOf(first, last, &IoStats::read_bytes)},
+                                {"write_bytes", sumOf(first, last, &IoStats::write_bytes)}};
+        }));
+  }
+
+  if (snapshot.watch) {
+    const auto &watch = *snapshot.watch;
+    add("watch", {{"pid", watch.pid},
+                  {"interval_ms", watch.interval_ms},
+                  {"sample_count", watch.samples.size()},
+                  {"samples", downsample(watch.samples, options.max_series_points)}});
+  }
+  return sections;
+}
+
+void allocate(std::vector<Section> &sections, size_t available) {
+  std::vector<Slice *> open;
+  std::vector<Slice *> by_weight;
+  for (auto &section : sections) {
+    if (section.dropped) {
+      continue;
+    }
+    for (auto &slice : section.slices) {
+      by_weight.push_back(&slice);
+      if (slice.demand > 0) {
+        open.push_back(&slice);
+      }
+    }
+  }
+
+  size_t remaining = available;
+  while (!open.empty()) {
+    double weight = 0.0;
+    for (const Slice *slice : open) {
+      weight += slice->weight;
+    }
+    std::vector<Slice *> unmet;
+    size_t granted = 0;
+    for (Slice *slice : open) {
+      double share = static_cast<double>(remaining) * slice->weight / weight;
+      if (static_cast<double>(slice->demand) <= share) {
+        slice->granted = slice->demand;
+        granted += slice->demand;
+      } else {
+        unmet.push_back(slice);
+      }
+    }
+    if (unmet.size() == open.size()) {
+      for (Slice *slice : open) {
+        double share = static_cast<double>(remaining) * slice->weight / weight;
+        slice->granted = static_cast<size_t>(share);
+      }
+      break;
+    }
+    remaining -= granted;
+    open = std::move(unmet);
+  }
+
+  std::stable_sort(by_weight.begin(), by_weight.end(),
+                   [](const Slice *a, const Slice *b) { return a->weight > b->weight; });
+  size_t granted = 0;
+  size_t used = 0;
+  for (Slice *slice : by_weight) {
+    granted += slice->granted;
+    while (slice->kept < slice->items.size() &&
+           used + slice->costs[slice->kept] <= granted) {
+      used += slice->costs[slice->kept++];
+    }
+  }
+  size_t leftover = available > used ? available - used : 0;
+  for (Slice *slice : by_weight) {
+    while (slice->kept < slice->items.size() && slice->costs[slice->kept] <= leftover) {
+      leftover -= slice->costs[slice->kept++];
+    }
+  }
+}
+
+} // namespace
+
+size_t estimateTokens(std::string_view text) {
+  return (text.size() + kBytesPerToken - 1) / kBytesPerToken;
+}
+
+CompactSnapshot compactSnapshot(const DiagnosticsSnapshot &snapshot,
+                                const CompactOptions &options) {
+  auto sections = buildSections(snapshot, options);
+  nlohmann::json version = {{"version", snapshot.version}};
+  size_t fixed = jsonTokens(version);
+  for (auto &section : sections) {
+    section.cost = jsonTokens(section.base) + estimateTokens(section.name) + kSectionOverheadTokens;
+    for (const auto &slice : section.slices) {
+      section.cost += estimateTokens(slice.key) + kSectionOverheadTokens + slice.reserve;
+    }
+    fixed += section.cost;
+  }
+  nlohmann::json omitted_sections = nlohmann::json::array();
+  for (auto it = sections.rbegin(); it != sections.rend() && fixed > options.token_budget; ++it) {
+    if (it->required) {
+      continue;
+    }
+    it->dropped = true;
+    fixed -= it->cost;
+    fixed += estimateTokens(it->name) + kSectionOverheadTokens;
+    omitted_sections.push_back(it->name);
+  }
+  allocate(sections, options.token_budget > fixed ? options.token_budget - fixed : 0);
+
+  CompactSnapshot compact;
+  compact.payload = std::move(version);
+  for (auto &section : sections) {
+    CompactSection summary;
+    summary.name = section.name;
+    summary.dropped = section.dropped;
+    if (section.dropped) {
+      compact.sections.push_back(std::move(summary));
+      continue;
+    }
+    for (auto &slice : section.slices) {
+      nlohmann::json items = nlohmann::json::array();
+      for (size_t index = 0; index < slice.kept; ++index) {
+        items.push_back(std::move(slice.items[index]));
+      }
+      section.base[slice.key] = std::move(items);
+      if (slice.kept < slice.total) {
+        section.base[slice.key + "_omitted"] = slice.omitted(slice.kept);
+      }
+      summary.kept += slice.kept;
+      summary.omitted += slice.total - slice.kept;
+    }
+    summary.tokens = jsonTokens(section.base);
+    compact.payload[section.name] = std::move(section.base);
+    compact.sections.push_back(std::move(summary));
+  }
+  if (!omitted_sections.empty()) {
+    compact.payload["omitted_sections"] = std::move(omitted_sections);
+  }
+  compact.tokens = jsonTokens(compact.payload);
+  return compact;
+}
+
+std::string formatCompactSummary(const CompactSnapshot &compact) {
+  std::string text;
+  std::string dropped;
+  for (const auto &section : compact.sections) {
+    if (section.dropped) {
+      dropped += (dropped.empty() ? "" : ", ") + section.name;
+    } else if (section.kept + section.omitted > 0) {
+      text += (text.empty() ? "" : ", ") + section.name + " " + std::to_string(section.kept) +
+              "/" + std::to_string(section.kept + section.omitted);
+    }
+  }
+  if (!dropped.empty()) {
+    text += (text.empty() ? "dropped " : "; dropped ") + dropped;
+  }
+  return text;
+}
+
+} // namespace proccli
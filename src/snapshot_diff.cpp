@@ -0,0 +1,311 @@
+#include "proccli/snapshot_diff.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <unordered_map>
+
+#include "proccli/history.h"
+
+namespace proccli {
+
+namespace {
+
+struct ProcessTotals {
+  double cpu_percent = 0.0;
+  double rss_kb = 0.0;
+  double read_bytes = 0.0;
+  double write_bytes = 0.0;
+  double instances = 0.0;
+};
+
+struct SyscallTotals {
+  double count = 0.0;
+  double time_ms = 0.0;
+  double p99_ms = 0.0;
+};
+
+std::unordered_map<std::string_view, ProcessTotals> processesByCommand(
+    const DiagnosticsSnapshot &snapshot) {
+  std::unordered_map<int, const IoStats *> io;
+  io.reserve(snapshot.io.size());
+  for (const auto &stats : snapshot.io) {
+    io.emplace(stats.pid, &stats);
+  }
+  std::unordered_map<std::string_view, ProcessTotals> totals;
+  totals.reserve(snapshot.processes.size());
+  for (const auto &process : snapshot.processes) {
+    auto &entry = totals[process.cmd];
+    entry.cpu_percent += process.cpu_percent;
+    entry.rss_kb += process.rss_kb;
+    entry.instances += 1.0;
+    if (auto it = io.find(process.pid); it != io.end()) {
+      entry.read_bytes += static_cast<double>(it->second->read_bytes);
+      entry.write_bytes += static_cast<double>(it->second->write_bytes);
+    }
+  }
+  return totals;
+}
+
+std::unordered_map<std::string_view, double> hotspotsBySymbol(const DiagnosticsSnapshot &snapshot) {
+  std::unordered_map<std::string_view, double> hotspots;
+  if (!snapshot.perf) {
+    return hotspots;
+  }
+  if (!snapshot.perf->hotspots.empty()) {
+    hotspots.reserve(snapshot.perf->hotspots.size());
+    for (const auto &hotspot : snapshot.perf->hotspots) {
+      hotspots[hotspot.symbol] += hotspot.percent;
+    }
+    return hotspots;
+  }
+  hotspots.reserve(snapshot.perf->frames.size());
+  for (const auto &frame : snapshot.perf->frames) {
+    hotspots[frame.symbol] += frame.exclusive_percent;
+  }
+  return hotspots;
+}
+
+std::unordered_map<std::string_view, SyscallTotals> syscallsByName(
+    const DiagnosticsSnapshot &snapshot) {
+  std::unordered_map<std::string_view, SyscallTotals> syscalls;
+  if (!snapshot.strace) {
+    return syscalls;
+  }
+  for (const auto &syscall : snapshot.strace->top_syscalls) {
+    auto &entry = syscalls[syscall.name];
+    entry.count += syscall.count;
+    entry.time_ms += syscall.time_ms;
+    if (syscall.latency) {
+      entry.p99_ms = std::max(entry.p99_ms, syscall.latency->p99_ms);
+    }
+  }
+  return syscalls;
+}
+
+class DiffBuilder {
+ public:
+  DiffBuilder(const DiffThresholds &thresholds, SnapshotDiff &diff)
+      : thresholds_(thresholds), diff_(diff) {}
+
+  void add(const char *kind, std::string_view key, const char *metric, double baseline,
+           double current, double threshold) {
+    if (baseline == current) {
+      return;
+    }
+    MetricDelta delta;
+    delta.kind = kind;
+    delta.key = key;
+    delta.metric = metric;
+    delta.baseline = baseline;
+    delta.current = current;
+    delta.delta = current - baseline;
+    if (baseline != 0.0) {
+      delta.relative_percent = delta.delta / std::fabs(baseline) * 100.0;
+    }
+    delta.regression = delta.delta > 0.0 && delta.delta >= threshold &&
+                       (!delta.relative_percent ||
+                        *delta.relative_percent >= thresholds_.relative_percent);
+    if (delta.regression) {
+      ++diff_.regressions;
+    }
+    diff_.deltas.push_back(std::move(delta));
+  }
+
+  void processes(std::string_view key, const ProcessTotals &baseline,
+                 const ProcessTotals &current) {
+    add("process", key, "instances", baseline.instances, current.instances,
+        std::numeric_limits<double>::infinity());
+    add("process", key, "cpu_percent", baseline.cpu_percent, current.cpu_percent,
+        thresholds_.cpu_percent);
+    add("process", key, "rss_kb", baseline.rss_kb, current.rss_kb, thresholds_.rss_kb);
+    add("process", key, "read_bytes", baseline.read_bytes, current.read_bytes,
+        thresholds_.io_bytes);
+    add("process", key, "write_bytes", baseline.write_bytes, current.write_bytes,
+        thresholds_.io_bytes);
+  }
+
+  void syscalls(std::string_view key, const SyscallTotals &baseline,
+                const SyscallTotals &current) {
+    add("syscall", key, "count", baseline.count, current.count, thresholds_.syscall_count);
+    add("syscall", key, "time_ms", baseline.time_ms, current.time_ms, thresholds_.syscall_ms);
+    add("syscall", key, "p99_ms", baseline.p99_ms, current.p99_ms, thresholds_.syscall_ms);
+  }
+
+  void hotspots(std::string_view key, double baseline, double current) {
+    add("hotspot", key, "percent", baseline, current, thresholds_.hotspot_percent);
+  }
+
+ private:
+  const DiffThresholds &thresholds_;
+  SnapshotDiff &diff_;
+};
+
+template <typename Map, typename Compare>
+void align(const Map &baseline, const Map &current, Compare compare) {
+  using Value = typename Map::mapped_type;
+  for (const auto &[key, value] : baseline) {
+    auto it = current.find(key);
+    compare(key, value, it == current.end() ? Value{} : it->second);
+  }
+  for (const auto &[key, value] : current) {
+    if (baseline.find(key) == baseline.end()) {
+      compare(key, Value{}, value);
+    }
+  }
+}
+
+double magnitude(const MetricDelta &delta) {
+  return delta.relative_percent ? std::fabs(*delta.relative_percent)
+                                : std::numeric_limits<double>::infinity();
+}
+
+std::string number(double value) {
+  char buffer[64];
+  if (value == std::floor(value) && std::fabs(value) < 1e15) {
+    std::snprintf(buffer, sizeof(buffer), "%.0f", value);
+  } else {
+    std::snprintf(buffer, sizeof(buffer), "%.2f", value);
+  }
+  return buffer;
+}
+
+std::string describe(const MetricDelta &delta) {
+  std::string line = "- " + delta.kind + " " + delta.key + " " + delta.metric + ": " +
+                     number(delta.baseline) + " -> " + number(delta.current) + " (" +
+                     (delta.delta > 0 ? "+" : "") + number(delta.delta);
+  if (delta.relative_percent) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), ", %+.1f%%", *delta.relative_percent);
+    line += buffer;
+  } else {
+    line += ", new";
+  }
+  return line + ")\n";
+}
+
+} // namespace
+
+bool setDiffThreshold(DiffThresholds &thresholds, std::string_view spec, std::string &error) {
+  auto equals = spec.find('=');
+  std::string_view name = spec.substr(0, equals);
+  double value = 0.0;
+  bool parsed = false;
+  if (equals != std::string_view::npos) {
+    auto [ptr, ec] = std::from_chars(spec.data() + equals + 1, spec.data() + spec.size(), value);
+    parsed = ec == std::errc() && ptr == spec.data() + spec.size() && value >= 0.0;
+  }
+  if (!parsed) {
+    error = "--threshold expects <name>=<non-negative number>, got " + std::string(spec);
+    return false;
+  }
+  if (name == "relative") {
+    thresholds.relative_percent = value;
+  } else if (name == "cpu") {
+    thresholds.cpu_percent = value;
+  } else if (name == "rss_kb") {
+    thresholds.rss_kb = value;
+  } else if (name == "io_bytes") {
+    thresholds.io_bytes = value;
+  } else if (name == "syscall_count") {
+    thresholds.syscall_count = value;
+  } else if (name == "syscall_ms") {
+    thresholds.syscall_ms = value;
+  } else if (name == "hotspot") {
+    thresholds.hotspot_percent = value;
+  } else {
+    error = "unknown threshold " + std::string(name) +
+            " (use relative, cpu, rss_kb, io_bytes, syscall_count, syscall_ms or hotspot)";
+    return false;
+  }
+  return true;
+}
+
+SnapshotDiff diffSnapshots(const DiagnosticsSnapshot &baseline, const DiagnosticsSnapshot &current,
+                           const DiffThresholds &thresholds) {
+  SnapshotDiff diff;
+  DiffBuilder builder(thresholds, diff);
+
+  auto before = summarizeRun("", baseline);
+  auto after = summarizeRun("", current);
+  builder.add("target", "total", "cpu_percent", before.cpu_percent, after.cpu_percent,
+              thresholds.cpu_percent);
+  builder.add("target", "total", "rss_kb", static_cast<double>(before.rss_kb),
+              static_cast<double>(after.rss_kb), thresholds.rss_kb);
+  builder.add("target", "total", "read_bytes", static_cast<double>(before.read_bytes),
+              static_cast<double>(after.read_bytes), thresholds.io_bytes);
+  builder.add("target", "total", "write_bytes", static_cast<double>(before.write_bytes),
+              static_cast<double>(after.write_bytes), thresholds.io_bytes);
+
+  align(processesByCommand(baseline), processesByCommand(current),
+        [&builder](std::string_view key, const ProcessTotals &a, const ProcessTotals &b) {
+          builder.processes(key, a, b);
+        });
+  align(syscallsByName(baseline), syscallsByName(current),
+        [&builder](std::string_view key, const SyscallTotals &a, const SyscallTotals &b) {
+          builder.syscalls(key, a, b);
+        });
+  align(hotspotsBySymbol(baseline), hotspotsBySymbol(current),
+        [&builder](std::string_view key, double a, double b) { builder.hotspots(key, a, b); });
+
+  std::sort(diff.deltas.begin(), diff.deltas.end(), [](const MetricDelta &a, const MetricDelta &b) {
+    if (a.regression != b.regression) {
+      return a.regression;
+    }
+    double ma = magnitude(a);
+    double mb = magnitude(b);
+    if (ma != mb) {
+      return ma > mb;
+    }
+    if (a.kind != b.kind) {
+      return a.kind < b.kind;
+    }
+    if (a.key != b.key) {
+      return a.key < b.key;
+    }
+    return a.metric < b.metric;
+  });
+  return diff;
+}
+
+std::string formatDiff(const SnapshotDiff &diff, size_t max_changes) {
+  std::string output = "Regressions (" + std::to_string(diff.regressions) + ")\n";
+  output += "===========\n";
+  for (size_t i = 0; i < diff.regressions; ++i) {
+    output += describe(diff.deltas[i]);
+  }
+  if (diff.regressions == 0) {
+    output += "- None\n";
+  }
+  size_t others = diff.deltas.size() - diff.regressions;
+  output += "\nOther changes (" + std::to_string(others) + ")\n";
+  output += "=============\n";
+  for (size_t i = diff.regressions; i < diff.deltas.size() && i - diff.regressions < max_changes;
+       ++i) {
+    output += describe(diff.deltas[i]);
+  }
+  if (others > max_changes) {
+    output += "- ... " + std::to_string(others - max_changes) + " more\n";
+  } else if (others == 0) {
+    output += "- None\n";
+  }
+  return output;
+}
+
+void to_json(nlohmann::json &j, const MetricDelta &delta) {
+  j = nlohmann::json{{"kind", delta.kind},         {"key", delta.key},
+                     {"metric", delta.metric},     {"baseline", delta.baseline},
+                     {"current", delta.current},   {"delta", delta.delta},
+                     {"regression", delta.regression}};
+  if (delta.relative_percent) {
+    j["relative_percent"] = *delta.relative_percent;
+  }
+}
+
+void to_json(nlohmann::json &j, const SnapshotDiff &diff) {
+  j = nlohmann::json{{"regressions", diff.regressions}, {"deltas", diff.deltas}};
+}
+
+} // namespace proccli
@@ -0,0 +1,499 @@
+#include "proccli/stack_trie.h"
+#include "proccli/parallel.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <sstream>
+
+namespace proccli {
+
+namespace {
+
+std::string_view trim(std::string_view value) {
+  while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) {
+    value.remove_prefix(1);
+  }
+  while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) {
+    value.remove_suffix(1);
+  }
+  return value;
+}
+
+bool isDigits(std::string_view value) {
+  return !value.empty() && std::all_of(value.begin(), value.end(), [](char c) {
+    return std::isdigit(static_cast<unsigned char>(c)) != 0;
+  });
+}
+
+bool parseWeight(std::string_view value, std::uint64_t &weight) {
+  auto [end, ec] = std::from_chars(value.data(), value.data() + value.size(), weight);
+  return ec == std::errc() && end == value.data() + value.size();
+}
+
+bool isPidToken(std::string_view token) {
+  auto slash = token.find('/');
+  if (slash == std::string_view::npos) {
+    return isDigits(token);
+  }
+  return isDigits(token.substr(0, slash)) && isDigits(token.substr(slash + 1));
+}
+
+std::vector<std::string_view> splitWhitespace(std::string_view line) {
+  std::vector<std::string_view> tokens;
+  size_t pos = 0;
+  while (pos < line.size()) {
+    while (pos < line.size() && std::isspace(static_cast<unsigned char>(line[pos]))) {
+      ++pos;
+    }
+    size_t start = pos;
+    while (pos < line.size() && !std::isspace(static_cast<unsigned char>(line[pos]))) {
+      ++pos;
+    }
+    if (pos > start) {
+      tokens.push_back(line.substr(start, pos - start));
+    }
+  }
+  return tokens;
+}
+
+// Returns false when the sample period does not fit in 64 bits; the sample is then skipped.
+bool parseSampleHeader(std::string_view line, std::string &comm, std::uint64_t &weight) {
+  auto tokens = splitWhitespace(line);
+  comm.clear();
+  weight = 1;
+  size_t index = 0;
+  for (; index < tokens.size(); ++index) {
+    if (index > 0 && isPidToken(tokens[index])) {
+      break;
+    }
+    if (!comm.empty()) {
+      comm += ' ';
+    }
+    comm.append(tokens[index]);
+  }
+  for (; index + 2 < tokens.size(); ++index) {
+    std::string_view token = tokens[index];
+    if (token.size() > 1 && token.back() == ':' && token.find('.') != std::string_view::npos) {
+      if (isDigits(tokens[index + 1])) {
+        return parseWeight(tokens[index + 1], weight);
+      }
+      break;
+    }
+  }
+  return true;
+}
+
+std::string frameLabel(std::string_view line) {
+  line = trim(line);
+  auto space = line.find(' ');
+  if (space == std::string_view::npos) {
+    return std::string(line);
+  }
+  std::string_view rest = trim(line.substr(space + 1));
+  std::string_view dso;
+  if (!rest.empty() && rest.back() == ')') {
+    auto open = rest.rfind(" (");
+    if (open != std::string_view::npos) {
+      dso = rest.substr(open + 2, rest.size() - open - 3);
+      rest = trim(rest.substr(0, open));
+    } else if (rest.front() == '(') {
+      dso = rest.substr(1, rest.size() - 2);
+      rest = {};
+    }
+  }
+  auto offset = rest.rfind("+0x");
+  if (offset != std::string_view::npos) {
+    rest = rest.substr(0, offset);
+  }
+  if (rest.empty() || rest == "[unknown]") {
+    auto slash = dso.rfind('/');
+    std::string_view module = slash == std::string_view::npos ? dso : dso.substr(slash + 1);
+    if (module.empty() || module == "unknown" || module == "[unknown]") {
+      return "[unknown]";
+    }
+    return "[" + std::string(module) + "]";
+  }
+  return std::string(rest);
+}
+
+bool isSampleHeader(std::string_view line) {
+  return !line.empty() && line.front() != '#' &&
+         !std::isspace(static_cast<unsigned char>(line.front()));
+}
+
+struct PerfScriptParser {
+  explicit PerfScriptParser(StackTrie &target) : trie(target) {}
+
+  void addLine(std::string_view line) {
+    if (trim(line).empty()) {
+      flush();
+      return;
+    }
+    if (line.front() == '#') {
+      return;
+    }
+    if (isSampleHeader(line)) {
+      flush();
+      in_sample = parseSampleHeader(line, comm, weight);
+      return;
+    }
+    if (in_sample) {
+      frames.push_back(trie.internFrame(frameLabel(line)));
+    }
+  }
+
+  void flush() {
+    if (!in_sample) {
+      return;
+    }
+    std::uint32_t node = trie.child(StackTrie::kRoot, trie.internFrame(comm));
+    for (auto it = frames.rbegin(); it != frames.rend(); ++it) {
+      node = trie.child(node, *it);
+    }
+    trie.addSample(node, weight);
+    frames.clear();
+    in_sample = false;
+    found = true;
+  }
+
+  StackTrie &trie;
+  std::string comm;
+  std::uint64_t weight = 1;
+  std::vector<std::uint64_t> frames;
+  bool in_sample = false;
+  bool found = false;
+};
+
+std::string escapeXml(std::string_view value) {
+  std::string out;
+  out.reserve(value.size());
+  for (char c : value) {
+    switch (c) {
+    case '&':
+      out += "&amp;";
+      break;
+    case '<':
+      out += "&lt;";
+      break;
+    case '>':
+      out += "&gt;";
+      break;
+    case '"':
+      out += "&quot;";
+      break;
+    default:
+      out += c;
+    }
+  }
+  return out;
+}
+
+std::string frameColor(std::string_view name) {
+  std::uint32_t hash = 2166136261u;
+  for (char c : name) {
+    hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "rgb(%u,%u,%u)", 205 + hash % 51,
+                (hash >> 8) % 231, (hash >> 16) % 56);
+  return buffer;
+}
+
+} // namespace
+
+StackTrie::StackTrie() {
+  nodes_.push_back(Node{});
+}
+
+std::uint32_t StackTrie::child(std::uint32_t node, std::uint64_t frame) {
+  auto [it, inserted] =
+      edges_.try_emplace(Edge{node, frame}, static_cast<std::uint32_t>(nodes_.size()));
+  if (inserted) {
+    Node created;
+    created.frame = frame;
+    created.parent = node;
+    created.next_sibling = nodes_[node].first_child;
+    nodes_[node].first_child = it->second;
+    nodes_.push_back(created);
+  }
+  return it->second;
+}
+
+void StackTrie::addSample(std::uint32_t leaf, std::uint64_t weight) {
+  nodes_[leaf].self += weight;
+  for (std::uint32_t node = leaf;; node = nodes_[node].parent) {
+    nodes_[node].total += weight;
+    if (node == kRoot) {
+      break;
+    }
+  }
+}
+
+std::uint64_t StackTrie::internFrame(std::string_view name) {
+  auto it = name_ids_.find(std::string(name));
+  if (it != name_ids_.end()) {
+    return it->second;
+  }
+  std::uint64_t id = names_.size();
+  names_.emplace_back(name);
+  name_ids_.emplace(names_.back(), id);
+  return id;
+}
+
+void StackTrie::merge(const StackTrie &other) {
+  std::vector<std::uint64_t> frames;
+  frames.reserve(other.names_.size());
+  for (const auto &name : other.names_) {
+    frames.push_back(internFrame(name));
+  }
+  std::vector<std::uint32_t> mapped(other.nodes_.size(), kRoot);
+  nodes_[kRoot].self += other.nodes_[kRoot].self;
+  nodes_[kRoot].total += other.nodes_[kRoot].total;
+  for (size_t i = 1; i < other.nodes_.size(); ++i) {
+    const Node &node = other.nodes_[i];
+    std::uint32_t target = child(mapped[node.parent], frames[node.frame]);
+    nodes_[target].self += node.self;
+    nodes_[target].total += node.total;
+    mapped[i] = target;
+  }
+}
+
+StackTrie StackTrie::relabel(const std::function<std::string(std::uint64_t frame)> &name) const {
+  StackTrie out;
+  std::vector<std::uint32_t> mapped(nodes_.size(), kRoot);
+  std::unordered_map<std::uint64_t, std::uint64_t> names;
+  out.nodes_[kRoot].self = nodes_[kRoot].self;
+  out.nodes_[kRoot].total = nodes_[kRoot].total;
+  for (size_t i = 1; i < nodes_.size(); ++i) {
+    const Node &node = nodes_[i];
+    auto label = names.find(node.frame);
+    if (label == names.end()) {
+      label = names.emplace(node.frame, out.internFrame(name(node.frame))).first;
+    }
+    std::uint32_t target = out.child(mapped[node.parent], label->second);
+    out.nodes_[target].self += node.self;
+    out.nodes_[target].total += node.total;
+    mapped[i] = target;
+  }
+  return out;
+}
+
+void StackTrie::writeFolded(std::ostream &out) const {
+  std::vector<std::vector<std::uint32_t>> children(nodes_.size());
+  for (std::uint32_t i = 1; i < nodes_.size(); ++i) {
+    children[nodes_[i].parent].push_back(i);
+  }
+  for (auto &list : children) {
+    std::sort(list.begin(), list.end(), [this](std::uint32_t a, std::uint32_t b) {
+      return names_[nodes_[a].frame] < names_[nodes_[b].frame];
+    });
+  }
+  std::string path;
+  std::vector<std::pair<std::uint32_t, size_t>> stack;
+  for (auto it = children[kRoot].rbegin(); it != children[kRoot].rend(); ++it) {
+    stack.emplace_back(*it, 0);
+  }
+  while (!stack.empty()) {
+    auto [node, prefix] = stack.back();
+    stack.pop_back();
+    path.resize(prefix);
+    if (prefix > 0) {
+      path += ';';
+    }
+    path += names_[nodes_[node].frame];
+    if (nodes_[node].self > 0) {
+      out << path << ' ' << nodes_[node].self << '\n';
+    }
+    for (auto it = children[node].rbegin(); it != children[node].rend(); ++it) {
+      stack.emplace_back(*it, path.size());
+    }
+  }
+}
+
+std::vector<PerfFrame> StackTrie::topFrames(size_t limit, bool include_roots) const {
+  std::vector<PerfFrame> frames;
+  std::uint64_t total = totalWeight();
+  if (total == 0) {
+    return frames;
+  }
+  std::unordered_map<std::uint64_t, std::uint64_t> inclusive;
+  std::unordered_map<std::uint64_t, std::uint64_t> exclusive;
+  std::unordered_map<std::uint64_t, int> on_path;
+  std::vector<std::pair<std::uint32_t, bool>> stack;
+  for (std::uint32_t c = nodes_[kRoot].first_child; c != 0; c = nodes_[c].next_sibling) {
+    stack.emplace_back(c, true);
+  }
+  while (!stack.empty()) {
+    auto [node, entering] = stack.back();
+    stack.pop_back();
+    std::uint64_t frame = nodes_[node].frame;
+    if (!entering) {
+      on_path[frame] -= 1;
+      continue;
+    }
+    if (include_roots || nodes_[node].parent != kRoot) {
+      if (on_path[frame]++ == 0) {
+        inclusive[frame] += nodes_[node].total;
+      }
+      exclusive[frame] += nodes_[node].self;
+      stack.emplace_back(node, false);
+    }
+    for (std::uint32_t c = nodes_[node].first_child; c != 0; c = nodes_[c].next_sibling) {
+      stack.emplace_back(c, true);
+    }
+  }
+  std::vector<std::uint64_t> order;
+  order.reserve(inclusive.size());
+  for (const auto &entry : inclusive) {
+    order.push_back(entry.first);
+  }
+  std::sort(order.begin(), order.end(), [&](std::uint64_t a, std::uint64_t b) {
+    if (inclusive[a] != inclusive[b]) {
+      return inclusive[a] > inclusive[b];
+    }
+    if (exclusive[a] != exclusive[b]) {
+      return exclusive[a] > exclusive[b];
+    }
+    return names_[a] < names_[b];
+  });
+  if (order.size() > limit) {
+    order.resize(limit);
+  }
+  for (std::uint64_t frame : order) {
+    frames.push_back({names_[frame],
+                      static_cast<double>(inclusive[frame]) * 100.0 / static_cast<double>(total),
+                      static_cast<double>(exclusive[frame]) * 100.0 / static_cast<double>(total)});
+  }
+  return frames;
+}
+
+bool parsePerfScript(std::istream &input, StackTrie &trie) {
+  PerfScriptParser parser(trie);
+  std::string line;
+  while (std::getline(input, line)) {
+    parser.addLine(line);
+  }
+  parser.flush();
+  return parser.found;
+}
+
+bool parsePerfScript(std::string_view text, StackTrie &trie, size_t threads) {
+  auto chunks = splitChunks(text, parseChunkCount(text.size(), threads), isSampleHeader);
+  std::vector<StackTrie> partial(chunks.size());
+  std::vector<char> found(chunks.size(), 0);
+  parallelFor(chunks.size(), threads, [&](size_t index) {
+    PerfScriptParser parser(partial[index]);
+    std::string_view rest = chunks[index];
+    while (!rest.empty()) {
+      size_t end = rest.find('\n');
+      parser.addLine(rest.substr(0, end));
+      rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+    }
+    parser.flush();
+    found[index] = parser.found ? 1 : 0;
+  });
+  for (const auto &chunk : partial) {
+    trie.merge(chunk);
+  }
+  return std::find(found.begin(), found.end(), 1) != found.end();
+}
+
+bool parseFolded(std::string_view text, StackTrie &trie) {
+  bool found = false;
+  while (!text.empty()) {
+    size_t end = text.find('\n');
+    std::string_view line = trim(text.substr(0, end));
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    auto space = line.rfind(' ');
+    std::uint64_t weight = 0;
+    if (space == std::string_view::npos || !parseWeight(line.substr(space + 1), weight)) {
+      continue;
+    }
+    std::string_view path = line.substr(0, space);
+    std::uint32_t node = StackTrie::kRoot;
+    while (!path.empty()) {
+      auto separator = path.find(';');
+      node = trie.child(node, trie.internFrame(path.substr(0, separator)));
+      path.remove_prefix(separator == std::string_view::npos ? path.size() : separator + 1);
+    }
+    if (node != StackTrie::kRoot && weight > 0) {
+      trie.addSample(node, weight);
+      found = true;
+    }
+  }
+  return found;
+}
+
+std::string renderFlameGraph(const StackTrie &trie, const std::string &title) {
+  const double width = 1200.0;
+  const double frame_height = 16.0;
+  const double margin = 10.0;
+  const double top = 40.0;
+  const auto &nodes = trie.nodes();
+  std::vector<std::vector<std::uint32_t>> children(nodes.size());
+  std::vector<size_t> depth(nodes.size(), 0);
+  size_t max_depth = 0;
+  for (std::uint32_t i = 1; i < nodes.size(); ++i) {
+    children[nodes[i].parent].push_back(i);
+    depth[i] = depth[nodes[i].parent] + 1;
+    max_depth = std::max(max_depth, depth[i]);
+  }
+  for (auto &list : children) {
+    std::sort(list.begin(), list.end(), [&](std::uint32_t a, std::uint32_t b) {
+      return trie.frameName(nodes[a].frame) < trie.frameName(nodes[b].frame);
+    });
+  }
+  double height = top + static_cast<double>(max_depth) * frame_height + margin * 2;
+  double total = static_cast<double>(std::max<std::uint64_t>(trie.totalWeight(), 1));
+  double scale = (width - margin * 2) / total;
+
+  std::ostringstream svg;
+  svg << "<?xml version=\"1.0\" standalone=\"no\"?>\n"
+      << "<svg version=\"1.1\" width=\"" << width << "\" height=\"" << height
+      << "\" viewBox=\"0 0 " << width << ' ' << height
+      << "\" xmlns=\"http://www.w3.org/2000/svg\" font-family=\"Verdana\" font-size=\"12\">\n"
+      << "<rect x=\"0\" y=\"0\" width=\"100%\" height=\"100%\" fill=\"#f8f8f8\"/>\n"
+      << "<text x=\"" << width / 2 << "\" y=\"24\" text-anchor=\"middle\" font-size=\"17\">"
+      << escapeXml(title) << "</text>\n";
+  std::vector<std::pair<std::uint32_t, double>> stack;
+  double x = margin;
+  for (std::uint32_t c : children[StackTrie::kRoot]) {
+    stack.emplace_back(c, x);
+    x += static_cast<double>(nodes[c].total) * scale;
+  }
+  char number[64];
+  while (!stack.empty()) {
+    auto [node, left] = stack.back();
+    stack.pop_back();
+    double w = static_cast<double>(nodes[node].total) * scale;
+    if (w < 0.1) {
+      continue;
+    }
+    double y = height - margin - static_cast<double>(depth[node]) * frame_height;
+    const std::string &name = trie.frameName(nodes[node].frame);
+    std::snprintf(number, sizeof(number), "%.2f", static_cast<double>(nodes[node].total) * 100.0 / total);
+    svg << "<g><title>" << escapeXml(name) << " (" << nodes[node].total << " samples, " << number
+        << "%)</title>";
+    std::snprintf(number, sizeof(number), "x=\"%.1f\" y=\"%.1f\" width=\"%.1f\"", left, y, w);
+    svg << "<rect " << number << " height=\"" << frame_height - 1 << "\" fill=\""
+        << frameColor(name) << "\" rx=\"2\"/>";
+    size_t fits = w > 6.0 ? static_cast<size_t>((w - 6.0) / 7.0) : 0;
+    if (fits >= 3) {
+      std::string label = name.size() <= fits ? name : name.substr(0, fits - 2) + "..";
+      std::snprintf(number, sizeof(number), "x=\"%.1f\" y=\"%.1f\"", left + 3.0, y + 11.5);
+      svg << "<text " << number << ">" << escapeXml(label) << "</text>";
+    }
+    svg << "</g>\n";
+    double child_x = left;
+    for (std::uint32_t c : children[node]) {
+      stack.emplace_back(c, child_x);
+      child_x += static_cast<double>(nodes[c].total) * scale;
+    }
+  }
+  svg << "</svg>\n";
+  return svg.str();
+}
+
+} // namespace proccli
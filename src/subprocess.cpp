@@ -0,0 +1,380 @@
+#include "proccli/subprocess.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "proccli/sampler.h"
+
+extern char **environ;
+
+namespace proccli {
+
+namespace {
+
+constexpr size_t kReadBufferBytes = 256 * 1024;
+constexpr size_t kMaxStderrBytes = 1 << 20;
+constexpr size_t kCaptureBlockBytes = 4 << 20;
+constexpr int kStopPollMs = 100;
+constexpr int kReapPollMs = 10;
+
+class Pipe {
+ public:
+  ~Pipe() { closeBoth(); }
+
+  bool open() {
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) != 0) {
+      return false;
+    }
+    read_fd = fds[0];
+    write_fd = fds[1];
+    return true;
+  }
+  void closeRead() { closeFd(read_fd); }
+  void closeWrite() { closeFd(write_fd); }
+  void closeBoth() {
+    closeRead();
+    closeWrite();
+  }
+
+  int read_fd = -1;
+  int write_fd = -1;
+
+ private:
+  static void closeFd(int &fd) {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+};
+
+ssize_t writeWithoutSigpipe(int fd, std::string_view data) {
+  sigset_t pipe_set;
+  sigset_t old_set;
+  sigemptyset(&pipe_set);
+  sigaddset(&pipe_set, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &pipe_set, &old_set);
+  ssize_t written = write(fd, data.data(), data.size());
+  if (written < 0 && errno == EPIPE) {
+    timespec zero{};
+    sigtimedwait(&pipe_set, nullptr, &zero);
+    errno = EPIPE;
+  }
+  pthread_sigmask(SIG_SETMASK, &old_set, nullptr);
+  return written;
+}
+
+void setNonBlocking(int fd) {
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+class LineSplitter {
+ public:
+  explicit LineSplitter(const std::function<void(std::string_view)> &callback)
+      : callback_(callback) {}
+
+  void feed(std::string_view chunk) {
+    while (!chunk.empty()) {
+      size_t end = chunk.find('\n');
+      if (end == std::string_view::npos) {
+        carry_.append(chunk);
+        return;
+      }
+      if (carry_.empty()) {
+        callback_(chunk.substr(0, end));
+      } else {
+        carry_.append(chunk.substr(0, end));
+        callback_(carry_);
+        carry_.clear();
+      }
+      chunk.remove_prefix(end + 1);
+    }
+  }
+  void finish() {
+    if (!carry_.empty()) {
+      callback_(carry_);
+      carry_.clear();
+    }
+  }
+
+ private:
+  const std::function<void(std::string_view)> &callback_;
+  std::string carry_;
+};
+
+// Captured stdout is kept in anonymous mappings and joined once the size is known; each block is
+// unmapped as soon as it is copied, so the peak stays near one copy of the output instead of the
+// two a doubling std::string holds while it grows. malloc'd blocks would not do: after the first
+// large free glibc serves them from the heap and keeps the pages.
+class BlockCapture {
+ public:
+  BlockCapture() = default;
+  BlockCapture(const BlockCapture &) = delete;
+  BlockCapture &operator=(const BlockCapture &) = delete;
+  ~BlockCapture() {
+    for (auto &block : blocks_) {
+      munmap(block.data, kCaptureBlockBytes);
+    }
+  }
+
+  bool append(std::string_view chunk) {
+    while (!chunk.empty()) {
+      if (blocks_.empty() || blocks_.back().size == kCaptureBlockBytes) {
+        void *data = mmap(nullptr, kCaptureBlockBytes, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data == MAP_FAILED) {
+          return false;
+        }
+        blocks_.push_back({static_cast<char *>(data), 0});
+      }
+      Block &block = blocks_.back();
+      size_t count = std::min(chunk.size(), kCaptureBlockBytes - block.size);
+      std::memcpy(block.data + block.size, chunk.data(), count);
+      block.size += count;
+      size_ += count;
+      chunk.remove_prefix(count);
+    }
+    return true;
+  }
+
+  std::string take() {
+    std::string joined;
+    joined.reserve(size_);
+    for (auto &block : blocks_) {
+      joined.append(block.data, block.size);
+      munmap(block.data, kCaptureBlockBytes);
+    }
+    blocks_.clear();
+    size_ = 0;
+    return joined;
+  }
+
+ private:
+  struct Block {
+    char *data = nullptr;
+    size_t size = 0;
+  };
+
+  std::vector<Block> blocks_;
+  size_t size_ = 0;
+};
+
+} // namespace
+
+SubprocessResult runProcess(const std::vector<std::string> &argv,
+                            const SubprocessOptions &options) {
+  SubprocessResult result;
+  if (argv.empty()) {
+    result.error = "empty command";
+    return result;
+  }
+  int sink_fd = -1;
+  if (!options.stdout_path.empty()) {
+    sink_fd = open(options.stdout_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (sink_fd < 0) {
+      result.error = "cannot open " + options.stdout_path + ": " + std::strerror(errno);
+      return result;
+    }
+  }
+  Pipe out;
+  Pipe err;
+  Pipe in;
+  bool has_input = !options.input.empty();
+  bool capture_stderr = options.capture_stderr && !options.merge_stderr;
+  if (!out.open() || (capture_stderr && !err.open()) || (has_input && !in.open())) {
+    result.error = std::string("pipe failed: ") + std::strerror(errno);
+    if (sink_fd >= 0) {
+      close(sink_fd);
+    }
+    return result;
+  }
+
+  posix_spawn_file_actions_t actions;
+  posix_spawn_file_actions_init(&actions);
+  if (has_input) {
+    posix_spawn_file_actions_adddup2(&actions, in.read_fd, STDIN_FILENO);
+  } else {
+    posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  }
+  posix_spawn_file_actions_adddup2(&actions, out.write_fd, STDOUT_FILENO);
+  if (options.merge_stderr) {
+    posix_spawn_file_actions_adddup2(&actions, out.write_fd, STDERR_FILENO);
+  } else if (capture_stderr) {
+    posix_spawn_file_actions_adddup2(&actions, err.write_fd, STDERR_FILENO);
+  }
+  std::vector<char *> args;
+  args.reserve(argv.size() + 1);
+  for (const auto &arg : argv) {
+    args.push_back(const_cast<char *>(arg.c_str()));
+  }
+  args.push_back(nullptr);
+  pid_t pid = 0;
+  int spawn_error = posix_spawnp(&pid, args[0], &actions, nullptr, args.data(), environ);
+  posix_spawn_file_actions_destroy(&actions);
+  out.closeWrite();
+  err.closeWrite();
+  in.closeRead();
+  if (spawn_error != 0) {
+    result.spawn_errno = spawn_error;
+    result.error = "cannot run " + argv[0] + ": " + std::strerror(spawn_error);
+    if (sink_fd >= 0) {
+      close(sink_fd);
+    }
+    return result;
+  }
+  result.started = true;
+
+  setNonBlocking(out.read_fd);
+  if (capture_stderr) {
+    setNonBlocking(err.read_fd);
+  }
+  if (has_input) {
+    setNonBlocking(in.write_fd);
+  }
+  static thread_local std::vector<char> buffer(kReadBufferBytes);
+  LineSplitter lines(options.on_stdout_line);
+  BlockCapture captured;
+  std::string_view pending_input(options.input);
+  double now = monotonicSeconds();
+  double deadline = options.timeout_ms > 0 ? now + options.timeout_ms / 1000.0 : 0.0;
+  double kill_at = 0.0;
+  double abandon_at = 0.0;
+  auto enforceDeadline = [&](double at) {
+    if (!result.timed_out && !result.stopped) {
+      if (deadline > 0.0 && at >= deadline) {
+        result.timed_out = true;
+      } else if (options.stop_requested && options.stop_requested()) {
+        result.stopped = true;
+      }
+      if (result.timed_out || result.stopped) {
+        kill(pid, SIGTERM);
+        kill_at = at + options.kill_grace_ms / 1000.0;
+      }
+    }
+    if (kill_at > 0.0 && at >= kill_at) {
+      kill(pid, SIGKILL);
+      kill_at = 0.0;
+      abandon_at = at + 0.5;
+    }
+  };
+  while (out.read_fd >= 0 || err.read_fd >= 0) {
+    now = monotonicSeconds();
+    enforceDeadline(now);
+    bool terminating = result.timed_out || result.stopped;
+    if (abandon_at > 0.0 && now >= abandon_at) {
+      break;
+    }
+    std::array<pollfd, 3> fds{};
+    nfds_t count = 0;
+    for (int fd : {out.read_fd, err.read_fd}) {
+      if (fd >= 0) {
+        fds[count++] = {fd, POLLIN, 0};
+      }
+    }
+    if (in.write_fd >= 0) {
+      fds[count++] = {in.write_fd, POLLOUT, 0};
+    }
+    int wait_ms = options.stop_requested && !terminating ? kStopPollMs : -1;
+    for (double until : {terminating ? 0.0 : deadline, kill_at, abandon_at}) {
+      if (until > 0.0) {
+        int ms = std::max(0, static_cast<int>((until - now) * 1000.0) + 1);
+        wait_ms = wait_ms < 0 ? ms : std::min(wait_ms, ms);
+      }
+    }
+    int ready = poll(fds.data(), count, wait_ms);
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+    for (nfds_t index = 0; ready > 0 && index < count; ++index) {
+      const pollfd &entry = fds[index];
+      if (entry.revents == 0) {
+        continue;
+      }
+      if (entry.fd == in.write_fd) {
+        ssize_t written = writeWithoutSigpipe(in.write_fd, pending_input);
+        if (written > 0) {
+          pending_input.remove_prefix(static_cast<size_t>(written));
+        }
+        if ((written < 0 && errno != EAGAIN && errno != EINTR) || pending_input.empty()) {
+          in.closeWrite();
+        }
+        continue;
+      }
+      ssize_t bytes = read(entry.fd, buffer.data(), buffer.size());
+      if (bytes < 0 && (errno == EAGAIN || errno == EINTR)) {
+        continue;
+      }
+      if (bytes <= 0) {
+        (entry.fd == out.read_fd ? out : err).closeRead();
+        continue;
+      }
+      std::string_view chunk(buffer.data(), static_cast<size_t>(bytes));
+      if (entry.fd == err.read_fd) {
+        if (result.err.size() < kMaxStderrBytes) {
+          result.err.append(chunk.substr(0, kMaxStderrBytes - result.err.size()));
+        }
+        continue;
+      }
+      result.stdout_bytes += chunk.size();
+      if (sink_fd >= 0 && write(sink_fd, chunk.data(), chunk.size()) < 0) {
+        result.error = "write to " + options.stdout_path + " failed: " + std::strerror(errno);
+        close(sink_fd);
+        sink_fd = -1;
+      }
+      if (options.on_stdout_line) {
+        lines.feed(chunk);
+      } else if (options.stdout_path.empty() && !captured.append(chunk)) {
+        result.error = "out of memory capturing " + argv[0] + " output";
+        kill(pid, SIGKILL);
+        break;
+      }
+    }
+  }
+  if (options.on_stdout_line) {
+    lines.finish();
+  }
+  result.out = captured.take();
+  out.closeRead();
+  err.closeRead();
+  in.closeWrite();
+  if (sink_fd >= 0) {
+    close(sink_fd);
+  }
+  // The child may close its output and keep running, so the deadline and the SIGTERM/SIGKILL
+  // sequence still apply until it is reaped.
+  int status = 0;
+  while (true) {
+    pid_t reaped = waitpid(pid, &status, WNOHANG);
+    if (reaped == pid || (reaped < 0 && errno != EINTR)) {
+      break;
+    }
+    if (reaped == 0) {
+      enforceDeadline(monotonicSeconds());
+      usleep(kReapPollMs * 1000);
+    }
+  }
+  if (WIFEXITED(status)) {
+    result.exit_code = WEXITSTATUS(status);
+  } else if (WIFSIGNALED(status)) {
+    result.term_signal = WTERMSIG(status);
+    result.exit_code = 128 + result.term_signal;
+  }
+  if (result.timed_out && result.error.empty()) {
+    result.error = argv[0] + " timed out after " + std::to_string(options.timeout_ms) + " ms";
+  }
+  return result;
+}
+
+} // namespace proccli
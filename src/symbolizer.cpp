@@ -0,0 +1,385 @@
+#include "proccli/symbolizer.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+#include <cxxabi.h>
+#include <elf.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "proccli/utils.h"
+
+namespace proccli {
+
+namespace {
+
+constexpr char kCacheMagic[8] = {'P', 'C', 'S', 'Y', 'M', 'v', '1', '\0'};
+
+std::string hexString(const unsigned char *data, size_t size) {
+  static const char digits[] = "0123456789abcdef";
+  std::string out;
+  out.reserve(size * 2);
+  for (size_t i = 0; i < size; ++i) {
+    out += digits[data[i] >> 4];
+    out += digits[data[i] & 0xf];
+  }
+  return out;
+}
+
+std::string findBuildId(const unsigned char *data, size_t size, std::uint64_t offset,
+                        std::uint64_t length) {
+  if (offset > size || length > size - offset) {
+    return "";
+  }
+  std::uint64_t pos = offset;
+  std::uint64_t end = offset + length;
+  while (pos + sizeof(Elf64_Nhdr) <= end) {
+    Elf64_Nhdr note;
+    std::memcpy(&note, data + pos, sizeof(note));
+    pos += sizeof(note);
+    std::uint64_t name_size = (note.n_namesz + 3) & ~3ULL;
+    std::uint64_t desc_size = (note.n_descsz + 3) & ~3ULL;
+    if (pos + name_size + desc_size > end) {
+      break;
+    }
+    if (note.n_type == NT_GNU_BUILD_ID && note.n_namesz == 4 &&
+        std::memcmp(data + pos, "GNU", 4) == 0) {
+      return hexString(data + pos + name_size, note.n_descsz);
+    }
+    pos += name_size + desc_size;
+  }
+  return "";
+}
+
+} // namespace
+
+std::string defaultSymbolCacheDir() {
+  if (const char *env = std::getenv("PROCCLI_SYMBOL_CACHE")) {
+    return env;
+  }
+  if (const char *xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) {
+    return std::string(xdg) + "/proccli/symbols";
+  }
+  if (const char *home = std::getenv("HOME"); home && *home) {
+    return std::string(home) + "/.cache/proccli/symbols";
+  }
+  return "";
+}
+
+std::string demangle(std::string_view symbol) {
+  if (symbol.size() < 2 || symbol[0] != '_' || symbol[1] != 'Z') {
+    return std::string(symbol);
+  }
+  std::string mangled(symbol);
+  int status = 0;
+  char *result = abi::__cxa_demangle(mangled.c_str(), nullptr, nullptr, &status);
+  if (status != 0 || result == nullptr) {
+    std::free(result);
+    return mangled;
+  }
+  std::string demangled(result);
+  std::free(result);
+  return demangled;
+}
+
+std::shared_ptr<ElfSymbolTable> ElfSymbolTable::load(const std::string &path,
+                                                     const std::string &cache_dir) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Elf64_Ehdr))) {
+    close(fd);
+    return nullptr;
+  }
+  size_t size = static_cast<size_t>(info.st_size);
+  void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    return nullptr;
+  }
+  auto table = std::make_shared<ElfSymbolTable>();
+  bool ok = table->parse(static_cast<const unsigned char *>(mapped), size, cache_dir);
+  if (ok && !table->from_cache_ &&!cache_dir.empty() && !table->build_id_.empty()) {
+    table->writeCache(cache_dir + "/" + table->build_id_ + ".sym");
+  }
+  munmap(mapped, size);
+  return ok ? table : nullptr;
+}
+
+bool ElfSymbolTable::parse(const unsigned char *data, size_t size, const std::string &cache_dir) {
+  if (std::memcmp(data, ELFMAG, SELFMAG) != 0 || data[EI_CLASS] != ELFCLASS64 ||
+      data[EI_DATA] != ELFDATA2LSB) {
+    return false;
+  }
+  Elf64_Ehdr ehdr;
+  std::memcpy(&ehdr, data, sizeof(ehdr));
+  if (ehdr.e_phoff > size || ehdr.e_phnum > (size - ehdr.e_phoff) / sizeof(Elf64_Phdr)) {
+    return false;
+  }
+  for (int i = 0; i < ehdr.e_phnum; ++i) {
+    Elf64_Phdr phdr;
+    std::memcpy(&phdr, data + ehdr.e_phoff + i * sizeof(Elf64_Phdr), sizeof(phdr));
+    if (phdr.p_type == PT_LOAD) {
+      segments_.push_back({phdr.p_offset, phdr.p_vaddr, phdr.p_filesz});
+    } else if (phdr.p_type == PT_NOTE && build_id_.empty()) {
+      build_id_ = findBuildId(data, size, phdr.p_offset, phdr.p_filesz);
+    }
+  }
+
+  if (!build_id_.empty() && !cache_dir.empty() &&
+      readCache(cache_dir + "/" + build_id_ + ".sym")) {
+    from_cache_ = true;
+    return true;
+  }
+
+  if (ehdr.e_shoff > size || ehdr.e_shnum > (size - ehdr.e_shoff) / sizeof(Elf64_Shdr)) {
+    return !segments_.empty();
+  }
+  std::vector<Elf64_Shdr> sections(ehdr.e_shnum);
+  if (ehdr.e_shnum > 0) {
+    std::memcpy(sections.data(), data + ehdr.e_shoff, ehdr.e_shnum * sizeof(Elf64_Shdr));
+  }
+  for (const auto &section : sections) {
+    if (section.sh_type != SHT_SYMTAB && section.sh_type != SHT_DYNSYM) {
+      continue;
+    }
+    if (section.sh_link >= sections.size() || section.sh_entsize != sizeof(Elf64_Sym) ||
+        section.sh_offset > size || section.sh_size > size - section.sh_offset) {
+      continue;
+    }
+    const Elf64_Shdr &strtab = sections[section.sh_link];
+    if (strtab.sh_offset > size || strtab.sh_size > size - strtab.sh_offset) {
+      continue;
+    }
+    const char *strings = reinterpret_cast<const char *>(data + strtab.sh_offset);
+    size_t count = section.sh_size / sizeof(Elf64_Sym);
+    for (size_t i = 0; i < count; ++i) {
+      Elf64_Sym sym;
+      std::memcpy(&sym, data + section.sh_offset + i * sizeof(Elf64_Sym), sizeof(sym));
+      int type = ELF64_ST_TYPE(sym.st_info);
+      if ((type != STT_FUNC && type != STT_GNU_IFUNC) || sym.st_shndx == SHN_UNDEF ||
+          sym.st_value == 0 || sym.st_name >= strtab.sh_size) {
+        continue;
+      }
+      const char *name = strings + sym.st_name;
+      size_t length = strnlen(name, strtab.sh_size - sym.st_name);
+      Symbol symbol;
+      symbol.start = sym.st_value;
+      symbol.size = static_cast<std::uint32_t>(std::min<std::uint64_t>(sym.st_size, UINT32_MAX));
+      symbol.name = static_cast<std::uint32_t>(names_.size());
+      names_.append(name, length);
+      names_.push_back('\0');
+      symbols_.push_back(symbol);
+    }
+  }
+  std::sort(symbols_.begin(), symbols_.end(), [](const Symbol &a, const Symbol &b) {
+    if (a.start != b.start) {
+      return a.start < b.start;
+    }
+    return a.size > b.size;
+  });
+  symbols_.erase(std::unique(symbols_.begin(), symbols_.end(),
+                             [](const Symbol &a, const Symbol &b) { return a.start == b.start; }),
+                 symbols_.end());
+  return true;
+}
+
+bool ElfSymbolTable::readCache(const std::string &path) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) {
+    return false;
+  }
+  char magic[8];
+  std::uint64_t count = 0;
+  std::uint64_t names_size = 0;
+  if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, kCacheMagic, sizeof(magic)) != 0 ||
+      !file.read(reinterpret_cast<char *>(&count), sizeof(count)) ||
+      !file.read(reinterpret_cast<char *>(&names_size), sizeof(names_size))) {
+    return false;
+  }
+  std::error_code ec;
+  std::uint64_t file_size = std::filesystem::file_size(path, ec);
+  constexpr std::uint64_t kHeaderSize = sizeof(magic) + sizeof(count) + sizeof(names_size);
+  if (ec || file_size < kHeaderSize) {
+    return false;
+  }
+  std::uint64_t payload = file_size - kHeaderSize;
+  if (count > payload / sizeof(Symbol) || names_size != payload - count * sizeof(Symbol)) {
+    return false;
+  }
+  std::vector<Symbol> symbols(count);
+  std::string names(names_size, '\0');
+  if (!file.read(reinterpret_cast<char *>(symbols.data()),
+                 static_cast<std::streamsize>(count * sizeof(Symbol))) ||
+      !file.read(names.data(), static_cast<std::streamsize>(names_size))) {
+    return false;
+  }
+  for (const auto &symbol : symbols) {
+    if (symbol.name >= names_size) {
+      return false;
+    }
+  }
+  symbols_ = std::move(symbols);
+  names_ = std::move(names);
+  return true;
+}
+
+void ElfSymbolTable::writeCache(const std::string &path) const {
+  std::error_code ec;
+  std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+  if (ec) {
+    return;
+  }
+  std::string temp = path + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream file(temp, std::ios::binary | std::ios::trunc);
+    if (!file) {
+      return;
+    }
+    std::uint64_t count = symbols_.size();
+    std::uint64_t names_size = names_.size();
+    file.write(kCacheMagic, sizeof(kCacheMagic));
+    file.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    file.write(reinterpret_cast<const char *>(&names_size), sizeof(names_size));
+    file.write(reinterpret_cast<const char *>(symbols_.data()),
+               static_cast<std::streamsize>(count * sizeof(Symbol)));
+    file.write(names_.data(), static_cast<std::streamsize>(names_size));
+    if (!file) {
+      std::filesystem::remove(temp, ec);
+      return;
+    }
+  }
+  std::filesystem::rename(temp, path, ec);
+}
+
+bool ElfSymbolTable::fileOffsetToVaddr(std::uint64_t offset, std::uint64_t &vaddr) const {
+  for (const auto &segment : segments_) {
+    if (offset >= segment.offset && offset < segment.offset + segment.filesz) {
+      vaddr = offset - segment.offset + segment.vaddr;
+      return true;
+    }
+  }
+  return false;
+}
+
+std::string_view ElfSymbolTable::lookup(std::uint64_t vaddr) const {
+  auto it = std::upper_bound(symbols_.begin(), symbols_.end(), vaddr,
+                             [](std::uint64_t value, const Symbol &s) { return value < s.start; });
+  if (it == symbols_.begin()) {
+    return {};
+  }
+  const Symbol &symbol = *std::prev(it);
+  if (symbol.size != 0 && vaddr >= symbol.start + symbol.size) {
+    return {};
+  }
+  return std::string_view(names_.data() + symbol.name);
+}
+
+Symbolizer::Symbolizer(std::string cache_dir) : cache_dir_(std::move(cache_dir)) {}
+
+std::shared_ptr<ElfSymbolTable> Symbolizer::table(int pid, const std::string &path) {
+  auto it = tables_.find(path);
+  if (it != tables_.end()) {
+    return it->second;
+  }
+  auto loaded = ElfSymbolTable::load("/proc/" + std::to_string(pid) + "/root" + path, cache_dir_);
+  if (!loaded) {
+    loaded = ElfSymbolTable::load(path, cache_dir_);
+  }
+  tables_.emplace(path, loaded);
+  return loaded;
+}
+
+bool Symbolizer::loadProcess(int pid) {
+  return loadMaps(pid, readFile("/proc/" + std::to_string(pid) + "/maps"));
+}
+
+bool Symbolizer::loadMaps(int pid, std::string_view maps) {
+  if (maps.empty()) {
+    return false;
+  }
+  std::vector<Mapping> mappings;
+  std::string_view rest(maps);
+  while (!rest.empty()) {
+    auto end = rest.find('\n');
+    std::string line(rest.substr(0, end));
+    rest.remove_prefix(end == std::string_view::npos ? rest.size() : end + 1);
+    char perms[5] = {};
+    unsigned long long start = 0;
+    unsigned long long stop = 0;
+    unsigned long long offset = 0;
+    int name_pos = 0;
+    if (std::sscanf(line.c_str(), "%llx-%llx %4s %llx %*s %*s %n", &start, &stop, perms, &offset,
+                    &name_pos) < 4 ||
+        perms[2] != 'x') {
+      continue;
+    }
+    Mapping mapping;
+    mapping.start = start;
+    mapping.end = stop;
+    mapping.offset = offset;
+    mapping.path = name_pos > 0 ? line.substr(static_cast<size_t>(name_pos)) : std::string();
+    mapping.module = mapping.path.empty() ? "[anon]" : mapping.path;
+    auto slash = mapping.module.rfind('/');
+    if (slash != std::string::npos) {
+      mapping.module = mapping.module.substr(slash + 1);
+    }
+    if (!mapping.path.empty() && mapping.path.front() == '/' &&
+        mapping.path.find(" (deleted)") == std::string::npos) {
+      mapping.table = table(pid, mapping.path);
+    }
+    mappings.push_back(std::move(mapping));
+  }
+  std::sort(mappings.begin(), mappings.end(),
+            [](const Mapping &a, const Mapping &b) { return a.start < b.start; });
+  processes_[pid] = std::move(mappings);
+  return true;
+}
+
+ResolvedFrame Symbolizer::resolve(int pid, std::uint64_t ip) {
+  ResolvedFrame frame;
+  frame.offset = ip;
+  auto process = processes_.find(pid);
+  if (process == processes_.end()) {
+    if (!loadProcess(pid)) {
+      processes_[pid] = {};
+    }
+    process = processes_.find(pid);
+  }
+  const auto &mappings = process->second;
+  auto it = std::upper_bound(mappings.begin(), mappings.end(), ip,
+                             [](std::uint64_t value, const Mapping &m) { return value < m.start; });
+  if (it == mappings.begin() || ip >= std::prev(it)->end) {
+    frame.module = "[unknown]";
+    return frame;
+  }
+  const Mapping &mapping = *std::prev(it);
+  frame.module = mapping.module;
+  frame.offset = ip - mapping.start + mapping.offset;
+  std::uint64_t vaddr = 0;
+  if (mapping.table && mapping.table->fileOffsetToVaddr(frame.offset, vaddr)) {
+    frame.symbol = mapping.table->lookup(vaddr);
+  }
+  return frame;
+}
+
+std::string Symbolizer::describe(int pid, std::uint64_t ip) {
+  ResolvedFrame frame = resolve(pid, ip);
+  if (!frame.symbol.empty()) {
+    return demangle(frame.symbol);
+  }
+  char buffer[32];
+  std::snprintf(buffer, sizeof(buffer), "+0x%llx", static_cast<unsigned long long>(frame.offset));
+  return std::string(frame.module) + buffer;
+}
+
+} // namespace proccli
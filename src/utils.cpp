@@ -6,16 +6,92 @@
 #include <iomanip>
 #include <sstream>
 
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 namespace proccli {
 
+MappedFile::~MappedFile() {
+  if (data_ != nullptr) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+}
+
+bool MappedFile::open(const std::string &path, std::string &error) {
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    error = "cannot open " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  struct stat info {};
+  if (fstat(fd, &info) != 0) {
+    error = "cannot stat " + path + ": " + std::strerror(errno);
+    close(fd);
+    return false;
+  }
+  if (info.st_size == 0) {
+    close(fd);
+    return true;
+  }
+  void *mapped = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    error = "cannot map " + path + ": " + std::strerror(errno);
+    return false;
+  }
+  data_ = static_cast<const char *>(mapped);
+  size_ = static_cast<size_t>(info.st_size);
+  madvise(mapped, size_, MADV_SEQUENTIAL);
+  return true;
+}
+
+void MappedFile::release(std::string_view consumed) const {
+  if (data_ == nullptr || consumed.data() < data_ || consumed.data() + consumed.size() > data_ + size_) {
+    return;
+  }
+  auto page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  size_t begin = (static_cast<size_t>(consumed.data() - data_) + page - 1) / page * page;
+  size_t end = static_cast<size_t>(consumed.data() + consumed.size() - data_) / page * page;
+  if (end > begin) {
+    madvise(const_cast<char *>(data_) + begin, end - begin, MADV_DONTNEED);
+  }
+}
+
 std::string readFile(const std::string &path) {
-  std::ifstream file(path);
-  if (!file) {
-    return "";
+  std::string content;
+  readFileAt(AT_FDCWD, path.c_str(), content);
+  return content;
+}
+
+bool readFileAt(int dir_fd, const char *path, std::string &buffer) {
+  buffer.clear();
+  int fd = openat(dir_fd, path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat info {};
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    buffer.resize(static_cast<size_t>(info.st_size) + 1);
+  }
+  size_t used = 0;
+  while (true) {
+    if (buffer.size() < used + 4096) {
+      buffer.resize(used + 4096);
+    }
+    ssize_t count = read(fd, buffer.data() + used, buffer.size() - used);
+    if (count <= 0) {
+      break;
+    }
+    used += static_cast<size_t>(count);
   }
-  std::ostringstream buffer;
-  buffer << file.rdbuf();
-  return buffer.str();
+  close(fd);
+  buffer.resize(used);
+  return true;
 }
 
 void writeFile(const std::string &path, const std::string &content) {
@@ -34,12 +110,12 @@ std::string isoTimestamp() {
   return stream.str();
 }
 
-std::string makeArtifactsDir(const std::string &base) {
+std::string makeArtifactsDir(const std::string &base, const std::string &root) {
   if (!base.empty()) {
     std::filesystem::create_directories(base + "/raw");
     return base;
   }
-  std::string dir = "artifacts/" + isoTimestamp();
+  std::string dir = root + "/" + isoTimestamp();
   std::filesystem::create_directories(dir + "/raw");
   return dir;
 }
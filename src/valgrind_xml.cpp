@@ -0,0 +1,350 @@
+#include "proccli/valgrind_xml.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace proccli {
+
+namespace {
+
+constexpr size_t kMaxTagBytes = 4096;
+constexpr size_t kMaxTextBytes = 1024;
+constexpr size_t kUniquesPerSite = 16;
+constexpr size_t kNoSite = static_cast<size_t>(-1);
+
+bool isLeakKind(std::string_view kind) {
+  return kind.compare(0, 5, "Leak_") == 0;
+}
+
+std::string decodeEntities(const std::string &text) {
+  if (text.find('&') == std::string::npos) {
+    return text;
+  }
+  static const std::pair<std::string_view, char> kEntities[] = {
+      {"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''},
+  };
+  std::string decoded;
+  decoded.reserve(text.size());
+  std::string_view rest(text);
+  while (!rest.empty()) {
+    bool replaced = false;
+    if (rest.front() == '&') {
+      for (const auto &[entity, ch] : kEntities) {
+        if (rest.compare(0, entity.size(), entity) == 0) {
+          decoded.push_back(ch);
+          rest.remove_prefix(entity.size());
+          replaced = true;
+          break;
+        }
+      }
+    }
+    if (!replaced) {
+      decoded.push_back(rest.front());
+      rest.remove_prefix(1);
+    }
+  }
+  return decoded;
+}
+
+long long toNumber(const std::string &text) {
+  long long value = 0;
+  std::from_chars(text.data(), text.data() + text.size(), value);
+  return value;
+}
+
+void leakKb(const std::map<std::string, long long> &bytes, const char *kind, int &field) {
+  auto it = bytes.find(kind);
+  if (it != bytes.end()) {
+    field = static_cast<int>(it->second / 1024);
+  }
+}
+
+} // namespace
+
+ValgrindXmlParser::ValgrindXmlParser(size_t max_sites) : max_sites_(max_sites) {}
+
+void ValgrindXmlParser::feed(std::string_view chunk) {
+  while (!chunk.empty()) {
+    if (in_tag_) {
+      size_t end = chunk.find('>');
+      std::string_view part = chunk.substr(0, end);
+      if (tag_.size() + part.size() <= kMaxTagBytes) {
+        tag_.append(part);
+      }
+      if (end == std::string_view::npos) {
+        return;
+      }
+      chunk.remove_prefix(end + 1);
+      in_tag_ = false;
+      handleTag(tag_);
+      tag_.clear();
+    } else {
+      size_t start = chunk.find('<');
+      if (capturing_ && text_.size() < kMaxTextBytes) {
+        text_.append(chunk.substr(0, std::min(start, kMaxTextBytes - text_.size())));
+      }
+      if (start == std::string_view::npos) {
+        return;
+      }
+      chunk.remove_prefix(start + 1);
+      in_tag_ = true;
+    }
+  }
+}
+
+void ValgrindXmlParser::handleTag(std::string_view tag) {
+  if (tag.empty() || tag.front() == '?' || tag.front() == '!') {
+    return;
+  }
+  if (tag.front() == '/') {
+    if (!elements_.empty()) {
+      closeElement();
+    }
+    return;
+  }
+  bool self_closing = tag.back() == '/';
+  if (self_closing) {
+    tag.remove_suffix(1);
+  }
+  size_t name_end = tag.find_first_of(" \t\r\n");
+  openElement(tag.substr(0, name_end));
+  if (self_closing) {
+    closeElement();
+  }
+}
+
+ValgrindXmlParser::Element ValgrindXmlParser::parent(size_t level) const {
+  if (elements_.size() <= level) {
+    return Element::Other;
+  }
+  return elements_[elements_.size() - 1 - level];
+}
+
+void ValgrindXmlParser::openElement(std::string_view name) {
+  static const std::pair<std::string_view, Element> kElements[] = {
+      {"valgrindoutput", Element::Root}, {"error", Element::Error},
+      {"unique", Element::Unique},       {"kind", Element::Kind},
+      {"what", Element::What},           {"xwhat", Element::Xwhat},
+      {"text", Element::Text},           {"leakedbytes", Element::LeakedBytes},
+      {"leakedblocks", Element::LeakedBlocks}, {"stack", Element::Stack},
+      {"frame", Element::Frame},         {"ip", Element::Ip},
+      {"obj", Element::Obj},             {"fn", Element::Fn},
+      {"file", Element::File},           {"line", Element::Line},
+      {"errorcounts", Element::ErrorCounts}, {"pair", Element::Pair},
+      {"count", Element::Count},
+  };
+  Element element = Element::Other;
+  for (const auto &[tag, value] : kElements) {
+    if (tag == name) {
+      element = value;
+      break;
+    }
+  }
+  elements_.push_back(element);
+  text_.clear();
+  capturing_ = false;
+  Element up = parent();
+  switch (element) {
+    case Element::Error:
+      if (up == Element::Root) {
+        error_ = PendingError{};
+      }
+      break;
+    case Element::Stack:
+      if (up == Element::Error) {
+        ++error_.stacks;
+      }
+      break;
+    case Element::Frame:
+      frame_ = FrameText{};
+      break;
+    case Element::Pair:
+      pair_unique_.clear();
+      pair_count_ = 0;
+      break;
+    case Element::Unique:
+      capturing_ = up == Element::Error || up == Element::Pair;
+      break;
+    case Element::Kind:
+    case Element::What:
+      capturing_ = up == Element::Error;
+      break;
+    case Element::Text:
+    case Element::LeakedBytes:
+    case Element::LeakedBlocks:
+      capturing_ = up == Element::Xwhat && parent(2) == Element::Error;
+      break;
+    case Element::Ip:
+    case Element::Obj:
+    case Element::Fn:
+    case Element::File:
+    case Element::Line:
+      capturing_ = up == Element::Frame && parent(2) == Element::Stack &&
+                   parent(3) == Element::Error && error_.stacks == 1;
+      break;
+    case Element::Count:
+      capturing_ = up == Element::Pair;
+      break;
+    default:
+      break;
+  }
+}
+
+void ValgrindXmlParser::closeElement() {
+  Element element = elements_.back();
+  if (capturing_) {
+    finishText(element);
+    capturing_ = false;
+  }
+  elements_.pop_back();
+  Element up = parent(0);
+  if (element == Element::Frame && up == Element::Stack && parent(1) == Element::Error &&
+      error_.stacks == 1 && error_.stack.size() < kStackDepth) {
+    std::string frame = frame_.fn.empty() ? frame_.ip : frame_.fn;
+    if (!frame_.file.empty()) {
+      frame += " (" + frame_.file + (frame_.line.empty() ? "" : ":" + frame_.line) + ")";
+    } else if (!frame_.obj.empty()) {
+      frame += " (" + frame_.obj + ")";
+    }
+    error_.stack.push_back(std::move(frame));
+  } else if (element == Element::Error && up == Element::Root) {
+    commitError();
+  } else if (element == Element::Pair) {
+    applyErrorCount();
+  }
+}
+
+void ValgrindXmlParser::finishText(Element element) {
+  std::string value = decodeEntities(text_);
+  switch (element) {
+    case Element::Unique:
+      (parent() == Element::Pair ? pair_unique_ : error_.unique) = std::move(value);
+      break;
+    case Element::Kind:
+      error_.kind = std::move(value);
+      break;
+    case Element::What:
+      error_.what = std::move(value);
+      break;
+    case Element::Text:
+      if (error_.what.empty()) {
+        error_.what = std::move(value);
+      }
+      break;
+    case Element::LeakedBytes:
+      error_.leaked_bytes = toNumber(value);
+      break;
+    case Element::LeakedBlocks:
+      error_.leaked_blocks = toNumber(value);
+      break;
+    case Element::Ip:
+      frame_.ip = std::move(value);
+      break;
+    case Element::Obj:
+      frame_.obj = std::move(value);
+      break;
+    case Element::Fn:
+      frame_.fn = std::move(value);
+      break;
+    case Element::File:
+      frame_.file = std::move(value);
+      break;
+    case Element::Line:
+      frame_.line = std::move(value);
+      break;
+    case Element::Count:
+      pair_count_ = toNumber(value);
+      break;
+    default:
+      break;
+  }
+}
+
+void ValgrindXmlParser::commitError() {
+  ++errors_;
+  auto &totals = kinds_[error_.kind];
+  ++totals.count;
+  totals.leaked_bytes += error_.leaked_bytes;
+
+  std::string key = error_.kind;
+  for (const auto &frame : error_.stack) {
+    key.push_back('\n');
+    key += frame;
+  }
+  // Leak records arrive at exit, after every other error, so they get their own share of the
+  // table instead of finding it filled by early errors.
+  bool leak = isLeakKind(error_.kind);
+  size_t used = leak ? leak_sites_ : sites_.size() - leak_sites_;
+  size_t site = kNoSite;
+  if (auto it = site_index_.find(key); it != site_index_.end()) {
+    site = it->second;
+    ++sites_[site].count;
+    sites_[site].leaked_bytes += error_.leaked_bytes;
+    sites_[site].leaked_blocks += error_.leaked_blocks;
+  } else if (used < max_sites_) {
+    site = sites_.size();
+    leak_sites_ += leak ? 1 : 0;
+    site_index_.emplace(std::move(key), site);
+    sites_.push_back({error_.kind, std::move(error_.what), std::move(error_.stack), 1,
+                      error_.leaked_bytes, error_.leaked_blocks});
+  } else {
+    ++unattributed_;
+  }
+  if (!error_.unique.empty() && uniques_.size() < max_sites_ * kUniquesPerSite) {
+    uniques_[error_.unique] = {site, error_.kind, 1};
+  }
+}
+
+void ValgrindXmlParser::applyErrorCount() {
+  auto it = uniques_.find(pair_unique_);
+  if (it == uniques_.end() || pair_count_ <= it->second.counted) {
+    return;
+  }
+  long long extra = pair_count_ - it->second.counted;
+  it->second.counted = pair_count_;
+  errors_ += static_cast<unsigned long long>(extra);
+  kinds_[it->second.kind].count += extra;
+  if (it->second.site == kNoSite) {
+    unattributed_ += extra;
+  } else {
+    sites_[it->second.site].count += extra;
+  }
+}
+
+ValgrindReport ValgrindXmlParser::report(size_t top) const {
+  ValgrindReport report;
+  std::map<std::string, long long> leaked;
+  for (const auto &[kind, totals] : kinds_) {
+    report.errors.push_back({kind, static_cast<int>(totals.count)});
+    if (isLeakKind(kind)) {
+      leaked[kind] = totals.leaked_bytes;
+    }
+  }
+  std::stable_sort(report.errors.begin(), report.errors.end(),
+                   [](const ValgrindError &a, const ValgrindError &b) { return a.count > b.count; });
+  if (!leaked.empty()) {
+    LeakSummary summary;
+    leakKb(leaked, "Leak_DefinitelyLost", summary.definitely_lost_kb);
+    leakKb(leaked, "Leak_IndirectlyLost", summary.indirectly_lost_kb);
+    leakKb(leaked, "Leak_PossiblyLost", summary.possibly_lost_kb);
+    leakKb(leaked, "Leak_StillReachable", summary.still_reachable_kb);
+    report.leak_summary = summary;
+  }
+  std::vector<size_t> order(sites_.size());
+  for (size_t index = 0; index < order.size(); ++index) {
+    order[index] = index;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    if (sites_[a].leaked_bytes != sites_[b].leaked_bytes) {
+      return sites_[a].leaked_bytes > sites_[b].leaked_bytes;
+    }
+    return sites_[a].count > sites_[b].count;
+  });
+  for (size_t index = 0; index < order.size() && index < top; ++index) {
+    report.sites.push_back(sites_[order[index]]);
+  }
+  report.unattributed_errors = unattributed_;
+  return report;
+}
+
+} // namespace proccli
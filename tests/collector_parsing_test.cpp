@@ -1,5 +1,11 @@
 #include <gtest/gtest.h>
 
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include <unistd.h>
+
 #include "proccli/collectors.h"
 
 TEST(PsCollectorTest, ParsesProcessLine) {
@@ -16,6 +22,16 @@ TEST(PsCollectorTest, ParsesProcessLine) {
   EXPECT_EQ(result[0].etime, "00:00:05");
 }
 
+TEST(PsCollectorTest, RoundTripsThreadCount) {
+  proccli::ProcessInfo info{42, 1, "java -jar app.jar", 2048, 4096, 12.5, 1.5, "1-02:03:04", 37};
+  auto result = proccli::PsCollector::parse(proccli::PsCollector::format({info}));
+  ASSERT_EQ(result.size(), 1u);
+  EXPECT_EQ(result[0].cmd, "java -jar app.jar");
+  EXPECT_EQ(result[0].etime, "1-02:03:04");
+  EXPECT_EQ(result[0].num_threads, 37);
+  EXPECT_EQ(proccli::PsCollector::parse("7 1 sleep 60 10 20 0.0 0.0 00:05\n")[0].cmd, "sleep 60");
+}
+
 TEST(ProcfsCollectorTest, ParsesMemInfo) {
   std::string input = "MemTotal:       16384 kB\nMemFree:         4096 kB\nMemAvailable:    8192 kB\n";
   auto info = proccli::ProcfsCollector::parseMemInfo(input);
@@ -62,3 +78,116 @@ TEST(StraceCollectorTest, ParsesSyscalls) {
   EXPECT_EQ(report->top_syscalls[0].count, 2);
   EXPECT_FALSE(report->slow_syscalls.empty());
 }
+
+TEST(ProcfsCollectorTest, RanksThreadsByCpuDelta) {
+  auto ticks = static_cast<unsigned long long>(sysconf(_SC_CLK_TCK));
+  std::vector<proccli::ThreadSample> before = {{10, "main", 'S', 100, 5, 1, 0},
+                                               {11, "worker", 'R', 50, 1, 9, 3}};
+  std::vector<proccli::ThreadSample> after = {{10, "main", 'S', 101, 6, 1, 0},
+                                              {11, "worker", 'R', 50 + ticks, 1, 20, 3},
+                                              {12, "late", 'S', 2, 0, 0, 1}};
+  auto threads = proccli::ProcfsCollector::rankThreads(before, after, 1.0);
+  ASSERT_EQ(threads.size(), 3u);
+  EXPECT_EQ(threads[0].tid, 11);
+  EXPECT_DOUBLE_EQ(threads[0].cpu_delta_ms, 1000.0);
+  EXPECT_DOUBLE_EQ(threads[0].cpu_percent, 100.0);
+  EXPECT_EQ(threads[0].nonvoluntary_ctxt_switches, 20);
+  EXPECT_EQ(threads[0].last_cpu, 3);
+  EXPECT_EQ(threads[0].state, "R");
+  EXPECT_EQ(threads[1].tid, 12);
+  EXPECT_EQ(threads[2].tid, 10);
+}
+
+TEST(ProcfsCollectorTest, CollectsOwnThreads) {
+  std::atomic<bool> stop{false};
+  std::thread worker([&stop] {
+    while (!stop) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  });
+  proccli::ProcfsCollector collector;
+  auto threads = collector.collectThreads(getpid());
+  stop = true;
+  worker.join();
+  EXPECT_GE(threads.size(), 2u);
+  bool found_main = false;
+  for (const auto &thread : threads) {
+    if (thread.tid == getpid()) {
+      found_main = true;
+      EXPECT_FALSE(thread.name.empty());
+      EXPECT_GE(thread.voluntary_ctxt, 0);
+    }
+  }
+  EXPECT_TRUE(found_main);
+}
+
+TEST(ProcfsCollectorTest, ParsesSmapsRollup) {
+  std::string content =
+      "55f7158ce000-7ffe3152f000 ---p 00000000 00:00 0                          [rollup]\n"
+      "Rss:                1412 kB\nPss:                 473 kB\nPss_Anon:            104 kB\n"
+      "Pss_File:            369 kB\nPss_Shmem:             0 kB\nShared_Clean:       1268 kB\n"
+      "Shared_Dirty:          0 kB\nPrivate_Clean:        40 kB\nPrivate_Dirty:       104 kB\n"
+      "Anonymous:           104 kB\nSwap:                 12 kB\nSwapPss:               6 kB\n";
+  auto memory = proccli::ProcfsCollector::parseSmaps(7, content, false);
+  ASSERT_TRUE(memory.has_value());
+  EXPECT_EQ(memory->pid, 7);
+  EXPECT_EQ(memory->source, "smaps_rollup");
+  EXPECT_EQ(memory->rss_kb, 1412);
+  EXPECT_EQ(memory->pss_kb, 473);
+  EXPECT_EQ(memory->pss_anon_kb, 104);
+  EXPECT_EQ(memory->pss_file_kb, 369);
+  EXPECT_EQ(memory->shared_kb, 1268);
+  EXPECT_EQ(memory->private_kb, 144);
+  EXPECT_EQ(memory->swap_kb, 12);
+  EXPECT_EQ(memory->swap_pss_kb, 6);
+  EXPECT_TRUE(memory->regions.empty());
+}
+
+TEST(ProcfsCollectorTest, AggregatesSmapsByMapping) {
+  std::string mapping_fields = "Size: 8 kB\nRss: 8 kB\nPss: 4 kB\nShared_Clean: 8 kB\n"
+                               "Anonymous: 0 kB\nSwap: 0 kB\nVmFlags: rd mr mw me\n";
+  std::string anon_fields = "Size: 100 kB\nRss: 60 kB\nPss: 60 kB\nPrivate_Dirty: 60 kB\n"
+                            "Anonymous: 60 kB\nSwap: 40 kB\n";
+  std::string content;
+  content += "7f0000000000-7f0000002000 r--p 00000000 fe:00 12 /usr/lib/libc.so.6\n" +
+             mapping_fields;
+  content += "7f0000002000-7f0000004000 r-xp 00002000 fe:00 12 /usr/lib/libc.so.6\n" +
+             mapping_fields;
+  content += "55c000000000-55c000019000 rw-p 00000000 00:00 0          [heap]\n" + anon_fields;
+  for (int i = 0; i < 100000; ++i) {
+    content += "7e0000000000-7e0000019000 rw-p 00000000 00:00 0 \n" + anon_fields;
+  }
+  auto memory = proccli::ProcfsCollector::parseSmaps(9, content, true);
+  ASSERT_TRUE(memory.has_value());
+  EXPECT_EQ(memory->source, "smaps");
+  EXPECT_EQ(memory->rss_kb, 16 + 60 * 100001);
+  EXPECT_EQ(memory->pss_file_kb, 8);
+  EXPECT_EQ(memory->pss_anon_kb, 60 * 100001);
+  ASSERT_EQ(memory->regions.size(), 3u);
+  EXPECT_EQ(memory->regions[0].name, "[anon]");
+  EXPECT_EQ(memory->regions[0].mappings, 100000);
+  EXPECT_EQ(memory->regions[0].swap_kb, 40LL * 100000);
+  EXPECT_EQ(memory->regions[1].name, "[heap]");
+  EXPECT_EQ(memory->regions[2].name, "/usr/lib/libc.so.6");
+  EXPECT_EQ(memory->regions[2].mappings, 2);
+  EXPECT_EQ(memory->regions[2].shared_kb, 16);
+}
+
+TEST(PerfCollectorTest, RejectsMalformedLines) {
+  std::string output = "12.00%x\n12.00% one\n  7.5%  app  [.] main\n1.25%  \n  3.75%\tapp\t[.]\tleaf\n";
+  auto report = proccli::PerfCollector::parse(output);
+  ASSERT_TRUE(report.has_value());
+  ASSERT_EQ(report->hotspots.size(), 2u);
+  EXPECT_EQ(report->hotspots[0].symbol, "main");
+  EXPECT_DOUBLE_EQ(report->hotspots[1].percent, 3.75);
+}
+
+TEST(PsCollectorTest, SkipsLinesWithNonNumericColumns) {
+  std::string output = "  PID  PPID CMD RSS VSZ %CPU %MEM ELAPSED\n"
+                       "7 1 a   b\tc 10 20 x.y 0.5 01:00\n"
+                       "8 1 a   b\tc 10 20 1.5 0.5 01:00\n";
+  auto result = proccli::PsCollector::parse(output);
+  ASSERT_EQ(result.size(), 1u);
+  EXPECT_EQ(result[0].pid, 8);
+  EXPECT_EQ(result[0].cmd, "a b c");
+}
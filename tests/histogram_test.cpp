@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/collectors.h"
+#include "proccli/histogram.h"
+
+TEST(LatencyHistogramTest, BucketsAreContiguousAndBounded) {
+  using proccli::LatencyHistogram;
+  for (size_t i = 1; i < LatencyHistogram::kBucketCount; ++i) {
+    ASSERT_EQ(LatencyHistogram::bucketLowest(i), LatencyHistogram::bucketHighest(i - 1) + 1);
+  }
+  for (std::uint64_t value : {std::uint64_t{0}, std::uint64_t{31}, std::uint64_t{32},
+                              std::uint64_t{1000}, std::uint64_t{123456789},
+                              LatencyHistogram::kMaxValue}) {
+    size_t index = LatencyHistogram::bucketIndex(value);
+    EXPECT_LE(LatencyHistogram::bucketLowest(index), value);
+    EXPECT_GE(LatencyHistogram::bucketHighest(index), value);
+    double width = LatencyHistogram::bucketHighest(index) - LatencyHistogram::bucketLowest(index);
+    EXPECT_LE(width, value / 32.0);
+  }
+  EXPECT_EQ(LatencyHistogram::bucketIndex(~0ULL), LatencyHistogram::kBucketCount - 1);
+}
+
+TEST(LatencyHistogramTest, SeparatesLongTailFromUniformlySlow) {
+  proccli::LatencyHistogram tail;
+  proccli::LatencyHistogram slow;
+  for (int i = 0; i < 1000; ++i) {
+    tail.record(i < 980 ? 5 : 200000);
+    slow.record(50000);
+  }
+  auto tail_summary = tail.summary();
+  EXPECT_DOUBLE_EQ(tail_summary.p50_ms, 0.005);
+  EXPECT_DOUBLE_EQ(tail_summary.p99_ms, 200.0);
+  EXPECT_DOUBLE_EQ(tail_summary.max_ms, 200.0);
+  ASSERT_EQ(tail_summary.buckets.size(), 2u);
+  EXPECT_EQ(tail_summary.buckets[0].count, 980);
+  auto slow_summary = slow.summary();
+  EXPECT_NEAR(slow_summary.p50_ms, 50.0, 50.0 / 32);
+  EXPECT_EQ(slow_summary.p50_ms, slow_summary.p999_ms);
+}
+
+TEST(LatencyHistogramTest, MergeMatchesSingleHistogram) {
+  proccli::LatencyHistogram whole;
+  proccli::LatencyHistogram left;
+  proccli::LatencyHistogram right;
+  for (std::uint64_t value = 1; value < 100000; value = value * 3 + 1) {
+    whole.record(value, value % 7 + 1);
+    (value % 2 == 0 ? left : right).record(value, value % 7 + 1);
+  }
+  left.merge(right);
+  auto merged = left.summary();
+  auto expected = whole.summary();
+  EXPECT_EQ(merged.count, expected.count);
+  EXPECT_EQ(merged.p999_ms, expected.p999_ms);
+  EXPECT_EQ(merged.max_ms, expected.max_ms);
+  ASSERT_EQ(merged.buckets.size(), expected.buckets.size());
+  for (size_t i = 0; i < merged.buckets.size(); ++i) {
+    EXPECT_EQ(merged.buckets[i].lowest_us, expected.buckets[i].lowest_us);
+    EXPECT_EQ(merged.buckets[i].count, expected.buckets[i].count);
+  }
+  auto rebuilt = proccli::LatencyHistogram::fromSummary(expected).summary();
+  EXPECT_EQ(rebuilt.p90_ms, expected.p90_ms);
+  EXPECT_EQ(rebuilt.max_ms, expected.max_ms);
+}
+
+TEST(LatencyHistogramTest, StraceReportCarriesLatencyThroughJson) {
+  proccli::StraceAggregator first;
+  proccli::StraceAggregator second;
+  first.addLine("futex(0x1, FUTEX_WAIT, 0, NULL) = 0 <0.000004>");
+  first.addLine("futex(0x1, FUTEX_WAIT, 0, NULL) = 0 <0.000006>");
+  second.addLine("futex(0x1, FUTEX_WAIT, 0, NULL) = 0 <0.750000>");
+  first.merge(second);
+  auto report = first.report();
+  ASSERT_EQ(report.top_syscalls.size(), 1u);
+  ASSERT_TRUE(report.top_syscalls[0].latency.has_value());
+  EXPECT_EQ(report.top_syscalls[0].latency->count, 3);
+  EXPECT_DOUBLE_EQ(report.top_syscalls[0].latency->max_ms, 750.0);
+  EXPECT_EQ(first.lines(), 3u);
+
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.strace = report;
+  nlohmann::json j = snapshot;
+  auto restored = proccli::snapshotFromJson(j);
+  ASSERT_TRUE(restored.strace.has_value());
+  ASSERT_TRUE(restored.strace->top_syscalls[0].latency.has_value());
+  EXPECT_EQ(restored.strace->top_syscalls[0].latency->buckets.size(), 3u);
+  EXPECT_DOUBLE_EQ(restored.strace->top_syscalls[0].latency->p50_ms, 0.006);
+}
@@ -0,0 +1,110 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+
+#include <unistd.h>
+
+#include "proccli/history.h"
+#include "proccli/snapshot_binary.h"
+#include "proccli/utils.h"
+
+namespace {
+
+proccli::DiagnosticsSnapshot runSnapshot(const std::string &captured_at, long long rss_kb,
+                                         const std::string &perf_status) {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 42;
+  snapshot.target.command = "./server\t--port 80";
+  snapshot.timing.captured_at = captured_at;
+  snapshot.processes = {{42, 1, "./server", rss_kb, 4096, 12.5, 0.5, "00:01", 4}};
+  snapshot.io = {{42, 100, 200}};
+  proccli::PerfReport perf;
+  perf.hotspots = {{"parse", 20.0}, {"main", 60.0}};
+  snapshot.perf = perf;
+  proccli::StraceReport strace;
+  strace.top_syscalls = {{"read", 10, 2.5, std::nullopt}, {"futex", 3, 40.0, std::nullopt}};
+  snapshot.strace = strace;
+  snapshot.quality.collectors = {{"ps", "ok", std::nullopt, 1.0},
+                                 {"perf", perf_status, std::nullopt, 2.0},
+                                 {"valgrind", "disabled", std::nullopt, std::nullopt}};
+  return snapshot;
+}
+
+} // namespace
+
+TEST(HistoryTest, SummarizesSnapshotIntoOneRow) {
+  auto entry = proccli::summarizeRun("artifacts/a", runSnapshot("2026-01-01T00:00:00Z", 2048, "ok"));
+  EXPECT_EQ(entry.pid, 42);
+  EXPECT_DOUBLE_EQ(entry.cpu_percent, 12.5);
+  EXPECT_EQ(entry.rss_kb, 2048);
+  EXPECT_EQ(entry.write_bytes, 200);
+  EXPECT_EQ(entry.status, "ok");
+  EXPECT_EQ(entry.top_hotspot, "main");
+  EXPECT_EQ(entry.top_syscall, "futex");
+
+  auto row = proccli::formatHistoryRow(entry);
+  auto parsed = proccli::parseHistoryRow(row);
+  ASSERT_TRUE(parsed.has_value());
+  EXPECT_EQ(parsed->command, "./server --port 80");
+  EXPECT_EQ(parsed->dir, "artifacts/a");
+  EXPECT_EQ(parsed->rss_kb, 2048);
+  EXPECT_DOUBLE_EQ(parsed->top_syscall_ms, 40.0);
+  EXPECT_FALSE(proccli::parseHistoryRow("artifacts/a\tonly\tthree").has_value());
+}
+
+TEST(HistoryTest, AppendsQueriesAndRebuildsIndex) {
+  namespace fs = std::filesystem;
+  fs::path root = fs::temp_directory_path() / ("proccli-history-" + std::to_string(getpid()));
+  fs::remove_all(root);
+  std::string error;
+  const char *stamps[] = {"2026-01-01T00:00:00Z", "2026-01-02T00:00:00Z", "2026-01-03T00:00:00Z"};
+  long long rss[] = {1000, 3000, 2000};
+  for (int i = 0; i < 3; ++i) {
+    std::string dir = (root / stamps[i]).string();
+    auto snapshot = runSnapshot(stamps[i], rss[i], i == 1 ? "partial" : "ok");
+    fs::create_directories(dir);
+    ASSERT_TRUE(proccli::writeSnapshotBinary(dir + "/normalized.bin", snapshot, error)) << error;
+    ASSERT_TRUE(proccli::appendHistory(root.string(), proccli::summarizeRun(dir, snapshot), error))
+        << error;
+  }
+  auto updated = proccli::summarizeRun((root / stamps[0]).string(),
+                                       runSnapshot(stamps[0], 1500, "ok"));
+  ASSERT_TRUE(proccli::appendHistory(root.string(), updated, error)) << error;
+
+  auto entries = proccli::readHistory(root.string(), error);
+  ASSERT_TRUE(error.empty()) << error;
+  ASSERT_EQ(entries.size(), 3u);
+
+  proccli::HistoryQuery by_rss;
+  by_rss.sort = "rss";
+  auto sorted = proccli::queryHistory(entries, by_rss);
+  EXPECT_EQ(sorted[0].rss_kb, 3000);
+  EXPECT_EQ(sorted[2].rss_kb, 1500);
+
+  proccli::HistoryQuery partial;
+  partial.status = "partial";
+  auto failing = proccli::queryHistory(entries, partial);
+  ASSERT_EQ(failing.size(), 1u);
+  EXPECT_EQ(failing[0].captured_at, stamps[1]);
+
+  proccli::HistoryQuery window;
+  window.since = "2026-01-02";
+  window.until = "2026-01-02";
+  EXPECT_EQ(proccli::queryHistory(entries, window).size(), 1u);
+
+  proccli::HistoryQuery latest;
+  latest.limit = 2;
+  auto recent = proccli::queryHistory(entries, latest);
+  ASSERT_EQ(recent.size(), 2u);
+  EXPECT_EQ(recent[1].captured_at, stamps[2]);
+
+  fs::remove(proccli::historyIndexPath(root.string()));
+  size_t runs = 0;
+  ASSERT_TRUE(proccli::rebuildHistory(root.string(), runs, error)) << error;
+  EXPECT_EQ(runs, 3u);
+  auto rebuilt = proccli::readHistory(root.string(), error);
+  ASSERT_EQ(rebuilt.size(), 3u);
+  EXPECT_EQ(rebuilt[0].captured_at, stamps[0]);
+  EXPECT_EQ(rebuilt[0].rss_kb, 1000);
+  fs::remove_all(root);
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "proccli/http_client.h"
+#include "stub_http_server.h"
+
+namespace {
+
+std::string okResponse(const std::string &body) {
+  return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+} // namespace
+
+TEST(HttpClientTest, ReusesKeepAliveConnection) {
+  StubHttpServer server([](int fd, const std::string &) {
+    StubHttpServer::send(fd, okResponse("hello"));
+    return true;
+  });
+  proccli::HttpClient client("127.0.0.1", server.port());
+  auto first = client.get("/one");
+  auto second = client.post("/two", "text/plain", "payload");
+  ASSERT_TRUE(first.error.empty()) << first.error;
+  ASSERT_TRUE(second.error.empty()) << second.error;
+  EXPECT_EQ(first.status, 200);
+  EXPECT_EQ(first.body, "hello");
+  EXPECT_EQ(second.body, "hello");
+  EXPECT_EQ(first.header("content-length"), "5");
+  EXPECT_EQ(server.connections(), 1);
+  auto requests = server.requests();
+  ASSERT_EQ(requests.size(), 2u);
+  EXPECT_EQ(requests[0].rfind("GET /one HTTP/1.1\r\n", 0), 0u);
+  EXPECT_NE(requests[1].find("Content-Length: 7\r\n"), std::string::npos);
+  EXPECT_EQ(requests[1].substr(requests[1].size() - 7), "payload");
+}
+
+TEST(HttpClientTest, DecodesChunkedBodyAcrossSplitWrites) {
+  StubHttpServer server([](int fd, const std::string &) {
+    StubHttpServer::send(fd, "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5;ext=1\r\nhel");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    StubHttpServer::send(fd, "lo\r\nA\r\n, chunked!\r\n0\r\nX-Trailer: yes\r\n\r\n");
+    return true;
+  });
+  proccli::HttpClient client("127.0.0.1", server.port());
+  std::string streamed;
+  int pieces = 0;
+  auto response = client.get("/", [&](std::string_view data) {
+    streamed.append(data);
+    ++pieces;
+    return true;
+  });
+  ASSERT_TRUE(response.error.empty()) << response.error;
+  EXPECT_EQ(streamed, "hello, chunked!");
+  EXPECT_GE(pieces, 3);
+  EXPECT_TRUE(response.body.empty());
+  EXPECT_TRUE(client.connected());
+}
+
+TEST(HttpClientTest, ReadsUntilCloseWithoutLength) {
+  StubHttpServer server([](int fd, const std::string &) {
+    StubHttpServer::send(fd, "HTTP/1.0 200 OK\r\n\r\nuntil close");
+    return false;
+  });
+  proccli::HttpClient client("127.0.0.1", server.port());
+  auto response = client.get("/");
+  ASSERT_TRUE(response.error.empty()) << response.error;
+  EXPECT_EQ(response.body, "until close");
+  EXPECT_FALSE(client.connected());
+}
+
+TEST(HttpClientTest, TimesOutWhenServerStalls) {
+  StubHttpServer server([](int fd, const std::string &) {
+    StubHttpServer::send(fd, "HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\nabc");
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    return false;
+  });
+  proccli::HttpClient client("127.0.0.1", server.port(), proccli::HttpOptions{1000, 50});
+  auto response = client.get("/");
+  EXPECT_NE(response.error.find("timed out after 50 ms"), std::string::npos) << response.error;
+  EXPECT_FALSE(client.connected());
+}
+
+TEST(HttpClientTest, ReportsRefusedConnection) {
+  int port = 0;
+  {
+    StubHttpServer server([](int, const std::string &) { return false; });
+    port = server.port();
+  }
+  proccli::HttpClient client("127.0.0.1", port);
+  auto response = client.get("/");
+  EXPECT_EQ(response.status, 0);
+  EXPECT_NE(response.error.find("cannot connect to 127.0.0.1"), std::string::npos)
+      << response.error;
+}
+
+TEST(HttpClientTest, RetriesWhenKeepAliveConnectionWentStale) {
+  StubHttpServer server([](int fd, const std::string &) {
+    StubHttpServer::send(fd, okResponse("ok"));
+    return false;
+  });
+  proccli::HttpClient client("127.0.0.1", server.port());
+  auto first = client.get("/");
+  ASSERT_TRUE(first.error.empty()) << first.error;
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  auto second = client.get("/");
+  ASSERT_TRUE(second.error.empty()) << second.error;
+  EXPECT_EQ(second.body, "ok");
+  EXPECT_EQ(server.connections(), 2);
+}
+
+TEST(HttpClientTest, AbortsWhenCallbackDeclines) {
+  StubHttpServer server([](int fd, const std::string &) {
+    StubHttpServer::send(fd, okResponse("0123456789"));
+    return true;
+  });
+  proccli::HttpClient client("127.0.0.1", server.port());
+  auto response = client.get("/", [](std::string_view) { return false; });
+  EXPECT_NE(response.error.find("aborted"), std::string::npos);
+  EXPECT_FALSE(client.connected());
+}
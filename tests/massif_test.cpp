@@ -0,0 +1,121 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/collectors.h"
+#include "proccli/massif.h"
+#include "proccli/utils.h"
+
+namespace {
+
+std::string sampleMassif() {
+  return proccli::readFile(std::string(PROCCLI_TEST_DATA_DIR) + "/massif.out");
+}
+
+} // namespace
+
+TEST(MassifParserTest, ExtractsTimelineAndPeakSites) {
+  auto profile = proccli::parseMassif(sampleMassif());
+  ASSERT_TRUE(profile);
+  EXPECT_EQ(profile->command, "./grower --records 5000");
+  EXPECT_EQ(profile->time_unit, "ms");
+  ASSERT_EQ(profile->timeline.size(), 6u);
+  EXPECT_EQ(profile->timeline[3].time, 398);
+  EXPECT_EQ(profile->timeline[3].extra_bytes, 8192);
+  EXPECT_EQ(profile->peak_snapshot, 3);
+  EXPECT_EQ(profile->peak_heap_bytes, 1048576);
+  ASSERT_EQ(profile->peak_sites.size(), 3u);
+  EXPECT_EQ(profile->peak_sites[0].bytes, 524288);
+  EXPECT_DOUBLE_EQ(profile->peak_sites[0].percent, 50.0);
+  ASSERT_EQ(profile->peak_sites[0].stack.size(), 3u);
+  EXPECT_EQ(profile->peak_sites[0].stack[0], "Table::grow(unsigned long) (table.cc:41)");
+  EXPECT_EQ(profile->peak_sites[0].stack[2], "main (grower.cc:22)");
+  EXPECT_EQ(profile->peak_sites[1].stack[1], "main (grower.cc:18)");
+  EXPECT_EQ(profile->peak_sites[2].stack[1], "Record::parse(char const*) (record.cc:30)");
+}
+
+TEST(MassifParserTest, ChunkedFeedMatchesWholeFile) {
+  std::string text = sampleMassif();
+  proccli::MassifParser parser;
+  for (size_t offset = 0; offset < text.size(); offset += 7) {
+    parser.feed(std::string_view(text).substr(offset, 7));
+  }
+  EXPECT_EQ(nlohmann::json(*parser.profile()), nlohmann::json(*proccli::parseMassif(text)));
+}
+
+TEST(MassifParserTest, FallsBackToLargestDetailedSnapshotWithoutPeak) {
+  std::string text = sampleMassif();
+  text.replace(text.find("heap_tree=peak"), 14, "heap_tree=detailed");
+  auto profile = proccli::parseMassif(text);
+  ASSERT_TRUE(profile);
+  EXPECT_EQ(profile->peak_snapshot, 3);
+  EXPECT_EQ(profile->peak_sites.size(), 3u);
+}
+
+TEST(MassifParserTest, KeepsOnlyTopSitesOfLargeTrees) {
+  std::string text = "cmd: ./big\ntime_unit: i\n#-----------\nsnapshot=0\n#-----------\n"
+                     "time=10\nmem_heap_B=5000050000\nmem_heap_extra_B=0\nmem_stacks_B=0\n"
+                     "heap_tree=peak\nn100000: 5000050000 (heap allocation functions) malloc\n";
+  for (int index = 1; index <= 100000; ++index) {
+    text += " n0: " + std::to_string(index) + " 0x4005A1: alloc_" + std::to_string(index) +
+            " (big.c:" + std::to_string(index) + ")\n";
+  }
+  proccli::MassifParser parser(5);
+  parser.feed(text);
+  auto profile = parser.profile();
+  ASSERT_TRUE(profile);
+  ASSERT_EQ(profile->peak_sites.size(), 5u);
+  EXPECT_EQ(profile->peak_sites[0].bytes, 100000);
+  EXPECT_EQ(profile->peak_sites[4].bytes, 99996);
+}
+
+TEST(MassifParserTest, RejectsFilesWithoutSnapshots) {
+  std::string error;
+  EXPECT_FALSE(proccli::parseMassif("desc: none\n"));
+  EXPECT_FALSE(proccli::readMassifFile("/nonexistent/massif.out", error));
+  EXPECT_FALSE(error.empty());
+}
+
+TEST(MassifCollectorTest, RunsMassifAndParsesItsOutput) {
+  auto dir = std::filesystem::temp_directory_path() / ("proccli-massif-" + std::to_string(getpid()));
+  std::filesystem::create_directories(dir);
+  auto script = dir / "valgrind";
+  std::ofstream(script) << "#!/bin/sh\n"
+                           "while [ $# -gt 0 ]; do\n"
+                           "  case \"$1\" in\n"
+                           "    --massif-out-file=*) out=\"${1#--massif-out-file=}\" ;;\n"
+                           "    --*) ;;\n"
+                           "    *) break ;;\n"
+                           "  esac\n"
+                           "  shift\n"
+                           "done\n"
+                           "cp \"$PROCCLI_FAKE_MASSIF\" \"$out\"\n"
+                           "exec \"$@\"\n";
+  std::filesystem::permissions(script, std::filesystem::perms::owner_all);
+  std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+  setenv("PATH", (dir.string() + ":" + old_path).c_str(), 1);
+  std::string fixture = std::string(PROCCLI_TEST_DATA_DIR) + "/massif.out";
+  setenv("PROCCLI_FAKE_MASSIF", fixture.c_str(), 1);
+
+  proccli::ValgrindCollector collector;
+  proccli::ValgrindRunOptions options;
+  options.tool = "massif";
+  options.massif_path = (dir / "massif.out").string();
+  std::string error;
+  int pid = collector.start("true", options, error);
+  ASSERT_GT(pid, 0) << error;
+  auto result = collector.finish();
+  setenv("PATH", old_path.c_str(), 1);
+  unsetenv("PROCCLI_FAKE_MASSIF");
+  ASSERT_TRUE(result.ok) << result.error;
+  ASSERT_TRUE(result.heap_profile);
+  EXPECT_EQ(result.heap_profile->peak_snapshot, 3);
+  std::filesystem::remove_all(dir);
+}
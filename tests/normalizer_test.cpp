@@ -1,6 +1,13 @@
 #include <gtest/gtest.h>
 
+#include <filesystem>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
 #include "proccli/normalizer.h"
+#include "proccli/utils.h"
 
 TEST(NormalizerTest, BuildsSnapshotFromArtifacts) {
   proccli::RawArtifacts artifacts;
@@ -27,3 +34,116 @@ TEST(NormalizerTest, BuildsSnapshotFromArtifacts) {
   EXPECT_EQ(snapshot.io[0].read_bytes, 100);
   ASSERT_EQ(snapshot.quality.collectors.size(), 2u);
 }
+
+TEST(NormalizerTest, RenormalizesArtifactDirectory) {
+  namespace fs = std::filesystem;
+  fs::path dir = fs::temp_directory_path() / ("proccli-normalize-" + std::to_string(getpid()));
+  fs::remove_all(dir);
+  proccli::DiagnosticsSnapshot previous;
+  previous.target.pid = 123;
+  previous.target.command = "./server";
+  previous.timing.captured_at = "2026-01-01T00:00:00Z";
+  previous.quality.collectors.push_back({"ps", "ok", std::nullopt, std::nullopt});
+  previous.system.meminfo = proccli::MemInfo{1, 1, 1};
+  proccli::writeFile((dir / "normalized.json").string(), nlohmann::json(previous).dump());
+  proccli::writeFile((dir / "raw/ps.txt").string(),
+                     "123 1 ./server 2048 4096 10.0 0.2 00:00:05 4\n"
+                     "124 123 worker 1024 2048 5.0 0.1 00:00:04 2\n");
+  proccli::writeFile((dir / "raw/meminfo.txt").string(), "MemTotal: 16384 kB\nMemFree: 4096 kB\n");
+  proccli::writeFile((dir / "raw/io.txt").string(), "read_bytes: 100\nwrite_bytes: 200\n");
+  proccli::writeFile((dir / "raw/io-124.txt").string(), "read_bytes: 7\nwrite_bytes: 9\n");
+  proccli::PerfReport perf;
+  perf.event = "cpu-clock";
+  perf.samples = 40;
+  perf.lost = 2;
+  perf.hotspots = {{"main", 75.0}, {"[libc.so.6]", 25.0}};
+  proccli::writeFile((dir / "raw/perf.txt").string(), proccli::PerfCollector::format(perf));
+  proccli::writeFile((dir / "raw/perf.folded").string(),
+                     "server;main;work 30\nserver;main 10\nserver;[libc.so.6] 10\n");
+  proccli::writeFile((dir / "raw/strace.txt").string(),
+                     "read(3, \"\", 1) = 0 <0.000010>\nread(3, \"\", 1) = 0 <0.000030>\n");
+  proccli::writeFile((dir / "raw/counters.json").string(),
+                     R"({"duration_s": 1.0, "hardware": false, "multiplexed": false,)"
+                     R"( "process": {"tid": 123, "page_faults": 12, "context_switches": 3,)"
+                     R"( "cpu_migrations": 0}})");
+
+  std::string error;
+  auto snapshot = proccli::normalizeArtifactDir(dir.string(), error, 2);
+  ASSERT_TRUE(snapshot.has_value()) << error;
+  EXPECT_EQ(snapshot->target.command, "./server");
+  EXPECT_EQ(snapshot->timing.captured_at, "2026-01-01T00:00:00Z");
+  ASSERT_EQ(snapshot->quality.collectors.size(), 1u);
+  ASSERT_EQ(snapshot->processes.size(), 2u);
+  ASSERT_TRUE(snapshot->system.meminfo.has_value());
+  EXPECT_EQ(snapshot->system.meminfo->mem_total_kb, 16384);
+  ASSERT_EQ(snapshot->io.size(), 2u);
+  EXPECT_EQ(snapshot->io[1].pid, 124);
+  ASSERT_TRUE(snapshot->process_tree.has_value());
+  ASSERT_FALSE(snapshot->process_tree->nodes.empty());
+  EXPECT_EQ(snapshot->process_tree->nodes[0].num_threads, 4);
+  EXPECT_EQ(snapshot->process_tree->nodes[0].subtree_threads, 6);
+  ASSERT_TRUE(snapshot->perf.has_value());
+  EXPECT_EQ(snapshot->perf->event, "cpu-clock");
+  EXPECT_EQ(snapshot->perf->samples, 40);
+  EXPECT_EQ(snapshot->perf->lost, 2);
+  ASSERT_EQ(snapshot->perf->hotspots.size(), 2u);
+  ASSERT_FALSE(snapshot->perf->frames.empty());
+  EXPECT_EQ(snapshot->perf->frames[0].symbol, "main");
+  EXPECT_DOUBLE_EQ(snapshot->perf->frames[0].inclusive_percent, 80.0);
+  ASSERT_TRUE(snapshot->strace.has_value());
+  EXPECT_EQ(snapshot->strace->top_syscalls[0].count, 2);
+  EXPECT_DOUBLE_EQ(snapshot->strace->top_syscalls[0].time_ms, 0.04);
+  ASSERT_TRUE(snapshot->counters.has_value());
+  EXPECT_EQ(snapshot->counters->process.page_faults, 12);
+  fs::remove_all(dir);
+}
+
+TEST(NormalizerTest, PerfHotspotsSurviveRenormalize) {
+  namespace fs = std::filesystem;
+  fs::path dir = fs::temp_directory_path() / ("proccli-perf-hotspots-" + std::to_string(getpid()));
+  fs::remove_all(dir);
+  proccli::PerfReport perf;
+  perf.event = "cpu-clock";
+  perf.samples = 3;
+  perf.hotspots = {{"std::vector<int, std::allocator<int> >::push_back(int const&)", 100.0 / 3},
+                   {"foo(int, char)", 2.0 / 3 * 100},
+                   {"[k] lookalike", 0.001}};
+  proccli::writeFile((dir / "raw/perf.txt").string(), proccli::PerfCollector::format(perf));
+
+  std::string error;
+  auto snapshot = proccli::normalizeArtifactDir(dir.string(), error);
+  ASSERT_TRUE(snapshot.has_value()) << error;
+  ASSERT_TRUE(snapshot->perf.has_value());
+  ASSERT_EQ(snapshot->perf->hotspots.size(), perf.hotspots.size());
+  for (size_t index = 0; index < perf.hotspots.size(); ++index) {
+    EXPECT_EQ(snapshot->perf->hotspots[index].symbol, perf.hotspots[index].symbol);
+    EXPECT_EQ(snapshot->perf->hotspots[index].percent, perf.hotspots[index].percent);
+  }
+  fs::remove_all(dir);
+}
+
+TEST(NormalizerTest, RejectsDirectoryWithoutRawArtifacts) {
+  std::string error;
+  EXPECT_FALSE(proccli::normalizeArtifactDir("/nonexistent/proccli", error).has_value());
+  EXPECT_NE(error.find("raw"), std::string::npos);
+}
+
+TEST(MappedFileTest, MapsAndReleasesFilePages) {
+  namespace fs = std::filesystem;
+  fs::path path = fs::temp_directory_path() / ("proccli-mapped-" + std::to_string(getpid()));
+  std::string content(3 * 4096 + 17, 'x');
+  content[5000] = 'y';
+  proccli::writeFile(path.string(), content);
+  proccli::MappedFile file;
+  std::string error;
+  ASSERT_TRUE(file.open(path.string(), error)) << error;
+  ASSERT_EQ(file.view(), content);
+  file.release(file.view());
+  EXPECT_EQ(file.view(), content);
+  proccli::writeFile(path.string(), "");
+  proccli::MappedFile empty;
+  ASSERT_TRUE(empty.open(path.string(), error));
+  EXPECT_TRUE(empty.view().empty());
+  fs::remove(path);
+  EXPECT_FALSE(proccli::MappedFile().open(path.string(), error));
+}
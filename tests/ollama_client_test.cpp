@@ -0,0 +1,155 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/ollama_client.h"
+#include "proccli/snapshot_compact.h"
+#include "stub_http_server.h"
+
+namespace {
+
+proccli::OllamaOptions localOptions(int port) {
+  proccli::OllamaOptions options;
+  options.host = "127.0.0.1";
+  options.port = port;
+  options.read_timeout_ms = 2000;
+  return options;
+}
+
+void sendChunk(int fd, const std::string &data) {
+  char size[32];
+  std::snprintf(size, sizeof(size), "%zx\r\n", data.size());
+  StubHttpServer::send(fd, size + data + "\r\n");
+}
+
+} // namespace
+
+TEST(OllamaClientTest, StreamsTokensFromChunkedNdjson) {
+  StubHttpServer server([](int fd, const std::string &) {
+    StubHttpServer::send(fd, "HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\n"
+                             "Transfer-Encoding: chunked\r\n\r\n");
+    sendChunk(fd, "{\"response\":\"Say \\\"hi\\\"\",\"done\":false}\n{\"resp");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    sendChunk(fd, "onse\":\" \\u00e9t\\u00e9\",\"done\":false}\n");
+    sendChunk(fd, "{\"response\":\"\",\"done\":true,\"total_duration\":1}\n");
+    sendChunk(fd, "");
+    return true;
+  });
+  proccli::OllamaClient client(localOptions(server.port()));
+  std::vector<std::string> tokens;
+  proccli::DiagnosticsSnapshot snapshot;
+  auto result = client.analyze(snapshot, "llama3",
+                               [&](std::string_view token) { tokens.emplace_back(token); });
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.response, "Say \"hi\" \xc3\xa9t\xc3\xa9");
+  ASSERT_EQ(tokens.size(), 2u);
+  EXPECT_EQ(tokens[0], "Say \"hi\"");
+  EXPECT_GT(result.total_ms, 0.0);
+  EXPECT_LE(result.first_token_ms, result.total_ms);
+
+  auto requests = server.requests();
+  ASSERT_EQ(requests.size(), 1u);
+  EXPECT_EQ(requests[0].rfind("POST /api/generate HTTP/1.1\r\n", 0), 0u);
+  auto body = nlohmann::json::parse(requests[0].substr(requests[0].find("\r\n\r\n") + 4));
+  EXPECT_EQ(body["model"], "llama3");
+  EXPECT_EQ(body["stream"], true);
+  EXPECT_EQ(body["options"]["num_ctx"], 6144 + 2048);
+  EXPECT_FALSE(body.contains("input"));
+  const auto &prompt = body["prompt"].get_ref<const std::string &>();
+  auto snapshot_start = prompt.find('{');
+  ASSERT_NE(snapshot_start, std::string::npos) << prompt;
+  EXPECT_GT(snapshot_start, 0u);
+  auto sent = nlohmann::json::parse(prompt.substr(snapshot_start));
+  EXPECT_TRUE(sent.contains("quality"));
+  EXPECT_EQ(result.prompt_tokens, proccli::estimateTokens(prompt));
+  EXPECT_LE(result.prompt_tokens, 6144u);
+}
+
+TEST(OllamaClientTest, CompactsLargeSnapshotToTokenBudget) {
+  StubHttpServer server([](int fd, const std::string &) {
+    std::string body = "{\"response\":\"ok\",\"done\":true}\n";
+    StubHttpServer::send(fd, "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) +
+                                 "\r\n\r\n" + body);
+    return true;
+  });
+  proccli::DiagnosticsSnapshot snapshot;
+  for (int i = 0; i < 20000; ++i) {
+    snapshot.processes.push_back({i + 1, 1, "worker " + std::to_string(i), 1000, 2000, 0.1, 0.1,
+                                  "00:01", 1});
+  }
+  auto options = localOptions(server.port());
+  options.token_budget = 2048;
+  proccli::OllamaClient client(options);
+  auto result = client.analyze(snapshot, "llama3");
+  ASSERT_TRUE(result.ok) << result.error;
+  auto request = server.requests().at(0);
+  auto body = nlohmann::json::parse(request.substr(request.find("\r\n\r\n") + 4));
+  const auto &prompt = body["prompt"].get_ref<const std::string &>();
+  EXPECT_LE(proccli::estimateTokens(prompt), 2048u);
+  EXPECT_NE(prompt.find("\"processes\""), std::string::npos);
+  EXPECT_LE(result.prompt_tokens, 2048u);
+  EXPECT_NE(result.compaction.find("processes"), std::string::npos) << result.compaction;
+}
+
+TEST(OllamaClientTest, SendsLargePayloadWithoutLimits) {
+  size_t received = 0;
+  StubHttpServer server([&](int fd, const std::string &request) {
+    received = request.size();
+    std::string body = "{\"response\":\"ok\",\"done\":true}\n";
+    StubHttpServer::send(fd, "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(body.size()) +
+                                 "\r\n\r\n" + body);
+    return true;
+  });
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.command = std::string(4 << 20, 'x');
+  proccli::OllamaClient client(localOptions(server.port()));
+  auto result = client.analyze(snapshot, "llama3");
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.response, "ok");
+  EXPECT_GT(received, size_t{4 << 20});
+}
+
+TEST(OllamaClientTest, ReportsServerError) {
+  StubHttpServer server([](int fd, const std::string &) {
+    std::string body = "{\"error\":\"model 'missing' not found\"}";
+    StubHttpServer::send(fd, "HTTP/1.1 404 Not Found\r\nContent-Length: " +
+                                 std::to_string(body.size()) + "\r\n\r\n" + body);
+    return true;
+  });
+  proccli::OllamaClient client(localOptions(server.port()));
+  auto result = client.analyze(proccli::DiagnosticsSnapshot{}, "missing");
+  EXPECT_FALSE(result.ok);
+  EXPECT_EQ(result.error, "Ollama error: model 'missing' not found");
+}
+
+TEST(OllamaClientTest, FallsBackWhenServerIsUnreachable) {
+  int port = 0;
+  {
+    StubHttpServer server([](int, const std::string &) { return false; });
+    port = server.port();
+  }
+  proccli::OllamaClient client(localOptions(port));
+  auto result = client.analyze(proccli::DiagnosticsSnapshot{}, "llama3");
+  EXPECT_FALSE(result.ok);
+  EXPECT_NE(result.error.find("cannot connect"), std::string::npos) << result.error;
+  EXPECT_NE(result.response.find("Unable to reach local Ollama server"), std::string::npos);
+}
+
+TEST(OllamaClientTest, ParsesOllamaHostFromEnvironment) {
+  setenv("OLLAMA_HOST", "http://10.0.0.5:8080", 1);
+  auto options = proccli::ollamaOptionsFromEnv();
+  EXPECT_EQ(options.host, "10.0.0.5");
+  EXPECT_EQ(options.port, 8080);
+  setenv("OLLAMA_HOST", "[::1]", 1);
+  options = proccli::ollamaOptionsFromEnv();
+  EXPECT_EQ(options.host, "::1");
+  EXPECT_EQ(options.port, 11434);
+  unsetenv("OLLAMA_HOST");
+}
@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/collectors.h"
+#include "proccli/parallel.h"
+#include "proccli/stack_trie.h"
+
+namespace {
+
+std::string largeStrace() {
+  std::string text;
+  for (int i = 0; text.size() < 4 * proccli::kMinParseChunkBytes; ++i) {
+    text += "[pid " + std::to_string(100 + i % 7) + "] 10:00:00.000001 read(3, \"x\", 1) = 1 <0.0000" +
+            std::to_string(10 + i % 83) + ">\n";
+    if (i % 11 == 0) {
+      text += "futex(0x1, FUTEX_WAIT, 0, NULL) = 0 <0." + std::to_string(100000 + i % 997) + ">\n";
+    }
+    if (i % 13 == 0) {
+      text += "close(3) = 0 <0.001000>\n";
+    }
+  }
+  return text;
+}
+
+std::string largePerfScript() {
+  std::string text = "# header comment\n";
+  for (int i = 0; text.size() < 4 * proccli::kMinParseChunkBytes; ++i) {
+    text += "app " + std::to_string(10 + i % 3) + " 1.000" + std::to_string(i % 10) +
+            ": 250000 cpu-clock:\n";
+    text += "\t    5555 leaf" + std::to_string(i % 17) + "+0x1 (/usr/bin/app)\n";
+    if (i % 5 != 0) {
+      text += "\t    4444 middle" + std::to_string(i % 3) + " (/usr/bin/app)\n";
+    }
+    text += "\t    3333 main (/usr/bin/app)\n\n";
+  }
+  return text;
+}
+
+std::string folded(const proccli::StackTrie &trie) {
+  std::ostringstream out;
+  trie.writeFolded(out);
+  return out.str();
+}
+
+} // namespace
+
+TEST(ParallelParseTest, SplitChunksAlignsToLinesAndPredicate) {
+  std::string text = "a\n b\n c\nd\n e\nf\n";
+  auto chunks = proccli::splitChunks(text, 4, [](std::string_view line) {
+    return !line.empty() && line.front() != ' ';
+  });
+  std::string joined;
+  for (auto chunk : chunks) {
+    ASSERT_FALSE(chunk.empty());
+    EXPECT_EQ(chunk.back(), '\n');
+    EXPECT_NE(chunk.front(), ' ');
+    joined += chunk;
+  }
+  EXPECT_EQ(joined, text);
+  EXPECT_GT(chunks.size(), 1u);
+  EXPECT_EQ(proccli::splitChunks("", 8).size(), 1u);
+  EXPECT_EQ(proccli::splitChunks("no newline", 8).size(), 1u);
+}
+
+TEST(ParallelParseTest, StraceMatchesSingleThreaded) {
+  std::string text = largeStrace();
+  ASSERT_GT(proccli::parseChunkCount(text.size(), 8), 1u);
+  auto serial = proccli::StraceCollector::parse(text, 1);
+  auto parallel = proccli::StraceCollector::parse(text, 8);
+  ASSERT_TRUE(serial.has_value());
+  ASSERT_TRUE(parallel.has_value());
+  EXPECT_EQ(nlohmann::json(*serial).dump(), nlohmann::json(*parallel).dump());
+}
+
+TEST(ParallelParseTest, PerfReportMatchesSingleThreaded) {
+  std::string text;
+  for (int i = 0; text.size() < 4 * proccli::kMinParseChunkBytes; ++i) {
+    text += "  " + std::to_string(i % 100) + ".25%  app  app  [.] symbol" + std::to_string(i) + "\n";
+  }
+  auto serial = proccli::PerfCollector::parse(text, 1);
+  auto parallel = proccli::PerfCollector::parse(text, 8);
+  EXPECT_EQ(nlohmann::json(*serial).dump(), nlohmann::json(*parallel).dump());
+}
+
+TEST(ParallelParseTest, PerfScriptBuildsIdenticalTrie) {
+  std::string text = largePerfScript();
+  proccli::StackTrie serial;
+  std::istringstream stream(text);
+  ASSERT_TRUE(proccli::parsePerfScript(stream, serial));
+  proccli::StackTrie parallel;
+  ASSERT_TRUE(proccli::parsePerfScript(std::string_view(text), parallel, 8));
+  ASSERT_EQ(serial.nodes().size(), parallel.nodes().size());
+  for (size_t i = 0; i < serial.nodes().size(); ++i) {
+    const auto &a = serial.nodes()[i];
+    const auto &b = parallel.nodes()[i];
+    ASSERT_EQ(serial.frameName(a.frame), parallel.frameName(b.frame));
+    ASSERT_EQ(a.parent, b.parent);
+    ASSERT_EQ(a.first_child, b.first_child);
+    ASSERT_EQ(a.next_sibling, b.next_sibling);
+    ASSERT_EQ(a.self, b.self);
+    ASSERT_EQ(a.total, b.total);
+  }
+  EXPECT_EQ(folded(serial), folded(parallel));
+}
+
+TEST(ParallelParseTest, PropagatesWorkerExceptions) {
+  EXPECT_THROW(proccli::parallelFor(16, 4,
+                                    [](size_t task) {
+                                      if (task == 7) {
+                                        throw std::runtime_error("boom");
+                                      }
+                                    }),
+               std::runtime_error);
+}
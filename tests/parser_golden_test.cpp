@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <functional>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/collectors.h"
+#include "proccli/massif.h"
+#include "proccli/utils.h"
+
+namespace {
+
+struct GoldenCase {
+  const char *input;
+  std::function<nlohmann::json(const std::string &)> parse;
+  const char *extension = ".txt";
+};
+
+template <typename T>
+nlohmann::json toJson(const std::optional<T> &value) {
+  return value ? nlohmann::json(*value) : nlohmann::json();
+}
+
+void checkGolden(const GoldenCase &golden) {
+  std::string base = std::string(PROCCLI_TEST_DATA_DIR) + "/" + golden.input;
+  nlohmann::json actual = golden.parse(proccli::readFile(base + golden.extension));
+  std::string expected_path = base + ".expected.json";
+  if (std::getenv("PROCCLI_UPDATE_GOLDEN") != nullptr) {
+    proccli::writeFile(expected_path, actual.dump(2) + "\n");
+  }
+  std::string expected = proccli::readFile(expected_path);
+  ASSERT_FALSE(expected.empty()) << expected_path;
+  EXPECT_EQ(actual, nlohmann::json::parse(expected)) << golden.input;
+}
+
+} // namespace
+
+TEST(ParserGoldenTest, Valgrind) {
+  checkGolden({"valgrind_memcheck", [](const std::string &text) {
+                 return toJson(proccli::ValgrindCollector::parse(text));
+               }});
+}
+
+TEST(ParserGoldenTest, ValgrindXml) {
+  checkGolden({"valgrind_xml",
+               [](const std::string &text) {
+                 return toJson(proccli::ValgrindCollector::parseXml(text));
+               },
+               ".xml"});
+}
+
+TEST(ParserGoldenTest, Massif) {
+  checkGolden({"massif",
+               [](const std::string &text) { return toJson(proccli::parseMassif(text)); },
+               ".out"});
+}
+
+TEST(ParserGoldenTest, PerfReport) {
+  checkGolden({"perf_report", [](const std::string &text) {
+                 return toJson(proccli::PerfCollector::parse(text));
+               }});
+}
+
+TEST(ParserGoldenTest, Ps) {
+  checkGolden({"ps", [](const std::string &text) {
+                 return nlohmann::json(proccli::PsCollector::parse(text));
+               }});
+}
+
+TEST(ParserGoldenTest, Strace) {
+  checkGolden({"strace", [](const std::string &text) {
+                 return toJson(proccli::StraceCollector::parse(text));
+               }});
+}
+
+TEST(ParserGoldenTest, Procfs) {
+  checkGolden({"meminfo", [](const std::string &text) {
+                 return toJson(proccli::ProcfsCollector::parseMemInfo(text));
+               }});
+  checkGolden({"loadavg", [](const std::string &text) {
+                 return toJson(proccli::ProcfsCollector::parseLoadAvg(text));
+               }});
+  checkGolden({"io", [](const std::string &text) {
+                 return toJson(proccli::ProcfsCollector::parseIo(42, text));
+               }});
+}
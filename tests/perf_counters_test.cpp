@@ -0,0 +1,70 @@
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "proccli/perf_counters.h"
+
+TEST(PerfCountersTest, DerivesRatios) {
+  proccli::PerfCounterCollector::Readings readings;
+  readings[0] = 2000;
+  readings[1] = 1000;
+  readings[2] = 400;
+  readings[3] = 100;
+  readings[4] = 5;
+  readings[5] = 12;
+  auto values = proccli::PerfCounterCollector::toValues(42, readings);
+  EXPECT_EQ(values.tid, 42);
+  ASSERT_TRUE(values.ipc.has_value());
+  EXPECT_DOUBLE_EQ(*values.ipc, 0.5);
+  EXPECT_DOUBLE_EQ(*values.cache_miss_percent, 25.0);
+  EXPECT_DOUBLE_EQ(*values.branch_mpki, 5.0);
+  EXPECT_EQ(values.page_faults, 12);
+  EXPECT_EQ(values.context_switches, 0);
+}
+
+TEST(PerfCountersTest, SoftwareOnlyLeavesHardwareFieldsEmpty) {
+  proccli::PerfCounterCollector::Readings readings;
+  readings[5] = 3;
+  readings[6] = 7;
+  auto values = proccli::PerfCounterCollector::toValues(1, readings);
+  EXPECT_FALSE(values.cycles.has_value());
+  EXPECT_FALSE(values.ipc.has_value());
+  EXPECT_FALSE(values.cache_miss_percent.has_value());
+  EXPECT_EQ(values.context_switches, 7);
+}
+
+TEST(PerfCountersTest, CountsFaultingChild) {
+  pid_t child = fork();
+  if (child == 0) {
+    while (true) {
+      void *block = mmap(nullptr, 1 << 20, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+                         -1, 0);
+      std::memset(block, 1, 1 << 20);
+      munmap(block, 1 << 20);
+      usleep(1000);
+    }
+  }
+  ASSERT_GT(child, 0);
+  proccli::PerfCounterOptions options;
+  options.duration_ms = 300;
+  options.per_thread = true;
+  proccli::PerfCounterCollector collector(options);
+  auto result = collector.collect({child});
+  kill(child, SIGKILL);
+  int status = 0;
+  waitpid(child, &status, 0);
+  if (!result.ok) {
+    GTEST_SKIP() << result.error;
+  }
+  EXPECT_EQ(result.report.process.tid, child);
+  EXPECT_GT(result.report.process.page_faults, 0);
+  EXPECT_GT(result.report.process.context_switches, 0);
+  ASSERT_EQ(result.report.threads.size(), 1u);
+  EXPECT_EQ(result.report.hardware, result.report.process.cycles.has_value());
+  EXPECT_EQ(result.report.hardware, result.warning.empty());
+}
@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <unistd.h>
+
+#include "proccli/perf_data.h"
+#include "proccli/utils.h"
+
+extern "C" __attribute__((noinline)) int proccli_perf_data_probe(int value) {
+  asm volatile("" ::: "memory");
+  return value * 7 + 3;
+}
+
+namespace {
+
+struct Mapping {
+  std::uint64_t start = 0;
+  std::uint64_t end = 0;
+  std::uint64_t offset = 0;
+  std::string path;
+};
+
+Mapping mappingOf(std::uint64_t ip) {
+  std::istringstream maps(proccli::readFile("/proc/self/maps"));
+  std::string line;
+  while (std::getline(maps, line)) {
+    unsigned long long start = 0;
+    unsigned long long end = 0;
+    unsigned long long offset = 0;
+    int name = 0;
+    if (std::sscanf(line.c_str(), "%llx-%llx %*s %llx %*s %*s %n", &start, &end, &offset,
+                    &name) >= 3 &&
+        ip >= start && ip < end) {
+      return {start, end, offset, line.substr(static_cast<size_t>(name))};
+    }
+  }
+  return {};
+}
+
+class PerfDataWriter {
+ public:
+  explicit PerfDataWriter(std::uint64_t sample_type) : sample_type_(sample_type) {}
+
+  void mmap2(std::uint32_t pid, std::uint64_t start, std::uint64_t length, std::uint64_t pgoff,
+             const std::string &path) {
+    std::vector<unsigned char> body;
+    put(body, pid);
+    put(body, pid);
+    put(body, start);
+    put(body, length);
+    put(body, pgoff);
+    body.resize(body.size() + 24 + 8, 0);
+    body.insert(body.end(), path.begin(), path.end());
+    body.resize((body.size() + 8) & ~size_t{7}, 0);
+    record(PERF_RECORD_MMAP2, 0, body);
+  }
+
+  void sample(std::uint32_t pid, std::uint64_t ip, std::uint64_t period) {
+    std::vector<unsigned char> body;
+    put(body, std::uint64_t{42});
+    put(body, ip);
+    put(body, pid);
+    put(body, pid);
+    put(body, period);
+    record(PERF_RECORD_SAMPLE, PERF_RECORD_MISC_USER, body);
+  }
+
+  void lost(std::uint64_t count) {
+    std::vector<unsigned char> body;
+    put(body, std::uint64_t{42});
+    put(body, count);
+    record(PERF_RECORD_LOST, 0, body);
+  }
+
+  void write(const std::string &path) const {
+    perf_event_attr attr{};
+    attr.type = PERF_TYPE_SOFTWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_SW_CPU_CLOCK;
+    attr.sample_type = sample_type_;
+    std::uint64_t attr_size = sizeof(attr) + 16;
+    std::uint64_t attrs_offset = 104;
+    std::uint64_t ids_offset = attrs_offset + attr_size;
+    std::uint64_t data_offset = ids_offset + 8;
+
+    std::vector<unsigned char> file;
+    put(file, std::uint64_t{0x32454c4946524550ULL});
+    put(file, std::uint64_t{104});
+    put(file, attr_size);
+    put(file, attrs_offset);
+    put(file, attr_size);
+    put(file, data_offset);
+    put(file, static_cast<std::uint64_t>(data_.size()));
+    file.resize(104, 0);
+    const auto *raw = reinterpret_cast<const unsigned char *>(&attr);
+    file.insert(file.end(), raw, raw + sizeof(attr));
+    put(file, ids_offset);
+    put(file, std::uint64_t{8});
+    put(file, std::uint64_t{42});
+    file.insert(file.end(), data_.begin(), data_.end());
+    std::ofstream(path, std::ios::binary)
+        .write(reinterpret_cast<const char *>(file.data()), static_cast<std::streamsize>(file.size()));
+  }
+
+ private:
+  template <typename T>
+  static void put(std::vector<unsigned char> &out, T value) {
+    const auto *bytes = reinterpret_cast<const unsigned char *>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(value));
+  }
+
+  void record(std::uint32_t type, std::uint16_t misc, const std::vector<unsigned char> &body) {
+    perf_event_header header{type, misc, static_cast<std::uint16_t>(sizeof(header) + body.size())};
+    const auto *raw = reinterpret_cast<const unsigned char *>(&header);
+    data_.insert(data_.end(), raw, raw + sizeof(header));
+    data_.insert(data_.end(), body.begin(), body.end());
+  }
+
+  std::uint64_t sample_type_;
+  std::vector<unsigned char> data_;
+};
+
+std::string tempPath(const std::string &name) {
+  return (std::filesystem::temp_directory_path() /
+          (name + "-" + std::to_string(getpid()) + ".data"))
+      .string();
+}
+
+} // namespace
+
+TEST(PerfDataTest, AggregatesSamplesBySymbolAndPeriod) {
+  auto probe = reinterpret_cast<std::uint64_t>(&proccli_perf_data_probe);
+  Mapping mapping = mappingOf(probe);
+  ASSERT_FALSE(mapping.path.empty());
+  std::uint64_t base = 0x400000;
+  std::uint64_t sample_ip = base + (probe - mapping.start) + 2;
+
+  PerfDataWriter writer(PERF_SAMPLE_IDENTIFIER | PERF_SAMPLE_IP | PERF_SAMPLE_TID |
+                        PERF_SAMPLE_PERIOD);
+  writer.mmap2(100, base, mapping.end - mapping.start, mapping.offset, mapping.path);
+  writer.sample(100, sample_ip, 3000);
+  writer.sample(100, sample_ip + 1, 3000);
+  writer.sample(100, 0x10, 2000);
+  writer.sample(200, sample_ip, 2000);
+  writer.lost(5);
+  std::string path = tempPath("proccli-perf");
+  writer.write(path);
+
+  std::string error;
+  auto report = proccli::readPerfData(path, error);
+  std::filesystem::remove(path);
+  ASSERT_TRUE(report.has_value()) << error;
+  EXPECT_EQ(report->event, "cpu-clock");
+  EXPECT_EQ(report->samples, 4);
+  EXPECT_EQ(report->lost, 5);
+  ASSERT_EQ(report->hotspots.size(), 3u);
+  EXPECT_EQ(report->hotspots[0].symbol, "proccli_perf_data_probe");
+  EXPECT_DOUBLE_EQ(report->hotspots[0].percent, 60.0);
+  EXPECT_EQ(report->hotspots[1].symbol, "[unknown]+0x10");
+  EXPECT_DOUBLE_EQ(report->hotspots[1].percent, 20.0);
+}
+
+TEST(PerfDataTest, StreamsCallchainsAndLocatesFrames) {
+  Mapping mapping = mappingOf(reinterpret_cast<std::uint64_t>(&proccli_perf_data_probe));
+  PerfDataWriter writer(PERF_SAMPLE_IDENTIFIER | PERF_SAMPLE_IP | PERF_SAMPLE_TID |
+                        PERF_SAMPLE_PERIOD);
+  writer.mmap2(7, 0x1000, 0x2000, 0x5000, mapping.path);
+  writer.sample(7, 0x1800, 1);
+  std::string path = tempPath("proccli-perf-locate");
+  writer.write(path);
+
+  proccli::PerfDataReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.open(path, error)) << error;
+  std::vector<proccli::PerfDataLocation> seen;
+  ASSERT_TRUE(reader.read(
+      [&](const proccli::PerfDataSample &sample) {
+        seen.push_back(reader.locate(sample.pid, sample.ip, sample.kernel));
+      },
+      error));
+  std::filesystem::remove(path);
+  ASSERT_EQ(seen.size(), 1u);
+  EXPECT_EQ(seen[0].offset, 0x5800u);
+  EXPECT_EQ(reader.dsoPath(seen[0].dso), mapping.path);
+}
+
+TEST(PerfDataTest, RejectsNonPerfFiles) {
+  std::string path = tempPath("proccli-not-perf");
+  proccli::writeFile(path, std::string(200, 'x'));
+  std::string error;
+  EXPECT_FALSE(proccli::readPerfData(path, error).has_value());
+  EXPECT_NE(error.find("not a perf.data"), std::string::npos);
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <cstdint>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "proccli/collectors.h"
+#include "proccli/perf_sampler.h"
+#include "proccli/symbolizer.h"
+#include "proccli/utils.h"
+
+extern "C" __attribute__((noinline)) int proccli_perf_sampler_probe(int value) {
+  asm volatile("" ::: "memory");
+  return value * 5 + 1;
+}
+
+TEST(PerfSamplerTest, SamplesBusyChild) {
+  pid_t child = fork();
+  if (child == 0) {
+    volatile unsigned long long counter = 0;
+    while (true) {
+      counter = counter + 1;
+    }
+  }
+  ASSERT_GT(child, 0);
+  proccli::PerfSamplerOptions options;
+  options.duration_ms = 300;
+  options.event = "cycles";
+  proccli::PerfSampler sampler(options);
+  auto result = sampler.sample({child});
+  proccli::PerfReport report;
+  if (result.ok) {
+    report = proccli::buildPerfReport(result.sample_set);
+  }
+  kill(child, SIGKILL);
+  int status = 0;
+  waitpid(child, &status, 0);
+  if (!result.ok) {
+    GTEST_SKIP() << result.error;
+  }
+  EXPECT_FALSE(report.event.empty());
+  EXPECT_GT(report.samples, 0);
+  ASSERT_FALSE(report.hotspots.empty());
+  EXPECT_FALSE(report.hotspots[0].symbol.empty());
+  EXPECT_GT(report.hotspots[0].percent, 0.0);
+}
+
+TEST(PerfSamplerTest, FormattedReportRoundTripsThroughParser) {
+  proccli::PerfReport report;
+  report.event = "cpu-clock";
+  report.samples = 10;
+  report.hotspots = {{"main", 60.0}, {"libc.so.6+0x1234", 40.0}};
+  auto parsed = proccli::PerfCollector::parse(proccli::PerfCollector::format(report));
+  ASSERT_TRUE(parsed.has_value());
+  ASSERT_EQ(parsed->hotspots.size(), 2u);
+  EXPECT_EQ(parsed->hotspots[1].symbol, "libc.so.6+0x1234");
+  EXPECT_DOUBLE_EQ(parsed->hotspots[0].percent, 60.0);
+}
+
+TEST(PerfSamplerTest, SymbolizesExitedProcessFromCapturedMaps) {
+  pid_t child = fork();
+  if (child == 0) {
+    _exit(proccli_perf_sampler_probe(0) == 1 ? 0 : 1);
+  }
+  ASSERT_GT(child, 0);
+  int status = 0;
+  waitpid(child, &status, 0);
+  proccli::PerfSampleSet set;
+  set.samples = 1;
+  auto ip = reinterpret_cast<std::uint64_t>(&proccli_perf_sampler_probe) + 4;
+  set.ip_counts[child][ip] = 1;
+  set.maps[child] = proccli::readFile("/proc/self/maps");
+  proccli::Symbolizer symbolizer;
+  auto report = proccli::buildPerfReport(set, symbolizer);
+  ASSERT_EQ(report.hotspots.size(), 1u);
+  EXPECT_EQ(report.hotspots[0].symbol, "proccli_perf_sampler_probe");
+}
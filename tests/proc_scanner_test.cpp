@@ -0,0 +1,88 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <unistd.h>
+
+#include "proccli/proc_scanner.h"
+
+namespace {
+
+void writeText(const std::filesystem::path &path, const std::string &content) {
+  std::filesystem::create_directories(path.parent_path());
+  std::ofstream file(path, std::ios::binary);
+  file << content;
+}
+
+} // namespace
+
+TEST(ProcScannerTest, ParsesStatWithSpacesInComm) {
+  std::string content =
+      "42 (my (odd) proc) S 7 42 42 0 -1 4194560 100 0 0 0 250 50 0 0 20 0 3 0 1000 "
+      "8192000 512 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 2 0 0 0 0 0\n";
+  proccli::ProcStat stat;
+  ASSERT_TRUE(proccli::parseProcStat(content, stat));
+  EXPECT_EQ(stat.pid, 42);
+  EXPECT_EQ(stat.comm, "my (odd) proc");
+  EXPECT_EQ(stat.state, 'S');
+  EXPECT_EQ(stat.ppid, 7);
+  EXPECT_EQ(stat.utime, 250u);
+  EXPECT_EQ(stat.stime, 50u);
+  EXPECT_EQ(stat.num_threads, 3);
+  EXPECT_EQ(stat.starttime, 1000u);
+  EXPECT_EQ(stat.vsize, 8192000u);
+  EXPECT_EQ(stat.rss_pages, 512);
+  EXPECT_EQ(stat.processor, 2);
+}
+
+TEST(ProcScannerTest, ScansSyntheticTree) {
+  auto root = std::filesystem::temp_directory_path() /
+              ("proccli_scan_" + std::to_string(getpid()));
+  std::filesystem::remove_all(root);
+  long ticks = sysconf(_SC_CLK_TCK);
+  writeText(root / "uptime", "100.00 50.00\n");
+  writeText(root / "meminfo", "MemTotal:       1000000 kB\n");
+  writeText(root / "10" / "stat",
+            "10 (worker) R 1 10 10 0 -1 0 0 0 0 0 " + std::to_string(ticks * 5) + " " +
+                std::to_string(ticks * 5) + " 0 0 20 0 1 0 0 4096000 " +
+                std::to_string(100000 / (sysconf(_SC_PAGESIZE) / 1024)) +
+                " 0 0 0 0 0 0 0 0 0 0 0 0 0 17 0\n");
+  writeText(root / "10" / "cmdline", std::string("/usr/bin/worker\0--flag\0two  words\0", 34));
+  writeText(root / "11" / "stat",
+            "11 (kthread) S 2 0 0 0 -1 0 0 0 0 0 0 0 0 0 20 0 1 0 0 0 0 0\n");
+  writeText(root / "self" / "stat", "ignored");
+
+  proccli::ProcScanner scanner(root.string());
+  auto processes = scanner.scan();
+  std::filesystem::remove_all(root);
+
+  ASSERT_TRUE(processes.has_value());
+  ASSERT_EQ(processes->size(), 2u);
+  const proccli::ProcessInfo *worker = nullptr;
+  const proccli::ProcessInfo *kthread = nullptr;
+  for (const auto &info : *processes) {
+    if (info.pid == 10) {
+      worker = &info;
+    } else if (info.pid == 11) {
+      kthread = &info;
+    }
+  }
+  ASSERT_NE(worker, nullptr);
+  ASSERT_NE(kthread, nullptr);
+  EXPECT_EQ(worker->ppid, 1);
+  EXPECT_EQ(worker->cmd, "/usr/bin/worker --flag two  words");
+  EXPECT_EQ(worker->rss_kb, 100000);
+  EXPECT_EQ(worker->vsz_kb, 4000);
+  EXPECT_DOUBLE_EQ(worker->cpu_percent, 10.0);
+  EXPECT_DOUBLE_EQ(worker->mem_percent, 10.0);
+  EXPECT_EQ(worker->etime, "01:40");
+  EXPECT_EQ(kthread->cmd, "[kthread]");
+}
+
+TEST(ProcScannerTest, FormatsElapsedLikePs) {
+  EXPECT_EQ(proccli::formatElapsed(5), "00:05");
+  EXPECT_EQ(proccli::formatElapsed(3725), "01:02:05");
+  EXPECT_EQ(proccli::formatElapsed(90061), "1-01:01:01");
+}
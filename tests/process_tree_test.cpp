@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+
+#include "proccli/process_tree.h"
+
+namespace {
+
+proccli::ProcessInfo process(int pid, int ppid, double cpu, int rss, int threads) {
+  proccli::ProcessInfo info;
+  info.pid = pid;
+  info.ppid = ppid;
+  info.cmd = "proc-" + std::to_string(pid);
+  info.cpu_percent = cpu;
+  info.rss_kb = rss;
+  info.num_threads = threads;
+  return info;
+}
+
+} // namespace
+
+TEST(ProcessTreeTest, RollsUpPreForkWorkers) {
+  std::vector<proccli::ProcessInfo> processes = {
+      process(1, 0, 0.0, 10, 1),     process(50, 1, 0.0, 100, 1),
+      process(100, 50, 1.0, 1000, 2), process(101, 100, 20.0, 500, 4),
+      process(102, 100, 30.0, 700, 4), process(103, 101, 5.0, 50, 1),
+      process(200, 1, 99.0, 9999, 8)};
+  std::vector<proccli::IoStats> io = {{101, 4096, 0}, {102, 0, 8192}, {103, 1, 1}};
+
+  auto tree = proccli::buildProcessTree(processes, 100, io);
+  ASSERT_TRUE(tree.has_value());
+  EXPECT_EQ(tree->root_pid, 100);
+  ASSERT_EQ(tree->nodes.size(), 4u);
+  const auto &root = tree->nodes[0];
+  EXPECT_EQ(root.pid, 100);
+  EXPECT_EQ(root.depth, 0);
+  EXPECT_EQ(root.subtree_processes, 4);
+  EXPECT_DOUBLE_EQ(root.subtree_cpu_percent, 56.0);
+  EXPECT_EQ(root.subtree_rss_kb, 2250);
+  EXPECT_EQ(root.subtree_read_bytes, 4097);
+  EXPECT_EQ(root.subtree_write_bytes, 8193);
+  EXPECT_EQ(root.subtree_threads, 11);
+
+  EXPECT_EQ(tree->nodes[1].pid, 101);
+  EXPECT_EQ(tree->nodes[1].depth, 1);
+  EXPECT_EQ(tree->nodes[1].subtree_processes, 2);
+  EXPECT_EQ(tree->nodes[2].pid, 103);
+  EXPECT_EQ(tree->nodes[2].depth, 2);
+  EXPECT_EQ(tree->nodes[3].pid, 102);
+  EXPECT_EQ(tree->nodes[3].read_bytes, 0);
+  EXPECT_EQ(tree->nodes[3].write_bytes, 8192);
+}
+
+TEST(ProcessTreeTest, ListsDescendantsAndHandlesMissingRoot) {
+  std::vector<proccli::ProcessInfo> processes = {process(1, 0, 0, 0, 1), process(2, 1, 0, 0, 1),
+                                                 process(3, 2, 0, 0, 1), process(4, 1, 0, 0, 1)};
+  EXPECT_EQ(proccli::descendantPids(processes, 2), (std::vector<int>{2, 3}));
+  EXPECT_TRUE(proccli::descendantPids(processes, 9).empty());
+  EXPECT_FALSE(proccli::buildProcessTree(processes, 9, {}).has_value());
+}
@@ -4,8 +4,8 @@
 
 TEST(ReportTest, IncludesLimitations) {
   proccli::DiagnosticsSnapshot snapshot;
-  snapshot.quality.collectors.push_back({"ps", "ok", std::nullopt});
-  snapshot.quality.collectors.push_back({"perf", "failed", std::string("missing")});
+  snapshot.quality.collectors.push_back({"ps", "ok", std::nullopt, std::nullopt});
+  snapshot.quality.collectors.push_back({"perf", "failed", std::string("missing"), std::nullopt});
 
   auto report = proccli::renderReport("Findings content", snapshot);
   EXPECT_NE(report.find("Findings"), std::string::npos);
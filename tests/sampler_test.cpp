@@ -0,0 +1,92 @@
+#include <gtest/gtest.h>
+
+#include <csignal>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "proccli/sampler.h"
+
+TEST(SamplerTest, ParsesStatusAndIoCounters) {
+  proccli::ProcCounters counters;
+  ASSERT_TRUE(proccli::parseStatusCounters(
+      "Name:\tapp\nVmRSS:\t  2048 kB\nvoluntary_ctxt_switches:\t10\n"
+      "nonvoluntary_ctxt_switches:\t3\n",
+      counters));
+  ASSERT_TRUE(proccli::parseIoCounters(
+      "rchar: 1\nwchar: 2\nread_bytes: 4096\nwrite_bytes: 8192\ncancelled_write_bytes: 0\n",
+      counters));
+  EXPECT_EQ(counters.rss_kb, 2048);
+  EXPECT_EQ(counters.voluntary_ctxt, 10);
+  EXPECT_EQ(counters.nonvoluntary_ctxt, 3);
+  EXPECT_EQ(counters.read_bytes, 4096);
+  EXPECT_EQ(counters.write_bytes, 8192);
+}
+
+TEST(SamplerTest, ComputesPerIntervalRates) {
+  proccli::ProcCounters previous;
+  previous.timestamp_s = 10.0;
+  previous.cpu_ticks = 100;
+  previous.read_bytes = 1000;
+  previous.write_bytes = 0;
+  previous.voluntary_ctxt = 50;
+  previous.nonvoluntary_ctxt = 5;
+  previous.rss_kb = 1000;
+  proccli::ProcCounters current = previous;
+  current.timestamp_s = 10.5;
+  current.cpu_ticks = 125;
+  current.read_bytes = 6000;
+  current.write_bytes = 500;
+  current.voluntary_ctxt = 150;
+  current.nonvoluntary_ctxt = 10;
+  current.rss_kb = 1200;
+
+  auto sample = proccli::computeRates(previous, current, 100);
+  EXPECT_DOUBLE_EQ(sample.cpu_percent, 50.0);
+  EXPECT_DOUBLE_EQ(sample.read_bytes_per_sec, 10000.0);
+  EXPECT_DOUBLE_EQ(sample.write_bytes_per_sec, 1000.0);
+  EXPECT_DOUBLE_EQ(sample.voluntary_ctxt_per_sec, 200.0);
+  EXPECT_DOUBLE_EQ(sample.nonvoluntary_ctxt_per_sec, 10.0);
+  EXPECT_EQ(sample.rss_kb, 1200);
+  EXPECT_EQ(sample.rss_delta_kb, 200);
+}
+
+TEST(SamplerTest, WatchesOwnProcessForDuration) {
+  int calls = 0;
+  auto series = proccli::watchProcess(getpid(), 10, 50, [&](const proccli::WatchSample &) {
+    ++calls;
+    return true;
+  });
+  EXPECT_EQ(series.pid, getpid());
+  EXPECT_EQ(series.interval_ms, 10);
+  EXPECT_GE(series.samples.size(), 4u);
+  EXPECT_EQ(static_cast<size_t>(calls), series.samples.size());
+  EXPECT_GT(series.samples.back().rss_kb, 0);
+}
+
+TEST(SamplerTest, ProcfsSamplerDropsExitedPids) {
+  pid_t child = fork();
+  if (child == 0) {
+    pause();
+    _exit(0);
+  }
+  ASSERT_GT(child, 0);
+  proccli::ProcfsSampler sampler;
+  ASSERT_TRUE(sampler.add(getpid()));
+  ASSERT_TRUE(sampler.add(child));
+  std::vector<proccli::PidCounters> samples;
+  std::vector<int> exited;
+  sampler.sample(samples, exited);
+  EXPECT_EQ(samples.size(), 2u);
+  EXPECT_TRUE(exited.empty());
+
+  kill(child, SIGKILL);
+  int status = 0;
+  waitpid(child, &status, 0);
+  sampler.sample(samples, exited);
+  ASSERT_EQ(samples.size(), 1u);
+  EXPECT_EQ(samples[0].pid, getpid());
+  ASSERT_EQ(exited.size(), 1u);
+  EXPECT_EQ(exited[0], child);
+  EXPECT_EQ(sampler.size(), 1u);
+}
@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+#include "proccli/sampler.h"
+#include "proccli/scheduler.h"
+
+namespace {
+
+proccli::CollectorResult ok(const std::string &name) {
+  return {name, "ok", std::nullopt};
+}
+
+void sleepMs(int ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+} // namespace
+
+TEST(CollectorSchedulerTest, RunsIndependentCollectorsConcurrently) {
+  proccli::CollectorScheduler scheduler;
+  for (const char *name : {"perf", "counters", "strace"}) {
+    scheduler.add({name, 0, {}, "", [name](const proccli::CancelToken &) {
+                     sleepMs(200);
+                     return ok(name);
+                   }});
+  }
+  double started = proccli::monotonicSeconds();
+  auto results = scheduler.run();
+  double elapsed_ms = (proccli::monotonicSeconds() - started) * 1000.0;
+  ASSERT_EQ(results.size(), 3u);
+  EXPECT_EQ(results[0].name, "perf");
+  EXPECT_EQ(results[2].name, "strace");
+  for (const auto &result : results) {
+    EXPECT_EQ(result.status, "ok");
+    EXPECT_GE(result.wall_ms, 190.0);
+  }
+  EXPECT_LT(elapsed_ms, 450.0);
+}
+
+TEST(CollectorSchedulerTest, SerializesExclusiveCollectorsInOrder) {
+  proccli::CollectorScheduler scheduler;
+  std::atomic<int> active{0};
+  std::atomic<int> max_active{0};
+  std::vector<std::string> order;
+  std::mutex order_mutex;
+  for (const char *name : {"strace", "other", "valgrind"}) {
+    std::string exclusive = std::string(name) == "other" ? "" : "ptrace";
+    scheduler.add({name, 0, {}, exclusive, [&, name, exclusive](const proccli::CancelToken &) {
+                     if (!exclusive.empty()) {
+                       int now = ++active;
+                       max_active = std::max(max_active.load(), now);
+                     }
+                     sleepMs(50);
+                     {
+                       std::lock_guard<std::mutex> lock(order_mutex);
+                       order.push_back(name);
+                     }
+                     if (!exclusive.empty()) {
+                       --active;
+                     }
+                     return ok(name);
+                   }});
+  }
+  scheduler.run();
+  EXPECT_EQ(max_active.load(), 1);
+  auto strace = std::find(order.begin(), order.end(), "strace");
+  auto valgrind = std::find(order.begin(), order.end(), "valgrind");
+  EXPECT_LT(strace, valgrind);
+}
+
+TEST(CollectorSchedulerTest, WaitingExclusiveCollectorDoesNotBlockReadyOne) {
+  proccli::CollectorScheduler scheduler;
+  std::atomic<bool> ps_done{false};
+  bool valgrind_before_ps = false;
+  scheduler.add({"strace", 0, {"ps"}, "ptrace",
+                 [](const proccli::CancelToken &) { return ok("strace"); }});
+  scheduler.add({"valgrind", 0, {}, "ptrace", [&](const proccli::CancelToken &) {
+                   valgrind_before_ps = !ps_done.load();
+                   return ok("valgrind");
+                 }});
+  scheduler.add({"ps", 0, {}, "", [&](const proccli::CancelToken &) {
+                   sleepMs(200);
+                   ps_done = true;
+                   return ok("ps");
+                 }});
+  auto results = scheduler.run();
+  EXPECT_TRUE(valgrind_before_ps);
+  for (const auto &result : results) {
+    EXPECT_EQ(result.status, "ok") << result.name;
+  }
+}
+
+TEST(CollectorSchedulerTest, StartsDependentsAfterTheirDependencies) {
+  proccli::CollectorScheduler scheduler;
+  std::atomic<bool> ps_done{false};
+  bool saw_ps = false;
+  scheduler.add({"proc", 0, {"ps"}, "", [&](const proccli::CancelToken &) {
+                   saw_ps = ps_done.load();
+                   return ok("proc");
+                 }});
+  scheduler.add({"ps", 0, {}, "", [&](const proccli::CancelToken &) {
+                   sleepMs(50);
+                   ps_done = true;
+                   return ok("ps");
+                 }});
+  auto results = scheduler.run();
+  EXPECT_TRUE(saw_ps);
+  EXPECT_EQ(results[0].name, "proc");
+  EXPECT_EQ(results[0].status, "ok");
+}
+
+TEST(CollectorSchedulerTest, MarksCollectorsPastTheirDeadlinePartial) {
+  proccli::CollectorScheduler scheduler;
+  scheduler.add({"strace", 100, {}, "", [](const proccli::CancelToken &cancel) {
+                   while (!cancel.cancelled()) {
+                     sleepMs(5);
+                   }
+                   return ok("strace");
+                 }});
+  scheduler.add({"ps", 100, {}, "", [](const proccli::CancelToken &) { return ok("ps"); }});
+  auto results = scheduler.run();
+  EXPECT_EQ(results[0].status, "partial");
+  ASSERT_TRUE(results[0].error);
+  EXPECT_NE(results[0].error->find("deadline"), std::string::npos);
+  EXPECT_GE(results[0].wall_ms, 95.0);
+  EXPECT_LT(results[0].wall_ms, 1000.0);
+  EXPECT_EQ(results[1].status, "ok");
+}
+
+TEST(CollectorSchedulerTest, InterruptCancelsRunningAndPendingCollectors) {
+  proccli::CollectorScheduler scheduler;
+  scheduler.add({"perf", 0, {}, "", [](const proccli::CancelToken &cancel) {
+                   while (!cancel.cancelled()) {
+                     sleepMs(5);
+                   }
+                   return ok("perf");
+                 }});
+  scheduler.add({"counters", 0, {"perf"}, "",
+                 [](const proccli::CancelToken &) { return ok("counters"); }});
+  double started = proccli::monotonicSeconds();
+  auto results = scheduler.run(
+      [started] { return proccli::monotonicSeconds() - started > 0.15; });
+  EXPECT_EQ(results[0].status, "partial");
+  EXPECT_EQ(results[0].error, "cancelled");
+  EXPECT_EQ(results[1].status, "failed");
+}
+
+TEST(CollectorSchedulerTest, ReportsExceptionsAsFailures) {
+  proccli::CollectorScheduler scheduler;
+  scheduler.add({"perf", 0, {}, "", [](const proccli::CancelToken &) -> proccli::CollectorResult {
+                   throw std::runtime_error("boom");
+                 }});
+  auto results = scheduler.run();
+  EXPECT_EQ(results[0].status, "failed");
+  EXPECT_EQ(results[0].error, "boom");
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+
+#include <filesystem>
+
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/snapshot_binary.h"
+
+namespace {
+
+proccli::DiagnosticsSnapshot fullSnapshot() {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 42;
+  snapshot.target.command = "./server --port 80";
+  snapshot.system.loadavg = proccli::LoadAvg{0.5, 0.25, 0.125};
+  snapshot.system.meminfo = proccli::MemInfo{16384, 4096, 8192};
+  snapshot.processes = {{42, 1, "./server", 2048, 4096, 12.5, 0.5, "00:01", 4},
+                        {43, 42, "worker", 1024, 3LL << 30, 3.0, 0.1, "00:00", 1}};
+  proccli::ProcessTree tree;
+  tree.root_pid = 42;
+  tree.nodes.push_back({42, 1, 0, "./server", 12.5, 2048, 10, 20, 4, 2, 15.5, 3072, 10, 20, 5});
+  snapshot.process_tree = tree;
+  snapshot.threads = {{42, "server", "R", 10.0, 25.0, 300.0, 7, 3, 1}};
+  proccli::MemoryBreakdown memory;
+  memory.pid = 42;
+  memory.source = "smaps_rollup+smaps";
+  memory.rss_kb = 2048;
+  memory.regions = {{"[heap]", 1, 512, 256, 200, 256, 0, 256, 0}};
+  snapshot.memory = memory;
+  proccli::ValgrindReport valgrind;
+  valgrind.errors = {{"Leak_DefinitelyLost", 2}};
+  valgrind.leak_summary = proccli::LeakSummary{4, 0, 1, 8};
+  valgrind.sites = {{"Leak_DefinitelyLost", "16 bytes lost", {"malloc", "main"}, 2, 16, 1}};
+  valgrind.unattributed_errors = 3;
+  snapshot.valgrind = valgrind;
+  proccli::HeapProfile heap;
+  heap.command = "./server";
+  heap.time_unit = "i";
+  heap.peak_snapshot = 1;
+  heap.peak_heap_bytes = 4096;
+  heap.timeline = {{0, 0, 0, 0, 0}, {1, 100, 4096, 64, 0}};
+  heap.peak_sites = {{4096, 100.0, {"malloc", "main"}}};
+  snapshot.heap_profile = heap;
+  proccli::PerfReport perf;
+  perf.event = "cpu-clock";
+  perf.samples = 100;
+  perf.hotspots = {{"main", 75.0}};
+  perf.frames = {{"main", 100.0, 75.0}};
+  snapshot.perf = perf;
+  proccli::CountersReport counters;
+  counters.duration_s = 1.0;
+  counters.process.cycles = 1000;
+  counters.process.instructions = 2000;
+  counters.process.ipc = 2.0;
+  counters.process.page_faults = 5;
+  counters.threads.push_back(counters.process);
+  snapshot.counters = counters;
+  proccli::StraceReport strace;
+  proccli::LatencySummary latency;
+  latency.count = 3;
+  latency.p50_ms = 0.006;
+  latency.max_ms = 750.0;
+  latency.buckets = {{4, 1}, {6, 1}, {750000, 1}};
+  strace.top_syscalls = {{"futex", 3, 750.01, latency}, {"read", 1, 0.1, std::nullopt}};
+  strace.slow_syscalls = {{"futex", 750.0}};
+  snapshot.strace = strace;
+  snapshot.io = {{42, 100, 200}};
+  proccli::WatchSeries watch;
+  watch.pid = 42;
+  watch.interval_ms = 100;
+  watch.samples = {{100.0, 50.0, 10.0, 20.0, 1.0, 2.0, 2048, 16}};
+  snapshot.watch = watch;
+  snapshot.timing.captured_at = "2026-01-01T00:00:00Z";
+  snapshot.quality.collectors = {{"ps", "ok", std::nullopt, 12.0},
+                                 {"strace", "partial", std::string("cancelled"), 500.0}};
+  return snapshot;
+}
+
+} // namespace
+
+TEST(SnapshotBinaryTest, RoundTripsEverySection) {
+  auto snapshot = fullSnapshot();
+  std::string data = proccli::encodeSnapshotBinary(snapshot);
+  ASSERT_TRUE(proccli::isSnapshotBinary(data));
+
+  proccli::SnapshotReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.attach(data, error)) << error;
+  EXPECT_EQ(reader.records(proccli::SnapshotSection::Processes), 2u);
+  EXPECT_EQ(reader.records(proccli::SnapshotSection::Quality), 2u);
+  proccli::DiagnosticsSnapshot restored;
+  ASSERT_TRUE(reader.readAll(restored, error)) << error;
+  EXPECT_EQ(nlohmann::json(restored), nlohmann::json(snapshot));
+}
+
+TEST(SnapshotBinaryTest, ReadsOnlyRequestedSections) {
+  proccli::DiagnosticsSnapshot snapshot = fullSnapshot();
+  std::string data = proccli::encodeSnapshotBinary(snapshot);
+  proccli::SnapshotReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.attach(data, error)) << error;
+
+  proccli::DiagnosticsSnapshot partial;
+  ASSERT_TRUE(reader.read(partial, {proccli::SnapshotSection::Target,
+                                    proccli::SnapshotSection::Quality},
+                          error))
+      << error;
+  EXPECT_EQ(partial.target.command, snapshot.target.command);
+  ASSERT_EQ(partial.quality.collectors.size(), 2u);
+  EXPECT_EQ(partial.quality.collectors[1].error, "cancelled");
+  EXPECT_TRUE(partial.processes.empty());
+  EXPECT_FALSE(partial.perf.has_value());
+}
+
+TEST(SnapshotBinaryTest, OmitsAbsentOptionalSections) {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 7;
+  std::string data = proccli::encodeSnapshotBinary(snapshot);
+  proccli::SnapshotReader reader;
+  std::string error;
+  ASSERT_TRUE(reader.attach(data, error)) << error;
+  EXPECT_TRUE(reader.has(proccli::SnapshotSection::Target));
+  EXPECT_FALSE(reader.has(proccli::SnapshotSection::Perf));
+  proccli::DiagnosticsSnapshot restored;
+  ASSERT_TRUE(reader.readAll(restored, error)) << error;
+  EXPECT_EQ(nlohmann::json(restored), nlohmann::json(snapshot));
+}
+
+TEST(SnapshotBinaryTest, RejectsForeignAndDamagedInput) {
+  proccli::SnapshotReader reader;
+  std::string error;
+  EXPECT_FALSE(reader.attach("{\"target\": {}}", error));
+
+  std::string data = proccli::encodeSnapshotBinary(fullSnapshot());
+  std::string future = data;
+  future[8] = 9;
+  EXPECT_FALSE(reader.attach(future, error));
+  EXPECT_NE(error.find("version"), std::string::npos);
+
+  std::string truncated = data.substr(0, data.size() / 2);
+  proccli::DiagnosticsSnapshot restored;
+  EXPECT_FALSE(reader.attach(truncated, error) && reader.readAll(restored, error));
+}
+
+TEST(SnapshotBinaryTest, WritesAndMapsFile) {
+  namespace fs = std::filesystem;
+  fs::path path = fs::temp_directory_path() / ("proccli-snapshot-" + std::to_string(getpid()) + ".bin");
+  auto snapshot = fullSnapshot();
+  std::string error;
+  ASSERT_TRUE(proccli::writeSnapshotBinary(path.string(), snapshot, error)) << error;
+  proccli::SnapshotReader reader;
+  ASSERT_TRUE(reader.open(path.string(), error)) << error;
+  proccli::DiagnosticsSnapshot restored;
+  ASSERT_TRUE(reader.readAll(restored, error)) << error;
+  EXPECT_EQ(nlohmann::json(restored), nlohmann::json(snapshot));
+  fs::remove(path);
+}
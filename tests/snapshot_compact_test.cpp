@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/snapshot_compact.h"
+
+namespace {
+
+proccli::DiagnosticsSnapshot busySnapshot(int processes) {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 100;
+  snapshot.target.command = "./server --port 8080";
+  snapshot.timing.captured_at = "2026-01-01T00:00:00Z";
+  for (int i = 0; i < processes; ++i) {
+    int pid = 1000 + i;
+    snapshot.processes.push_back({pid, 1, "/usr/bin/worker --shard " + std::to_string(i),
+                                  1000 + i % 97, 4096, (i % 13) / 10.0, 0.1, "01:00", 1});
+    snapshot.io.push_back({pid, i * 10LL, i * 5LL});
+  }
+  snapshot.processes.push_back({100, 1, "./server", 5000, 9000, 0.0, 1.0, "00:10", 8});
+  snapshot.processes.push_back({7, 1, "hog", 10, 20, 95.0, 0.0, "00:01", 1});
+  snapshot.processes.push_back({8, 1, "fat", 9000000, 9000000, 0.0, 60.0, "00:01", 1});
+
+  proccli::ProcessTree tree;
+  tree.root_pid = 100;
+  tree.nodes.push_back({100, 1, 0, "./server", 10.0, 5000, 0, 0, 8, 3, 40.0, 9000, 0, 0, 10});
+  tree.nodes.push_back({101, 100, 1, "child", 30.0, 4000, 0, 0, 2, 1, 30.0, 4000, 0, 0, 2});
+  snapshot.process_tree = tree;
+
+  proccli::PerfReport perf;
+  perf.event = "cpu-clock";
+  perf.samples = 1000;
+  for (int i = 0; i < 3000; ++i) {
+    perf.hotspots.push_back({"ns::Class::method" + std::to_string(i) + "()", 0.01});
+    perf.frames.push_back({"frame" + std::to_string(i), 0.02, 0.01});
+  }
+  perf.hotspots.push_back({"hot_loop()", 42.0});
+  snapshot.perf = perf;
+
+  proccli::StraceReport strace;
+  for (int i = 0; i < 500; ++i) {
+    proccli::LatencySummary latency;
+    latency.count = 10;
+    latency.buckets = {{1, 5}, {10, 5}};
+    strace.top_syscalls.push_back({"syscall" + std::to_string(i), 10, 0.5, latency});
+  }
+  strace.top_syscalls.push_back({"futex", 9000, 800.0, std::nullopt});
+  snapshot.strace = strace;
+
+  snapshot.quality.collectors = {{"ps", "ok", std::nullopt, 3.0},
+                                 {"perf", "failed", std::string("perf not found"), 1.0}};
+  return snapshot;
+}
+
+const nlohmann::json *findByField(const nlohmann::json &items, const char *field,
+                                  const nlohmann::json &value) {
+  for (const auto &item : items) {
+    if (item.at(field) == value) {
+      return &item;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+TEST(SnapshotCompactTest, KeepsSmallSnapshotIntact) {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 1;
+  snapshot.processes = {{1, 0, "init", 100, 200, 0.5, 0.1, "10:00", 1},
+                        {2, 1, "shell", 300, 400, 1.5, 0.2, "01:00", 1}};
+  auto compact = proccli::compactSnapshot(snapshot);
+  const auto &processes = compact.payload.at("processes");
+  EXPECT_EQ(processes.at("count"), 2);
+  EXPECT_EQ(processes.at("entries").size(), 2u);
+  EXPECT_FALSE(processes.contains("entries_omitted"));
+  EXPECT_FALSE(compact.payload.contains("omitted_sections"));
+  EXPECT_EQ(compact.tokens, proccli::estimateTokens(compact.payload.dump()));
+}
+
+TEST(SnapshotCompactTest, FitsBusyHostIntoBudget) {
+  auto snapshot = busySnapshot(20000);
+  proccli::CompactOptions options;
+  options.token_budget = 4000;
+  auto compact = proccli::compactSnapshot(snapshot, options);
+  EXPECT_LE(proccli::estimateTokens(compact.payload.dump()), options.token_budget);
+  EXPECT_GT(compact.tokens, options.token_budget / 2);
+
+  const auto &processes = compact.payload.at("processes");
+  const auto &entries = processes.at("entries");
+  EXPECT_EQ(entries.at(0).at("pid"), 100);
+  EXPECT_NE(findByField(entries, "pid", 7), nullptr);
+  EXPECT_NE(findByField(entries, "pid", 8), nullptr);
+  EXPECT_EQ(entries.size() + processes.at("entries_omitted").at("count").get<size_t>(), 20003u);
+  EXPECT_EQ(processes.at("count"), 20003);
+
+  EXPECT_EQ(compact.payload.at("process_tree").at("nodes").size(), 2u);
+  EXPECT_EQ(compact.payload.at("perf").at("hotspots").at(0).at("symbol"), "hot_loop()");
+  const auto &syscalls = compact.payload.at("strace").at("top_syscalls");
+  EXPECT_EQ(syscalls.at(0).at("name"), "futex");
+  EXPECT_FALSE(syscalls.at(1).at("latency").contains("buckets"));
+  const auto &issues = compact.payload.at("quality").at("issues");
+  ASSERT_EQ(issues.size(), 1u);
+  EXPECT_EQ(issues.at(0).at("error"), "perf not found");
+  EXPECT_GT(compact.payload.at("perf").at("hotspots").size(),
+            compact.payload.at("perf").at("frames").size());
+}
+
+TEST(SnapshotCompactTest, PromptSizeDoesNotGrowWithHostSize) {
+  proccli::CompactOptions options;
+  options.token_budget = 3000;
+  auto small = proccli::compactSnapshot(busySnapshot(2000), options);
+  auto large = proccli::compactSnapshot(busySnapshot(50000), options);
+  EXPECT_LE(small.tokens, options.token_budget);
+  EXPECT_LE(large.tokens, options.token_budget);
+  EXPECT_LT(large.tokens > small.tokens ? large.tokens - small.tokens
+                                        : small.tokens - large.tokens,
+            options.token_budget / 10);
+}
+
+TEST(SnapshotCompactTest, DropsLowPrioritySectionsUnderTinyBudget) {
+  auto snapshot = busySnapshot(100);
+  proccli::WatchSeries watch;
+  watch.samples.resize(500);
+  snapshot.watch = watch;
+  proccli::CompactOptions options;
+  options.token_budget = 150;
+  auto compact = proccli::compactSnapshot(snapshot, options);
+  EXPECT_TRUE(compact.payload.contains("target"));
+  EXPECT_TRUE(compact.payload.contains("quality"));
+  ASSERT_TRUE(compact.payload.contains("omitted_sections"));
+  EXPECT_FALSE(compact.payload.contains("watch"));
+  auto summary = proccli::formatCompactSummary(compact);
+  EXPECT_NE(summary.find("dropped"), std::string::npos) << summary;
+}
+
+TEST(SnapshotCompactTest, DownsamplesSeriesAndTruncatesStacks) {
+  proccli::DiagnosticsSnapshot snapshot;
+  proccli::WatchSeries watch;
+  watch.samples.resize(1000);
+  for (size_t i = 0; i < watch.samples.size(); ++i) {
+    watch.samples[i].elapsed_ms = static_cast<double>(i);
+  }
+  snapshot.watch = watch;
+  proccli::ValgrindReport valgrind;
+  proccli::ValgrindSite site;
+  site.kind = "Leak_DefinitelyLost";
+  site.stack.assign(40, "frame");
+  site.leaked_bytes = 64;
+  valgrind.sites.push_back(site);
+  snapshot.valgrind = valgrind;
+  auto compact = proccli::compactSnapshot(snapshot);
+  const auto &samples = compact.payload.at("watch").at("samples");
+  ASSERT_EQ(samples.size(), 32u);
+  EXPECT_EQ(samples.front().at("elapsed_ms"), 0.0);
+  EXPECT_EQ(samples.back().at("elapsed_ms"), 999.0);
+  const auto &kept = compact.payload.at("valgrind").at("sites").at(0);
+  EXPECT_EQ(kept.at("stack").size(), 8u);
+  EXPECT_EQ(kept.at("stack_frames_omitted"), 32);
+}
+
+TEST(SnapshotCompactTest, ClipsLongCommandLinesOnCharacterBoundaries) {
+  proccli::DiagnosticsSnapshot snapshot;
+  std::string command = "x";
+  for (int i = 0; i < 200; ++i) {
+    command += "\xc3\xa9";
+  }
+  snapshot.processes = {{1, 0, command, 100, 200, 0.5, 0.1, "10:00", 1}};
+  proccli::CompactOptions options;
+  options.max_command_chars = 10;
+  auto compact = proccli::compactSnapshot(snapshot, options);
+  auto cmd = compact.payload.at("processes").at("entries").at(0).at("cmd").get<std::string>();
+  EXPECT_EQ(cmd, "x\xc3\xa9\xc3\xa9\xc3\xa9\xc3\xa9...");
+  EXPECT_NO_THROW(compact.payload.dump());
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/snapshot_diff.h"
+
+namespace {
+
+proccli::DiagnosticsSnapshot snapshotWith(int worker_rss_kb, double parse_percent, int read_calls,
+                                          double read_p99_ms) {
+  proccli::DiagnosticsSnapshot snapshot;
+  snapshot.target.pid = 10;
+  snapshot.processes = {{10, 1, "./server", 50000, 90000, 20.0, 1.0, "00:10", 4},
+                        {11, 10, "worker", worker_rss_kb, 8000, 5.0, 0.1, "00:10", 1},
+                        {12, 10, "worker", worker_rss_kb, 8000, 5.0, 0.1, "00:10", 1}};
+  snapshot.io = {{11, 1000, 2000}};
+  proccli::PerfReport perf;
+  perf.hotspots = {{"parse", parse_percent}, {"main", 30.0}};
+  snapshot.perf = perf;
+  proccli::StraceReport strace;
+  proccli::LatencySummary latency;
+  latency.count = read_calls;
+  latency.p99_ms = read_p99_ms;
+  strace.top_syscalls = {{"read", read_calls, read_calls * 0.01, latency},
+                         {"futex", 50, 3.0, std::nullopt}};
+  snapshot.strace = strace;
+  return snapshot;
+}
+
+const proccli::MetricDelta *find(const proccli::SnapshotDiff &diff, const std::string &kind,
+                                 const std::string &key, const std::string &metric) {
+  auto it = std::find_if(diff.deltas.begin(), diff.deltas.end(), [&](const auto &delta) {
+    return delta.kind == kind && delta.key == key && delta.metric == metric;
+  });
+  return it == diff.deltas.end() ? nullptr : &*it;
+}
+
+} // namespace
+
+TEST(SnapshotDiffTest, IdenticalSnapshotsHaveNoDeltas) {
+  auto snapshot = snapshotWith(4000, 40.0, 1000, 0.5);
+  auto diff = proccli::diffSnapshots(snapshot, snapshot);
+  EXPECT_TRUE(diff.deltas.empty());
+  EXPECT_EQ(diff.regressions, 0u);
+}
+
+TEST(SnapshotDiffTest, AlignsByNameAndFlagsRegressionsOverThresholds) {
+  auto baseline = snapshotWith(4000, 40.0, 1000, 0.5);
+  auto current = snapshotWith(12000, 55.0, 1050, 25.0);
+  current.strace->top_syscalls.push_back({"openat", 500, 80.0, std::nullopt});
+  current.perf->hotspots.erase(current.perf->hotspots.begin() + 1);
+
+  auto diff = proccli::diffSnapshots(baseline, current);
+  const auto *rss = find(diff, "process", "worker", "rss_kb");
+  ASSERT_NE(rss, nullptr);
+  EXPECT_DOUBLE_EQ(rss->baseline, 8000.0);
+  EXPECT_DOUBLE_EQ(rss->current, 24000.0);
+  ASSERT_TRUE(rss->relative_percent.has_value());
+  EXPECT_DOUBLE_EQ(*rss->relative_percent, 200.0);
+  EXPECT_TRUE(rss->regression);
+
+  const auto *parse = find(diff, "hotspot", "parse", "percent");
+  ASSERT_NE(parse, nullptr);
+  EXPECT_TRUE(parse->regression);
+  const auto *main = find(diff, "hotspot", "main", "percent");
+  ASSERT_NE(main, nullptr);
+  EXPECT_DOUBLE_EQ(main->current, 0.0);
+  EXPECT_FALSE(main->regression);
+
+  const auto *count = find(diff, "syscall", "read", "count");
+  ASSERT_NE(count, nullptr);
+  EXPECT_FALSE(count->regression);
+  const auto *p99 = find(diff, "syscall", "read", "p99_ms");
+  ASSERT_NE(p99, nullptr);
+  EXPECT_TRUE(p99->regression);
+  const auto *opened = find(diff, "syscall", "openat", "count");
+  ASSERT_NE(opened, nullptr);
+  EXPECT_FALSE(opened->relative_percent.has_value());
+  EXPECT_TRUE(opened->regression);
+
+  EXPECT_EQ(find(diff, "process", "./server", "rss_kb"), nullptr);
+  ASSERT_GT(diff.regressions, 0u);
+  for (size_t i = 0; i < diff.deltas.size(); ++i) {
+    EXPECT_EQ(diff.deltas[i].regression, i < diff.regressions);
+  }
+  auto text = proccli::formatDiff(diff);
+  EXPECT_NE(text.find("process worker rss_kb: 8000 -> 24000 (+16000, +200.0%)"), std::string::npos);
+  nlohmann::json j = diff;
+  EXPECT_EQ(j.at("regressions").get<size_t>(), diff.regressions);
+}
+
+TEST(SnapshotDiffTest, ThresholdsAreConfigurable) {
+  auto baseline = snapshotWith(4000, 40.0, 1000, 0.5);
+  auto current = snapshotWith(12000, 40.0, 1000, 0.5);
+  proccli::DiffThresholds thresholds;
+  std::string error;
+  ASSERT_TRUE(proccli::setDiffThreshold(thresholds, "rss_kb=20000", error)) << error;
+  EXPECT_EQ(proccli::diffSnapshots(baseline, current, thresholds).regressions, 0u);
+  ASSERT_TRUE(proccli::setDiffThreshold(thresholds, "rss_kb=1000", error)) << error;
+  ASSERT_TRUE(proccli::setDiffThreshold(thresholds, "relative=500", error)) << error;
+  EXPECT_EQ(proccli::diffSnapshots(baseline, current, thresholds).regressions, 0u);
+  EXPECT_FALSE(proccli::setDiffThreshold(thresholds, "rss_kb=", error));
+  EXPECT_FALSE(proccli::setDiffThreshold(thresholds, "latency=5", error));
+  EXPECT_FALSE(proccli::setDiffThreshold(thresholds, "cpu=-1", error));
+}
@@ -0,0 +1,126 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include "proccli/perf_sampler.h"
+#include "proccli/stack_trie.h"
+
+namespace {
+
+const char *kPerfScript = R"(# ========
+# captured on: test
+server 1234/1234 [001] 100.000001:     300 cpu-clock:u:
+	    7f00000010 __memmove_avx_unaligned_erms+0x10 (/usr/lib/libc.so.6)
+	    400100 encode_frame+0x20 (/opt/server)
+	    400010 main+0x5 (/opt/server)
+
+server 1234/1234 [001] 100.000002:     100 cpu-clock:u:
+	    7f00000010 __memmove_avx_unaligned_erms+0x10 (/usr/lib/libc.so.6)
+	    400200 parse_request+0x8 (/opt/server)
+	    400010 main+0x5 (/opt/server)
+
+server 1234/1235 [002] 100.000003:     100 cpu-clock:u:
+	    400100 encode_frame+0x44 (/opt/server)
+	    400010 main+0x5 (/opt/server)
+
+my worker 1300/1301 [003] 100.000004:     500 cpu-clock:u:
+	    deadbeef [unknown] (/opt/plugin.so)
+	    400010 main+0x5 (/opt/server)
+)";
+
+} // namespace
+
+TEST(StackTrieTest, FoldsPerfScriptStacks) {
+  std::istringstream input(kPerfScript);
+  proccli::StackTrie trie;
+  ASSERT_TRUE(proccli::parsePerfScript(input, trie));
+  EXPECT_EQ(trie.totalWeight(), 1000u);
+  std::ostringstream folded;
+  trie.writeFolded(folded);
+  EXPECT_EQ(folded.str(),
+            "my worker;main;[plugin.so] 500\n"
+            "server;main;encode_frame 100\n"
+            "server;main;encode_frame;__memmove_avx_unaligned_erms 300\n"
+            "server;main;parse_request;__memmove_avx_unaligned_erms 100\n");
+}
+
+TEST(StackTrieTest, ReportsInclusiveAndExclusiveFrames) {
+  std::istringstream input(kPerfScript);
+  proccli::StackTrie trie;
+  ASSERT_TRUE(proccli::parsePerfScript(input, trie));
+  auto report = proccli::buildStackReport(trie, 10);
+  ASSERT_FALSE(report.frames.empty());
+  EXPECT_EQ(report.frames[0].symbol, "main");
+  EXPECT_DOUBLE_EQ(report.frames[0].inclusive_percent, 100.0);
+  EXPECT_DOUBLE_EQ(report.frames[0].exclusive_percent, 0.0);
+  auto memmove = std::find_if(report.frames.begin(), report.frames.end(), [](const auto &frame) {
+    return frame.symbol == "__memmove_avx_unaligned_erms";
+  });
+  ASSERT_NE(memmove, report.frames.end());
+  EXPECT_DOUBLE_EQ(memmove->inclusive_percent, 40.0);
+  EXPECT_DOUBLE_EQ(memmove->exclusive_percent, 40.0);
+  ASSERT_FALSE(report.hotspots.empty());
+  EXPECT_EQ(report.hotspots[0].symbol, "[plugin.so]");
+  EXPECT_DOUBLE_EQ(report.hotspots[0].percent, 50.0);
+}
+
+TEST(StackTrieTest, CountsRecursiveFramesOnce) {
+  proccli::StackTrie trie;
+  auto root = trie.child(proccli::StackTrie::kRoot, trie.internFrame("app"));
+  auto outer = trie.child(root, trie.internFrame("walk"));
+  auto inner = trie.child(outer, trie.internFrame("walk"));
+  trie.addSample(inner, 4);
+  trie.addSample(outer, 1);
+  auto frames = trie.topFrames(5);
+  ASSERT_EQ(frames.size(), 1u);
+  EXPECT_EQ(frames[0].symbol, "walk");
+  EXPECT_DOUBLE_EQ(frames[0].inclusive_percent, 100.0);
+  EXPECT_DOUBLE_EQ(frames[0].exclusive_percent, 100.0);
+}
+
+TEST(StackTrieTest, RelabelMergesFramesWithSameName) {
+  proccli::StackTrie raw;
+  auto process = raw.child(proccli::StackTrie::kRoot, 1);
+  raw.addSample(raw.child(process, 0x1010), 2);
+  raw.addSample(raw.child(process, 0x1020), 3);
+  raw.addSample(raw.child(process, 0x2000), 5);
+  auto named = raw.relabel([](std::uint64_t frame) -> std::string {
+    if (frame == 1) {
+      return "app";
+    }
+    return frame < 0x2000 ? "hot_loop" : "idle";
+  });
+  std::ostringstream folded;
+  named.writeFolded(folded);
+  EXPECT_EQ(folded.str(), "app;hot_loop 5\napp;idle 5\n");
+}
+
+TEST(StackTrieTest, RendersSelfContainedFlameGraph) {
+  std::istringstream input(kPerfScript);
+  proccli::StackTrie trie;
+  ASSERT_TRUE(proccli::parsePerfScript(input, trie));
+  std::string svg = proccli::renderFlameGraph(trie, "test <profile>");
+  EXPECT_EQ(svg.rfind("<?xml", 0), 0u);
+  EXPECT_NE(svg.find("test &lt;profile&gt;"), std::string::npos);
+  EXPECT_NE(svg.find("<title>encode_frame (400 samples, 40.00%)</title>"), std::string::npos);
+  EXPECT_EQ(svg.find("<script"), std::string::npos);
+  EXPECT_NE(svg.find("</svg>"), std::string::npos);
+}
+
+TEST(StackTrieTest, SkipsOverflowingWeights) {
+  proccli::StackTrie folded;
+  ASSERT_TRUE(proccli::parseFolded("server;main 99999999999999999999999\nserver;main;work 5\n",
+                                   folded));
+  EXPECT_EQ(folded.totalWeight(), 5u);
+
+  std::istringstream input(
+      "server 1234/1234 [001] 100.000001: 99999999999999999999999 cpu-clock:u:\n"
+      "\t    400010 main+0x5 (/opt/server)\n"
+      "\n"
+      "server 1234/1234 [001] 100.000002:     100 cpu-clock:u:\n"
+      "\t    400010 main+0x5 (/opt/server)\n");
+  proccli::StackTrie script;
+  ASSERT_TRUE(proccli::parsePerfScript(input, script));
+  EXPECT_EQ(script.totalWeight(), 100u);
+}
@@ -0,0 +1,119 @@
+#include <gtest/gtest.h>
+
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include <unistd.h>
+
+#include "proccli/collectors.h"
+#include "proccli/sampler.h"
+#include "proccli/scheduler.h"
+#include "proccli/utils.h"
+
+TEST(StraceAggregatorTest, HandlesFollowForkAndResumedLines) {
+  proccli::StraceAggregator aggregator(3);
+  aggregator.addLine("[pid  4242] 12:00:00.000001 read(3, <unfinished ...>");
+  aggregator.addLine("4243  12:00:00.000002 futex(0x7f, FUTEX_WAIT, 0, NULL) = 0 <0.250000>");
+  aggregator.addLine("[pid  4242] 12:00:00.000003 <... read resumed>\"abc\", 3) = 3 <0.000100>");
+  aggregator.addLine("12:00:00.000004 write(1, \"a<b>\", 4) = 4 <0.000200>");
+  aggregator.addLine("--- SIGCHLD {si_signo=SIGCHLD, si_code=CLD_EXITED} ---");
+  aggregator.addLine("+++ exited with 0 +++");
+  auto report = aggregator.report();
+  EXPECT_EQ(aggregator.lines(), 6u);
+  ASSERT_EQ(report.top_syscalls.size(), 3u);
+  ASSERT_EQ(report.slow_syscalls.size(), 3u);
+  EXPECT_EQ(report.slow_syscalls[0].name, "futex");
+  EXPECT_DOUBLE_EQ(report.slow_syscalls[0].duration_ms, 250.0);
+  EXPECT_EQ(report.slow_syscalls[2].name, "read");
+}
+
+TEST(StraceAggregatorTest, KeepsOnlyTopKSlowCalls) {
+  proccli::StraceAggregator aggregator(5);
+  for (int i = 0; i < 100000; ++i) {
+    aggregator.addLine("poll([{fd=3}], 1, 10) = 0 <0.0" + std::to_string(10000 + i % 997) + ">");
+  }
+  auto report = aggregator.report();
+  ASSERT_EQ(report.slow_syscalls.size(), 5u);
+  EXPECT_NEAR(report.slow_syscalls[0].duration_ms, 10.996, 1e-9);
+  EXPECT_GE(report.slow_syscalls[0].duration_ms, report.slow_syscalls[4].duration_ms);
+  ASSERT_EQ(report.top_syscalls.size(), 1u);
+  EXPECT_EQ(report.top_syscalls[0].count, 100000);
+}
+
+TEST(StraceAggregatorTest, KeepsEverySyscallWithLatency) {
+  proccli::StraceAggregator aggregator(1);
+  aggregator.addLine("read(3, \"\", 1) = 0 <0.000010>");
+  aggregator.addLine("read(3, \"\", 1) = 0 <0.000010>");
+  aggregator.addLine("write(1, \"a\", 1) = 1 <0.000020>");
+  aggregator.addLine("futex(0x7f, FUTEX_WAIT, 0, NULL) = 0 <0.500000>");
+  auto report = aggregator.report();
+  ASSERT_EQ(report.slow_syscalls.size(), 1u);
+  ASSERT_EQ(report.top_syscalls.size(), 3u);
+  EXPECT_EQ(report.top_syscalls[0].name, "read");
+  for (const auto &syscall : report.top_syscalls) {
+    ASSERT_TRUE(syscall.latency.has_value()) << syscall.name;
+    EXPECT_EQ(syscall.latency->count, syscall.count);
+  }
+}
+
+TEST(StraceCollectorTest, StreamsFromPipeUntilTimeout) {
+  auto dir = std::filesystem::temp_directory_path() / ("proccli-strace-" + std::to_string(getpid()));
+  std::filesystem::create_directories(dir);
+  auto script = dir / "strace";
+  std::ofstream(script) << "#!/bin/sh\n"
+                           "i=0\n"
+                           "while [ $i -lt 500 ]; do\n"
+                           "  echo \"[pid 42] 12:00:00.000001 read(3, \\\"x\\\", 1) = 1 <0.000010>\" >&2\n"
+                           "  i=$((i+1))\n"
+                           "done\n"
+                           "echo \"12:00:00.000002 nanosleep({tv_sec=1}, NULL) = 0 <1.000100>\" >&2\n"
+                           "exec sleep 30\n";
+  std::filesystem::permissions(script, std::filesystem::perms::owner_all);
+  std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+  setenv("PATH", (dir.string() + ":" + old_path).c_str(), 1);
+  auto raw = dir / "strace.txt";
+  auto result = proccli::StraceCollector::collect(getpid(), 300, raw.string());
+  setenv("PATH", old_path.c_str(), 1);
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.lines, 501u);
+  ASSERT_FALSE(result.report.top_syscalls.empty());
+  EXPECT_EQ(result.report.top_syscalls[0].name, "read");
+  EXPECT_EQ(result.report.top_syscalls[0].count, 500);
+  ASSERT_FALSE(result.report.slow_syscalls.empty());
+  EXPECT_EQ(result.report.slow_syscalls[0].name, "nanosleep");
+  EXPECT_EQ(proccli::readFile(raw.string()).size() > 0, true);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(StraceCollectorTest, KillsStraceThatIgnoresTermOnCancel) {
+  auto dir = std::filesystem::temp_directory_path() /
+             ("proccli-strace-kill-" + std::to_string(getpid()));
+  std::filesystem::create_directories(dir);
+  auto script = dir / "strace";
+  std::ofstream(script) << "#!/bin/sh\n"
+                           "trap '' TERM INT\n"
+                           "echo \"12:00:00.000001 read(3, \\\"x\\\", 1) = 1 <0.000010>\" >&2\n"
+                           "while :; do sleep 1; done\n";
+  std::filesystem::permissions(script, std::filesystem::perms::owner_all);
+  std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+  setenv("PATH", (dir.string() + ":" + old_path).c_str(), 1);
+  proccli::CancelToken cancel(200);
+  double started = proccli::monotonicSeconds();
+  auto result = proccli::StraceCollector::collect(getpid(), 60000, "", &cancel);
+  double elapsed = proccli::monotonicSeconds() - started;
+  setenv("PATH", old_path.c_str(), 1);
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.lines, 1u);
+  EXPECT_LT(elapsed, 5.0);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(StraceCollectorTest, ReportsMissingBinary) {
+  std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+  setenv("PATH", "/nonexistent", 1);
+  auto result = proccli::StraceCollector::collect(getpid(), 100);
+  setenv("PATH", old_path.c_str(), 1);
+  EXPECT_FALSE(result.ok);
+  EXPECT_NE(result.error.find("not found"), std::string::npos);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+class StubHttpServer {
+ public:
+  using Handler = std::function<bool(int fd, const std::string &request)>;
+
+  explicit StubHttpServer(Handler handler) : handler_(std::move(handler)) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t size = sizeof(address);
+    bind(listen_fd_, reinterpret_cast<sockaddr *>(&address), size);
+    listen(listen_fd_, 8);
+    getsockname(listen_fd_, reinterpret_cast<sockaddr *>(&address), &size);
+    port_ = ntohs(address.sin_port);
+    thread_ = std::thread([this] { serve(); });
+  }
+
+  ~StubHttpServer() {
+    stop_ = true;
+    thread_.join();
+    close(listen_fd_);
+  }
+
+  int port() const { return port_; }
+  int connections() const { return connections_; }
+
+  std::vector<std::string> requests() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_;
+  }
+
+  static void send(int fd, std::string_view data) {
+    while (!data.empty()) {
+      ssize_t sent = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+      if (sent <= 0) {
+        return;
+      }
+      data.remove_prefix(static_cast<size_t>(sent));
+    }
+  }
+
+  bool stopping() const { return stop_; }
+
+ private:
+  bool wait(int fd) {
+    while (!stop_) {
+      pollfd entry{fd, POLLIN, 0};
+      if (poll(&entry, 1, 20) > 0) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool readRequest(int fd, std::string &buffer, std::string &request) {
+    while (true) {
+      auto end = buffer.find("\r\n\r\n");
+      if (end != std::string::npos) {
+        size_t length = 0;
+        auto header = buffer.find("Content-Length: ");
+        if (header != std::string::npos && header < end) {
+          length = std::stoul(buffer.substr(header + 16));
+        }
+        if (buffer.size() >= end + 4 + length) {
+          request = buffer.substr(0, end + 4 + length);
+          buffer.erase(0, end + 4 + length);
+          return true;
+        }
+      }
+      if (!wait(fd)) {
+        return false;
+      }
+      char chunk[65536];
+      ssize_t count = recv(fd, chunk, sizeof(chunk), 0);
+      if (count <= 0) {
+        return false;
+      }
+      buffer.append(chunk, static_cast<size_t>(count));
+    }
+  }
+
+  void serve() {
+    while (wait(listen_fd_)) {
+      int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+      if (fd < 0) {
+        continue;
+      }
+      ++connections_;
+      std::string buffer;
+      std::string request;
+      while (readRequest(fd, buffer, request)) {
+        {
+          std::lock_guard<std::mutex> lock(mutex_);
+          requests_.push_back(request);
+        }
+        if (!handler_(fd, request)) {
+          break;
+        }
+      }
+      close(fd);
+    }
+  }
+
+  Handler handler_;
+  int listen_fd_ = -1;
+  int port_ = 0;
+  std::atomic<bool> stop_{false};
+  std::atomic<int> connections_{0};
+  std::mutex mutex_;
+  std::vector<std::string> requests_;
+  std::thread thread_;
+};
@@ -0,0 +1,127 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <csignal>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "proccli/collectors.h"
+#include "proccli/sampler.h"
+#include "proccli/subprocess.h"
+#include "proccli/utils.h"
+
+TEST(SubprocessTest, CapturesStdoutStderrAndExitCode) {
+  auto result = proccli::runProcess({"sh", "-c", "echo out; echo err >&2; exit 3"});
+  ASSERT_TRUE(result.started) << result.error;
+  EXPECT_EQ(result.exit_code, 3);
+  EXPECT_EQ(result.out, "out\n");
+  EXPECT_EQ(result.err, "err\n");
+  EXPECT_EQ(result.stdout_bytes, 4u);
+}
+
+TEST(SubprocessTest, PassesArgumentsWithoutAShell) {
+  auto result = proccli::runProcess({"printf", "%s", "a b;$HOME `id` \"q\""});
+  ASSERT_TRUE(result.started);
+  EXPECT_EQ(result.out, "a b;$HOME `id` \"q\"");
+}
+
+TEST(SubprocessTest, FeedsLargeInputWhileDrainingOutput) {
+  proccli::SubprocessOptions options;
+  options.input.assign(4 << 20, 'x');
+  for (size_t index = 0; index < options.input.size(); index += 100) {
+    options.input[index] = '\n';
+  }
+  auto result = proccli::runProcess({"cat"}, options);
+  EXPECT_EQ(result.exit_code, 0);
+  EXPECT_EQ(result.out, options.input);
+}
+
+TEST(SubprocessTest, StreamsToFileAndLineCallback) {
+  auto path = std::filesystem::temp_directory_path() /
+              ("proccli-subprocess-" + std::to_string(getpid()) + ".txt");
+  proccli::SubprocessOptions to_file;
+  to_file.stdout_path = path.string();
+  auto written = proccli::runProcess({"seq", "1", "1000"}, to_file);
+  EXPECT_EQ(written.exit_code, 0);
+  EXPECT_TRUE(written.out.empty());
+  std::string content = proccli::readFile(path.string());
+  EXPECT_EQ(written.stdout_bytes, content.size());
+  EXPECT_EQ(content.substr(0, 4), "1\n2\n");
+  std::filesystem::remove(path);
+
+  std::vector<std::string> lines;
+  proccli::SubprocessOptions to_lines;
+  to_lines.on_stdout_line = [&](std::string_view line) { lines.emplace_back(line); };
+  proccli::runProcess({"printf", "a\nbb\nccc"}, to_lines);
+  EXPECT_EQ(lines, (std::vector<std::string>{"a", "bb", "ccc"}));
+
+  lines.clear();
+  to_lines.stdout_path = path.string();
+  to_lines.merge_stderr = true;
+  auto teed = proccli::runProcess({"sh", "-c", "echo out; echo err >&2"}, to_lines);
+  EXPECT_TRUE(teed.err.empty());
+  EXPECT_EQ(lines, (std::vector<std::string>{"out", "err"}));
+  EXPECT_EQ(proccli::readFile(path.string()), "out\nerr\n");
+  std::filesystem::remove(path);
+}
+
+TEST(SubprocessTest, CapturesOutputLargerThanOneBlock) {
+  auto result = proccli::runProcess({"head", "-c", "10000000", "/dev/zero"});
+  EXPECT_EQ(result.exit_code, 0);
+  EXPECT_EQ(result.out.size(), 10000000u);
+  EXPECT_EQ(result.out.find_first_not_of('\0'), std::string::npos);
+}
+
+TEST(SubprocessTest, TerminatesWhenStopIsRequested) {
+  proccli::SubprocessOptions options;
+  double started = proccli::monotonicSeconds();
+  options.stop_requested = [started] { return proccli::monotonicSeconds() - started > 0.1; };
+  auto result = proccli::runProcess({"sleep", "10"}, options);
+  EXPECT_LT(proccli::monotonicSeconds() - started, 2.0);
+  EXPECT_TRUE(result.stopped);
+  EXPECT_FALSE(result.timed_out);
+  EXPECT_EQ(result.term_signal, SIGTERM);
+}
+
+TEST(SubprocessTest, TerminatesOnTimeout) {
+  proccli::SubprocessOptions options;
+  options.timeout_ms = 100;
+  double started = proccli::monotonicSeconds();
+  auto result = proccli::runProcess({"sleep", "10"}, options);
+  EXPECT_LT(proccli::monotonicSeconds() - started, 2.0);
+  EXPECT_TRUE(result.timed_out);
+  EXPECT_EQ(result.term_signal, SIGTERM);
+  EXPECT_NE(result.error.find("timed out"), std::string::npos);
+}
+
+TEST(SubprocessTest, TerminatesOnTimeoutAfterOutputCloses) {
+  proccli::SubprocessOptions options;
+  options.timeout_ms = 100;
+  double started = proccli::monotonicSeconds();
+  auto result = proccli::runProcess({"sh", "-c", "exec >&- 2>&-; sleep 10"}, options);
+  EXPECT_LT(proccli::monotonicSeconds() - started, 2.0);
+  EXPECT_TRUE(result.timed_out);
+  EXPECT_EQ(result.term_signal, SIGTERM);
+}
+
+TEST(SubprocessTest, EscalatesToKillWhenTermIsIgnored) {
+  proccli::SubprocessOptions options;
+  options.timeout_ms = 100;
+  options.kill_grace_ms = 100;
+  double started = proccli::monotonicSeconds();
+  auto result = proccli::runProcess({"sh", "-c", "trap '' TERM; sleep 10"}, options);
+  EXPECT_LT(proccli::monotonicSeconds() - started, 3.0);
+  EXPECT_TRUE(result.timed_out);
+  EXPECT_EQ(result.term_signal, SIGKILL);
+}
+
+TEST(SubprocessTest, ReportsMissingExecutable) {
+  auto result = proccli::runProcess({"proccli-no-such-binary"});
+  EXPECT_FALSE(result.started);
+  EXPECT_EQ(result.spawn_errno, ENOENT);
+  EXPECT_NE(result.error.find("cannot run"), std::string::npos);
+  EXPECT_EQ(proccli::runCommand({"proccli-no-such-binary"}).exit_code, 127);
+}
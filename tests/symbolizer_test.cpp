@@ -0,0 +1,89 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+
+#include <unistd.h>
+
+#include "proccli/symbolizer.h"
+
+extern "C" __attribute__((noinline)) int proccli_symbolizer_probe(int value) {
+  asm volatile("" ::: "memory");
+  return value * 3 + 1;
+}
+
+namespace {
+
+std::filesystem::path tempCacheDir() {
+  auto dir = std::filesystem::temp_directory_path() /
+             ("proccli-symbols-" + std::to_string(getpid()));
+  std::filesystem::remove_all(dir);
+  return dir;
+}
+
+} // namespace
+
+TEST(SymbolizerTest, ResolvesFunctionInOwnBinary) {
+  auto cache = tempCacheDir();
+  proccli::Symbolizer symbolizer(cache.string());
+  auto ip = reinterpret_cast<std::uint64_t>(&proccli_symbolizer_probe) + 4;
+  auto frame = symbolizer.resolve(getpid(), ip);
+  EXPECT_EQ(frame.symbol, "proccli_symbolizer_probe");
+  EXPECT_FALSE(frame.module.empty());
+  EXPECT_EQ(symbolizer.describe(getpid(), ip), "proccli_symbolizer_probe");
+  std::filesystem::remove_all(cache);
+}
+
+TEST(SymbolizerTest, CachesTableByBuildId) {
+  auto cache = tempCacheDir();
+  auto first = proccli::ElfSymbolTable::load("/proc/self/exe", cache.string());
+  ASSERT_TRUE(first);
+  if (first->buildId().empty()) {
+    GTEST_SKIP() << "test binary has no build-id";
+  }
+  EXPECT_FALSE(first->loadedFromCache());
+  EXPECT_TRUE(std::filesystem::exists(cache / (first->buildId() + ".sym")));
+  auto second = proccli::ElfSymbolTable::load("/proc/self/exe", cache.string());
+  ASSERT_TRUE(second);
+  EXPECT_TRUE(second->loadedFromCache());
+  EXPECT_EQ(second->size(), first->size());
+  std::filesystem::remove_all(cache);
+}
+
+TEST(SymbolizerTest, RebuildsTableWhenCacheIsCorrupt) {
+  auto cache = tempCacheDir();
+  auto first = proccli::ElfSymbolTable::load("/proc/self/exe", cache.string());
+  ASSERT_TRUE(first);
+  if (first->buildId().empty()) {
+    GTEST_SKIP() << "test binary has no build-id";
+  }
+  auto path = cache / (first->buildId() + ".sym");
+  std::uint64_t huge = std::uint64_t{1} << 60;
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    file.seekp(8);
+    file.write(reinterpret_cast<const char *>(&huge), sizeof(huge));
+  }
+  auto second = proccli::ElfSymbolTable::load("/proc/self/exe", cache.string());
+  ASSERT_TRUE(second);
+  EXPECT_FALSE(second->loadedFromCache());
+  EXPECT_EQ(second->size(), first->size());
+
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) / 2);
+  auto third = proccli::ElfSymbolTable::load("/proc/self/exe", cache.string());
+  ASSERT_TRUE(third);
+  EXPECT_FALSE(third->loadedFromCache());
+  EXPECT_EQ(third->size(), first->size());
+  std::filesystem::remove_all(cache);
+}
+
+TEST(SymbolizerTest, FallsBackToModuleOffset) {
+  proccli::Symbolizer symbolizer("");
+  EXPECT_EQ(symbolizer.describe(getpid(), 0x10).rfind("[unknown]+0x", 0), 0u);
+}
+
+TEST(SymbolizerTest, DemanglesCxxNames) {
+  EXPECT_EQ(proccli::demangle("_ZN7proccli11ProcScanner4scanEv"), "proccli::ProcScanner::scan()");
+  EXPECT_EQ(proccli::demangle("main"), "main");
+}
@@ -0,0 +1,190 @@
+#include <gtest/gtest.h>
+
+#include <csignal>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <nlohmann/json.hpp>
+
+#include "proccli/collectors.h"
+#include "proccli/sampler.h"
+#include "proccli/scheduler.h"
+#include "proccli/utils.h"
+#include "proccli/valgrind_xml.h"
+
+namespace {
+
+std::string sampleXml() {
+  return proccli::readFile(std::string(PROCCLI_TEST_DATA_DIR) + "/valgrind_xml.xml");
+}
+
+std::string leakError(int index, int site) {
+  return "<error><unique>0x" + std::to_string(index) +
+         "</unique><tid>1</tid><kind>Leak_DefinitelyLost</kind><xwhat><text>16 bytes in 1 "
+         "blocks are definitely lost</text><leakedbytes>16</leakedbytes><leakedblocks>1"
+         "</leakedblocks></xwhat><stack><frame><ip>0x1</ip><fn>malloc</fn></frame><frame>"
+         "<ip>0x2</ip><fn>alloc_" +
+         std::to_string(site) + "</fn><file>a.c</file><line>" + std::to_string(site) +
+         "</line></frame></stack></error>\n";
+}
+
+std::string invalidRead(int index, int site) {
+  return "<error><unique>0x" + std::to_string(index) +
+         "</unique><tid>1</tid><kind>InvalidRead</kind><what>Invalid read of size 4</what>"
+         "<stack><frame><ip>0x3</ip><fn>read_" +
+         std::to_string(site) + "</fn><file>b.c</file><line>" + std::to_string(site) +
+         "</line></frame></stack></error>\n";
+}
+
+std::filesystem::path installFakeValgrind(const std::string &old_path) {
+  auto dir = std::filesystem::temp_directory_path() / ("proccli-valgrind-" + std::to_string(getpid()));
+  std::filesystem::create_directories(dir);
+  auto script = dir / "valgrind";
+  std::ofstream(script) << "#!/bin/sh\n"
+                           "while [ $# -gt 0 ]; do\n"
+                           "  case \"$1\" in\n"
+                           "    --xml-fd=*) fd=\"${1#--xml-fd=}\" ;;\n"
+                           "    --*) ;;\n"
+                           "    *) break ;;\n"
+                           "  esac\n"
+                           "  shift\n"
+                           "done\n"
+                           "eval \"cat \\\"\\$PROCCLI_FAKE_VALGRIND_XML\\\" >&$fd\"\n"
+                           "exec \"$@\"\n";
+  std::filesystem::permissions(script, std::filesystem::perms::owner_all);
+  setenv("PATH", (dir.string() + ":" + old_path).c_str(), 1);
+  std::string xml_path = std::string(PROCCLI_TEST_DATA_DIR) + "/valgrind_xml.xml";
+  setenv("PROCCLI_FAKE_VALGRIND_XML", xml_path.c_str(), 1);
+  return dir;
+}
+
+} // namespace
+
+TEST(ValgrindXmlParserTest, AggregatesErrorsLeaksAndErrorCounts) {
+  auto report = proccli::ValgrindCollector::parseXml(sampleXml());
+  ASSERT_TRUE(report);
+  ASSERT_EQ(report->errors.size(), 4u);
+  EXPECT_EQ(report->errors[0].kind, "InvalidRead");
+  EXPECT_EQ(report->errors[0].count, 12);
+  ASSERT_TRUE(report->leak_summary);
+  EXPECT_EQ(report->leak_summary->definitely_lost_kb, 5);
+  ASSERT_EQ(report->sites.size(), 4u);
+  const auto &leak = report->sites[0];
+  EXPECT_EQ(leak.kind, "Leak_DefinitelyLost");
+  EXPECT_EQ(leak.count, 2);
+  EXPECT_EQ(leak.leaked_bytes, 5120);
+  EXPECT_EQ(leak.leaked_blocks, 5);
+  ASSERT_EQ(leak.stack.size(), 3u);
+  EXPECT_EQ(leak.stack[1], "make_buffer(unsigned long) (leaky.cc:31)");
+  const auto &uninit = report->sites[3];
+  EXPECT_EQ(uninit.stack[0], "check<int>(int const&) (leaky.cc:24)");
+  EXPECT_EQ(report->sites[2].stack.size(), 2u);
+}
+
+TEST(ValgrindXmlParserTest, ByteAtATimeFeedMatchesWholeDocument) {
+  std::string xml = sampleXml();
+  proccli::ValgrindXmlParser parser;
+  for (char ch : xml) {
+    parser.feed(std::string_view(&ch, 1));
+  }
+  EXPECT_EQ(nlohmann::json(parser.report()),
+            nlohmann::json(*proccli::ValgrindCollector::parseXml(xml)));
+}
+
+TEST(ValgrindXmlParserTest, SiteTableStaysBounded) {
+  proccli::ValgrindXmlParser parser(64);
+  parser.feed("<?xml version=\"1.0\"?>\n<valgrindoutput>\n");
+  for (int index = 0; index < 200000; ++index) {
+    parser.feed(leakError(index, index % 1000));
+  }
+  parser.feed("</valgrindoutput>\n");
+  auto report = parser.report(10);
+  EXPECT_EQ(parser.errors(), 200000u);
+  ASSERT_EQ(report.errors.size(), 1u);
+  EXPECT_EQ(report.errors[0].count, 200000);
+  EXPECT_EQ(report.leak_summary->definitely_lost_kb, 200000 * 16 / 1024);
+  ASSERT_EQ(report.sites.size(), 10u);
+  EXPECT_EQ(report.sites[0].count, 200);
+  EXPECT_EQ(report.unattributed_errors, 200000 - 64 * 200);
+}
+
+TEST(ValgrindXmlParserTest, LeaksKeepSitesAfterTableFillsWithErrors) {
+  proccli::ValgrindXmlParser parser(64);
+  parser.feed("<?xml version=\"1.0\"?>\n<valgrindoutput>\n");
+  for (int index = 0; index < 1000; ++index) {
+    parser.feed(invalidRead(index, index));
+  }
+  for (int index = 0; index < 10; ++index) {
+    parser.feed(leakError(1000 + index, index));
+  }
+  parser.feed("</valgrindoutput>\n");
+  auto report = parser.report(10);
+  EXPECT_EQ(parser.errors(), 1010u);
+  EXPECT_EQ(report.unattributed_errors, 1000 - 64);
+  ASSERT_EQ(report.sites.size(), 10u);
+  for (const auto &site : report.sites) {
+    EXPECT_EQ(site.kind, "Leak_DefinitelyLost");
+    EXPECT_EQ(site.leaked_bytes, 16);
+  }
+}
+
+TEST(ValgrindCollectorTest, StreamsXmlFromFakeValgrind) {
+  std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+  auto dir = installFakeValgrind(old_path);
+
+  proccli::ValgrindCollector collector;
+  proccli::ValgrindRunOptions options;
+  options.xml_path = (dir / "valgrind.xml").string();
+  std::string error;
+  int pid = collector.start("sh -c \"exit 3\"", options, error);
+  ASSERT_GT(pid, 0) << error;
+  auto result = collector.finish();
+  setenv("PATH", old_path.c_str(), 1);
+  unsetenv("PROCCLI_FAKE_VALGRIND_XML");
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.exit_code, 3);
+  EXPECT_EQ(result.errors, 18u);
+  EXPECT_EQ(result.report.sites.size(), 4u);
+  EXPECT_EQ(proccli::readFile(options.xml_path), sampleXml());
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ValgrindCollectorTest, KillsValgrindWhenCancelled) {
+  std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+  auto dir = installFakeValgrind(old_path);
+
+  proccli::ValgrindCollector collector;
+  std::string error;
+  int pid = collector.start("sh -c \"trap '' TERM; while :; do sleep 1; done\"", {}, error);
+  ASSERT_GT(pid, 0) << error;
+  proccli::CancelToken cancel(200);
+  double started = proccli::monotonicSeconds();
+  auto result = collector.finish(&cancel);
+  double elapsed = proccli::monotonicSeconds() - started;
+  setenv("PATH", old_path.c_str(), 1);
+  unsetenv("PROCCLI_FAKE_VALGRIND_XML");
+  ASSERT_TRUE(result.ok) << result.error;
+  EXPECT_EQ(result.exit_code, 128 + SIGKILL);
+  EXPECT_EQ(result.errors, 18u);
+  EXPECT_GE(elapsed, 2.0);
+  EXPECT_LT(elapsed, 5.0);
+  std::filesystem::remove_all(dir);
+}
+
+TEST(ValgrindCollectorTest, ReportsMissingBinaryAndUnsupportedTools) {
+  std::string old_path = std::getenv("PATH") ? std::getenv("PATH") : "";
+  setenv("PATH", "/nonexistent", 1);
+  proccli::ValgrindCollector collector;
+  std::string error;
+  EXPECT_LT(collector.start("true", {}, error), 0);
+  EXPECT_NE(error.find("not found"), std::string::npos);
+  setenv("PATH", old_path.c_str(), 1);
+  proccli::ValgrindRunOptions options;
+  options.tool = "cachegrind";
+  EXPECT_LT(collector.start("true", options, error), 0);
+  EXPECT_NE(error.find("not supported"), std::string::npos);
+}